@@ -11,6 +11,7 @@ dirs := \
 	gl_basic \
 	gl_perf \
 	gl_yuvtex \
+	gltrace \
 	gralloc \
 	hwc \
 	include \
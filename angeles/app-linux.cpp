@@ -54,6 +54,7 @@
 
 #include <EGLUtils.h>
 #include <WindowSurface.h>
+#include <glTestFrame.h>
 
 using namespace android;
 
@@ -118,7 +119,7 @@ static void checkEGLErrors()
         fprintf(stderr, "EGL Error: 0x%04x\n", (int)error);
 }
 
-static int initGraphics(EGLint samples, const WindowSurface& windowSurface)
+static int initGraphics(EGLint samples, WindowSurface& windowSurface)
 {
     EGLint configAttribs[] = {
             EGL_DEPTH_SIZE, 16,
@@ -135,19 +136,16 @@ static int initGraphics(EGLint samples, const WindowSurface& windowSurface)
     EGLint w, h;
     EGLDisplay dpy;
 
-    EGLNativeWindowType window = windowSurface.getSurface();
-
-    dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    dpy = windowSurface.getDisplay();
     eglInitialize(dpy, &majorVersion, &minorVersion);
 
-    status_t err = EGLUtils::selectConfigForNativeWindow(
-            dpy, configAttribs, window, &config);
+    status_t err = windowSurface.selectConfig(dpy, configAttribs, &config);
     if (err) {
         fprintf(stderr, "couldn't find an EGLConfig matching the screen format\n");
         return 0;
     }
 
-    surface = eglCreateWindowSurface(dpy, config, window, NULL);
+    surface = windowSurface.createEGLSurface(dpy, config);
     egl_error("eglCreateWindowSurface");
 
     fprintf(stderr,"surface = %p\n", surface);
@@ -156,11 +154,11 @@ static int initGraphics(EGLint samples, const WindowSurface& windowSurface)
     egl_error("eglCreateContext");
     fprintf(stderr,"context = %p\n", context);
 
-    eglMakeCurrent(dpy, surface, surface, context);
+    windowSurface.makeCurrent(dpy, surface, context);
     egl_error("eglMakeCurrent");
 
-    eglQuerySurface(dpy, surface, EGL_WIDTH, &sWindowWidth);
-    eglQuerySurface(dpy, surface, EGL_HEIGHT, &sWindowHeight);
+    sWindowWidth = windowSurface.getWidth();
+    sWindowHeight = windowSurface.getHeight();
 
     sEglDisplay = dpy;
     sEglSurface = surface;
@@ -175,11 +173,13 @@ static int initGraphics(EGLint samples, const WindowSurface& windowSurface)
 }
 
 
-static void deinitGraphics()
+static void deinitGraphics(WindowSurface& windowSurface)
 {
     eglMakeCurrent(sEglDisplay, NULL, NULL, NULL);
-    eglDestroyContext(sEglDisplay, sEglContext);
-    eglDestroySurface(sEglDisplay, sEglSurface);
+    windowSurface.destroyContext(sEglDisplay, sEglContext);
+    if (sEglSurface != EGL_NO_SURFACE) {
+        eglDestroySurface(sEglDisplay, sEglSurface);
+    }
     eglTerminate(sEglDisplay);
 }
 
@@ -202,6 +202,7 @@ int main(int argc, char *argv[])
 
     appInit();
 
+    GLTestFrameRecorder recorder(sEglDisplay, sEglSurface, 1 << 16);
     struct timeval timeTemp;
     int frameCount = 0;
     gettimeofday(&timeTemp, NULL);
@@ -215,19 +216,21 @@ int main(int argc, char *argv[])
         appRender(timeNow.tv_sec * 1000 + timeNow.tv_usec / 1000,
                 sWindowWidth, sWindowHeight);
         checkGLErrors();
-        eglSwapBuffers(sEglDisplay, sEglSurface);
+        recorder.swapBuffers(windowSurface);
         checkEGLErrors();
         frameCount++;
     }
 
     gettimeofday(&timeTemp, NULL);
+    recorder.flush();
 
     appDeinit();
-    deinitGraphics();
+    deinitGraphics(windowSurface);
 
     totalTime = (timeTemp.tv_usec/1000000.0 + timeTemp.tv_sec) - totalTime;
     printf("totalTime=%f s, frameCount=%d, %.2f fps\n",
             totalTime, frameCount, frameCount/totalTime);
+    recorder.report("angeles");
 
     return EXIT_SUCCESS;
 }
@@ -24,9 +24,9 @@
 #include <GLES/gl.h>
 #include <GLES/glext.h>
 
-#include <utils/StopWatch.h>
 #include <WindowSurface.h>
 #include <EGLUtils.h>
+#include <glTestBench.h>
 
 using namespace android;
 
@@ -46,23 +46,21 @@ int main(int argc, char** argv)
      EGLDisplay dpy;
 
      WindowSurface windowSurface;
-     EGLNativeWindowType window = windowSurface.getSurface();
-     
-     dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+     dpy = windowSurface.getDisplay();
      eglInitialize(dpy, &majorVersion, &minorVersion);
           
-     status_t err = EGLUtils::selectConfigForNativeWindow(
-             dpy, configAttribs, window, &config);
+     status_t err = windowSurface.selectConfig(dpy, configAttribs, &config);
      if (err) {
          fprintf(stderr, "couldn't find an EGLConfig matching the screen format\n");
          return 0;
      }
 
-     surface = eglCreateWindowSurface(dpy, config, window, NULL);
+     surface = windowSurface.createEGLSurface(dpy, config);
      context = eglCreateContext(dpy, config, NULL, NULL);
-     eglMakeCurrent(dpy, surface, surface, context);   
-     eglQuerySurface(dpy, surface, EGL_WIDTH, &w);
-     eglQuerySurface(dpy, surface, EGL_HEIGHT, &h);
+     windowSurface.makeCurrent(dpy, surface, context);
+     w = windowSurface.getWidth();
+     h = windowSurface.getHeight();
      
      printf("w=%d, h=%d\n", w, h);
      
@@ -124,36 +122,34 @@ int main(int argc, char** argv)
      glClearColor(1,0,0,0);
      glClear(GL_COLOR_BUFFER_BIT);
      glDrawArrays(GL_TRIANGLE_FAN, 0, 4); 
-     eglSwapBuffers(dpy, surface);
+     windowSurface.swapBuffers(dpy, surface);
      
 
-     nsecs_t times[32];
+     GLTestBenchResult results[32];
 
      for (int c=1 ; c<32 ; c++) {
-         glClear(GL_COLOR_BUFFER_BIT);
-         for (int i=0 ; i<c ; i++) {
-             glDrawArrays(GL_TRIANGLE_FAN, 0, 4); 
+         char name[32];
+         snprintf(name, sizeof(name), "fill x%d", c);
+         GLTestBenchConfig benchConfig;
+         benchConfig.workPerIteration = double(c) * w * h / 1000000.0;
+         benchConfig.workUnits = "Mpixels";
+         GLTestBench bench(name, benchConfig);
+         while (!bench.done()) {
+             glClear(GL_COLOR_BUFFER_BIT);
+             uint64_t now = glTestBenchNow();
+             for (int i=0 ; i<c ; i++) {
+                 glDrawArrays(GL_TRIANGLE_FAN, 0, 4); 
+             }
+             windowSurface.swapBuffers(dpy, surface);
+             bench.addSample(glTestBenchNow() - now);
          }
-         eglSwapBuffers(dpy, surface);
+         bench.report();
+         results[c] = bench.result();
      }
 
-
-     //     for (int c=31 ; c>=1 ; c--) {
-     int j=0;
      for (int c=1 ; c<32 ; c++) {
-         glClear(GL_COLOR_BUFFER_BIT);
-         nsecs_t now = systemTime();
-         for (int i=0 ; i<c ; i++) {
-             glDrawArrays(GL_TRIANGLE_FAN, 0, 4); 
-         }
-         eglSwapBuffers(dpy, surface);
-         nsecs_t t = systemTime() - now;
-         times[j++] = t;
-     }
-
-     for (int c=1, j=0 ; c<32 ; c++, j++) {
-         nsecs_t t = times[j];
-         printf("%lld\t%d\t%f\n", t, c, (double(t)/c)/1000000.0);
+         double t = results[c].median;
+         printf("%.0f\t%d\t%f\n", t, c, (t/c)/1000000.0);
      }
 
 
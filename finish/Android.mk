@@ -12,9 +12,10 @@ LOCAL_SHARED_LIBRARIES := \
     libui \
     libgui
 
-LOCAL_STATIC_LIBRARIES += libglTest
+LOCAL_STATIC_LIBRARIES += libglTest libtestUtil
 
-LOCAL_C_INCLUDES += $(call include-path-for, opengl-tests-includes)
+LOCAL_C_INCLUDES += system/extras/tests/include \
+	$(call include-path-for, opengl-tests-includes)
 
 LOCAL_MODULE:= test-opengl-finish
 
@@ -28,9 +28,53 @@
 
 #include <WindowSurface.h>
 #include <EGLUtils.h>
+#include <glTestBench.h>
+#include <glTestLib.h>
 
 using namespace android;
 
+/*
+ * Times count glDrawTexiOES() blits of a crop x crop texture region,
+ * drawn at blit x blit.  When drained, each sample runs through the
+ * following glFinish(); when pipelined, it is the whole frame, including
+ * the swap and any wait for the frames in flight.  When modify is set, a
+ * texel is updated before each iteration.
+ */
+static void timeBlit(WindowSurface& windowSurface, EGLDisplay dpy,
+        EGLSurface surface, GLTestFrameLimiter& limiter, const char* name,
+        GLint crop, GLint blit, int count, bool modify)
+{
+    GLint cropRect[4] = { 0, crop, crop, -crop };
+    char benchName[128];
+    snprintf(benchName, sizeof(benchName), "%s, %s", name, limiter.name());
+    GLTestBench bench(benchName);
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    while (!bench.done()) {
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_CROP_RECT_OES, cropRect);
+        if (modify) {
+            uint16_t green = 0x7E0;
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGB,
+                    GL_UNSIGNED_SHORT_5_6_5, &green);
+        }
+        uint64_t now = glTestBenchNow();
+        for (int i = 0; i < count; i++) {
+            glDrawTexiOES(0, 0, 0, blit, blit);
+        }
+        if (limiter.drained()) {
+            glFinish();
+            bench.addSample(glTestBenchNow() - now);
+            windowSurface.swapBuffers(dpy, surface);
+        } else {
+            windowSurface.swapBuffers(dpy, surface);
+            limiter.frameEnd();
+            bench.addSample(glTestBenchNow() - now);
+        }
+    }
+    limiter.drain();
+    bench.report();
+}
+
 int main(int argc, char** argv)
 {
     EGLint configAttribs[] = {
@@ -47,23 +91,21 @@ int main(int argc, char** argv)
      EGLDisplay dpy;
 
      WindowSurface windowSurface;
-     EGLNativeWindowType window = windowSurface.getSurface();
-     
-     dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+     dpy = windowSurface.getDisplay();
      eglInitialize(dpy, &majorVersion, &minorVersion);
           
-     status_t err = EGLUtils::selectConfigForNativeWindow(
-             dpy, configAttribs, window, &config);
+     status_t err = windowSurface.selectConfig(dpy, configAttribs, &config);
      if (err) {
          fprintf(stderr, "couldn't find an EGLConfig matching the screen format\n");
          return 0;
      }
 
-     surface = eglCreateWindowSurface(dpy, config, window, NULL);
+     surface = windowSurface.createEGLSurface(dpy, config);
      context = eglCreateContext(dpy, config, NULL, NULL);
-     eglMakeCurrent(dpy, surface, surface, context);   
-     eglQuerySurface(dpy, surface, EGL_WIDTH, &w);
-     eglQuerySurface(dpy, surface, EGL_HEIGHT, &h);
+     windowSurface.makeCurrent(dpy, surface, context);
+     w = windowSurface.getWidth();
+     h = windowSurface.getHeight();
      GLint dim = w<h ? w : h;
 
      glBindTexture(GL_TEXTURE_2D, 0);
@@ -75,9 +117,6 @@ int main(int argc, char** argv)
      glDisable(GL_DITHER);
      glShadeModel(GL_FLAT);
 
-     long long now, t;
-     int i;
-
      char* texels = (char*)malloc(512*512*2);
      memset(texels,0xFF,512*512*2);
      
@@ -86,142 +125,43 @@ int main(int argc, char** argv)
 
      char* dst = (char*)malloc(320*480*2);
      memset(dst, 0, 320*480*2);
-     printf("307200 bytes memcpy\n");
-     for (i=0 ; i<4 ; i++) {
-         now = systemTime();
+     GLTestBench memcpyBench("307200 bytes memcpy");
+     while (memcpyBench.iterate()) {
          memcpy(dst, texels, 320*480*2);
-         t = systemTime();
-         printf("memcpy() time = %llu us\n", (t-now)/1000);
-         fflush(stdout);
      }
+     memcpyBench.report();
      free(dst);
 
      free(texels);
 
      setpriority(PRIO_PROCESS, 0, -20);
-     
-     printf("512x512 unmodified texture, 512x512 blit:\n");
-     glClear(GL_COLOR_BUFFER_BIT);
-     for (i=0 ; i<4 ; i++) {
-         GLint crop[4] = { 0, 512, 512, -512 };
-         glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_CROP_RECT_OES, crop);
-         now = systemTime();
-         glDrawTexiOES(0, 0, 0, 512, 512);
-         glFinish();
-         t = systemTime();
-         printf("glFinish() time = %llu us\n", (t-now)/1000);
-         fflush(stdout);
-         eglSwapBuffers(dpy, surface);
-     }
-     
-     printf("512x512 unmodified texture, 1x1 blit:\n");
-     glClear(GL_COLOR_BUFFER_BIT);
-     for (i=0 ; i<4 ; i++) {
-         GLint crop[4] = { 0, 1, 1, -1 };
-         glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_CROP_RECT_OES, crop);
-         now = systemTime();
-         glDrawTexiOES(0, 0, 0, 1, 1);
-         glFinish();
-         t = systemTime();
-         printf("glFinish() time = %llu us\n", (t-now)/1000);
-         fflush(stdout);
-         eglSwapBuffers(dpy, surface);
-     }
-     
-     printf("512x512 unmodified texture, 512x512 blit (x2):\n");
-     glClear(GL_COLOR_BUFFER_BIT);
-     for (i=0 ; i<4 ; i++) {
-         GLint crop[4] = { 0, 512, 512, -512 };
-         glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_CROP_RECT_OES, crop);
-         now = systemTime();
-         glDrawTexiOES(0, 0, 0, 512, 512);
-         glDrawTexiOES(0, 0, 0, 512, 512);
-         glFinish();
-         t = systemTime();
-         printf("glFinish() time = %llu us\n", (t-now)/1000);
-         fflush(stdout);
-         eglSwapBuffers(dpy, surface);
-     }
-
-     printf("512x512 unmodified texture, 1x1 blit (x2):\n");
-     glClear(GL_COLOR_BUFFER_BIT);
-     for (i=0 ; i<4 ; i++) {
-         GLint crop[4] = { 0, 1, 1, -1 };
-         glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_CROP_RECT_OES, crop);
-         now = systemTime();
-         glDrawTexiOES(0, 0, 0, 1, 1);
-         glDrawTexiOES(0, 0, 0, 1, 1);
-         glFinish();
-         t = systemTime();
-         printf("glFinish() time = %llu us\n", (t-now)/1000);
-         fflush(stdout);
-         eglSwapBuffers(dpy, surface);
-     }
-
-     
-     printf("512x512 (1x1 texel MODIFIED texture), 512x512 blit:\n");
-     glClear(GL_COLOR_BUFFER_BIT);
-     for (i=0 ; i<4 ; i++) {
-         uint16_t green = 0x7E0;
-         GLint crop[4] = { 0, 512, 512, -512 };
-         glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_CROP_RECT_OES, crop);
-         glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, &green);
-         now = systemTime();
-         glDrawTexiOES(0, 0, 0, 512, 512);
-         glFinish();
-         t = systemTime();
-         printf("glFinish() time = %llu us\n", (t-now)/1000);
-         fflush(stdout);
-         eglSwapBuffers(dpy, surface);
-     }
 
+     GLTestFrameLimiter limiter;
+
+     timeBlit(windowSurface, dpy, surface, limiter,
+             "512x512 unmodified texture, 512x512 blit", 512, 512, 1, false);
+     timeBlit(windowSurface, dpy, surface, limiter,
+             "512x512 unmodified texture, 1x1 blit", 1, 1, 1, false);
+     timeBlit(windowSurface, dpy, surface, limiter,
+             "512x512 unmodified texture, 512x512 blit (x2)", 512, 512, 2,
+             false);
+     timeBlit(windowSurface, dpy, surface, limiter,
+             "512x512 unmodified texture, 1x1 blit (x2)", 1, 1, 2, false);
+     timeBlit(windowSurface, dpy, surface, limiter,
+             "512x512 (1x1 texel MODIFIED texture), 512x512 blit", 512, 512,
+             1, true);
 
      int16_t texel = 0xF800;
      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB,
              1, 1, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, &texel);
 
-     printf("1x1 unmodified texture, 1x1 blit:\n");
-     glClear(GL_COLOR_BUFFER_BIT);
-     for (i=0 ; i<4 ; i++) {
-         GLint crop[4] = { 0, 1, 1, -1 };
-         glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_CROP_RECT_OES, crop);
-         now = systemTime();
-         glDrawTexiOES(0, 0, 0, 1, 1);
-         glFinish();
-         t = systemTime();
-         printf("glFinish() time = %llu us\n", (t-now)/1000);
-         eglSwapBuffers(dpy, surface);
-     }
-
-     printf("1x1 unmodified texture, 512x512 blit:\n");
-     glClear(GL_COLOR_BUFFER_BIT);
-     for (i=0 ; i<4 ; i++) {
-         GLint crop[4] = { 0, 1, 1, -1 };
-         glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_CROP_RECT_OES, crop);
-         now = systemTime();
-         glDrawTexiOES(0, 0, 0, 512, 512);
-         glFinish();
-         t = systemTime();
-         printf("glFinish() time = %llu us\n", (t-now)/1000);
-         fflush(stdout);
-         eglSwapBuffers(dpy, surface);
-     }
-
-     printf("1x1 (1x1 texel MODIFIED texture), 512x512 blit:\n");
-     glClear(GL_COLOR_BUFFER_BIT);
-     for (i=0 ; i<4 ; i++) {
-         uint16_t green = 0x7E0;
-         GLint crop[4] = { 0, 1, 1, -1 };
-         glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_CROP_RECT_OES, crop);
-         glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, &green);
-         now = systemTime();
-         glDrawTexiOES(0, 0, 0, 1, 1);
-         glFinish();
-         t = systemTime();
-         printf("glFinish() time = %llu us\n", (t-now)/1000);
-         fflush(stdout);
-         eglSwapBuffers(dpy, surface);
-     }
+     timeBlit(windowSurface, dpy, surface, limiter,
+             "1x1 unmodified texture, 1x1 blit", 1, 1, 1, false);
+     timeBlit(windowSurface, dpy, surface, limiter,
+             "1x1 unmodified texture, 512x512 blit", 1, 512, 1, false);
+     timeBlit(windowSurface, dpy, surface, limiter,
+             "1x1 (1x1 texel MODIFIED texture), 512x512 blit", 1, 512, 1,
+             true);
 
      return 0;
 }
@@ -28,6 +28,7 @@
 
 #include <WindowSurface.h>
 #include <EGLUtils.h>
+#include <glTestProgram.h>
 
 using namespace android;
 
@@ -73,70 +74,6 @@ static const char gFragmentShader[] = "precision mediump float;\n"
     "  gl_FragColor = vec4(0.0, 1.0, 0.0, 0.5);\n"
     "}\n";
 
-GLuint loadShader(GLenum shaderType, const char* pSource) {
-    GLuint shader = glCreateShader(shaderType);
-    if (shader) {
-        glShaderSource(shader, 1, &pSource, NULL);
-        glCompileShader(shader);
-        GLint compiled = 0;
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-        if (!compiled) {
-            GLint infoLen = 0;
-            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLen);
-            if (infoLen) {
-                char* buf = (char*) malloc(infoLen);
-                if (buf) {
-                    glGetShaderInfoLog(shader, infoLen, NULL, buf);
-                    fprintf(stderr, "Could not compile shader %d:\n%s\n",
-                            shaderType, buf);
-                    free(buf);
-                }
-                glDeleteShader(shader);
-                shader = 0;
-            }
-        }
-    }
-    return shader;
-}
-
-GLuint createProgram(const char* pVertexSource, const char* pFragmentSource) {
-    GLuint vertexShader = loadShader(GL_VERTEX_SHADER, pVertexSource);
-    if (!vertexShader) {
-        return 0;
-    }
-
-    GLuint pixelShader = loadShader(GL_FRAGMENT_SHADER, pFragmentSource);
-    if (!pixelShader) {
-        return 0;
-    }
-
-    GLuint program = glCreateProgram();
-    if (program) {
-        glAttachShader(program, vertexShader);
-        checkGlError("glAttachShader");
-        glAttachShader(program, pixelShader);
-        checkGlError("glAttachShader");
-        glLinkProgram(program);
-        GLint linkStatus = GL_FALSE;
-        glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
-        if (linkStatus != GL_TRUE) {
-            GLint bufLength = 0;
-            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &bufLength);
-            if (bufLength) {
-                char* buf = (char*) malloc(bufLength);
-                if (buf) {
-                    glGetProgramInfoLog(program, bufLength, NULL, buf);
-                    fprintf(stderr, "Could not link program:\n%s\n", buf);
-                    free(buf);
-                }
-            }
-            glDeleteProgram(program);
-            program = 0;
-        }
-    }
-    return program;
-}
-
 GLuint gProgram;
 GLuint gTextureProgram;
 GLuint gvPositionHandle;
@@ -164,7 +101,7 @@ static const char gSimpleFS[] =
     "}\n\n";
 
 bool setupGraphics(int w, int h) {
-    gProgram = createProgram(gVertexShader, gFragmentShader);
+    gProgram = glTestCreateProgram(gVertexShader, gFragmentShader);
     if (!gProgram) {
         return false;
     }
@@ -172,7 +109,7 @@ bool setupGraphics(int w, int h) {
     checkGlError("glGetAttribLocation");
     fprintf(stderr, "glGetAttribLocation(\"vPosition\") = %d\n", gvPositionHandle);
 
-    gTextureProgram = createProgram(gSimpleVS, gSimpleFS);
+    gTextureProgram = glTestCreateProgram(gSimpleVS, gSimpleFS);
     if (!gTextureProgram) {
         return false;
     }
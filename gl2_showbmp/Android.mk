@@ -5,7 +5,6 @@ LOCAL_SRC_FILES:= \
 	common.cpp \
 	gl2_drawrgb.cpp \
 	gl2_drawrgba.cpp \
-	TimeUtils.cpp \
 	main.cpp
 
 LOCAL_SHARED_LIBRARIES := \
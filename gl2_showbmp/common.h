@@ -26,8 +26,6 @@
 void printGLString(const char *name, GLenum s);
 void checkEglError(const char* op, EGLBoolean returnVal = EGL_TRUE);
 void checkGlError(const char* op);
-GLuint loadShader(GLenum shaderType, const char* pSource);
-GLuint createProgram(const char* pVertexSource, const char* pFragmentSource);
 void printEGLConfiguration(EGLDisplay dpy, EGLConfig config);
 int printEGLConfigurations(EGLDisplay dpy);
 
@@ -29,6 +29,7 @@
 
 #include <WindowSurface.h>
 #include <EGLUtils.h>
+#include <glTestProgram.h>
 
 #include "common.h"
 
@@ -148,7 +149,7 @@ bool setupYuvTexSurface(char *fileName) {
     }
 
     // loader the program
-    gProgram = createProgram(g_strVertexShader, g_strFragmentShader);
+    gProgram = glTestCreateProgram(g_strVertexShader, g_strFragmentShader);
     if (!gProgram) {
         return false;
     }
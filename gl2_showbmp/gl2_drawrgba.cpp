@@ -28,6 +28,7 @@
 
 #include <WindowSurface.h>
 #include <EGLUtils.h>
+#include <glTestProgram.h>
 
 #include "common.h"
 
@@ -59,7 +60,7 @@ static const char gSimpleFS[] =
 
 bool setupGraphicsRGBA(int w, int h, char *fileName) {
 
-    gTextureProgram = createProgram(gSimpleVS, gSimpleFS);
+    gTextureProgram = glTestCreateProgram(gSimpleVS, gSimpleFS);
     if (!gTextureProgram) {
         return false;
     }
@@ -28,9 +28,10 @@
 
 #include <WindowSurface.h>
 #include <EGLUtils.h>
+#include <glTestBench.h>
+#include <glTestFrame.h>
 
 #include "common.h"
-#include "TimeUtils.h"
 
 typedef struct tagTextureDrawer {
     bool (*setupGraphics)(int, int, char*);
@@ -55,9 +56,6 @@ int main(int argc, char** argv) {
             mode = RGB_MODE;
     }
 
-    int m_statsNumFrames = 0;
-    long long m_statsStartTime = 0.0f;
-
     EGLBoolean returnValue;
     EGLConfig myConfig = {0};
 
@@ -78,8 +76,10 @@ int main(int argc, char** argv) {
 
     EGLDisplay dpy;
 
+    WindowSurface windowSurface;
+
     checkEglError("<init>");
-    dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    dpy = windowSurface.getDisplay();
     checkEglError("eglGetDisplay");
     if (dpy == EGL_NO_DISPLAY) {
         printf("eglGetDisplay returned EGL_NO_DISPLAY.\n");
@@ -101,15 +101,17 @@ int main(int argc, char** argv) {
 
     checkEglError("printEGLConfigurations");
 
-    WindowSurface windowSurface;
-    EGLNativeWindowType window = windowSurface.getSurface();
-    EGLint numConfigs = -1, n = 0;
-    eglChooseConfig(dpy, s_configAttribs, 0, 0, &numConfigs);
-    if (numConfigs) {
-        EGLConfig* const configs = new EGLConfig[numConfigs];
-        eglChooseConfig(dpy, s_configAttribs, configs, numConfigs, &n);
-        myConfig = configs[0];
-        delete[] configs;
+    if (windowSurface.isOffscreen()) {
+        windowSurface.selectConfig(dpy, s_configAttribs, &myConfig);
+    } else {
+        EGLint numConfigs = -1, n = 0;
+        eglChooseConfig(dpy, s_configAttribs, 0, 0, &numConfigs);
+        if (numConfigs) {
+            EGLConfig* const configs = new EGLConfig[numConfigs];
+            eglChooseConfig(dpy, s_configAttribs, configs, numConfigs, &n);
+            myConfig = configs[0];
+            delete[] configs;
+        }
     }
 
     checkEglError("EGLUtils::selectConfigForNativeWindow");
@@ -117,9 +119,10 @@ int main(int argc, char** argv) {
     printf("Chose this configuration:\n");
     printEGLConfiguration(dpy, myConfig);
 
-    surface = eglCreateWindowSurface(dpy, myConfig, window, NULL);
+    surface = windowSurface.createEGLSurface(dpy, myConfig);
     checkEglError("eglCreateWindowSurface");
-    if (surface == EGL_NO_SURFACE) {
+    if (surface == EGL_NO_SURFACE
+            && windowSurface.getBackend() != WindowSurface::BACKEND_SURFACELESS) {
         printf("gelCreateWindowSurface failed.\n");
         return 0;
     }
@@ -130,15 +133,13 @@ int main(int argc, char** argv) {
         printf("eglCreateContext failed\n");
         return 0;
     }
-    returnValue = eglMakeCurrent(dpy, surface, surface, context);
+    returnValue = windowSurface.makeCurrent(dpy, surface, context);
     checkEglError("eglMakeCurrent", returnValue);
     if (returnValue != EGL_TRUE) {
         return 0;
     }
-    eglQuerySurface(dpy, surface, EGL_WIDTH, &w);
-    checkEglError("eglQuerySurface");
-    eglQuerySurface(dpy, surface, EGL_HEIGHT, &h);
-    checkEglError("eglQuerySurface");
+    w = windowSurface.getWidth();
+    h = windowSurface.getHeight();
     GLint dim = w < h ? w : h;
 
     fprintf(stderr, "Window dimensions: %d x %d\n", w, h);
@@ -163,18 +164,18 @@ int main(int argc, char** argv) {
             return 1;
         }
 
+        // Report frame pacing every five seconds
+        GLTestFrameRecorder recorder(dpy, surface);
+        uint64_t reportStart = glTestBenchNow();
         for (;;) {
             (*texDrawer[mode].renderFrame)();
-            eglSwapBuffers(dpy, surface);
+            recorder.swapBuffers(windowSurface);
             checkEglError("eglSwapBuffers");
-	    long long currTime = GetCurrentTimeMS();
-            m_statsNumFrames++;
-            if (currTime - m_statsStartTime >= 1000) {
-		float dt = (float)(currTime - m_statsStartTime) / 1000.0f;
-		printf("FPS: %5.3f\n", (float)m_statsNumFrames / dt);
-		m_statsStartTime = currTime;
-		m_statsNumFrames = 0;
-	    }
+            if (glTestBenchNow() - reportStart >= 5000000000ULL) {
+                recorder.report("showbmp", false);
+                recorder.reset();
+                reportStart = glTestBenchNow();
+            }
         }
     }
 
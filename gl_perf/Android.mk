@@ -14,14 +14,44 @@ LOCAL_SHARED_LIBRARIES := \
     libgui \
     libutils
 
-LOCAL_STATIC_LIBRARIES += libglTest
+LOCAL_STATIC_LIBRARIES += libglTest libtestUtil
 
-LOCAL_C_INCLUDES += $(call include-path-for, opengl-tests-includes)
+LOCAL_C_INCLUDES += system/extras/tests/include \
+	$(call include-path-for, opengl-tests-includes)
 
 LOCAL_MODULE:= test-opengl-gl2_perf
 
 LOCAL_MODULE_TAGS := optional
 
 LOCAL_CFLAGS := -DGL_GLEXT_PROTOTYPES
+LOCAL_CXX_STL := libc++
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	gl2_mtperf.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    liblog \
+    libEGL \
+    libGLESv2 \
+    libui \
+    libgui \
+    libutils
+
+LOCAL_STATIC_LIBRARIES += libglTest libtestUtil
+
+LOCAL_C_INCLUDES += system/extras/tests/include \
+	$(call include-path-for, opengl-tests-includes)
+
+LOCAL_MODULE:= test-opengl-gl2_mtperf
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := -DGL_GLEXT_PROTOTYPES
+LOCAL_CXX_STL := libc++
 
 include $(BUILD_EXECUTABLE)
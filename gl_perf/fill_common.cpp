@@ -14,15 +14,29 @@
  * limitations under the License.
  */
 
+#include <glTestBench.h>
+#include <glTestLib.h>
+#include <glTestProgram.h>
+#include <glTestState.h>
+
+#include <vector>
+
 #include "fragment_shaders.cpp"
 
 FILE * fOut = NULL;
 void ptSwap();
+void ptDrain();
 
 static char gCurrentTestName[1024];
 static uint32_t gWidth = 0;
 static uint32_t gHeight = 0;
 
+// Binds and enables go through gState.  With GLTEST_STATE_BENCH set,
+// every draw reissues the test's full state setup, the way many apps do,
+// and each test is run with redundant calls forwarded and then filtered.
+static GLTestStateCache gState;
+static bool gStateBench = false;
+
 static void checkGlError(const char* op) {
     for (GLint error = glGetError(); error; error
             = glGetError()) {
@@ -30,131 +44,46 @@ static void checkGlError(const char* op) {
     }
 }
 
-GLuint loadShader(GLenum shaderType, const char* pSource) {
-    GLuint shader = glCreateShader(shaderType);
-    if (shader) {
-        glShaderSource(shader, 1, &pSource, NULL);
-        glCompileShader(shader);
-        GLint compiled = 0;
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-        if (!compiled) {
-            GLint infoLen = 0;
-            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLen);
-            if (infoLen) {
-                char* buf = (char*) malloc(infoLen);
-                if (buf) {
-                    glGetShaderInfoLog(shader, infoLen, NULL, buf);
-                    ALOGE("Could not compile shader %d:\n%s\n", shaderType, buf);
-                    free(buf);
-                }
-                glDeleteShader(shader);
-                shader = 0;
-            }
-        }
-    }
-    return shader;
-}
-
-enum {
-    A_POS,
-    A_COLOR,
-    A_TEX0,
-    A_TEX1
-};
-
 GLuint createProgram(const char* pVertexSource, const char* pFragmentSource) {
-    GLuint vertexShader = loadShader(GL_VERTEX_SHADER, pVertexSource);
-    if (!vertexShader) {
-        return 0;
-    }
-
-    GLuint pixelShader = loadShader(GL_FRAGMENT_SHADER, pFragmentSource);
-    if (!pixelShader) {
-        return 0;
-    }
-
-    GLuint program = glCreateProgram();
-    if (program) {
-        glAttachShader(program, vertexShader);
-        checkGlError("glAttachShader v");
-        glAttachShader(program, pixelShader);
-        checkGlError("glAttachShader p");
-
-        glBindAttribLocation(program, A_POS, "a_pos");
-        glBindAttribLocation(program, A_COLOR, "a_color");
-        glBindAttribLocation(program, A_TEX0, "a_tex0");
-        glBindAttribLocation(program, A_TEX1, "a_tex1");
-        glLinkProgram(program);
-        GLint linkStatus = GL_FALSE;
-        glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
-        if (linkStatus != GL_TRUE) {
-            GLint bufLength = 0;
-            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &bufLength);
-            if (bufLength) {
-                char* buf = (char*) malloc(bufLength);
-                if (buf) {
-                    glGetProgramInfoLog(program, bufLength, NULL, buf);
-                    ALOGE("Could not link program:\n%s\n", buf);
-                    free(buf);
-                }
-            }
-            glDeleteProgram(program);
-            program = 0;
-        }
-    }
+    GLuint program = glTestCreateProgram(pVertexSource, pFragmentSource, gAttribs);
     checkGlError("createProgram");
-    glUseProgram(program);
+    gState.useProgram(program);
     return program;
 }
 
-uint64_t getTime() {
-    struct timespec t;
-    clock_gettime(CLOCK_MONOTONIC, &t);
-    return t.tv_nsec + ((uint64_t)t.tv_sec * 1000 * 1000 * 1000);
+// Mpixels per second of pixels filled in the median time of result,
+// 0 when result has no samples
+static double resultMpps(const GLTestBenchResult& result, double pixels) {
+    return result.median > 0 ? pixels / (result.median / 1000000000) / 1000000 : 0;
 }
 
-uint64_t gTime;
-void startTimer() {
-    gTime = getTime();
-}
-
-
-static void endTimer(int count) {
-    uint64_t t2 = getTime();
-    double delta = ((double)(t2 - gTime)) / 1000000000;
+static void reportTest(const GLTestBenchResult& result,
+                       const GLTestBenchResult& gpuResult,
+                       const GLTestBenchResult& boundResult, int count) {
+    double delta = result.median / 1000000000;
     double pixels = (gWidth * gHeight) * count;
     double mpps = pixels / delta / 1000000;
     double dc60 = ((double)count) / delta / 60;
+    double gpuMpps = resultMpps(gpuResult, pixels);
+    double boundMpps = resultMpps(boundResult, pixels);
 
     if (fOut) {
-        fprintf(fOut, "%s, %f, %f\r\n", gCurrentTestName, mpps, dc60);
+        fprintf(fOut, "%s, %f, %f, %f, %f\r\n", gCurrentTestName, mpps, dc60, gpuMpps,
+                boundMpps);
         fflush(fOut);
     } else {
-        printf("%s, %f, %f\n", gCurrentTestName, mpps, dc60);
+        printf("%s, %f, %f, %f, %f\n", gCurrentTestName, mpps, dc60, gpuMpps, boundMpps);
+    }
+    ALOGI("%s, %f, %f, %f, %f\r\n", gCurrentTestName, mpps, dc60, gpuMpps, boundMpps);
+    glTestBenchReport(result);
+    if (gpuResult.samples) {
+        glTestBenchReport(gpuResult);
+    }
+    if (boundResult.samples) {
+        glTestBenchReport(boundResult);
     }
-    ALOGI("%s, %f, %f\r\n", gCurrentTestName, mpps, dc60);
 }
 
-
-static const char gVertexShader[] =
-    "attribute vec4 a_pos;\n"
-    "attribute vec4 a_color;\n"
-    "attribute vec2 a_tex0;\n"
-    "attribute vec2 a_tex1;\n"
-    "varying vec4 v_color;\n"
-    "varying vec2 v_tex0;\n"
-    "varying vec2 v_tex1;\n"
-    "uniform vec2 u_texOff;\n"
-
-    "void main() {\n"
-    "    v_color = a_color;\n"
-    "    v_tex0 = a_tex0;\n"
-    "    v_tex1 = a_tex1;\n"
-    "    v_tex0.x += u_texOff.x;\n"
-    "    v_tex1.y += u_texOff.y;\n"
-    "    gl_Position = a_pos;\n"
-    "}\n";
-
 static void setupVA() {
     static const float vtx[] = {
         -1.0f,-1.0f,
@@ -177,15 +106,28 @@ static void setupVA() {
         0.0f,1.0f,
         0.0f,0.0f };
 
-    glEnableVertexAttribArray(A_POS);
-    glEnableVertexAttribArray(A_COLOR);
-    glEnableVertexAttribArray(A_TEX0);
-    glEnableVertexAttribArray(A_TEX1);
+    gState.bindBuffer(GL_ARRAY_BUFFER, 0);
+    gState.enableVertexAttribArray(A_POS);
+    gState.enableVertexAttribArray(A_COLOR);
+    gState.enableVertexAttribArray(A_TEX0);
+    gState.enableVertexAttribArray(A_TEX1);
 
-    glVertexAttribPointer(A_POS, 2, GL_FLOAT, false, 8, vtx);
-    glVertexAttribPointer(A_COLOR, 4, GL_FLOAT, false, 16, color);
-    glVertexAttribPointer(A_TEX0, 2, GL_FLOAT, false, 8, tex0);
-    glVertexAttribPointer(A_TEX1, 2, GL_FLOAT, false, 8, tex1);
+    gState.vertexAttribPointer(A_POS, 2, GL_FLOAT, false, 8, vtx);
+    gState.vertexAttribPointer(A_COLOR, 4, GL_FLOAT, false, 16, color);
+    gState.vertexAttribPointer(A_TEX0, 2, GL_FLOAT, false, 8, tex0);
+    gState.vertexAttribPointer(A_TEX1, 2, GL_FLOAT, false, 8, tex1);
+}
+
+// Binds the program and textures of a test, with blending enabled
+static void bindTestState(int pgm, int tex) {
+    gState.useProgram(pgm);
+    gState.activeTexture(GL_TEXTURE0);
+    gState.bindTexture(GL_TEXTURE_2D, tex);
+    gState.activeTexture(GL_TEXTURE1);
+    gState.bindTexture(GL_TEXTURE_2D, tex);
+    gState.activeTexture(GL_TEXTURE0);
+    gState.blendFunc(GL_ONE, GL_ONE);
+    gState.enable(GL_BLEND);
 }
 
 static void randUniform(int pgm, const char *var) {
@@ -199,31 +141,80 @@ static void randUniform(int pgm, const char *var) {
     }
 }
 
-static void doLoop(bool warmup, int pgm, uint32_t passCount) {
+// Adds a GPU timer scope to the bench of its kind of GPU time
+static void addGpuSample(const GLTestGpuTiming& timing, GLTestBench& gpuBench,
+                         GLTestBench& boundBench, GLTestBench& submitBench) {
+    if (timing.disjoint) {
+        return;
+    }
+    if (timing.estimated) {
+        boundBench.addSample(timing.gpuNs);
+    } else {
+        gpuBench.addSample(timing.gpuNs);
+    }
+    submitBench.addSample(timing.cpuSubmitNs);
+}
+
+// Returns the median CPU submit time of the draws, in nanoseconds
+static double doLoop(bool warmup, int pgm, int tex, uint32_t passCount) {
     if (warmup) {
         glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
         ptSwap();
         glFinish();
-        return;
+        return 0;
     }
 
-    startTimer();
-    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
-    for (uint32_t ct=0; ct < passCount; ct++) {
-        GLint loc = glGetUniformLocation(pgm, "u_texOff");
-        glUniform2f(loc, ((float)ct) / passCount, ((float)ct) / 2.f / passCount);
-
-        randUniform(pgm, "u_color");
-        randUniform(pgm, "u_0");
-        randUniform(pgm, "u_1");
-        randUniform(pgm, "u_2");
-        randUniform(pgm, "u_3");
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    GLTestBenchConfig benchConfig;
+    benchConfig.workPerIteration = ((double)gWidth * gHeight) * passCount / 1000000;
+    benchConfig.workUnits = "Mpixels";
+    GLTestBench bench(gCurrentTestName, benchConfig);
+
+    // GPU fill time of the draws alone, excluding the swap.  Without timer
+    // queries only an upper bound, up to when a fence is seen signaled, is
+    // known, which is kept apart from the measured times.
+    std::string gpuName = std::string(gCurrentTestName) + ", gpu";
+    GLTestBench gpuBench(gpuName.c_str(), benchConfig);
+    std::string boundName = std::string(gCurrentTestName) + ", gpu (fence bound)";
+    GLTestBench boundBench(boundName.c_str(), benchConfig);
+    std::string submitName = std::string(gCurrentTestName) + ", cpu submit";
+    GLTestBench submitBench(submitName.c_str(), benchConfig);
+    GLTestGpuTimer gpuTimer;
+    GLTestGpuTiming timing;
+
+    while (bench.iterate()) {
+        gpuTimer.begin();
+        glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+        for (uint32_t ct=0; ct < passCount; ct++) {
+            if (gStateBench) {
+                bindTestState(pgm, tex);
+                setupVA();
+            }
+            GLint loc = glGetUniformLocation(pgm, "u_texOff");
+            glUniform2f(loc, ((float)ct) / passCount, ((float)ct) / 2.f / passCount);
+
+            randUniform(pgm, "u_color");
+            randUniform(pgm, "u_0");
+            randUniform(pgm, "u_1");
+            randUniform(pgm, "u_2");
+            randUniform(pgm, "u_3");
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+        gpuTimer.end();
+        ptSwap();
+
+        while (gpuTimer.poll(timing)) {
+            addGpuSample(timing, gpuBench, boundBench, submitBench);
+        }
+    }
+    ptDrain();
+    while (gpuTimer.wait(timing)) {
+        addGpuSample(timing, gpuBench, boundBench, submitBench);
     }
-    ptSwap();
-    glFinish();
-    endTimer(passCount);
+    GLTestBenchResult submitResult = submitBench.result();
+    glTestBenchReport(submitResult);
+    reportTest(bench.result(), gpuBench.result(), boundBench.result(), passCount);
+    return submitResult.median;
 }
 
 
@@ -243,7 +234,7 @@ void genTextures() {
             m[y*1024 + x] = rgb(x, (((x+y) & 0xff) == 0x7f) * 0xff, y);
         }
     }
-    glBindTexture(GL_TEXTURE_2D, 1);
+    gState.bindTexture(GL_TEXTURE_2D, 1);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1024, 1024, 0, GL_RGBA, GL_UNSIGNED_BYTE, m);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -255,7 +246,7 @@ void genTextures() {
             m[y*16 + x] = rgb(x << 4, (((x+y) & 0xf) == 0x7) * 0xff, y << 4);
         }
     }
-    glBindTexture(GL_TEXTURE_2D, 2);
+    gState.bindTexture(GL_TEXTURE_2D, 2);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 16, 16, 0, GL_RGBA, GL_UNSIGNED_BYTE, m);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -264,9 +255,44 @@ void genTextures() {
     free(m);
 }
 
+static GLTestProgramQueue *gProgramQueue = NULL;
+static std::vector<unsigned int> gProgramTickets;
+static std::vector<int> gPrograms;
+
+// Submits the program of every fragment test up front, so that compiles
+// overlap the earlier tests instead of stalling each one.
+static void queuePrograms() {
+    gProgramQueue = new GLTestProgramQueue(gAttribs);
+    for (uint32_t num = 0; num < gFragmentTestCount; num++) {
+        gProgramTickets.push_back(gProgramQueue->submit(gVertexShader,
+                gFragmentTests[num]->txt));
+    }
+    gPrograms.assign(gFragmentTestCount, -1);
+    printf("program queue: %s\n",
+            GLTestProgramQueue::modeName(gProgramQueue->mode()));
+}
+
+// Frees the queue once every test has waited for its program.
+static void releasePrograms() {
+    delete gProgramQueue;
+    gProgramQueue = NULL;
+    gProgramTickets.clear();
+}
+
+static int getProgram(uint32_t pgmNum) {
+    if (!gProgramQueue) {
+        return createProgram(gVertexShader, gFragmentTests[pgmNum]->txt);
+    }
+    if (gPrograms[pgmNum] < 0) {
+        gPrograms[pgmNum] = gProgramQueue->wait(gProgramTickets[pgmNum]);
+    }
+    checkGlError("getProgram");
+    gState.useProgram(gPrograms[pgmNum]);
+    return gPrograms[pgmNum];
+}
+
 static void doSingleTest(uint32_t pgmNum, int tex) {
-    const char *pgmTxt = gFragmentTests[pgmNum]->txt;
-    int pgm = createProgram(gVertexShader, pgmTxt);
+    int pgm = getProgram(pgmNum);
     if (!pgm) {
         printf("error running test\n");
         return;
@@ -277,22 +303,38 @@ static void doSingleTest(uint32_t pgmNum, int tex) {
     if (loc >= 0) glUniform1i(loc, 1);
 
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glActiveTexture(GL_TEXTURE0);
-
-    glBlendFunc(GL_ONE, GL_ONE);
-    glDisable(GL_BLEND);
+    gState.disable(GL_BLEND);
     //sprintf(str2, "%i, %i, %i, %i, %i, 0",
             //useVarColor, texCount, modulateFirstTex, extraMath, tex0);
     //doLoop(true, pgm, w, h, str2);
     //doLoop(false, pgm, w, h, str2);
 
-    glEnable(GL_BLEND);
-    sprintf(gCurrentTestName, "%s, %i, %i, 1", gFragmentTests[pgmNum]->name, pgmNum, tex);
-    doLoop(true, pgm, 100);
-    doLoop(false, pgm, 100);
+    bindTestState(pgm, tex);
+    if (!gStateBench) {
+        sprintf(gCurrentTestName, "%s, %i, %i, 1", gFragmentTests[pgmNum]->name, pgmNum, tex);
+        doLoop(true, pgm, tex, 100);
+        doLoop(false, pgm, tex, 100);
+        return;
+    }
+
+    // Same call stream both ways, only the forwarding differs
+    bool filtering = gState.filtering();
+    double submitNs[2];
+    for (int filter = 0; filter < 2; filter++) {
+        gState.setFiltering(filter);
+        gState.resetStats();
+        sprintf(gCurrentTestName, "%s, %i, %i, 1, %s", gFragmentTests[pgmNum]->name,
+                pgmNum, tex, filter ? "filtered" : "forwarded");
+        doLoop(true, pgm, tex, 100);
+        submitNs[filter] = doLoop(false, pgm, tex, 100);
+        gState.report(gCurrentTestName);
+    }
+    gState.setFiltering(filtering);
+    if (submitNs[0] > 0) {
+        printf("%s, %i, %i: redundant state costs %.1f us/frame (%.1f%% of submit)\n",
+                gFragmentTests[pgmNum]->name, pgmNum, tex,
+                (submitNs[0] - submitNs[1]) / 1000,
+                100 * (submitNs[0] - submitNs[1]) / submitNs[0]);
+    }
 }
 
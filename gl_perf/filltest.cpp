@@ -37,10 +37,15 @@ using namespace android;
 bool doTest(uint32_t w, uint32_t h) {
     gWidth = w;
     gHeight = h;
+    const char *stateBench = getenv("GLTEST_STATE_BENCH");
+    gStateBench = (stateBench != NULL) && (strcmp(stateBench, "0") != 0);
     setupVA();
     genTextures();
+    queuePrograms();
 
-    printf("\nvarColor, texCount, modulate, extraMath, texSize, blend, Mpps, DC60\n");
+    printf("\nvarColor, texCount, modulate, extraMath, texSize, blend, %sMpps, DC60, GPU Mpps, "
+            "GPU bound Mpps\n",
+            gStateBench ? "state, " : "");
 
     for (uint32_t num = 0; num < gFragmentTestCount; num++) {
         doSingleTest(num, 2);
@@ -48,6 +53,8 @@ bool doTest(uint32_t w, uint32_t h) {
             doSingleTest(num, 1);
         }
     }
+    releasePrograms();
+    glTestProgramReport();
 
     exit(0);
     return true;
@@ -0,0 +1,476 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Multi-context scaling benchmark
+ *
+ * Runs one of the gl_perf fragment tests from 1 up to the given number
+ * of threads at once.  Each thread has its own EGL context and its own
+ * offscreen surface, and with -s all the contexts are in one share
+ * group.  For each thread count the aggregate and per-thread fill rate
+ * are reported, along with the cost of an eglMakeCurrent() release and
+ * rebind while every thread is doing the same.  Scaling is the aggregate
+ * fill rate relative to that many times the single thread rate, so it
+ * falls below 1.0 where driver locking serializes the threads.
+ *
+ * The surfaces are pbuffers, or framebuffer objects with
+ * GLTEST_SURFACE=surfaceless, or software pbuffers with
+ * GLTEST_SURFACE=software.  GLTEST_FRAMES_IN_FLIGHT applies to each
+ * thread.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include <WindowSurface.h>
+#include <glTestBench.h>
+#include <glTestLib.h>
+#include <glTestProgram.h>
+
+#include "fragment_shaders.cpp"
+
+using namespace android;
+using namespace std;
+
+// Defaults
+static const unsigned int defaultMaxThreads = 4;
+static const uint32_t defaultTest = 2;          // Texture copy
+static const double defaultSeconds = 3.0;
+static const uint32_t defaultWidth = 512;
+static const uint32_t defaultHeight = 512;
+static const uint32_t defaultDraws = 10;
+static const unsigned int makeCurrentIterations = 200;
+
+// Command-line options
+static unsigned int maxThreads = defaultMaxThreads;
+static bool sharedContexts;
+static uint32_t testNum = defaultTest;
+static double seconds = defaultSeconds;
+static uint32_t width = defaultWidth;
+static uint32_t height = defaultHeight;
+static uint32_t draws = defaultDraws;
+
+static EGLDisplay dpy;
+static EGLConfig config;
+static WindowSurface::Backend backend;
+
+// Serializes per-thread setup, so that only rendering overlaps
+static mutex setupLock;
+
+// Reusable barrier that starts and ends each phase on every thread
+class Barrier {
+  public:
+    Barrier(unsigned int count) : _count(count), _waiting(0),
+        _generation(0) {}
+
+    void wait(void) {
+        unique_lock<mutex> lock(_lock);
+        unsigned int generation = _generation;
+        if (++_waiting == _count) {
+            _waiting = 0;
+            _generation++;
+            _cond.notify_all();
+            return;
+        }
+        _cond.wait(lock, [&] { return _generation != generation; });
+    }
+
+  private:
+    mutex _lock;
+    condition_variable _cond;
+    unsigned int _count;
+    unsigned int _waiting;
+    unsigned int _generation;
+};
+
+struct Worker {
+    unsigned int index;
+    WindowSurface *windowSurface;
+    EGLSurface surface;
+    EGLContext context;
+    bool ok;
+    GLTestBenchResult frame;        // Per frame, in Mpixels
+    GLTestBenchResult makeCurrent;  // Per release and rebind
+};
+
+static void setupVA(void) {
+    static const float vtx[] = {
+        -1.0f,-1.0f,
+         1.0f,-1.0f,
+        -1.0f, 1.0f,
+         1.0f, 1.0f };
+    static const float color[] = {
+        1.0f,0.0f,1.0f,1.0f,
+        0.0f,0.0f,1.0f,1.0f,
+        1.0f,1.0f,0.0f,1.0f,
+        1.0f,1.0f,1.0f,1.0f };
+    static const float tex0[] = {
+        0.0f,0.0f,
+        1.0f,0.0f,
+        0.0f,1.0f,
+        1.0f,1.0f };
+    static const float tex1[] = {
+        1.0f,0.0f,
+        1.0f,1.0f,
+        0.0f,1.0f,
+        0.0f,0.0f };
+
+    glEnableVertexAttribArray(A_POS);
+    glEnableVertexAttribArray(A_COLOR);
+    glEnableVertexAttribArray(A_TEX0);
+    glEnableVertexAttribArray(A_TEX1);
+
+    glVertexAttribPointer(A_POS, 2, GL_FLOAT, false, 8, vtx);
+    glVertexAttribPointer(A_COLOR, 4, GL_FLOAT, false, 16, color);
+    glVertexAttribPointer(A_TEX0, 2, GL_FLOAT, false, 8, tex0);
+    glVertexAttribPointer(A_TEX1, 2, GL_FLOAT, false, 8, tex1);
+}
+
+// 256x256 gradient texture, bound to units 0 and 1
+static GLuint setupTexture(void) {
+    vector<uint32_t> texels(256 * 256);
+    for (uint32_t y = 0; y < 256; y++) {
+        for (uint32_t x = 0; x < 256; x++) {
+            texels[y * 256 + x] = 0xff000000 | (y << 16)
+                | ((((x + y) & 0xff) == 0x7f) ? 0xff00 : 0) | x;
+        }
+    }
+
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 256, 256, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, &texels[0]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glActiveTexture(GL_TEXTURE0);
+
+    return tex;
+}
+
+static void setUniform(GLuint pgm, const char *name, float x, float y,
+                       float z, float w) {
+    GLint loc = glGetUniformLocation(pgm, name);
+    if (loc >= 0) { glUniform4f(loc, x, y, z, w); }
+}
+
+static void runWorker(Worker *worker, Barrier *barrier) {
+    char name[64];
+    GLuint pgm = 0;
+    GLuint tex = 0;
+
+    {
+        lock_guard<mutex> lock(setupLock);
+        worker->ok = worker->windowSurface->makeCurrent(dpy, worker->surface,
+            worker->context) == EGL_TRUE;
+        if (worker->ok) {
+            pgm = glTestCreateProgram(gVertexShader,
+                gFragmentTests[testNum]->txt, gAttribs);
+            worker->ok = pgm != 0;
+        }
+        if (worker->ok) {
+            glUseProgram(pgm);
+            glViewport(0, 0, width, height);
+            setupVA();
+            tex = setupTexture();
+            GLint loc = glGetUniformLocation(pgm, "u_tex0");
+            if (loc >= 0) { glUniform1i(loc, 0); }
+            loc = glGetUniformLocation(pgm, "u_tex1");
+            if (loc >= 0) { glUniform1i(loc, 1); }
+            setUniform(pgm, "u_color", 0.9f, 0.8f, 0.7f, 1.0f);
+            glBlendFunc(GL_ONE, GL_ONE);
+            glEnable(GL_BLEND);
+            glTestCheckGlError("setup");
+        }
+    }
+
+    // Fill rate, for the same time on every thread
+    barrier->wait();
+    if (worker->ok) {
+        GLTestBenchConfig benchConfig;
+        benchConfig.maxIterations = UINT32_MAX;
+        benchConfig.maxSeconds = seconds;
+        benchConfig.targetRelCI = 0.0;
+        benchConfig.workPerIteration = (double) width * height * draws
+            / 1000000;
+        benchConfig.workUnits = "Mpixels";
+        snprintf(name, sizeof(name), "thread %u fill", worker->index);
+        GLTestBench bench(name, benchConfig);
+        GLTestFrameLimiter limiter;
+        GLint texOff = glGetUniformLocation(pgm, "u_texOff");
+
+        while (bench.iterate()) {
+            glClear(GL_COLOR_BUFFER_BIT);
+            for (uint32_t ct = 0; ct < draws; ct++) {
+                glUniform2f(texOff, (float) ct / draws,
+                            (float) ct / 2.f / draws);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            }
+            worker->windowSurface->swapBuffers(dpy, worker->surface);
+            limiter.frameEnd();
+        }
+        limiter.drain();
+        worker->frame = bench.result();
+    }
+
+    // Release and rebind, contending with the other threads
+    barrier->wait();
+    if (worker->ok) {
+        GLTestBenchConfig benchConfig;
+        benchConfig.minIterations = makeCurrentIterations;
+        benchConfig.maxIterations = makeCurrentIterations;
+        snprintf(name, sizeof(name), "thread %u makeCurrent", worker->index);
+        GLTestBench bench(name, benchConfig);
+
+        while (bench.iterate()) {
+            eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                           EGL_NO_CONTEXT);
+            worker->windowSurface->makeCurrent(dpy, worker->surface,
+                                               worker->context);
+        }
+        worker->makeCurrent = bench.result();
+
+        glDeleteTextures(1, &tex);
+        glDeleteProgram(pgm);
+    }
+    barrier->wait();
+
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglReleaseThread();
+}
+
+/*
+ * Runs the test on count threads at once.  Returns the aggregate fill
+ * rate, in Mpixels/sec, or a negative value on failure.
+ */
+static double runThreads(unsigned int count, double singleRate) {
+    EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    vector<Worker> workers(count);
+    bool ok = true;
+
+    for (unsigned int n = 0; n < count; n++) {
+        Worker& worker = workers[n];
+        worker.index = n;
+        worker.ok = false;
+        worker.windowSurface = new WindowSurface(backend, width, height);
+        worker.surface = worker.windowSurface->createEGLSurface(dpy, config);
+        EGLContext share = (sharedContexts && (n > 0))
+            ? workers[0].context : EGL_NO_CONTEXT;
+        worker.context = eglCreateContext(dpy, config, share,
+                                          contextAttribs);
+        if (((worker.surface == EGL_NO_SURFACE)
+             && (backend != WindowSurface::BACKEND_SURFACELESS))
+            || (worker.context == EGL_NO_CONTEXT)) {
+            fprintf(stderr, "Unable to create thread %u surface or context, "
+                    "error 0x%x\n", n, eglGetError());
+            ok = false;
+            count = n + 1;
+            break;
+        }
+    }
+
+    if (ok) {
+        Barrier barrier(count);
+        vector<thread> threads;
+        for (unsigned int n = 0; n < count; n++) {
+            threads.push_back(thread(runWorker, &workers[n], &barrier));
+        }
+        for (unsigned int n = 0; n < count; n++) {
+            threads[n].join();
+        }
+    }
+
+    double aggregate = 0;
+    double minRate = 0, maxRate = 0;
+    double makeCurrentNs = 0;
+    for (unsigned int n = 0; ok && (n < count); n++) {
+        const Worker& worker = workers[n];
+        if (!worker.ok) {
+            fprintf(stderr, "Thread %u failed to set up\n", n);
+            ok = false;
+            break;
+        }
+        double rate = worker.frame.throughput;
+        aggregate += rate;
+        minRate = (n == 0) ? rate : min(minRate, rate);
+        maxRate = (n == 0) ? rate : max(maxRate, rate);
+        makeCurrentNs = max(makeCurrentNs, worker.makeCurrent.median);
+    }
+
+    if (ok) {
+        double scaling = (singleRate > 0) ? aggregate / (singleRate * count)
+            : 1.0;
+        printf("%u, %s, %f, %f, %f, %f, %f\n", count,
+               sharedContexts ? "shared" : "separate", aggregate, minRate,
+               maxRate, scaling, makeCurrentNs / 1000);
+        for (unsigned int n = 0; n < count; n++) {
+            printf("    thread %u: %f Mpps, %u frames, frame median %f ms, "
+                   "makeCurrent median %f us\n", n,
+                   workers[n].frame.throughput, workers[n].frame.samples,
+                   workers[n].frame.median / 1000000,
+                   workers[n].makeCurrent.median / 1000);
+        }
+    }
+
+    for (unsigned int n = 0; n < workers.size(); n++) {
+        if (workers[n].context != EGL_NO_CONTEXT) {
+            workers[n].windowSurface->destroyContext(dpy,
+                                                     workers[n].context);
+        }
+        if (workers[n].surface != EGL_NO_SURFACE) {
+            eglDestroySurface(dpy, workers[n].surface);
+        }
+        delete workers[n].windowSurface;
+    }
+
+    return ok ? aggregate : -1;
+}
+
+static void usage(const char *cmd) {
+    fprintf(stderr, "usage: %s [-t threads] [-s] [-p test] [-d seconds] "
+            "[-w WxH] [-n draws]\n", cmd);
+    fprintf(stderr, "  -t  Maximum number of threads (default %u)\n",
+            defaultMaxThreads);
+    fprintf(stderr, "  -s  Put all the contexts in one share group\n");
+    fprintf(stderr, "  -p  Fragment test (default %u):\n", defaultTest);
+    for (uint32_t n = 0; n < gFragmentTestCount; n++) {
+        fprintf(stderr, "        %u  %s\n", n, gFragmentTests[n]->name);
+    }
+    fprintf(stderr, "  -d  Seconds per thread count (default %g)\n",
+            defaultSeconds);
+    fprintf(stderr, "  -w  Surface size per thread (default %ux%u)\n",
+            defaultWidth, defaultHeight);
+    fprintf(stderr, "  -n  Full surface draws per frame (default %u)\n",
+            defaultDraws);
+}
+
+int main(int argc, char** argv) {
+    int opt;
+    char *end;
+
+    while ((opt = getopt(argc, argv, "t:sp:d:w:n:?h")) != -1) {
+        switch (opt) {
+        case 't':
+            maxThreads = strtoul(optarg, &end, 10);
+            if ((*end != '\0') || (maxThreads == 0)) {
+                fprintf(stderr, "Invalid thread count: %s\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 's':
+            sharedContexts = true;
+            break;
+
+        case 'p':
+            testNum = strtoul(optarg, &end, 10);
+            if ((*end != '\0') || (testNum >= gFragmentTestCount)) {
+                fprintf(stderr, "Invalid fragment test: %s\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 'd':
+            seconds = strtod(optarg, &end);
+            if ((*end != '\0') || (seconds <= 0)) {
+                fprintf(stderr, "Invalid duration: %s\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 'w':
+            if ((sscanf(optarg, "%ux%u", &width, &height) != 2)
+                || (width == 0) || (height == 0)) {
+                fprintf(stderr, "Invalid size: %s\n", optarg);
+                return 1;
+            }
+            break;
+
+        case 'n':
+            draws = strtoul(optarg, &end, 10);
+            if ((*end != '\0') || (draws == 0)) {
+                fprintf(stderr, "Invalid draw count: %s\n", optarg);
+                return 1;
+            }
+            break;
+
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    // Every thread needs its own surface, so a full screen window won't
+    // do.  The environment may still pick an offscreen backend.
+    const char *env = getenv("GLTEST_SURFACE");
+    backend = WindowSurface::BACKEND_PBUFFER;
+    if ((env != NULL) && (*env != '\0')
+        && (!WindowSurface::parseBackend(env, &backend)
+            || (backend == WindowSurface::BACKEND_SURFACEFLINGER))) {
+        fprintf(stderr, "GLTEST_SURFACE=%s not usable, using pbuffer\n", env);
+        backend = WindowSurface::BACKEND_PBUFFER;
+    }
+    WindowSurface probe(backend, width, height);
+
+    dpy = probe.getDisplay();
+    if ((dpy == EGL_NO_DISPLAY) || !eglInitialize(dpy, NULL, NULL)) {
+        fprintf(stderr, "eglInitialize failed, error 0x%x\n", eglGetError());
+        return 1;
+    }
+
+    EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+            EGL_NONE };
+    if (probe.selectConfig(dpy, configAttribs, &config)) {
+        fprintf(stderr, "No EGL config for the %s backend\n",
+                WindowSurface::backendName(backend));
+        return 1;
+    }
+
+    printf("%s, %ux%u per thread, %u draws per frame, %s surfaces\n",
+           gFragmentTests[testNum]->name, width, height, draws,
+           WindowSurface::backendName(backend));
+    printf("threads, contexts, aggregate Mpps, min thread Mpps, "
+           "max thread Mpps, scaling, slowest makeCurrent us\n");
+
+    double singleRate = 0;
+    for (unsigned int count = 1; count <= maxThreads; count++) {
+        double rate = runThreads(count, singleRate);
+        if (rate < 0) { return 1; }
+        if (count == 1) { singleRate = rate; }
+    }
+
+    eglTerminate(dpy);
+    return 0;
+}
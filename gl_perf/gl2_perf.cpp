@@ -28,6 +28,7 @@
 
 #include <WindowSurface.h>
 #include <EGLUtils.h>
+#include <glTestLib.h>
 
 using namespace android;
 
@@ -55,6 +56,8 @@ bool doTest(uint32_t w, uint32_t h);
 
 static EGLDisplay dpy;
 static EGLSurface surface;
+static WindowSurface* windowSurfacePtr;
+static GLTestFrameLimiter* frameLimiterPtr;
 
 int main(int argc, char** argv) {
     EGLBoolean returnValue;
@@ -71,8 +74,11 @@ int main(int argc, char** argv) {
     EGLint w, h;
 
 
+    WindowSurface windowSurface;
+    windowSurfacePtr = &windowSurface;
+
     checkEglError("<init>");
-    dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    dpy = windowSurface.getDisplay();
     checkEglError("eglGetDisplay");
     if (dpy == EGL_NO_DISPLAY) {
         printf("eglGetDisplay returned EGL_NO_DISPLAY.\n");
@@ -86,19 +92,18 @@ int main(int argc, char** argv) {
         return 0;
     }
 
-    WindowSurface windowSurface;
-    EGLNativeWindowType window = windowSurface.getSurface();
-    returnValue = EGLUtils::selectConfigForNativeWindow(dpy, s_configAttribs, window, &myConfig);
+    returnValue = windowSurface.selectConfig(dpy, s_configAttribs, &myConfig);
     if (returnValue) {
-        printf("EGLUtils::selectConfigForNativeWindow() returned %d", returnValue);
+        printf("WindowSurface::selectConfig() returned %d", returnValue);
         return 0;
     }
 
-    checkEglError("EGLUtils::selectConfigForNativeWindow");
+    checkEglError("WindowSurface::selectConfig");
 
-    surface = eglCreateWindowSurface(dpy, myConfig, window, NULL);
-    checkEglError("eglCreateWindowSurface");
-    if (surface == EGL_NO_SURFACE) {
+    surface = windowSurface.createEGLSurface(dpy, myConfig);
+    checkEglError("WindowSurface::createEGLSurface");
+    if (surface == EGL_NO_SURFACE
+            && windowSurface.getBackend() != WindowSurface::BACKEND_SURFACELESS) {
         printf("gelCreateWindowSurface failed.\n");
         return 0;
     }
@@ -109,29 +114,39 @@ int main(int argc, char** argv) {
         printf("eglCreateContext failed\n");
         return 0;
     }
-    returnValue = eglMakeCurrent(dpy, surface, surface, context);
+    returnValue = windowSurface.makeCurrent(dpy, surface, context);
     checkEglError("eglMakeCurrent", returnValue);
     if (returnValue != EGL_TRUE) {
         return 0;
     }
-    eglQuerySurface(dpy, surface, EGL_WIDTH, &w);
-    checkEglError("eglQuerySurface");
-    eglQuerySurface(dpy, surface, EGL_HEIGHT, &h);
-    checkEglError("eglQuerySurface");
+    w = windowSurface.getWidth();
+    h = windowSurface.getHeight();
     GLint dim = w < h ? w : h;
 
     glViewport(0, 0, w, h);
 
+    GLTestFrameLimiter frameLimiter;
+    frameLimiterPtr = &frameLimiter;
+    printf("frames in flight: %s\n", frameLimiter.name());
+
     for (;;) {
         doTest(w, h);
-        eglSwapBuffers(dpy, surface);
+        windowSurface.swapBuffers(dpy, surface);
         checkEglError("eglSwapBuffers");
     }
 
     return 0;
 }
 
+// Swaps, then waits as the frame limiter requires: for this frame when
+// drained, or for an earlier one when pipelined
 void ptSwap() {
-    eglSwapBuffers(dpy, surface);
+    windowSurfacePtr->swapBuffers(dpy, surface);
+    frameLimiterPtr->frameEnd();
+}
+
+// Waits for all frames in flight
+void ptDrain() {
+    frameLimiterPtr->drain();
 }
 
@@ -41,6 +41,10 @@ LOCAL_SHARED_LIBRARIES := \
 	libEGL \
 	libGLESv2
 
+LOCAL_STATIC_LIBRARIES := libglTest
+
+LOCAL_C_INCLUDES += $(call include-path-for, opengl-tests-includes)
+
 LOCAL_MODULE := libgldualjni
 
 
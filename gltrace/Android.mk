@@ -0,0 +1,29 @@
+# Copyright (C) 2011 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+LOCAL_PATH:= $(call my-dir)
+
+# GL call tracing shim, loaded with LD_PRELOAD ahead of libEGL and the
+# GLES libraries.  It must not link against them itself, so that the
+# real entry points are found with dlsym(RTLD_NEXT).
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE:= libglTestTrace
+LOCAL_SRC_FILES:= glTrace.cpp
+LOCAL_SHARED_LIBRARIES := libdl
+LOCAL_CFLAGS := -Wall -Wextra -Werror
+LOCAL_CXX_STL := libc++
+
+include $(BUILD_SHARED_LIBRARY)
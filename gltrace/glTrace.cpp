@@ -0,0 +1,716 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * GL Call Tracing Shim
+ *
+ * Interposes the EGL, GLES 1 and GLES 2 entry points used by the tests
+ * when preloaded ahead of the real libraries:
+ *
+ *   LD_PRELOAD=libglTestTrace.so angeles
+ *
+ * For each entry point it counts calls, CPU time spent inside the real
+ * implementation, state changes that repeat the current state and bytes
+ * uploaded through glTexImage2D()/glTexSubImage2D().  Frames are
+ * delimited by eglSwapBuffers().  The time the shim itself spends
+ * tracking state ahead of the real calls is totaled separately.  A
+ * summary is written to stderr (or GLTRACE_SUMMARY) at exit, and when
+ * GLTRACE_FILE is set every call is also appended to it as a binary
+ * record:
+ *
+ *   Header:  "GLTR", uint32 version, uint32 entry count, then for each
+ *            entry a uint8 name length and the name
+ *   Records: uint32 frame, uint16 entry, uint16 flags, uint32 CPU ns
+ *
+ * Redundant state is tracked per process, and forgotten on
+ * eglMakeCurrent().  Calls made by the driver through the public entry
+ * points while inside another traced call are not recorded.  An entry
+ * point the driver doesn't export is reported once, and calls to it do
+ * nothing.
+ */
+
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+using namespace std;
+
+// Entry points whose calls are only counted and timed.
+// X(return type, name, parameter list, argument list)
+#define GLTRACE_GENERIC(X) \
+    X(void, glClear, (GLbitfield mask), (mask)) \
+    X(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count), \
+      (mode, first, count)) \
+    X(void, glDrawElements, (GLenum mode, GLsizei count, GLenum type, \
+      const void *indices), (mode, count, type, indices)) \
+    X(void, glFinish, (void), ()) \
+    X(void, glFlush, (void), ()) \
+    X(GLenum, glGetError, (void), ()) \
+    X(const GLubyte *, glGetString, (GLenum name), (name)) \
+    X(void, glGetIntegerv, (GLenum pname, GLint *data), (pname, data)) \
+    X(void, glGenTextures, (GLsizei n, GLuint *textures), (n, textures)) \
+    X(void, glTexParameteri, (GLenum target, GLenum pname, GLint param), \
+      (target, pname, param)) \
+    X(void, glTexParameterf, (GLenum target, GLenum pname, GLfloat param), \
+      (target, pname, param)) \
+    X(void, glTexParameteriv, (GLenum target, GLenum pname, \
+      const GLint *params), (target, pname, params)) \
+    X(void, glPixelStorei, (GLenum pname, GLint param), (pname, param)) \
+    X(void, glCopyTexSubImage2D, (GLenum target, GLint level, GLint xoffset, \
+      GLint yoffset, GLint x, GLint y, GLsizei width, GLsizei height), \
+      (target, level, xoffset, yoffset, x, y, width, height)) \
+    X(void, glScissor, (GLint x, GLint y, GLsizei width, GLsizei height), \
+      (x, y, width, height)) \
+    X(GLuint, glCreateShader, (GLenum type), (type)) \
+    X(void, glCompileShader, (GLuint shader), (shader)) \
+    X(void, glDeleteShader, (GLuint shader), (shader)) \
+    X(GLuint, glCreateProgram, (void), ()) \
+    X(void, glAttachShader, (GLuint program, GLuint shader), \
+      (program, shader)) \
+    X(void, glBindAttribLocation, (GLuint program, GLuint index, \
+      const GLchar *name), (program, index, name)) \
+    X(void, glLinkProgram, (GLuint program), (program)) \
+    X(void, glDeleteProgram, (GLuint program), (program)) \
+    X(GLint, glGetAttribLocation, (GLuint program, const GLchar *name), \
+      (program, name)) \
+    X(GLint, glGetUniformLocation, (GLuint program, const GLchar *name), \
+      (program, name)) \
+    X(void, glUniform1i, (GLint location, GLint v0), (location, v0)) \
+    X(void, glUniform2f, (GLint location, GLfloat v0, GLfloat v1), \
+      (location, v0, v1)) \
+    X(void, glUniform4f, (GLint location, GLfloat v0, GLfloat v1, \
+      GLfloat v2, GLfloat v3), (location, v0, v1, v2, v3)) \
+    X(void, glVertexAttribPointer, (GLuint index, GLint size, GLenum type, \
+      GLboolean normalized, GLsizei stride, const void *pointer), \
+      (index, size, type, normalized, stride, pointer)) \
+    X(void, glEnableVertexAttribArray, (GLuint index), (index)) \
+    X(void, glDisableVertexAttribArray, (GLuint index), (index)) \
+    X(void, glGenFramebuffers, (GLsizei n, GLuint *framebuffers), \
+      (n, framebuffers)) \
+    X(void, glFramebufferTexture2D, (GLenum target, GLenum attachment, \
+      GLenum textarget, GLuint texture, GLint level), \
+      (target, attachment, textarget, texture, level)) \
+    X(void, glLoadIdentity, (void), ()) \
+    X(void, glPushMatrix, (void), ()) \
+    X(void, glPopMatrix, (void), ()) \
+    X(void, glTranslatef, (GLfloat x, GLfloat y, GLfloat z), (x, y, z)) \
+    X(void, glTranslatex, (GLfixed x, GLfixed y, GLfixed z), (x, y, z)) \
+    X(void, glRotatex, (GLfixed angle, GLfixed x, GLfixed y, GLfixed z), \
+      (angle, x, y, z)) \
+    X(void, glScalex, (GLfixed x, GLfixed y, GLfixed z), (x, y, z)) \
+    X(void, glMultMatrixf, (const GLfloat *m), (m)) \
+    X(void, glMultMatrixx, (const GLfixed *m), (m)) \
+    X(void, glFrustumf, (GLfloat l, GLfloat r, GLfloat b, GLfloat t, \
+      GLfloat n, GLfloat f), (l, r, b, t, n, f)) \
+    X(void, glFrustumx, (GLfixed l, GLfixed r, GLfixed b, GLfixed t, \
+      GLfixed n, GLfixed f), (l, r, b, t, n, f)) \
+    X(void, glOrthof, (GLfloat l, GLfloat r, GLfloat b, GLfloat t, \
+      GLfloat n, GLfloat f), (l, r, b, t, n, f)) \
+    X(void, glEnableClientState, (GLenum array), (array)) \
+    X(void, glDisableClientState, (GLenum array), (array)) \
+    X(void, glVertexPointer, (GLint size, GLenum type, GLsizei stride, \
+      const void *pointer), (size, type, stride, pointer)) \
+    X(void, glColorPointer, (GLint size, GLenum type, GLsizei stride, \
+      const void *pointer), (size, type, stride, pointer)) \
+    X(void, glTexCoordPointer, (GLint size, GLenum type, GLsizei stride, \
+      const void *pointer), (size, type, stride, pointer)) \
+    X(void, glNormalPointer, (GLenum type, GLsizei stride, \
+      const void *pointer), (type, stride, pointer)) \
+    X(void, glColor4f, (GLfloat r, GLfloat g, GLfloat b, GLfloat a), \
+      (r, g, b, a)) \
+    X(void, glColor4x, (GLfixed r, GLfixed g, GLfixed b, GLfixed a), \
+      (r, g, b, a)) \
+    X(void, glClearColorx, (GLfixed r, GLfixed g, GLfixed b, GLfixed a), \
+      (r, g, b, a)) \
+    X(void, glTexEnvx, (GLenum target, GLenum pname, GLfixed param), \
+      (target, pname, param)) \
+    X(void, glTexParameterx, (GLenum target, GLenum pname, GLfixed param), \
+      (target, pname, param)) \
+    X(void, glLightxv, (GLenum light, GLenum pname, const GLfixed *params), \
+      (light, pname, params)) \
+    X(void, glMaterialx, (GLenum face, GLenum pname, GLfixed param), \
+      (face, pname, param)) \
+    X(void, glMaterialxv, (GLenum face, GLenum pname, \
+      const GLfixed *params), (face, pname, params)) \
+    X(void, glDrawTexiOES, (GLint x, GLint y, GLint z, GLint width, \
+      GLint height), (x, y, z, width, height)) \
+    X(void, glEGLImageTargetTexture2DOES, (GLenum target, void *image), \
+      (target, image)) \
+    X(EGLBoolean, eglSwapInterval, (EGLDisplay dpy, EGLint interval), \
+      (dpy, interval))
+
+// Entry points with their own wrappers below, for state tracking
+#define GLTRACE_CUSTOM(X) \
+    X(void, glEnable, (GLenum cap), (cap)) \
+    X(void, glDisable, (GLenum cap), (cap)) \
+    X(void, glActiveTexture, (GLenum texture), (texture)) \
+    X(void, glBindTexture, (GLenum target, GLuint texture), \
+      (target, texture)) \
+    X(void, glUseProgram, (GLuint program), (program)) \
+    X(void, glBindFramebuffer, (GLenum target, GLuint framebuffer), \
+      (target, framebuffer)) \
+    X(void, glBlendFunc, (GLenum sfactor, GLenum dfactor), \
+      (sfactor, dfactor)) \
+    X(void, glClearColor, (GLfloat r, GLfloat g, GLfloat b, GLfloat a), \
+      (r, g, b, a)) \
+    X(void, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height), \
+      (x, y, width, height)) \
+    X(void, glMatrixMode, (GLenum mode), (mode)) \
+    X(void, glShadeModel, (GLenum mode), (mode)) \
+    X(void, glTexImage2D, (GLenum target, GLint level, GLint internalformat, \
+      GLsizei width, GLsizei height, GLint border, GLenum format, \
+      GLenum type, const void *pixels), (target, level, internalformat, \
+      width, height, border, format, type, pixels)) \
+    X(void, glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, \
+      GLint yoffset, GLsizei width, GLsizei height, GLenum format, \
+      GLenum type, const void *pixels), (target, level, xoffset, yoffset, \
+      width, height, format, type, pixels)) \
+    X(EGLBoolean, eglSwapBuffers, (EGLDisplay dpy, EGLSurface surface), \
+      (dpy, surface)) \
+    X(EGLBoolean, eglMakeCurrent, (EGLDisplay dpy, EGLSurface draw, \
+      EGLSurface read, EGLContext ctx), (dpy, draw, read, ctx)) \
+    X(__eglMustCastToProperFunctionPointerType, eglGetProcAddress, \
+      (const char *procname), (procname))
+
+#define X(ret, name, params, args) typedef ret (*name##Proc) params;
+GLTRACE_GENERIC(X)
+GLTRACE_CUSTOM(X)
+#undef X
+
+enum {
+#define X(ret, name, params, args) ID_##name,
+    GLTRACE_GENERIC(X)
+    GLTRACE_CUSTOM(X)
+#undef X
+    ID_COUNT
+};
+
+static const char *entryNames[] = {
+#define X(ret, name, params, args) #name,
+    GLTRACE_GENERIC(X)
+    GLTRACE_CUSTOM(X)
+#undef X
+};
+
+// Binary trace record
+struct TraceRecord {
+    uint32_t frame;
+    uint16_t entry;
+    uint16_t flags;
+    uint32_t cpuNs;
+} __attribute__((packed));
+
+static const uint32_t traceVersion = 1;
+static const uint16_t flagRedundant = 0x1;
+static const size_t traceBufferRecords = 4096;
+
+struct EntryStats {
+    uint64_t calls;
+    uint64_t ns;
+    uint64_t shimNs;            // Spent by the wrapper before the call
+    uint64_t redundant;
+    uint64_t bytes;
+};
+
+// Tracked state, for redundant change detection.  Values not yet seen
+// are missing from the maps.
+struct TrackedState {
+    map<GLenum, bool> enabled;
+    map<pair<GLenum, GLenum>, GLuint> textures; // (unit, target)
+    map<GLenum, GLuint> framebuffers;
+    map<GLenum, GLuint> names;                  // Bound object names, keyed
+                                                // by entry ID
+    map<GLenum, vector<GLfloat> > values;       // Keyed by entry ID
+    GLenum activeTexture;
+};
+
+static mutex traceLock;
+static EntryStats stats[ID_COUNT];
+static TrackedState state;
+static uint32_t frame;
+static uint64_t callsThisFrame, maxCallsPerFrame;
+static FILE *traceFile;
+static vector<TraceRecord> traceBuffer;
+static bool traceInitDone;
+static __thread unsigned int callDepth;
+
+static inline uint64_t now()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+// Called with traceLock held
+static void traceInit(void)
+{
+    if (traceInitDone) { return; }
+    traceInitDone = true;
+    state.activeTexture = GL_TEXTURE0;
+
+    const char *path = getenv("GLTRACE_FILE");
+    if ((path == NULL) || (*path == '\0')) { return; }
+    if ((traceFile = fopen(path, "wb")) == NULL) {
+        fprintf(stderr, "glTrace: unable to open %s\n", path);
+        return;
+    }
+
+    uint32_t count = ID_COUNT;
+    fwrite("GLTR", 4, 1, traceFile);
+    fwrite(&traceVersion, sizeof(traceVersion), 1, traceFile);
+    fwrite(&count, sizeof(count), 1, traceFile);
+    for (unsigned int i = 0; i < ID_COUNT; i++) {
+        uint8_t len = strlen(entryNames[i]);
+        fwrite(&len, sizeof(len), 1, traceFile);
+        fwrite(entryNames[i], len, 1, traceFile);
+    }
+    traceBuffer.reserve(traceBufferRecords);
+}
+
+static void traceFlush(void)
+{
+    if ((traceFile != NULL) && !traceBuffer.empty()) {
+        fwrite(&traceBuffer[0], sizeof(TraceRecord), traceBuffer.size(),
+               traceFile);
+        traceBuffer.clear();
+    }
+}
+
+// Real entry point of name, NULL if the driver doesn't export it
+static void *findReal(const char *name)
+{
+    void *proc = dlsym(RTLD_NEXT, name);
+
+    // Extension entry points may only be available through the real
+    // eglGetProcAddress()
+    if (proc == NULL) {
+        static eglGetProcAddressProc realGetProcAddress =
+            (eglGetProcAddressProc) dlsym(RTLD_NEXT, "eglGetProcAddress");
+        if (realGetProcAddress != NULL) {
+            proc = (void *) realGetProcAddress(name);
+        }
+    }
+
+    return proc;
+}
+
+// Called once per wrapper, so a missing entry point is reported once
+static void *lookup(const char *name)
+{
+    void *proc = findReal(name);
+
+    if (proc == NULL) {
+        fprintf(stderr, "glTrace: unable to find %s, calls do nothing\n",
+                name);
+    }
+
+    return proc;
+}
+
+// Value returned by a wrapper whose real entry point is missing
+template <typename R, typename... Args>
+static R missing(R (*)(Args...))
+{
+    return R();
+}
+
+/*
+ * Trace Call
+ *
+ * Times the real call of the enclosing wrapper, from begin(), called
+ * just before it, to destruction, and records the call, unless it's
+ * nested inside another traced call.  The time from construction to
+ * begin(), spent tracking state, is counted as the shim's.  A wrapper
+ * that never calls begin() didn't call the real entry point.
+ */
+class TraceCall {
+  public:
+    TraceCall(unsigned int entry) : redundant(false), bytes(0),
+        _entry(entry), _nested(callDepth++ != 0), _created(now()),
+        _start(0) {}
+    ~TraceCall();
+
+    void begin(void) { _start = now(); }
+
+    bool redundant;
+    uint64_t bytes;
+
+  private:
+    unsigned int _entry;
+    bool _nested;
+    uint64_t _created;
+    uint64_t _start;
+};
+
+TraceCall::~TraceCall()
+{
+    uint64_t end = now();
+    uint64_t ns = _start ? end - _start : 0;
+    uint64_t shimNs = (_start ? _start : end) - _created;
+
+    callDepth--;
+    if (_nested) { return; }
+
+    lock_guard<mutex> lock(traceLock);
+    traceInit();
+    EntryStats& entryStats = stats[_entry];
+    entryStats.calls++;
+    entryStats.ns += ns;
+    entryStats.shimNs += shimNs;
+    entryStats.redundant += redundant;
+    entryStats.bytes += bytes;
+    callsThisFrame++;
+
+    if (traceFile != NULL) {
+        TraceRecord record;
+        record.frame = frame;
+        record.entry = _entry;
+        record.flags = redundant ? flagRedundant : 0;
+        record.cpuNs = (ns > UINT32_MAX) ? UINT32_MAX : ns;
+        traceBuffer.push_back(record);
+        if (traceBuffer.size() >= traceBufferRecords) { traceFlush(); }
+    }
+
+    if (_entry == ID_eglSwapBuffers) {
+        maxCallsPerFrame = max(maxCallsPerFrame, callsThisFrame);
+        callsThisFrame = 0;
+        frame++;
+    }
+}
+
+// Updates a tracked value, returning true if it was already current
+template <typename K, typename V>
+static bool stateSet(map<K, V>& values, const K& key, const V& value)
+{
+    lock_guard<mutex> lock(traceLock);
+    typename map<K, V>::iterator it = values.find(key);
+
+    if ((it != values.end()) && (it->second == value)) { return true; }
+    values[key] = value;
+
+    return false;
+}
+
+static bool stateSetValues(GLenum entry, const GLfloat *v, size_t count)
+{
+    return stateSet(state.values, entry, vector<GLfloat>(v, v + count));
+}
+
+static uint64_t imageBytes(GLsizei width, GLsizei height, GLenum format,
+                           GLenum type, const void *pixels)
+{
+    unsigned int bytesPerPixel;
+
+    if (pixels == NULL) { return 0; }
+    switch (type) {
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+        bytesPerPixel = 2;
+        break;
+
+    default:
+        switch (format) {
+        case GL_RGBA: bytesPerPixel = 4; break;
+        case GL_RGB: bytesPerPixel = 3; break;
+        case GL_LUMINANCE_ALPHA: bytesPerPixel = 2; break;
+        default: bytesPerPixel = 1; break;
+        }
+        break;
+    }
+
+    return (uint64_t) width * height * bytesPerPixel;
+}
+
+#define REAL(name) \
+    static name##Proc real = (name##Proc) lookup(#name); \
+    if (real == NULL) { return missing(real); }
+
+#define X(ret, name, params, args) \
+    extern "C" ret name params \
+    { \
+        REAL(name); \
+        TraceCall call(ID_##name); \
+        call.begin(); \
+        return real args; \
+    }
+GLTRACE_GENERIC(X)
+#undef X
+
+extern "C" void glEnable(GLenum cap)
+{
+    REAL(glEnable);
+    TraceCall call(ID_glEnable);
+    call.redundant = stateSet(state.enabled, cap, true);
+    call.begin();
+    real(cap);
+}
+
+extern "C" void glDisable(GLenum cap)
+{
+    REAL(glDisable);
+    TraceCall call(ID_glDisable);
+    call.redundant = stateSet(state.enabled, cap, false);
+    call.begin();
+    real(cap);
+}
+
+extern "C" void glActiveTexture(GLenum texture)
+{
+    REAL(glActiveTexture);
+    TraceCall call(ID_glActiveTexture);
+    {
+        lock_guard<mutex> lock(traceLock);
+        call.redundant = (state.activeTexture == texture);
+        state.activeTexture = texture;
+    }
+    call.begin();
+    real(texture);
+}
+
+extern "C" void glBindTexture(GLenum target, GLuint texture)
+{
+    REAL(glBindTexture);
+    TraceCall call(ID_glBindTexture);
+    GLenum unit;
+    {
+        lock_guard<mutex> lock(traceLock);
+        unit = state.activeTexture;
+    }
+    call.redundant = stateSet(state.textures, make_pair(unit, target),
+                              texture);
+    call.begin();
+    real(target, texture);
+}
+
+extern "C" void glUseProgram(GLuint program)
+{
+    REAL(glUseProgram);
+    TraceCall call(ID_glUseProgram);
+    call.redundant = stateSet(state.names, (GLenum) ID_glUseProgram,
+                              program);
+    call.begin();
+    real(program);
+}
+
+extern "C" void glBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    REAL(glBindFramebuffer);
+    TraceCall call(ID_glBindFramebuffer);
+    call.redundant = stateSet(state.framebuffers, target, framebuffer);
+    call.begin();
+    real(target, framebuffer);
+}
+
+extern "C" void glBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+    REAL(glBlendFunc);
+    TraceCall call(ID_glBlendFunc);
+    GLfloat v[] = {(GLfloat) sfactor, (GLfloat) dfactor};
+    call.redundant = stateSetValues(ID_glBlendFunc, v, 2);
+    call.begin();
+    real(sfactor, dfactor);
+}
+
+extern "C" void glClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+    REAL(glClearColor);
+    TraceCall call(ID_glClearColor);
+    GLfloat v[] = {r, g, b, a};
+    call.redundant = stateSetValues(ID_glClearColor, v, 4);
+    call.begin();
+    real(r, g, b, a);
+}
+
+extern "C" void glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    REAL(glViewport);
+    TraceCall call(ID_glViewport);
+    GLfloat v[] = {(GLfloat) x, (GLfloat) y, (GLfloat) width,
+                   (GLfloat) height};
+    call.redundant = stateSetValues(ID_glViewport, v, 4);
+    call.begin();
+    real(x, y, width, height);
+}
+
+extern "C" void glMatrixMode(GLenum mode)
+{
+    REAL(glMatrixMode);
+    TraceCall call(ID_glMatrixMode);
+    GLfloat v = mode;
+    call.redundant = stateSetValues(ID_glMatrixMode, &v, 1);
+    call.begin();
+    real(mode);
+}
+
+extern "C" void glShadeModel(GLenum mode)
+{
+    REAL(glShadeModel);
+    TraceCall call(ID_glShadeModel);
+    GLfloat v = mode;
+    call.redundant = stateSetValues(ID_glShadeModel, &v, 1);
+    call.begin();
+    real(mode);
+}
+
+extern "C" void glTexImage2D(GLenum target, GLint level,
+    GLint internalformat, GLsizei width, GLsizei height, GLint border,
+    GLenum format, GLenum type, const void *pixels)
+{
+    REAL(glTexImage2D);
+    TraceCall call(ID_glTexImage2D);
+    call.bytes = imageBytes(width, height, format, type, pixels);
+    call.begin();
+    real(target, level, internalformat, width, height, border, format, type,
+         pixels);
+}
+
+extern "C" void glTexSubImage2D(GLenum target, GLint level, GLint xoffset,
+    GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type,
+    const void *pixels)
+{
+    REAL(glTexSubImage2D);
+    TraceCall call(ID_glTexSubImage2D);
+    call.bytes = imageBytes(width, height, format, type, pixels);
+    call.begin();
+    real(target, level, xoffset, yoffset, width, height, format, type,
+         pixels);
+}
+
+extern "C" EGLBoolean eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
+{
+    REAL(eglSwapBuffers);
+    TraceCall call(ID_eglSwapBuffers);
+    call.begin();
+    return real(dpy, surface);
+}
+
+extern "C" EGLBoolean eglMakeCurrent(EGLDisplay dpy, EGLSurface draw,
+    EGLSurface read, EGLContext ctx)
+{
+    REAL(eglMakeCurrent);
+    TraceCall call(ID_eglMakeCurrent);
+    {
+        lock_guard<mutex> lock(traceLock);
+        state = TrackedState();
+        state.activeTexture = GL_TEXTURE0;
+    }
+    call.begin();
+    return real(dpy, draw, read, ctx);
+}
+
+// Hands out the traced wrappers, so that entry points looked up at
+// runtime are traced too
+extern "C" __eglMustCastToProperFunctionPointerType eglGetProcAddress(
+    const char *procname)
+{
+    static const struct {
+        const char *name;
+        __eglMustCastToProperFunctionPointerType proc;
+    } wrappers[] = {
+#define X(ret, name, params, args) \
+        {#name, (__eglMustCastToProperFunctionPointerType) name},
+        GLTRACE_GENERIC(X)
+        GLTRACE_CUSTOM(X)
+#undef X
+    };
+    REAL(eglGetProcAddress);
+    TraceCall call(ID_eglGetProcAddress);
+
+    // Wrappers of entry points the driver lacks aren't handed out, so
+    // extension checks by lookup still work
+    for (size_t i = 0; i < sizeof(wrappers) / sizeof(wrappers[0]); i++) {
+        if (strcmp(procname, wrappers[i].name) == 0) {
+            return (findReal(procname) != NULL) ? wrappers[i].proc : NULL;
+        }
+    }
+
+    call.begin();
+    return real(procname);
+}
+
+/*
+ * Summary
+ *
+ * Flushes the binary trace and writes per entry point totals, most
+ * expensive first.
+ */
+__attribute__((destructor))
+static void traceSummary(void)
+{
+    lock_guard<mutex> lock(traceLock);
+    const char *path = getenv("GLTRACE_SUMMARY");
+    FILE *out = stderr;
+
+    traceFlush();
+    if (traceFile != NULL) {
+        fclose(traceFile);
+        traceFile = NULL;
+    }
+
+    if ((path != NULL) && (*path != '\0')
+        && ((out = fopen(path, "w")) == NULL)) {
+        fprintf(stderr, "glTrace: unable to open %s\n", path);
+        out = stderr;
+    }
+
+    vector<unsigned int> order;
+    uint64_t totalCalls = 0, totalNs = 0, totalShimNs = 0;
+    for (unsigned int i = 0; i < ID_COUNT; i++) {
+        if (stats[i].calls == 0) { continue; }
+        order.push_back(i);
+        totalCalls += stats[i].calls;
+        totalNs += stats[i].ns;
+        totalShimNs += stats[i].shimNs;
+    }
+    sort(order.begin(), order.end(),
+         [](unsigned int a, unsigned int b) { return stats[a].ns > stats[b].ns; });
+
+    double frames = (frame == 0) ? 1.0 : frame;
+    fprintf(out, "glTrace: %u frames, %llu calls, %.3f ms in GL/EGL, "
+            "%.1f calls/frame (max %llu)\n", frame,
+            (unsigned long long) totalCalls, totalNs / 1e6,
+            totalCalls / frames,
+            (unsigned long long) max(maxCallsPerFrame, callsThisFrame));
+    fprintf(out, "glTrace: %.3f ms in the shim before calls, "
+            "%.0f ns/call\n", totalShimNs / 1e6,
+            totalCalls ? (double) totalShimNs / totalCalls : 0.0);
+    fprintf(out, "%-32s %10s %10s %10s %10s %10s %12s\n", "entry", "calls",
+            "calls/frm", "total ms", "avg ns", "redundant", "bytes");
+    for (size_t i = 0; i < order.size(); i++) {
+        const EntryStats& s = stats[order[i]];
+        fprintf(out, "%-32s %10llu %10.1f %10.3f %10.0f %10llu %12llu\n",
+                entryNames[order[i]], (unsigned long long) s.calls,
+                s.calls / frames, s.ns / 1e6, (double) s.ns / s.calls,
+                (unsigned long long) s.redundant,
+                (unsigned long long) s.bytes);
+    }
+
+    if (out != stderr) { fclose(out); }
+}
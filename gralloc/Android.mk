@@ -9,8 +9,33 @@ LOCAL_SHARED_LIBRARIES := \
     libutils \
     libui
 
+LOCAL_STATIC_LIBRARIES += libglTest
+
+LOCAL_C_INCLUDES += $(call include-path-for, opengl-tests-includes)
+
 LOCAL_MODULE:= test-opengl-gralloc
 
 LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_EXECUTABLE)
+
+# Host build, copying to and from a GLTestBuffer stand-in
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    gralloc.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+    libglTest_host \
+    libcutils \
+    libutils \
+    liblog
+
+LOCAL_C_INCLUDES += $(call include-path-for, opengl-tests-includes) \
+    hardware/libhardware/include
+
+LOCAL_MODULE:= test-opengl-gralloc_host
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
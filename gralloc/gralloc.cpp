@@ -15,15 +15,15 @@
  ** limitations under the License.
  */
 
-#define LOG_TAG "StopWatch"
+#define LOG_TAG "gralloc"
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <utils/StopWatch.h>
+#include <string.h>
 #include <utils/Log.h>
 
-#include <ui/GraphicBuffer.h>
-#include <ui/GraphicBufferMapper.h>
+#include <glTestBench.h>
+#include <glTestBuffer.h>
 
 using namespace android;
 
@@ -46,9 +46,11 @@ int main(int argc, char** argv)
     memset(temp2, 0, size);
 
 
-    sp<GraphicBuffer> buffer = new GraphicBuffer(128, 256, HAL_PIXEL_FORMAT_RGBA_8888,
-            GRALLOC_USAGE_SW_READ_OFTEN |
-            GRALLOC_USAGE_SW_WRITE_OFTEN);
+    // On hosts the buffer is a memfd stand-in, see glTestBuffer.h for the
+    // environment variables that configure it
+    sp<GLTestBuffer> buffer = new GLTestBuffer(128, 256, HAL_PIXEL_FORMAT_RGBA_8888,
+            GLTestBuffer::USAGE_SW_READ_OFTEN |
+            GLTestBuffer::USAGE_SW_WRITE_OFTEN);
 
     status_t err = buffer->initCheck();
     if (err != NO_ERROR) {
@@ -58,50 +60,61 @@ int main(int argc, char** argv)
 
     void* vaddr;
     buffer->lock(
-            GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN,
+            GLTestBuffer::USAGE_SW_READ_OFTEN | GLTestBuffer::USAGE_SW_WRITE_OFTEN,
             &vaddr);
 
+    GLTestBenchConfig benchConfig;
+    benchConfig.workPerIteration = size / (1024.0 * 1024.0);
+    benchConfig.workUnits = "MiB";
+
     {
-        StopWatch watch("memset");
-        for (int i=0 ; i<10 ; i++)
+        GLTestBench bench("memset", benchConfig);
+        while (bench.iterate())
             memset(vaddr, 0, size);
+        bench.report();
     }
 
     {
-        StopWatch watch("memcpy baseline");
-        for (int i=0 ; i<10 ; i++)
+        GLTestBench bench("memcpy baseline", benchConfig);
+        while (bench.iterate())
             memcpy(temp, temp2, size);
+        bench.report();
     }
 
     {
-        StopWatch watch("memcpy from gralloc");
-        for (int i=0 ; i<10 ; i++)
+        GLTestBench bench("memcpy from gralloc", benchConfig);
+        while (bench.iterate())
             memcpy(temp, vaddr, size);
+        bench.report();
     }
 
     {
-        StopWatch watch("memcpy into gralloc");
-        for (int i=0 ; i<10 ; i++)
+        GLTestBench bench("memcpy into gralloc", benchConfig);
+        while (bench.iterate())
             memcpy(vaddr, temp, size);
+        bench.report();
     }
 
 
     {
-        StopWatch watch("lamecpy baseline");
-        for (int i=0 ; i<10 ; i++)
+        GLTestBench bench("lamecpy baseline", benchConfig);
+        while (bench.iterate())
             lamecpy(temp, temp2, size);
+        bench.report();
     }
 
     {
-        StopWatch watch("lamecpy from gralloc");
-        for (int i=0 ; i<10 ; i++)
+        GLTestBench bench("lamecpy from gralloc", benchConfig);
+        while (bench.iterate())
             lamecpy(temp, vaddr, size);
+        bench.report();
     }
 
     {
-        StopWatch watch("lamecpy into gralloc");
-        for (int i=0 ; i<10 ; i++)
+        GLTestBench bench("lamecpy into gralloc", benchConfig);
+        while (bench.iterate())
             lamecpy(vaddr, temp, size);
+        bench.report();
     }
 
     buffer->unlock();
@@ -21,12 +21,40 @@ LOCAL_MODULE_TAGS := tests
 LOCAL_MODULE:= libhwcTest
 LOCAL_CFLAGS := -DGL_GLEXT_PROTOTYPES -DEGL_EGLEXT_PROTOTYPES -Wall -Wextra -Werror
 LOCAL_CXX_STL := libc++
-LOCAL_SRC_FILES:= hwcTestLib.cpp
+LOCAL_SRC_FILES:= hwcTestLib.cpp \
+    hwcTestColor.cpp \
+    hwcTestFill.cpp \
+    hwcTestCompose.cpp \
+    hwcTestBufferPool.cpp \
+    hwcTestMock.cpp \
+    hwcTestTrace.cpp
 LOCAL_C_INCLUDES += system/extras/tests/include \
     $(call include-path-for, opengl-tests-includes) \
 
 include $(BUILD_STATIC_LIBRARY)
 
+# Host build, filling GLTestBuffer stand-ins and composing them with the
+# mock hardware composer
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+
+LOCAL_MODULE_TAGS := tests
+LOCAL_MODULE:= libhwcTest_host
+LOCAL_CFLAGS := -Wall -Wextra -Werror
+LOCAL_CXX_STL := libc++
+LOCAL_SRC_FILES:= hwcTestLib.cpp \
+    hwcTestColor.cpp \
+    hwcTestFill.cpp \
+    hwcTestCompose.cpp \
+    hwcTestBufferPool.cpp \
+    hwcTestMock.cpp \
+    hwcTestTrace.cpp
+LOCAL_C_INCLUDES += system/extras/tests/include \
+    hardware/libhardware/include \
+    $(call include-path-for, opengl-tests-includes) \
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
 include $(CLEAR_VARS)
 LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
 
@@ -60,6 +88,36 @@ include $(BUILD_NATIVE_TEST)
 include $(CLEAR_VARS)
 LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
 
+LOCAL_MODULE:= hwcReplay
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -DGL_GLEXT_PROTOTYPES -DEGL_EGLEXT_PROTOTYPES -Wall -Wextra -Werror
+LOCAL_CXX_STL := libc++
+LOCAL_SRC_FILES:= hwcReplay.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libEGL \
+    libGLESv2 \
+    libutils \
+    liblog \
+    libui \
+    libhardware \
+
+LOCAL_STATIC_LIBRARIES := \
+    libtestUtil \
+    libglTest \
+    libhwcTest \
+
+LOCAL_C_INCLUDES += \
+    system/extras/tests/include \
+    hardware/libhardware/include \
+    $(call include-path-for, opengl-tests-includes) \
+
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+
 LOCAL_MODULE:= hwcRects
 LOCAL_MODULE_TAGS := tests
 LOCAL_CFLAGS := -DGL_GLEXT_PROTOTYPES -DEGL_EGLEXT_PROTOTYPES -Wall -Wextra -Werror
@@ -146,3 +204,179 @@ LOCAL_C_INCLUDES += \
     $(call include-path-for, opengl-tests-includes) \
 
 include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+
+LOCAL_MODULE:= hwcFillBench
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -DGL_GLEXT_PROTOTYPES -DEGL_EGLEXT_PROTOTYPES -Wall -Wextra -Werror
+LOCAL_CXX_STL := libc++
+LOCAL_SRC_FILES:= hwcFillBench.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libutils \
+    liblog \
+    libui \
+    libhardware \
+
+LOCAL_STATIC_LIBRARIES := \
+    libtestUtil \
+    libglTest \
+    libhwcTest \
+
+LOCAL_C_INCLUDES += \
+    system/extras/tests/include \
+    hardware/libhardware/include \
+    $(call include-path-for, opengl-tests-includes) \
+
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+
+LOCAL_MODULE:= hwcComposeBench
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -DGL_GLEXT_PROTOTYPES -DEGL_EGLEXT_PROTOTYPES -Wall -Wextra -Werror
+LOCAL_CXX_STL := libc++
+LOCAL_SRC_FILES:= hwcComposeBench.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libutils \
+    liblog \
+    libui \
+    libhardware \
+
+LOCAL_STATIC_LIBRARIES := \
+    libtestUtil \
+    libglTest \
+    libhwcTest \
+
+LOCAL_C_INCLUDES += \
+    system/extras/tests/include \
+    hardware/libhardware/include \
+    $(call include-path-for, opengl-tests-includes) \
+
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+
+LOCAL_MODULE:= hwcFillBench_host
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Wall -Wextra -Werror
+LOCAL_CXX_STL := libc++
+LOCAL_SRC_FILES:= hwcFillBench.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+    libhwcTest_host \
+    libglTest_host \
+    libtestUtil \
+    libcutils \
+    libutils \
+    liblog \
+
+LOCAL_C_INCLUDES += \
+    system/extras/tests/include \
+    hardware/libhardware/include \
+    $(call include-path-for, opengl-tests-includes) \
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+
+LOCAL_MODULE:= hwcComposeBench_host
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Wall -Wextra -Werror
+LOCAL_CXX_STL := libc++
+LOCAL_SRC_FILES:= hwcComposeBench.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+    libhwcTest_host \
+    libglTest_host \
+    libtestUtil \
+    libcutils \
+    libutils \
+    liblog \
+
+LOCAL_C_INCLUDES += \
+    system/extras/tests/include \
+    hardware/libhardware/include \
+    $(call include-path-for, opengl-tests-includes) \
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+
+LOCAL_MODULE:= hwcStress_host
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Wall -Wextra -Werror
+LOCAL_CXX_STL := libc++
+LOCAL_SRC_FILES:= hwcStress.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+    libhwcTest_host \
+    libglTest_host \
+    libtestUtil \
+    libcutils \
+    libutils \
+    liblog \
+
+LOCAL_C_INCLUDES += \
+    system/extras/tests/include \
+    hardware/libhardware/include \
+    $(call include-path-for, opengl-tests-includes) \
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+
+LOCAL_MODULE:= hwcReplay_host
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Wall -Wextra -Werror
+LOCAL_CXX_STL := libc++
+LOCAL_SRC_FILES:= hwcReplay.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+    libhwcTest_host \
+    libglTest_host \
+    libtestUtil \
+    libcutils \
+    libutils \
+    liblog \
+
+LOCAL_C_INCLUDES += \
+    system/extras/tests/include \
+    hardware/libhardware/include \
+    $(call include-path-for, opengl-tests-includes) \
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+
+LOCAL_MODULE:= hwcCommit_host
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Wall -Wextra -Werror
+LOCAL_CXX_STL := libc++
+LOCAL_SRC_FILES:= hwcCommit.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+    libhwcTest_host \
+    libglTest_host \
+    libtestUtil \
+    libcutils \
+    libutils \
+    liblog \
+
+LOCAL_C_INCLUDES += \
+    system/extras/tests/include \
+    hardware/libhardware/include \
+    $(call include-path-for, opengl-tests-includes) \
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -87,7 +87,6 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
-#include <ui/GraphicBuffer.h>
 
 #include <utils/Log.h>
 #include <testUtil.h>
@@ -122,8 +121,8 @@ const float defaultEndDelay = 2.0; // Default delay after rendering graphics
     } while (0)
 
 // Globals
-static const int texUsage = GraphicBuffer::USAGE_HW_TEXTURE |
-        GraphicBuffer::USAGE_SW_WRITE_RARELY;
+static const int texUsage = GLTestBuffer::USAGE_HW_TEXTURE |
+        GLTestBuffer::USAGE_SW_WRITE_RARELY;
 static hwc_composer_device_1_t *hwcDevice;
 static EGLDisplay dpy;
 static EGLSurface surface;
@@ -277,16 +276,18 @@ main(int argc, char *argv[])
     testPrintI("endRefColor: %s", ((string) endRefColor).c_str());
     testPrintI("endDelay: %f", endDelay);
 
-    // Stop framework
-    rv = snprintf(cmd, sizeof(cmd), "%s", CMD_STOP_FRAMEWORK);
-    if (rv >= (signed) sizeof(cmd) - 1) {
-        testPrintE("Command too long for: %s", CMD_STOP_FRAMEWORK);
-        exit(8);
+    // Stop framework, unless the mock hardware composer stands in for the HAL
+    if (!hwcTestMockActive()) {
+        rv = snprintf(cmd, sizeof(cmd), "%s", CMD_STOP_FRAMEWORK);
+        if (rv >= (signed) sizeof(cmd) - 1) {
+            testPrintE("Command too long for: %s", CMD_STOP_FRAMEWORK);
+            exit(8);
+        }
+        testExecCmd(cmd);
+        testDelay(1.0); // TODO - needs means to query whether asynchronous
+                        // stop framework operation has completed.  For now,
+                        // just wait a long time.
     }
-    testExecCmd(cmd);
-    testDelay(1.0); // TODO - needs means to query whether asynchronous stop
-                    // framework operation has completed.  For now, just wait
-                    // a long time.
 
     init();
 
@@ -307,8 +308,8 @@ main(int argc, char *argv[])
 
     // Create reference and equivalence graphic buffers
     const unsigned int numFrames = 2;
-    sp<GraphicBuffer> refFrame;
-    refFrame = new GraphicBuffer(refWidth, refHeight,
+    sp<GLTestBuffer> refFrame;
+    refFrame = new GLTestBuffer(refWidth, refHeight,
                                  refFormat->format, texUsage);
     if ((rv = refFrame->initCheck()) != NO_ERROR) {
         testPrintE("refFrame initCheck failed, rv: %i", rv);
@@ -321,8 +322,8 @@ main(int argc, char *argv[])
                refWidth, refHeight, refFormat->format,
                hwcTestGraphicFormat2str(refFormat->format));
 
-    sp<GraphicBuffer> equivFrame;
-    equivFrame = new GraphicBuffer(equivWidth, equivHeight,
+    sp<GLTestBuffer> equivFrame;
+    equivFrame = new GLTestBuffer(equivWidth, equivHeight,
                                    equivFormat->format, texUsage);
     if ((rv = refFrame->initCheck()) != NO_ERROR) {
         testPrintE("refFrame initCheck failed, rv: %i", rv);
@@ -396,13 +397,15 @@ main(int argc, char *argv[])
 
     testDelay(endDelay);
 
-    // Start framework
-    rv = snprintf(cmd, sizeof(cmd), "%s", CMD_START_FRAMEWORK);
-    if (rv >= (signed) sizeof(cmd) - 1) {
-        testPrintE("Command too long for: %s", CMD_START_FRAMEWORK);
-        exit(12);
+    // Start framework, unless the mock hardware composer stands in for the HAL
+    if (!hwcTestMockActive()) {
+        rv = snprintf(cmd, sizeof(cmd), "%s", CMD_START_FRAMEWORK);
+        if (rv >= (signed) sizeof(cmd) - 1) {
+            testPrintE("Command too long for: %s", CMD_START_FRAMEWORK);
+            exit(12);
+        }
+        testExecCmd(cmd);
     }
-    testExecCmd(cmd);
 
     return 0;
 }
@@ -22,6 +22,9 @@
  *   hwcCommit [options] graphicFormat ...
  *     options:
  *       -s [width, height] - Starting dimension
+ *       -d file - Capability database to keep the measurements in
+ *       -i - Incremental, measure only the formats without a current
+ *            entry in the capability database
  *       -v - Verbose
  *
  *      graphic formats:
@@ -64,10 +67,29 @@
  *   searchLimits.  Results that happen to reach a searchLimit are prefixed
  *   with >=, so that it is known that the value could possibly be larger.
  *
+ *   The searches assume the HWC is monotone along the dimension being
+ *   searched, in that if it commits to a value it commits to every value
+ *   between that one and the starting point.  Under that assumption each
+ *   commit point is found by galloping away from the starting point and
+ *   then binary searching, rather than by stepping one pixel or overlay
+ *   at a time.  The overlays committed to by each probed list are cached,
+ *   so that lists revisited by different measurements aren't prepared
+ *   again.  Probes that don't depend on each other, such as those of the
+ *   overlap measurements, are made as a batch, with the lists of the next
+ *   probes set up by a worker thread while the HWC prepares the current
+ *   one.
+ *
  *   Measurements are made for each of the graphic formats specified as
  *   positional parameters on the command-line.  If no graphic formats
  *   are specified on the command line, then by default measurements are
  *   made and reported for each of the known graphic format.
+ *
+ *   With -d, the measurements of each format are also kept in a
+ *   capability database file, along with a fingerprint of the device
+ *   they were made on.  With -i as well, formats whose entry has the
+ *   device's fingerprint and isn't marked stale are reported from the
+ *   database instead of being measured again.  See Capability Database
+ *   below for the file format.
  */
 
 #define LOG_TAG "hwcCommitTest"
@@ -76,16 +98,21 @@
 #include <assert.h>
 #include <cerrno>
 #include <cmath>
+#include <condition_variable>
 #include <cstdlib>
 #include <ctime>
+#include <fstream>
 #include <iomanip>
 #include <istream>
 #include <libgen.h>
 #include <list>
+#include <map>
+#include <mutex>
 #include <sched.h>
 #include <sstream>
 #include <stdint.h>
 #include <string.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
@@ -98,14 +125,13 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
-#include <ui/GraphicBuffer.h>
 
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <testUtil.h>
 
 #include <hardware/hwcomposer.h>
 
-#include <glTestLib.h>
 #include "hwcTestLib.h"
 
 using namespace std;
@@ -213,8 +239,9 @@ public:
     bool operator>(const Rational& other) const {
         return (!(*this == other) && !(*this < other));
     }
-    static void double2Rational(double f, Range nRange, Range dRange,
-                               Rational& lower, Rational& upper);
+    static Rational midpoint(const Rational& a, const Rational& b);
+    static void bracket(const Rational& f, Range nRange, Range dRange,
+                        Rational& lower, Rational& upper);
         
     operator string() const;
     operator double() const { return (double) _n / (double) _d; }
@@ -226,14 +253,27 @@ private:
 };
 
 // Globals
-static const int texUsage = GraphicBuffer::USAGE_HW_TEXTURE |
-        GraphicBuffer::USAGE_SW_WRITE_RARELY;
+static const int texUsage = GLTestBuffer::USAGE_HW_TEXTURE |
+        GLTestBuffer::USAGE_SW_WRITE_RARELY;
 static hwc_composer_device_1_t *hwcDevice;
 static EGLDisplay dpy;
 static EGLSurface surface;
 static EGLint width, height;
 static size_t maxHeadingLen;
 static vector<string> formats;
+// Buffers of the numOverlays() probes, reused by later probes of the
+// same source size and format.  Nearly every miss is a size probed for
+// the first time, so the default idle cap is enough; a larger one only
+// holds more memory.
+static HwcTestBufferPool bufferPool;
+static HwcTestLayerArena layerArena;  // Layer lists of the probes
+
+// Overlays committed to by each rectangle list probed so far, keyed by
+// the rectangles' format, transform, blend, source and frame geometry.
+// The searches of the different measurements revisit many of the same
+// lists, which are then answered without another prepare.
+static map<vector<int32_t>, uint32_t> probeCache;
+static uint64_t probes, probeCacheHits;
 
 // Measurements
 struct meas {
@@ -273,6 +313,8 @@ vector<meas> measurements;
 
 // Function prototypes
 uint32_t numOverlays(list<Rectangle>& rectList);
+static uint32_t numOverlays(const Rectangle& rect);
+vector<uint32_t> numOverlaysBatch(vector<list<Rectangle> >& rectLists);
 uint32_t maxOverlays(uint32_t format, bool allowOverlap);
 list<uint32_t> supportedTransforms(uint32_t format);
 list<uint32_t> supportedBlends(uint32_t format);
@@ -296,8 +338,10 @@ Rational scVScale(uint32_t format,
                   const HwcTestDim& dfMin, const HwcTestDim& dfMax,
                   const HwcTestDim& scMin, const HwcTestDim& scMax,
                   HwcTestDim& outBestDf, HwcTestDim& outBestSc);
-uint32_t numOverlapping(uint32_t backgroundFormat, uint32_t foregroundFormat,
-                        uint32_t backgroundBlend, uint32_t foregroundBlend);
+list<Rectangle> overlapLayout(uint32_t backgroundFormat,
+                              uint32_t foregroundFormat,
+                              uint32_t backgroundBlend,
+                              uint32_t foregroundBlend);
 string transformList2str(const list<uint32_t>& transformList);
 string blendList2str(const list<uint32_t>& blendList);
 void init(void);
@@ -305,10 +349,20 @@ void printFormatHeadings(size_t indent);
 void printOverlapLine(size_t indent, const string formatStr,
                       const vector<uint32_t>& results);
 void printSyntax(const char *cmd);
+void measure(const struct hwcTestGraphicFormat *format, struct meas *measPtr);
+void measureOverlap(const vector<bool>& measured);
+void printMeas(struct meas *measPtr);
+void capDbRead(void);
+void capDbWrite(void);
+bool capDbLookup(const char *name, struct meas *measPtr);
+void capDbStore(const char *name, struct meas *measPtr);
 
 // Command-line option settings
 static bool verbose = defaultVerbose;
 static HwcTestDim startDim = defaultStartDim;
+static string capDbPath;        // Capability database, when one is kept
+static bool incremental;        // Take current entries from the database
+static unsigned int capDbReused;
 
 /*
  * Main
@@ -340,12 +394,11 @@ main(int argc, char *argv[])
     bool    error;
     string  str;
     char cmd[MAXCMD];
-    list<Rectangle> rectList;
 
     testSetLogCatTag(LOG_TAG);
 
     // Parse command line arguments
-    while ((opt = getopt(argc, argv, "s:v?h")) != -1) {
+    while ((opt = getopt(argc, argv, "s:d:iv?h")) != -1) {
         switch (opt) {
 
           case 's': // Start Dimension
@@ -372,6 +425,14 @@ main(int argc, char *argv[])
             }
             break;
 
+          case 'd': // Capability database
+            capDbPath = optarg;
+            break;
+
+          case 'i': // Incremental
+            incremental = true;
+            break;
+
           case 'v': // Verbose
             verbose = true;
             break;
@@ -384,14 +445,23 @@ main(int argc, char *argv[])
         }
     }
 
+    if (incremental && capDbPath.empty()) {
+        testPrintE("Incremental measurement needs a capability database");
+        exit(40);
+    }
+
     // Positional parameters
     // Positional parameters provide the names of graphic formats that
     // measurements are to be made on.  Measurements are made on all
     // known graphic formats when no positional parameters are provided.
     if (optind == argc) {
         // No command-line specified graphic formats
-        // Add all graphic formats to the list of formats to be measured
+        // Add all graphic formats to the list of formats to be measured,
+        // other than legacy formats, which must be named
         for (unsigned int n1 = 0; n1 < NUMA(hwcTestGraphicFormat); n1++) {
+            if (hwcTestGraphicFormat[n1].flags & HWC_TEST_FORMAT_LEGACY) {
+                continue;
+            }
             formats.push_back(hwcTestGraphicFormat[n1].desc);
         }
     } else {
@@ -409,22 +479,26 @@ main(int argc, char *argv[])
          maxHeadingLen = max(maxHeadingLen, it->length());
     }
 
-    // Stop framework
-    rv = snprintf(cmd, sizeof(cmd), "%s", CMD_STOP_FRAMEWORK);
-    if (rv >= (signed) sizeof(cmd) - 1) {
-        testPrintE("Command too long for: %s", CMD_STOP_FRAMEWORK);
-        exit(14);
+    // Stop framework, unless the mock hardware composer stands in for the HAL
+    if (!hwcTestMockActive()) {
+        rv = snprintf(cmd, sizeof(cmd), "%s", CMD_STOP_FRAMEWORK);
+        if (rv >= (signed) sizeof(cmd) - 1) {
+            testPrintE("Command too long for: %s", CMD_STOP_FRAMEWORK);
+            exit(14);
+        }
+        testExecCmd(cmd);
+        testDelay(1.0); // TODO - needs means to query whether asynchronous
+                        // stop framework operation has completed.  For now,
+                        // just wait a long time.
     }
-    testExecCmd(cmd);
-    testDelay(1.0); // TODO - needs means to query whether asynchronous stop
-                    // framework operation has completed.  For now, just wait
-                    // a long time.
 
     testPrintI("startDim: %s", ((string) startDim).c_str());
 
     init();
+    if (!capDbPath.empty()) { capDbRead(); }
 
     // For each of the graphic formats
+    vector<bool> measured(formats.size());
     for (vector<string>::iterator itFormat = formats.begin();
          itFormat != formats.end(); ++itFormat) {
 
@@ -446,142 +520,26 @@ main(int argc, char *argv[])
         measurements.push_back(meas);
         measPtr = &measurements[measurements.size() - 1];
 
-        // Start dimension num overlays
-        Rectangle rect(format->format, startDim);
-        rectList.clear();
-        rectList.push_back(rect);
-        measPtr->startDimOverlays = numOverlays(rectList);
-        testPrintI("  startDimOverlays: %u", measPtr->startDimOverlays);
-
-        // Skip the rest of the measurements, when the start dimension
-        // doesn't produce an overlay
-        if (measPtr->startDimOverlays == 0) { continue; }
-
-        // Max Overlays
-        measPtr->maxNonOverlapping = maxOverlays(format->format, false);
-        testPrintI("  max nonOverlapping overlays: %s%u",
-                   (measPtr->maxNonOverlapping == searchLimits.numOverlays)
-                       ? ">= " : "",
-                   measPtr->maxNonOverlapping);
-        measPtr->maxOverlapping = maxOverlays(format->format, true);
-        testPrintI("  max Overlapping overlays: %s%u",
-                   (measPtr->maxOverlapping == searchLimits.numOverlays)
-                       ? ">= " : "",
-                   measPtr->maxOverlapping);
-
-        // Transforms and blends
-        measPtr->transforms = supportedTransforms(format->format);
-        testPrintI("  transforms: %s",
-                   transformList2str(measPtr->transforms).c_str());
-        measPtr->blends = supportedBlends(format->format);
-        testPrintI("  blends: %s",
-                   blendList2str(measPtr->blends).c_str());
-
-        // Display frame measurements
-        measPtr->df.minWidth = dfMinWidth(format->format);
-        testPrintI("  dfMinWidth: %u", measPtr->df.minWidth);
-
-        measPtr->df.minHeight = dfMinHeight(format->format);
-        testPrintI("  dfMinHeight: %u", measPtr->df.minHeight);
-
-        measPtr->df.maxWidth = dfMaxWidth(format->format);
-        testPrintI("  dfMaxWidth: %u", measPtr->df.maxWidth);
-
-        measPtr->df.maxHeight = dfMaxHeight(format->format);
-        testPrintI("  dfMaxHeight: %u", measPtr->df.maxHeight);
-
-        measPtr->df.minDim = dfMinDim(format->format);
-        testPrintI("  dfMinDim: %s", ((string) measPtr->df.minDim).c_str());
-
-        measPtr->df.maxDim = dfMaxDim(format->format);
-        testPrintI("  dfMaxDim: %s", ((string) measPtr->df.maxDim).c_str());
-
-        // Source crop measurements
-        measPtr->sc.minWidth = scMinWidth(format->format, measPtr->df.minDim);
-        testPrintI("  scMinWidth: %u", measPtr->sc.minWidth);
-
-        measPtr->sc.minHeight = scMinHeight(format->format, measPtr->df.minDim);
-        testPrintI("  scMinHeight: %u", measPtr->sc.minHeight);
-
-        measPtr->sc.maxWidth = scMaxWidth(format->format, measPtr->df.maxDim);
-        testPrintI("  scMaxWidth: %s%u", (measPtr->sc.maxWidth
-                   == searchLimits.sourceCrop.width()) ? ">= " : "",
-                   measPtr->sc.maxWidth);
-
-        measPtr->sc.maxHeight = scMaxHeight(format->format, measPtr->df.maxDim);
-        testPrintI("  scMaxHeight: %s%u", (measPtr->sc.maxHeight
-                   == searchLimits.sourceCrop.height()) ? ">= " : "",
-                   measPtr->sc.maxHeight);
-
-        measPtr->sc.minDim = scMinDim(format->format, measPtr->df.minDim);
-        testPrintI("  scMinDim: %s", ((string) measPtr->sc.minDim).c_str());
-
-        measPtr->sc.maxDim = scMaxDim(format->format, measPtr->df.maxDim);
-        testPrintI("  scMaxDim: %s%s", ((measPtr->sc.maxDim.width()
-                         >= searchLimits.sourceCrop.width())
-                         || (measPtr->sc.maxDim.width() >=
-                         searchLimits.sourceCrop.height())) ? ">= " : "",
-                   ((string) measPtr->sc.maxDim).c_str());
-
-        measPtr->sc.hScale = scHScale(format->format,
-                                      measPtr->df.minDim, measPtr->df.maxDim,
-                                      measPtr->sc.minDim, measPtr->sc.maxDim,
-                                      measPtr->sc.hScaleBestDf,
-                                      measPtr->sc.hScaleBestSc);
-        testPrintI("  scHScale: %s%f",
-                   (measPtr->sc.hScale
-                       >= Rational(searchLimits.sourceCrop.width(),
-                                   measPtr->df.minDim.width())) ? ">= " : "",
-                   (double) measPtr->sc.hScale);
-        testPrintI("    HScale Best Display Frame: %s",
-                   ((string) measPtr->sc.hScaleBestDf).c_str());
-        testPrintI("    HScale Best Source Crop: %s",
-                   ((string) measPtr->sc.hScaleBestSc).c_str());
-
-        measPtr->sc.vScale = scVScale(format->format,
-                                      measPtr->df.minDim, measPtr->df.maxDim,
-                                      measPtr->sc.minDim, measPtr->sc.maxDim,
-                                      measPtr->sc.vScaleBestDf,
-                                      measPtr->sc.vScaleBestSc);
-        testPrintI("  scVScale: %s%f",
-                   (measPtr->sc.vScale
-                       >= Rational(searchLimits.sourceCrop.height(),
-                                   measPtr->df.minDim.height())) ? ">= " : "",
-                   (double) measPtr->sc.vScale);
-        testPrintI("    VScale Best Display Frame: %s",
-                   ((string) measPtr->sc.vScaleBestDf).c_str());
-        testPrintI("    VScale Best Source Crop: %s",
-                   ((string) measPtr->sc.vScaleBestSc).c_str());
-
-        // Overlap two graphic formats and different blends
-        // Results displayed after all overlap measurments with
-        // current format in the foreground
-        // TODO: make measurments with background blend other than
-        //       none.  All of these measurements are done with a
-        //       background blend of HWC_BLENDING_NONE, with the
-        //       blend type of the foregound being varied.
-        uint32_t foregroundFormat = format->format;
-        for (vector<string>::iterator it = formats.begin();
-             it != formats.end(); ++it) {
-            uint32_t num;
-
-            const struct hwcTestGraphicFormat *backgroundFormatPtr
-                = hwcTestGraphicFormatLookup((*it).c_str());
-            uint32_t backgroundFormat = backgroundFormatPtr->format;
-
-            num = numOverlapping(backgroundFormat, foregroundFormat,
-                                 HWC_BLENDING_NONE, HWC_BLENDING_NONE);
-            measPtr->overlapBlendNone.push_back(num);
-
-            num = numOverlapping(backgroundFormat, foregroundFormat,
-                                 HWC_BLENDING_NONE, HWC_BLENDING_PREMULT);
-            measPtr->overlapBlendPremult.push_back(num);
-
-            num = numOverlapping(backgroundFormat, foregroundFormat,
-                                 HWC_BLENDING_NONE, HWC_BLENDING_COVERAGE);
-            measPtr->overlapBlendCoverage.push_back(num);
+        // Take the measurements from the capability database, when
+        // re-probing incrementally and the format's entry is current,
+        // otherwise measure them.
+        if (incremental && capDbLookup(format->desc, measPtr)) {
+            testPrintI("  from capability database");
+            capDbReused++;
+        } else {
+            measure(format, measPtr);
+            measured[itFormat - formats.begin()] = true;
         }
+        printMeas(measPtr);
+    }
 
+    // Overlap measurements, of the formats measured above
+    measureOverlap(measured);
+    for (size_t n1 = 0; n1 < formats.size(); n1++) {
+        if (measured[n1] && !capDbPath.empty()) {
+            capDbStore(hwcTestGraphicFormatLookup(formats[n1].c_str())->desc,
+                       &measurements[n1]);
+        }
     }
 
     // Display overlap results
@@ -612,18 +570,591 @@ main(int argc, char *argv[])
                          - formats.begin()].overlapBlendCoverage);
     }
     testPrintI("");
+    testPrintI("probes: %llu, %llu answered from the cache (%.1f%%)",
+               (unsigned long long) probes,
+               (unsigned long long) probeCacheHits,
+               probes ? 100.0 * probeCacheHits / probes : 0.0);
+    bufferPool.report("hwcCommit");
+    bufferPool.clear();
+    if (!capDbPath.empty()) {
+        capDbWrite();
+        testPrintI("capability database %s: %u of %zu formats reused",
+                   capDbPath.c_str(), capDbReused, formats.size());
+    }
 
-    // Start framework
-    rv = snprintf(cmd, sizeof(cmd), "%s", CMD_START_FRAMEWORK);
-    if (rv >= (signed) sizeof(cmd) - 1) {
-        testPrintE("Command too long for: %s", CMD_START_FRAMEWORK);
-        exit(21);
+    // Start framework, unless the mock hardware composer stands in for the HAL
+    if (!hwcTestMockActive()) {
+        rv = snprintf(cmd, sizeof(cmd), "%s", CMD_START_FRAMEWORK);
+        if (rv >= (signed) sizeof(cmd) - 1) {
+            testPrintE("Command too long for: %s", CMD_START_FRAMEWORK);
+            exit(21);
+        }
+        testExecCmd(cmd);
     }
-    testExecCmd(cmd);
 
     return 0;
 }
 
+// Measure
+// Takes each of the measurements of the given format
+void measure(const struct hwcTestGraphicFormat *format, struct meas *measPtr)
+{
+    // Start dimension num overlays
+    measPtr->startDimOverlays = numOverlays(Rectangle(format->format,
+                                                      startDim));
+
+    // Skip the rest of the measurements, when the start dimension
+    // doesn't produce an overlay
+    if (measPtr->startDimOverlays == 0) { return; }
+
+    // Max Overlays
+    measPtr->maxNonOverlapping = maxOverlays(format->format, false);
+    measPtr->maxOverlapping = maxOverlays(format->format, true);
+
+    // Transforms and blends
+    measPtr->transforms = supportedTransforms(format->format);
+    measPtr->blends = supportedBlends(format->format);
+
+    // Display frame measurements
+    measPtr->df.minWidth = dfMinWidth(format->format);
+    measPtr->df.minHeight = dfMinHeight(format->format);
+    measPtr->df.maxWidth = dfMaxWidth(format->format);
+    measPtr->df.maxHeight = dfMaxHeight(format->format);
+    measPtr->df.minDim = dfMinDim(format->format);
+    measPtr->df.maxDim = dfMaxDim(format->format);
+
+    // Source crop measurements
+    measPtr->sc.minWidth = scMinWidth(format->format, measPtr->df.minDim);
+    measPtr->sc.minHeight = scMinHeight(format->format, measPtr->df.minDim);
+    measPtr->sc.maxWidth = scMaxWidth(format->format, measPtr->df.maxDim);
+    measPtr->sc.maxHeight = scMaxHeight(format->format, measPtr->df.maxDim);
+    measPtr->sc.minDim = scMinDim(format->format, measPtr->df.minDim);
+    measPtr->sc.maxDim = scMaxDim(format->format, measPtr->df.maxDim);
+    measPtr->sc.hScale = scHScale(format->format,
+                                  measPtr->df.minDim, measPtr->df.maxDim,
+                                  measPtr->sc.minDim, measPtr->sc.maxDim,
+                                  measPtr->sc.hScaleBestDf,
+                                  measPtr->sc.hScaleBestSc);
+    measPtr->sc.vScale = scVScale(format->format,
+                                  measPtr->df.minDim, measPtr->df.maxDim,
+                                  measPtr->sc.minDim, measPtr->sc.maxDim,
+                                  measPtr->sc.vScaleBestDf,
+                                  measPtr->sc.vScaleBestSc);
+}
+
+// Measure Overlap
+// Overlaps each of the measured formats, in the foreground, with each of
+// the formats, in the background, for each of the foreground blends.
+// The probes are all independent, so they are made as one batch.
+// TODO: make measurments with background blend other than
+//       none.  All of these measurements are done with a
+//       background blend of HWC_BLENDING_NONE, with the
+//       blend type of the foregound being varied.
+void measureOverlap(const vector<bool>& measured)
+{
+    static const uint32_t foregroundBlends[] = {
+        HWC_BLENDING_NONE, HWC_BLENDING_PREMULT, HWC_BLENDING_COVERAGE,
+    };
+    vector<list<Rectangle> > rectLists;
+
+    for (size_t fg = 0; fg < formats.size(); fg++) {
+        if (!measured[fg] || (measurements[fg].startDimOverlays == 0)) {
+            continue;
+        }
+        for (size_t bg = 0; bg < formats.size(); bg++) {
+            for (unsigned int idx = 0; idx < NUMA(foregroundBlends); idx++) {
+                rectLists.push_back(overlapLayout(measurements[bg].format,
+                    measurements[fg].format, HWC_BLENDING_NONE,
+                    foregroundBlends[idx]));
+            }
+        }
+    }
+
+    vector<uint32_t> num = numOverlaysBatch(rectLists);
+    vector<uint32_t>::iterator it = num.begin();
+    for (size_t fg = 0; fg < formats.size(); fg++) {
+        if (!measured[fg] || (measurements[fg].startDimOverlays == 0)) {
+            continue;
+        }
+        struct meas *measPtr = &measurements[fg];
+        for (size_t bg = 0; bg < formats.size(); bg++) {
+            measPtr->overlapBlendNone.push_back(*it++);
+            measPtr->overlapBlendPremult.push_back(*it++);
+            measPtr->overlapBlendCoverage.push_back(*it++);
+        }
+    }
+}
+
+// Print Measurements
+// Reports the measurements of a format, other than the overlap results,
+// which are reported for all the formats together
+void printMeas(struct meas *measPtr)
+{
+    testPrintI("  startDimOverlays: %u", measPtr->startDimOverlays);
+    if (measPtr->startDimOverlays == 0) { return; }
+
+    testPrintI("  max nonOverlapping overlays: %s%u",
+               (measPtr->maxNonOverlapping == searchLimits.numOverlays)
+                   ? ">= " : "",
+               measPtr->maxNonOverlapping);
+    testPrintI("  max Overlapping overlays: %s%u",
+               (measPtr->maxOverlapping == searchLimits.numOverlays)
+                   ? ">= " : "",
+               measPtr->maxOverlapping);
+
+    testPrintI("  transforms: %s",
+               transformList2str(measPtr->transforms).c_str());
+    testPrintI("  blends: %s",
+               blendList2str(measPtr->blends).c_str());
+
+    testPrintI("  dfMinWidth: %u", measPtr->df.minWidth);
+    testPrintI("  dfMinHeight: %u", measPtr->df.minHeight);
+    testPrintI("  dfMaxWidth: %u", measPtr->df.maxWidth);
+    testPrintI("  dfMaxHeight: %u", measPtr->df.maxHeight);
+    testPrintI("  dfMinDim: %s", ((string) measPtr->df.minDim).c_str());
+    testPrintI("  dfMaxDim: %s", ((string) measPtr->df.maxDim).c_str());
+
+    testPrintI("  scMinWidth: %u", measPtr->sc.minWidth);
+    testPrintI("  scMinHeight: %u", measPtr->sc.minHeight);
+    testPrintI("  scMaxWidth: %s%u", (measPtr->sc.maxWidth
+               == searchLimits.sourceCrop.width()) ? ">= " : "",
+               measPtr->sc.maxWidth);
+    testPrintI("  scMaxHeight: %s%u", (measPtr->sc.maxHeight
+               == searchLimits.sourceCrop.height()) ? ">= " : "",
+               measPtr->sc.maxHeight);
+    testPrintI("  scMinDim: %s", ((string) measPtr->sc.minDim).c_str());
+    testPrintI("  scMaxDim: %s%s", ((measPtr->sc.maxDim.width()
+                     >= searchLimits.sourceCrop.width())
+                     || (measPtr->sc.maxDim.width() >=
+                     searchLimits.sourceCrop.height())) ? ">= " : "",
+               ((string) measPtr->sc.maxDim).c_str());
+
+    testPrintI("  scHScale: %s%f",
+               (measPtr->sc.hScale
+                   >= Rational(searchLimits.sourceCrop.width(),
+                               measPtr->df.minDim.width())) ? ">= " : "",
+               (double) measPtr->sc.hScale);
+    testPrintI("    HScale Best Display Frame: %s",
+               ((string) measPtr->sc.hScaleBestDf).c_str());
+    testPrintI("    HScale Best Source Crop: %s",
+               ((string) measPtr->sc.hScaleBestSc).c_str());
+    testPrintI("  scVScale: %s%f",
+               (measPtr->sc.vScale
+                   >= Rational(searchLimits.sourceCrop.height(),
+                               measPtr->df.minDim.height())) ? ">= " : "",
+               (double) measPtr->sc.vScale);
+    testPrintI("    VScale Best Display Frame: %s",
+               ((string) measPtr->sc.vScaleBestDf).c_str());
+    testPrintI("    VScale Best Source Crop: %s",
+               ((string) measPtr->sc.vScaleBestSc).c_str());
+}
+
+/*
+ * Capability Database
+ *
+ * A text file of the measurements of each format, so that a later run,
+ * or other tooling, can take them without another search.  The file
+ * starts with a version line, followed by an entry per format:
+ *
+ *   hwcCommit capabilities 1
+ *   format RGBA8888
+ *   fingerprint hal=0x1000000 display=1280x720 start=100x100 build=...
+ *   stale 0
+ *   startDimOverlays 1
+ *   maxOverlays 4 3
+ *   transforms 1 2 3
+ *   blends 256 1029
+ *   df 1 1 1 1 1280 720 1280 720
+ *   sc 1 1 1 1 3000 2000 3000 2000
+ *   hScale 3000 1 1 1 3000 1
+ *   vScale 2000 1 1 1 1 2000
+ *   overlap RGBA8888 2 2 2
+ *   end
+ *
+ * The df and sc lines are each the min width, min height, min
+ * dimension, max width, max height and max dimension.  The scale lines
+ * are the ratio, as numerator and denominator, followed by the display
+ * frame and source crop it was found with.  An overlap line per
+ * background format gives the overlays committed to with the foreground
+ * blend of none, premult and coverage.  Entries of a format with no
+ * overlay at the start dimension end after its startDimOverlays line.
+ *
+ * The fingerprint names what the measurements depend on: the HWC
+ * device version, display size, start dimension and build fingerprint,
+ * plus the model when the mock HWC is used.  With -i, an entry is used
+ * in place of measuring its format, as long as its fingerprint matches
+ * the device's, it has an overlap line for each format being measured
+ * and it isn't stale.  Tools mark entries for re-measurement by setting
+ * their stale value to 1.  A file of another version is ignored, and
+ * replaced by the next write.
+ */
+
+static const unsigned int capDbVersion = 1;
+
+// Entry for the measurements of one format
+struct capDbEntry {
+    string fingerprint;
+    bool stale;
+    struct meas meas;   // Overlap vectors unused, see overlap
+    map<string, vector<uint32_t> > overlap; // By background format,
+                                            // blend none, premult and
+                                            // coverage
+};
+
+static map<string, capDbEntry> capDb; // By format name
+static string capDbFingerprint;
+
+// Forms the fingerprint of the device being measured
+static string capDbDeviceFingerprint(void)
+{
+    char build[PROPERTY_VALUE_MAX];
+    ostringstream out;
+
+    property_get("ro.build.fingerprint", build, "unknown");
+    out << "hal=0x" << hex << hwcDevice->common.version << dec
+        << " display=" << width << 'x' << height
+        << " start=" << startDim.width() << 'x' << startDim.height()
+        << " build=" << build;
+    if (hwcTestMockActive()) {
+        out << " mock=" << getenv("GLTEST_HWC_MOCK");
+    }
+
+    // Keep it to a single line
+    string rv = out.str();
+    replace(rv.begin(), rv.end(), '\n', ' ');
+
+    return rv;
+}
+
+static void capDbParseError(unsigned int lineNum, const string& line)
+{
+    testPrintE("Capability database %s line %u invalid: %s",
+               capDbPath.c_str(), lineNum, line.c_str());
+    exit(41);
+}
+
+// Forms the fingerprint of the device, which entries are checked
+// against, and loads the database file, when there is one
+void capDbRead(void)
+{
+    capDbFingerprint = capDbDeviceFingerprint();
+
+    ifstream in(capDbPath.c_str());
+    if (!in) { return; }
+
+    string line;
+    unsigned int lineNum = 1;
+    unsigned int version = 0;
+    string magic1, magic2;
+    if (getline(in, line)) {
+        istringstream header(line);
+        header >> magic1 >> magic2 >> version;
+    }
+    if ((magic1 != "hwcCommit") || (magic2 != "capabilities")) {
+        capDbParseError(lineNum, line);
+    }
+    if (version != capDbVersion) {
+        testPrintI("Ignoring version %u capability database %s", version,
+                   capDbPath.c_str());
+        return;
+    }
+
+    capDbEntry *entry = NULL;
+    while (getline(in, line)) {
+        lineNum++;
+        istringstream fields(line);
+        string keyword;
+        fields >> keyword;
+        if (keyword.empty()) { continue; }
+
+        if (keyword == "format") {
+            string name;
+            fields >> name;
+            entry = &capDb[name];
+            *entry = capDbEntry();
+            entry->stale = false;
+            continue;
+        }
+        if (entry == NULL) { capDbParseError(lineNum, line); }
+
+        struct meas *m = &entry->meas;
+        uint32_t v[8];
+        if (keyword == "end") {
+            entry = NULL;
+            continue;
+        } else if (keyword == "fingerprint") {
+            fields >> ws;
+            getline(fields, entry->fingerprint);
+            continue;
+        } else if (keyword == "stale") {
+            fields >> entry->stale;
+        } else if (keyword == "startDimOverlays") {
+            fields >> m->startDimOverlays;
+        } else if (keyword == "maxOverlays") {
+            fields >> m->maxNonOverlapping >> m->maxOverlapping;
+        } else if ((keyword == "transforms") || (keyword == "blends")) {
+            list<uint32_t>& ids = (keyword == "transforms")
+                ? m->transforms : m->blends;
+            while (fields >> v[0]) { ids.push_back(v[0]); }
+            continue;
+        } else if (keyword == "df") {
+            for (unsigned int n1 = 0; n1 < 8; n1++) { fields >> v[n1]; }
+            m->df.minWidth = v[0];
+            m->df.minHeight = v[1];
+            m->df.minDim = HwcTestDim(v[2], v[3]);
+            m->df.maxWidth = v[4];
+            m->df.maxHeight = v[5];
+            m->df.maxDim = HwcTestDim(v[6], v[7]);
+        } else if (keyword == "sc") {
+            for (unsigned int n1 = 0; n1 < 8; n1++) { fields >> v[n1]; }
+            m->sc.minWidth = v[0];
+            m->sc.minHeight = v[1];
+            m->sc.minDim = HwcTestDim(v[2], v[3]);
+            m->sc.maxWidth = v[4];
+            m->sc.maxHeight = v[5];
+            m->sc.maxDim = HwcTestDim(v[6], v[7]);
+        } else if (keyword == "hScale") {
+            for (unsigned int n1 = 0; n1 < 6; n1++) { fields >> v[n1]; }
+            m->sc.hScale = Rational(v[0], v[1]);
+            m->sc.hScaleBestDf = HwcTestDim(v[2], v[3]);
+            m->sc.hScaleBestSc = HwcTestDim(v[4], v[5]);
+        } else if (keyword == "vScale") {
+            for (unsigned int n1 = 0; n1 < 6; n1++) { fields >> v[n1]; }
+            m->sc.vScale = Rational(v[0], v[1]);
+            m->sc.vScaleBestDf = HwcTestDim(v[2], v[3]);
+            m->sc.vScaleBestSc = HwcTestDim(v[4], v[5]);
+        } else if (keyword == "overlap") {
+            string background;
+            fields >> background >> v[0] >> v[1] >> v[2];
+            entry->overlap[background] = vector<uint32_t>(v, v + 3);
+        } else {
+            capDbParseError(lineNum, line);
+        }
+        if (fields.fail()) { capDbParseError(lineNum, line); }
+    }
+}
+
+// Writes the database file, replacing it as a whole, so that a reader
+// never sees it partially written
+void capDbWrite(void)
+{
+    string tmpPath = capDbPath + ".tmp";
+    ofstream out(tmpPath.c_str());
+
+    out << "hwcCommit capabilities " << capDbVersion << '\n';
+    for (map<string, capDbEntry>::iterator it = capDb.begin();
+         it != capDb.end(); ++it) {
+        struct meas *m = &it->second.meas;
+
+        out << "format " << it->first << '\n';
+        out << "fingerprint " << it->second.fingerprint << '\n';
+        out << "stale " << it->second.stale << '\n';
+        out << "startDimOverlays " << m->startDimOverlays << '\n';
+        if (m->startDimOverlays == 0) {
+            out << "end\n";
+            continue;
+        }
+        out << "maxOverlays " << m->maxNonOverlapping << ' '
+            << m->maxOverlapping << '\n';
+        out << "transforms";
+        for (list<uint32_t>::iterator id = m->transforms.begin();
+             id != m->transforms.end(); ++id) {
+            out << ' ' << *id;
+        }
+        out << "\nblends";
+        for (list<uint32_t>::iterator id = m->blends.begin();
+             id != m->blends.end(); ++id) {
+            out << ' ' << *id;
+        }
+        out << '\n';
+        out << "df " << m->df.minWidth << ' ' << m->df.minHeight << ' '
+            << m->df.minDim.width() << ' ' << m->df.minDim.height() << ' '
+            << m->df.maxWidth << ' ' << m->df.maxHeight << ' '
+            << m->df.maxDim.width() << ' ' << m->df.maxDim.height() << '\n';
+        out << "sc " << m->sc.minWidth << ' ' << m->sc.minHeight << ' '
+            << m->sc.minDim.width() << ' ' << m->sc.minDim.height() << ' '
+            << m->sc.maxWidth << ' ' << m->sc.maxHeight << ' '
+            << m->sc.maxDim.width() << ' ' << m->sc.maxDim.height() << '\n';
+        out << "hScale " << m->sc.hScale.numerator() << ' '
+            << m->sc.hScale.denominator() << ' '
+            << m->sc.hScaleBestDf.width() << ' '
+            << m->sc.hScaleBestDf.height() << ' '
+            << m->sc.hScaleBestSc.width() << ' '
+            << m->sc.hScaleBestSc.height() << '\n';
+        out << "vScale " << m->sc.vScale.numerator() << ' '
+            << m->sc.vScale.denominator() << ' '
+            << m->sc.vScaleBestDf.width() << ' '
+            << m->sc.vScaleBestDf.height() << ' '
+            << m->sc.vScaleBestSc.width() << ' '
+            << m->sc.vScaleBestSc.height() << '\n';
+        for (map<string, vector<uint32_t> >::iterator overlap
+                 = it->second.overlap.begin();
+             overlap != it->second.overlap.end(); ++overlap) {
+            out << "overlap " << overlap->first << ' '
+                << overlap->second[0] << ' ' << overlap->second[1] << ' '
+                << overlap->second[2] << '\n';
+        }
+        out << "end\n";
+    }
+    out.close();
+
+    if (out.fail() || (rename(tmpPath.c_str(), capDbPath.c_str()) != 0)) {
+        testPrintE("Failed to write capability database %s: %s",
+                   capDbPath.c_str(), strerror(errno));
+        exit(42);
+    }
+}
+
+// Takes the measurements of a format from its database entry, when the
+// entry is current.  Returns false when the format needs measuring.
+bool capDbLookup(const char *name, struct meas *measPtr)
+{
+    map<string, capDbEntry>::iterator it = capDb.find(name);
+    if ((it == capDb.end()) || it->second.stale
+        || (it->second.fingerprint != capDbFingerprint)) {
+        return false;
+    }
+
+    struct meas meas = it->second.meas;
+    meas.format = measPtr->format;
+    if (meas.startDimOverlays != 0) {
+        for (vector<string>::iterator format = formats.begin();
+             format != formats.end(); ++format) {
+            map<string, vector<uint32_t> >::iterator overlap
+                = it->second.overlap.find(
+                    hwcTestGraphicFormatLookup(format->c_str())->desc);
+            if (overlap == it->second.overlap.end()) { return false; }
+            meas.overlapBlendNone.push_back(overlap->second[0]);
+            meas.overlapBlendPremult.push_back(overlap->second[1]);
+            meas.overlapBlendCoverage.push_back(overlap->second[2]);
+        }
+    }
+    *measPtr = meas;
+
+    return true;
+}
+
+// Replaces the database entry of a format with its measurements.
+// Overlap results with background formats not being measured are kept.
+void capDbStore(const char *name, struct meas *measPtr)
+{
+    capDbEntry& entry = capDb[name];
+    map<string, vector<uint32_t> > overlap;
+
+    if (entry.fingerprint == capDbFingerprint) {
+        overlap.swap(entry.overlap);
+    }
+    entry.fingerprint = capDbFingerprint;
+    entry.stale = false;
+    entry.meas = *measPtr;
+    entry.meas.overlapBlendNone.clear();
+    entry.meas.overlapBlendPremult.clear();
+    entry.meas.overlapBlendCoverage.clear();
+    for (unsigned int n1 = 0; n1 < measPtr->overlapBlendNone.size(); n1++) {
+        uint32_t results[] = {
+            measPtr->overlapBlendNone[n1],
+            measPtr->overlapBlendPremult[n1],
+            measPtr->overlapBlendCoverage[n1],
+        };
+        overlap[hwcTestGraphicFormatLookup(formats[n1].c_str())->desc]
+            = vector<uint32_t>(results, results + 3);
+    }
+    entry.overlap.swap(overlap);
+}
+
+/*
+ * Monotone searches
+ *
+ * The commit points are searched for on the assumption that the HWC
+ * is monotone along each probed dimension: when it commits to a size,
+ * it also commits to every size between that one and the start
+ * dimension.  Each search gallops from one end of its range, probing
+ * offsets 0, 1, 3, 7, ... until the probe changes outcome, then binary
+ * searches the last step.  Crossing the commit point at offset n takes
+ * about 2 * log2(n) probes instead of n.
+ */
+
+// Smallest value from low to high the probe succeeds for, where it
+// fails below some value and succeeds from there on.  Returns high + 1
+// when it succeeds for none.
+template <class Probe>
+static uint32_t searchFirst(uint32_t low, uint32_t high, Probe probe)
+{
+    int64_t fail = (int64_t) low - 1;   // Greatest known to fail
+    int64_t pass;                       // Least known to pass
+    int64_t step = 1;
+
+    for (int64_t value = low;; step *= 2) {
+        if (probe((uint32_t) value)) {
+            pass = value;
+            break;
+        }
+        fail = value;
+        if (value >= high) { return high + 1; }
+        value = min((int64_t) high, (int64_t) low + 2 * step - 1);
+    }
+
+    while (pass - fail > 1) {
+        int64_t mid = fail + (pass - fail) / 2;
+        if (probe((uint32_t) mid)) {
+            pass = mid;
+        } else {
+            fail = mid;
+        }
+    }
+
+    return pass;
+}
+
+// Largest value from low to high the probe succeeds for, where it
+// succeeds up to some value and fails from there on.  Returns low - 1
+// when it succeeds for none, or when the range is empty.
+template <class Probe>
+static uint32_t searchLast(uint32_t low, uint32_t high, Probe probe)
+{
+    if (high < low) { return low - 1; }
+
+    uint32_t offset = searchFirst(0, high - low,
+                                  [&](uint32_t n) { return probe(high - n); });
+
+    return high - offset;
+}
+
+// Overlays given to a single rectangle
+static uint32_t numOverlays(const Rectangle& rect)
+{
+    list<Rectangle> rectList(1, rect);
+
+    return numOverlays(rectList);
+}
+
+// Rectangles of the given format, for maxOverlays()
+static list<Rectangle> overlayLayout(uint32_t format, bool allowOverlap,
+                                     unsigned int numRects)
+{
+    list<Rectangle> rectList;
+
+    for (unsigned int x = 0;
+         (x + startDim.width()) < (unsigned int) width;
+         x += (allowOverlap) ? 1 : startDim.width()) {
+        for (unsigned int y = 0;
+             (y + startDim.height()) < (unsigned int) height;
+             y += (allowOverlap) ? 1 : startDim.height()) {
+            Rectangle rect(format, startDim, startDim);
+            rect.displayFrame.left = x;
+            rect.displayFrame.top = y;
+            rect.displayFrame.right = x + startDim.width();
+            rect.displayFrame.bottom = y + startDim.height();
+
+            rectList.push_back(rect);
+
+            if (rectList.size() >= numRects) { return rectList; }
+        }
+    }
+
+    return rectList;
+}
+
 // Determine the maximum number of overlays that are all of the same format
 // that the HWC will commit to.  If allowOverlap is true, then the rectangles
 // are laid out on a diagonal starting from the upper left corner.  With
@@ -632,35 +1163,39 @@ main(int argc, char *argv[])
 // order.  Note, column major ordering is used so that the initial rectangles
 // are all on different horizontal scan rows.  It is common that hardware
 // has limits on the number of objects it can handle on any single row.
+// The count is doubled while the HWC commits to every rectangle, then
+// the last count it commits to all of is binary searched for.
 uint32_t maxOverlays(uint32_t format, bool allowOverlap)
 {
     unsigned int max = 0;
+    unsigned int full = 0;      // Greatest count all committed to
+    unsigned int partial = 0;   // Least count not all committed to
 
-    for (unsigned int numRects = 1; numRects <= searchLimits.numOverlays;
-         numRects++) {
-        list<Rectangle> rectList;
-
-        for (unsigned int x = 0;
-             (x + startDim.width()) < (unsigned int) width;
-             x += (allowOverlap) ? 1 : startDim.width()) {
-            for (unsigned int y = 0;
-                 (y + startDim.height()) < (unsigned int) height;
-                 y += (allowOverlap) ? 1 : startDim.height()) {
-                Rectangle rect(format, startDim, startDim);
-                rect.displayFrame.left = x;
-                rect.displayFrame.top = y;
-                rect.displayFrame.right = x + startDim.width();
-                rect.displayFrame.bottom = y + startDim.height();
-
-                rectList.push_back(rect);
-
-                if (rectList.size() >= numRects) { break; }
-            }
-            if (rectList.size() >= numRects) { break; }
+    for (unsigned int numRects = 1;; numRects *= 2) {
+        numRects = min(numRects, searchLimits.numOverlays);
+        list<Rectangle> rectList = overlayLayout(format, allowOverlap,
+                                                 numRects);
+        uint32_t num = numOverlays(rectList);
+        if (num > max) { max = num; }
+        if (num < numRects) {
+            partial = numRects;
+            break;
         }
+        full = numRects;
+        if (numRects == searchLimits.numOverlays) { return max; }
+    }
 
+    while (partial - full > 1) {
+        unsigned int numRects = full + (partial - full) / 2;
+        list<Rectangle> rectList = overlayLayout(format, allowOverlap,
+                                                 numRects);
         uint32_t num = numOverlays(rectList);
         if (num > max) { max = num; }
+        if (num < numRects) {
+            partial = numRects;
+        } else {
+            full = numRects;
+        }
     }
 
     return max;
@@ -671,20 +1206,19 @@ uint32_t maxOverlays(uint32_t format, bool allowOverlap)
 list<uint32_t> supportedTransforms(uint32_t format)
 {
     list<uint32_t> rv;
-    list<Rectangle> rectList;
+    vector<list<Rectangle> > rectLists;
     Rectangle rect(format, startDim);
 
     // For each of the transform types
     for (unsigned int idx = 0; idx < NUMA(transformType); idx++) {
-        unsigned int id = transformType[idx].id;
-
-        rect.transform = id;
-        rectList.clear();
-        rectList.push_back(rect);
-        uint32_t num = numOverlays(rectList);
+        rect.transform = transformType[idx].id;
+        rectLists.push_back(list<Rectangle>(1, rect));
+    }
 
-        if (num == 1) {
-            rv.push_back(id);
+    vector<uint32_t> num = numOverlaysBatch(rectLists);
+    for (unsigned int idx = 0; idx < NUMA(transformType); idx++) {
+        if (num[idx] == 1) {
+            rv.push_back(transformType[idx].id);
         }
     }
 
@@ -696,20 +1230,19 @@ list<uint32_t> supportedTransforms(uint32_t format)
 list<uint32_t> supportedBlends(uint32_t format)
 {
     list<uint32_t> rv;
-    list<Rectangle> rectList;
+    vector<list<Rectangle> > rectLists;
     Rectangle rect(format, startDim);
 
     // For each of the blend types
     for (unsigned int idx = 0; idx < NUMA(blendType); idx++) {
-        unsigned int id = blendType[idx].id;
-
-        rect.blend = id;
-        rectList.clear();
-        rectList.push_back(rect);
-        uint32_t num = numOverlays(rectList);
+        rect.blend = blendType[idx].id;
+        rectLists.push_back(list<Rectangle>(1, rect));
+    }
 
-        if (num == 1) {
-            rv.push_back(id);
+    vector<uint32_t> num = numOverlaysBatch(rectLists);
+    for (unsigned int idx = 0; idx < NUMA(blendType); idx++) {
+        if (num[idx] == 1) {
+            rv.push_back(blendType[idx].id);
         }
     }
 
@@ -720,19 +1253,10 @@ list<uint32_t> supportedBlends(uint32_t format)
 // that the HWC will commit to.
 uint32_t dfMinWidth(uint32_t format)
 {
-    uint32_t w;
-    list<Rectangle> rectList;
-
-    for (w = 1; w <= startDim.width(); w++) {
-        HwcTestDim dim(w, startDim.height());
-        Rectangle rect(format, dim);
-        rectList.clear();
-        rectList.push_back(rect);
-        uint32_t num = numOverlays(rectList);
-        if (num > 0) {
-            return w;
-        }
-    }
+    uint32_t w = searchFirst(1, startDim.width(), [&](uint32_t w) {
+        return numOverlays(Rectangle(format,
+                                     HwcTestDim(w, startDim.height()))) > 0;
+    });
     if (w > startDim.width()) {
         testPrintE("Failed to locate display frame min width");
         exit(33);
@@ -744,19 +1268,10 @@ uint32_t dfMinWidth(uint32_t format)
 // Display frame minimum height
 uint32_t dfMinHeight(uint32_t format)
 {
-    uint32_t h;
-    list<Rectangle> rectList;
-
-    for (h = 1; h <= startDim.height(); h++) {
-        HwcTestDim dim(startDim.width(), h);
-        Rectangle rect(format, dim);
-        rectList.clear();
-        rectList.push_back(rect);
-        uint32_t num = numOverlays(rectList);
-        if (num > 0) {
-            return h;
-        }
-    }
+    uint32_t h = searchFirst(1, startDim.height(), [&](uint32_t h) {
+        return numOverlays(Rectangle(format,
+                                     HwcTestDim(startDim.width(), h))) > 0;
+    });
     if (h > startDim.height()) {
         testPrintE("Failed to locate display frame min height");
         exit(34);
@@ -768,19 +1283,10 @@ uint32_t dfMinHeight(uint32_t format)
 // Display frame maximum width
 uint32_t dfMaxWidth(uint32_t format)
 {
-    uint32_t w;
-    list<Rectangle> rectList;
-
-    for (w = width; w >= startDim.width(); w--) {
-        HwcTestDim dim(w, startDim.height());
-        Rectangle rect(format, dim);
-        rectList.clear();
-        rectList.push_back(rect);
-        uint32_t num = numOverlays(rectList);
-        if (num > 0) {
-            return w;
-        }
-    }
+    uint32_t w = searchLast(startDim.width(), width, [&](uint32_t w) {
+        return numOverlays(Rectangle(format,
+                                     HwcTestDim(w, startDim.height()))) > 0;
+    });
     if (w < startDim.width()) {
         testPrintE("Failed to locate display frame max width");
         exit(35);
@@ -792,18 +1298,10 @@ uint32_t dfMaxWidth(uint32_t format)
 // Display frame maximum height
 uint32_t dfMaxHeight(uint32_t format)
 {
-    uint32_t h;
-
-    for (h = height; h >= startDim.height(); h--) {
-        HwcTestDim dim(startDim.width(), h);
-        Rectangle rect(format, dim);
-        list<Rectangle> rectList;
-        rectList.push_back(rect);
-        uint32_t num = numOverlays(rectList);
-        if (num > 0) {
-            return h;
-        }
-    }
+    uint32_t h = searchLast(startDim.height(), height, [&](uint32_t h) {
+        return numOverlays(Rectangle(format,
+                                     HwcTestDim(startDim.width(), h))) > 0;
+    });
     if (h < startDim.height()) {
         testPrintE("Failed to locate display frame max height");
         exit(36);
@@ -815,6 +1313,7 @@ uint32_t dfMaxHeight(uint32_t format)
 // Determine the minimum number of pixels that the HWC will ever commit to.
 // Note, this might be different that dfMinWidth * dfMinHeight, in that this
 // function adjusts both the width and height from the starting dimension.
+// For each width the least height committed to is searched for.
 HwcTestDim dfMinDim(uint32_t format)
 {
     uint64_t bestMinPixels = 0;
@@ -825,24 +1324,18 @@ HwcTestDim dfMinDim(uint32_t format)
     bool origVerbose = verbose;  // Temporarily turn off verbose
     verbose = false;
     for (uint32_t w = 1; w <= startDim.width(); w++) {
-        for (uint32_t h = 1; h <= startDim.height(); h++) {
-            if (bestSet && ((w > bestMinPixels) || (h > bestMinPixels))) {
-                break;
-            }
-
-            HwcTestDim dim(w, h);
-            Rectangle rect(format, dim);
-            list<Rectangle> rectList;
-            rectList.push_back(rect);
-            uint32_t num = numOverlays(rectList);
-            if (num > 0) {
-                uint64_t pixels = dim.width() * dim.height();
-                if (!bestSet || (pixels < bestMinPixels)) {
-                    bestMinPixels = pixels;
-                    bestDim = dim;
-                    bestSet = true;
-                }
-            }
+        if (bestSet && (w > bestMinPixels)) { break; }
+
+        uint32_t h = searchFirst(1, startDim.height(), [&](uint32_t h) {
+            return numOverlays(Rectangle(format, HwcTestDim(w, h))) > 0;
+        });
+        if (h > startDim.height()) { continue; }
+
+        uint64_t pixels = (uint64_t) w * h;
+        if (!bestSet || (pixels < bestMinPixels)) {
+            bestMinPixels = pixels;
+            bestDim = HwcTestDim(w, h);
+            bestSet = true;
         }
     }
     verbose = origVerbose;
@@ -856,6 +1349,9 @@ HwcTestDim dfMinDim(uint32_t format)
 }
 
 // Display frame maximum dimension
+// For each width the greatest height committed to is searched for.  It
+// can only shrink as the width grows, so it bounds the next search, and
+// once no height is committed to no greater width is either.
 HwcTestDim dfMaxDim(uint32_t format)
 {
     uint64_t bestMaxPixels = 0;
@@ -872,26 +1368,23 @@ HwcTestDim dfMaxDim(uint32_t format)
     uint32_t num = numOverlays(rectList);
     if (num == 1) { return dim; }
 
-    // TODO: Use a binary search
     bool origVerbose = verbose;  // Temporarily turn off verbose
     verbose = false;
+    uint32_t maxH = height;
     for (uint32_t w = startDim.width(); w <= (uint32_t) width; w++) {
-        for (uint32_t h = startDim.height(); h <= (uint32_t) height; h++) {
-            if (bestSet && ((w * h) <= bestMaxPixels)) { continue; }
-
-            HwcTestDim dim(w, h);
-            Rectangle rect(format, dim);
-            list<Rectangle> rectList;
-            rectList.push_back(rect);
-            uint32_t num = numOverlays(rectList);
-            if (num > 0) {
-                uint64_t pixels = dim.width() * dim.height();
-                if (!bestSet || (pixels > bestMaxPixels)) {
-                    bestMaxPixels = pixels;
-                    bestDim = dim;
-                    bestSet = true;
-                }
-            }
+        if (bestSet && ((uint64_t) w * maxH <= bestMaxPixels)) { continue; }
+
+        uint32_t h = searchLast(startDim.height(), maxH, [&](uint32_t h) {
+            return numOverlays(Rectangle(format, HwcTestDim(w, h))) > 0;
+        });
+        if (h < startDim.height()) { break; }
+        maxH = h;
+
+        uint64_t pixels = (uint64_t) w * h;
+        if (!bestSet || (pixels > bestMaxPixels)) {
+            bestMaxPixels = pixels;
+            bestDim = HwcTestDim(w, h);
+            bestSet = true;
         }
     }
     verbose = origVerbose;
@@ -907,78 +1400,63 @@ HwcTestDim dfMaxDim(uint32_t format)
 // Source crop minimum width
 uint32_t scMinWidth(uint32_t format, const HwcTestDim& dfDim)
 {
-    uint32_t w;
-    list<Rectangle> rectList;
-
-    // Source crop frame min width
-    for (w = 1; w <= dfDim.width(); w++) {
-        Rectangle rect(format, dfDim, HwcTestDim(w, dfDim.height()));
-        rectList.clear();
-        rectList.push_back(rect);
-        uint32_t num = numOverlays(rectList);
-        if (num > 0) {
-            return w;
-        }
+    uint32_t w = searchFirst(1, dfDim.width(), [&](uint32_t w) {
+        return numOverlays(Rectangle(format, dfDim,
+                                     HwcTestDim(w, dfDim.height()))) > 0;
+    });
+    if (w > dfDim.width()) {
+        testPrintE("Failed to locate source crop min width");
+        exit(35);
     }
-    testPrintE("Failed to locate source crop min width");
-    exit(35);
+
+    return w;
 }
 
 // Source crop minimum height
 uint32_t scMinHeight(uint32_t format, const HwcTestDim& dfDim)
 {
-    uint32_t h;
-    list<Rectangle> rectList;
-
-    for (h = 1; h <= dfDim.height(); h++) {
-        Rectangle rect(format, dfDim, HwcTestDim(dfDim.width(), h));
-        rectList.clear();
-        rectList.push_back(rect);
-        uint32_t num = numOverlays(rectList);
-        if (num > 0) {
-            return h;
-        }
+    uint32_t h = searchFirst(1, dfDim.height(), [&](uint32_t h) {
+        return numOverlays(Rectangle(format, dfDim,
+                                     HwcTestDim(dfDim.width(), h))) > 0;
+    });
+    if (h > dfDim.height()) {
+        testPrintE("Failed to locate source crop min height");
+        exit(36);
     }
-    testPrintE("Failed to locate source crop min height");
-    exit(36);
+
+    return h;
 }
 
 // Source crop maximum width
 uint32_t scMaxWidth(uint32_t format, const HwcTestDim& dfDim)
 {
-    uint32_t w;
-    list<Rectangle> rectList;
-
-    for (w = searchLimits.sourceCrop.width(); w >= dfDim.width(); w--) {
-        Rectangle rect(format, dfDim, HwcTestDim(w, dfDim.height()));
-        rectList.clear();
-        rectList.push_back(rect);
-        uint32_t num = numOverlays(rectList);
-        if (num > 0) {
-            return w;
-        }
+    uint32_t w = searchLast(dfDim.width(), searchLimits.sourceCrop.width(),
+                            [&](uint32_t w) {
+        return numOverlays(Rectangle(format, dfDim,
+                                     HwcTestDim(w, dfDim.height()))) > 0;
+    });
+    if (w < dfDim.width()) {
+        testPrintE("Failed to locate source crop max width");
+        exit(35);
     }
-    testPrintE("Failed to locate source crop max width");
-    exit(35);
+
+    return w;
 }
 
 // Source crop maximum height
 uint32_t scMaxHeight(uint32_t format, const HwcTestDim& dfDim)
 {
-    uint32_t h;
-    list<Rectangle> rectList;
-
-    for (h = searchLimits.sourceCrop.height(); h >= dfDim.height(); h--) {
-        Rectangle rect(format, dfDim, HwcTestDim(dfDim.width(), h));
-        rectList.clear();
-        rectList.push_back(rect);
-        uint32_t num = numOverlays(rectList);
-        if (num > 0) {
-            return h;
-        }
+    uint32_t h = searchLast(dfDim.height(), searchLimits.sourceCrop.height(),
+                            [&](uint32_t h) {
+        return numOverlays(Rectangle(format, dfDim,
+                                     HwcTestDim(dfDim.width(), h))) > 0;
+    });
+    if (h < dfDim.height()) {
+        testPrintE("Failed to locate source crop max height");
+        exit(36);
     }
-    testPrintE("Failed to locate source crop max height");
-    exit(36);
+
+    return h;
 }
 
 // Source crop minimum dimension
@@ -986,7 +1464,8 @@ uint32_t scMaxHeight(uint32_t format, const HwcTestDim& dfDim)
 // HWC will commit to.  Note, this may be different from scMinWidth
 // * scMinHeight, in that this function searches for a combination of
 // width and height.  While the other routines always keep one of the
-// dimensions equal to the corresponding start dimension.
+// dimensions equal to the corresponding start dimension.  For each
+// width the least height committed to is searched for.
 HwcTestDim scMinDim(uint32_t format, const HwcTestDim& dfDim)
 {
     uint64_t bestMinPixels = 0;
@@ -997,24 +1476,19 @@ HwcTestDim scMinDim(uint32_t format, const HwcTestDim& dfDim)
     bool origVerbose = verbose;  // Temporarily turn off verbose
     verbose = false;
     for (uint32_t w = 1; w <= dfDim.width(); w++) {
-        for (uint32_t h = 1; h <= dfDim.height(); h++) {
-            if (bestSet && ((w > bestMinPixels) || (h > bestMinPixels))) {
-                break;
-            }
-
-            HwcTestDim dim(w, h);
-            Rectangle rect(format, dfDim, HwcTestDim(w, h));
-            list<Rectangle> rectList;
-            rectList.push_back(rect);
-            uint32_t num = numOverlays(rectList);
-            if (num > 0) {
-                uint64_t pixels = dim.width() * dim.height();
-                if (!bestSet || (pixels < bestMinPixels)) {
-                    bestMinPixels = pixels;
-                    bestDim = dim;
-                    bestSet = true;
-                }
-            }
+        if (bestSet && (w > bestMinPixels)) { break; }
+
+        uint32_t h = searchFirst(1, dfDim.height(), [&](uint32_t h) {
+            return numOverlays(Rectangle(format, dfDim,
+                                         HwcTestDim(w, h))) > 0;
+        });
+        if (h > dfDim.height()) { continue; }
+
+        uint64_t pixels = (uint64_t) w * h;
+        if (!bestSet || (pixels < bestMinPixels)) {
+            bestMinPixels = pixels;
+            bestDim = HwcTestDim(w, h);
+            bestSet = true;
         }
     }
     verbose = origVerbose;
@@ -1028,6 +1502,7 @@ HwcTestDim scMinDim(uint32_t format, const HwcTestDim& dfDim)
 }
 
 // Source crop maximum dimension
+// Searched for as the display frame maximum dimension is.
 HwcTestDim scMaxDim(uint32_t format, const HwcTestDim& dfDim)
 {
     uint64_t bestMaxPixels = 0;
@@ -1044,28 +1519,25 @@ HwcTestDim scMaxDim(uint32_t format, const HwcTestDim& dfDim)
     uint32_t num = numOverlays(rectList);
     if (num == 1) { return dim; }
 
-    // TODO: Use a binary search
     bool origVerbose = verbose;  // Temporarily turn off verbose
     verbose = false;
+    uint32_t maxH = searchLimits.sourceCrop.height();
     for (uint32_t w = dfDim.width();
          w <= searchLimits.sourceCrop.width(); w++) {
-        for (uint32_t h = dfDim.height();
-             h <= searchLimits.sourceCrop.height(); h++) {
-            if (bestSet && ((w * h) <= bestMaxPixels)) { continue; }
-
-            HwcTestDim dim(w, h);
-            Rectangle rect(format, dfDim, dim);
-            list<Rectangle> rectList;
-            rectList.push_back(rect);
-            uint32_t num = numOverlays(rectList);
-            if (num > 0) {
-                uint64_t pixels = dim.width() * dim.height();
-                if (!bestSet || (pixels > bestMaxPixels)) {
-                    bestMaxPixels = pixels;
-                    bestDim = dim;
-                    bestSet = true;
-                }
-            }
+        if (bestSet && ((uint64_t) w * maxH <= bestMaxPixels)) { continue; }
+
+        uint32_t h = searchLast(dfDim.height(), maxH, [&](uint32_t h) {
+            return numOverlays(Rectangle(format, dfDim,
+                                         HwcTestDim(w, h))) > 0;
+        });
+        if (h < dfDim.height()) { break; }
+        maxH = h;
+
+        uint64_t pixels = (uint64_t) w * h;
+        if (!bestSet || (pixels > bestMaxPixels)) {
+            bestMaxPixels = pixels;
+            bestDim = HwcTestDim(w, h);
+            bestSet = true;
         }
     }
     verbose = origVerbose;
@@ -1087,7 +1559,7 @@ HwcTestDim scMaxDim(uint32_t format, const HwcTestDim& dfDim)
 // each pass of the binary search the mid-point between the greatest
 // point committed to (best) and the smallest point in which a commit
 // has failed is calculated.  This mid-point is then passed to a function
-// named double2Rational, which determines the closest rational numbers
+// named Rational::bracket, which determines the closest rational numbers
 // just below and above the mid-point.  By default the lower rational
 // number is used for the scale factor on the next pass of the binary
 // search.  The upper value is only used when best is already equal
@@ -1118,16 +1590,11 @@ Rational scHScale(uint32_t format,
             // Halve the difference between best and minBad.
             Rational lower, upper, selected;
 
-            // Try the closest ratio halfway between minBood and minBad;
-            // TODO: Avoid rounding issue by using Rational type for
-            //       midpoint.  For now will use double, which should
-            //       have more than sufficient resolution.
-            double mid = (double) best
-                         + ((double) minBad - (double) best) / 2.0;
-            Rational::double2Rational(mid,
-                            Range(scMin.width(), scMax.width()),
-                            Range(dfMin.width(), dfMax.width()),
-                            lower, upper);
+            // Try the closest ratio halfway between best and minBad
+            Rational::bracket(Rational::midpoint(best, minBad),
+                              Range(scMin.width(), scMax.width()),
+                              Range(dfMin.width(), dfMax.width()),
+                              lower, upper);
             if (((lower == best) && (upper == minBad))) {
                 return best;
             }
@@ -1186,7 +1653,7 @@ Rational scHScale(uint32_t format,
 // each pass of the binary search the mid-point between the greatest
 // point committed to (best) and the smallest point in which a commit
 // has failed is calculated.  This mid-point is then passed to a function
-// named double2Rational, which determines the closest rational numbers
+// named Rational::bracket, which determines the closest rational numbers
 // just below and above the mid-point.  By default the lower rational
 // number is used for the scale factor on the next pass of the binary
 // search.  The upper value is only used when best is already equal
@@ -1217,16 +1684,11 @@ Rational scVScale(uint32_t format,
             // Halve the difference between best and minBad.
             Rational lower, upper, selected;
 
-            // Try the closest ratio halfway between minBood and minBad;
-            // TODO: Avoid rounding issue by using Rational type for
-            //       midpoint.  For now will use double, which should
-            //       have more than sufficient resolution.
-            double mid = (double) best
-                         + ((double) minBad - (double) best) / 2.0;
-            Rational::double2Rational(mid,
-                            Range(scMin.height(), scMax.height()),
-                            Range(dfMin.height(), dfMax.height()),
-                            lower, upper);
+            // Try the closest ratio halfway between best and minBad
+            Rational::bracket(Rational::midpoint(best, minBad),
+                              Range(scMin.height(), scMax.height()),
+                              Range(dfMin.height(), dfMax.height()),
+                              lower, upper);
             if (((lower == best) && (upper == minBad))) {
                 return best;
             }
@@ -1276,8 +1738,12 @@ Rational scVScale(uint32_t format,
     return best;
 }
 
-uint32_t numOverlapping(uint32_t backgroundFormat, uint32_t foregroundFormat,
-                        uint32_t backgroundBlend, uint32_t foregroundBlend)
+// Rectangles of a foreground overlapping a background, for
+// measureOverlap()
+list<Rectangle> overlapLayout(uint32_t backgroundFormat,
+                              uint32_t foregroundFormat,
+                              uint32_t backgroundBlend,
+                              uint32_t foregroundBlend)
 {
     list<Rectangle> rectList;
 
@@ -1298,9 +1764,7 @@ uint32_t numOverlapping(uint32_t backgroundFormat, uint32_t foregroundFormat,
     background.blend = foregroundBlend;
     rectList.push_back(foreground);
 
-    uint32_t num = numOverlays(rectList);
-
-    return num;
+    return rectList;
 }
 
 Rectangle::Rectangle(uint32_t graphicFormat, HwcTestDim dfDim,
@@ -1333,6 +1797,79 @@ void Rectangle::setSourceDim(HwcTestDim dim)
     }
 }
 
+// Greatest fraction <= x and least fraction > x with a denominator of
+// at most maxD, for x = X / Y.  Found by descending the Stern-Brocot
+// tree toward x, taking each run of steps in one direction at once,
+// which takes a number of steps logarithmic in maxD.
+static void sternBrocot(uint64_t X, uint64_t Y, uint64_t maxD,
+                        uint64_t& lp, uint64_t& lq, uint64_t& up,
+                        uint64_t& uq)
+{
+    lp = 0, lq = 1;     // 0/1 <= x
+    up = 1, uq = 0;     // 1/0 > x
+
+    for (bool moved = true; moved;) {
+        moved = false;
+
+        // Mediants toward the upper bound that stay <= x
+        uint64_t k = (X * lq - Y * lp) / (Y * up - X * uq);
+        if (uq != 0) { k = min(k, (maxD - lq) / uq); }
+        if (k > 0) {
+            lp += k * up;
+            lq += k * uq;
+            moved = true;
+        }
+
+        // Mediants toward the lower bound that stay > x
+        uint64_t gap = X * lq - Y * lp;
+        k = (maxD - uq) / lq;
+        if (gap != 0) { k = min(k, (Y * up - X * uq - 1) / gap); }
+        if (k > 0) {
+            up += k * lp;
+            uq += k * lq;
+            moved = true;
+        }
+    }
+}
+
+// Greatest p / q <= x, or with above the least p / q > x, with q from
+// qa to qb and p the numerator closest to x for q.  Returns false when
+// there is no such q.
+static bool stripBest(uint64_t X, uint64_t Y, uint64_t qa, uint64_t qb,
+                      bool above, uint64_t& p, uint64_t& q)
+{
+    qa = max(qa, (uint64_t) 1);
+    if (qa > qb) { return false; }
+
+    // Best with a denominator of at most qb, scaled to the least
+    // denominator in the strip.  For a multiple of the denominator the
+    // multiple of the numerator is still the closest to x.
+    uint64_t lp, lq, up, uq;
+    sternBrocot(X, Y, qb, lp, lq, up, uq);
+    uint64_t bp = above ? up : lp;
+    uint64_t bq = above ? uq : lq;
+    uint64_t k = max((qa + bq - 1) / bq, (uint64_t) 1);
+    if (k * bq <= qb) {
+        p = k * bp;
+        q = k * bq;
+        return true;
+    }
+
+    // The strip lies between two multiples of bq, so it spans fewer
+    // than bq < qa denominators.  This only happens with a range of
+    // denominators narrower than its lower end, and is checked one
+    // denominator at a time.
+    for (uint64_t d = qa; d <= qb; d++) {
+        uint64_t n = d * X / Y + (above ? 1 : 0);
+        if ((d == qa) || (above ? (n * q < p * d) : (n * q > p * d))) {
+            p = n;
+            q = d;
+        }
+    }
+
+    return true;
+}
+
 // Rational member functions
 bool Rational::operator==(const Rational& other) const
 {
@@ -1359,45 +1896,121 @@ Rational::operator string() const
     return out.str();
 }
 
-void Rational::double2Rational(double f, Range nRange, Range dRange,
-                    Rational& lower, Rational& upper)
+// Exact midpoint of two rationals, in lowest terms
+Rational Rational::midpoint(const Rational& a, const Rational& b)
 {
-    Rational bestLower(nRange.lower(), dRange.upper());
-    Rational bestUpper(nRange.upper(), dRange.lower());
-
-    // Search for a better solution
-    for (uint32_t d = dRange.lower(); d <= dRange.upper(); d++) {
-        Rational val(d * f, d);  // Lower, because double to int cast truncates
-
-        if ((val.numerator() < nRange.lower())
-            || (val.numerator() > nRange.upper())) { continue; }
+    uint64_t n = (uint64_t) a._n * b._d + (uint64_t) b._n * a._d;
+    uint64_t d = 2 * (uint64_t) a._d * b._d;
+
+    uint64_t gcd = n, r = d;
+    while (r != 0) {
+        uint64_t t = gcd % r;
+        gcd = r;
+        r = t;
+    }
 
-        if (((double) val > (double) bestLower) && ((double) val <= f)) {
-            bestLower = val;
-        } 
+    return Rational(n / gcd, d / gcd);
+}
 
-        val.setNumerator(val.numerator() + 1);
-        if (val.numerator() > nRange.upper()) { continue; }
+// Determines the closest rationals with a numerator within nRange and a
+// denominator within dRange, that are just below (or equal to) and just
+// above f.  Of equal rationals, the one with the least denominator is
+// given.  When there is none below or above, lower is the least and
+// upper the greatest rational of the ranges.
+//
+// For a denominator q the closest numerators are floor(q * f) and one
+// more than it, which grow with q.  So the denominators for which they
+// are within nRange form a strip, within which the closest rational is
+// a bounded best approximation of f.  Outside of the strip, the
+// numerator is clamped to nRange, and the closest rational is the one
+// with the denominator next to the strip.
+void Rational::bracket(const Rational& f, Range nRange, Range dRange,
+                       Rational& lower, Rational& upper)
+{
+    uint64_t X = f._n, Y = f._d;
+    uint64_t nL = nRange.lower(), nH = nRange.upper();
+    uint64_t dL = dRange.lower(), dH = dRange.upper();
+    uint64_t p, q;
+
+    // Least denominator q with floor(q * f) >= n
+    auto floorReaches = [X, Y](uint64_t n) -> uint64_t {
+        if (n == 0) { return 0; }
+        if (X == 0) { return UINT64_MAX; }
+        return (n * Y + X - 1) / X;
+    };
+
+    // Lower: floor(q * f) within nRange, or else nRange.upper() with
+    // the least denominator for which floor(q * f) is above it
+    lower = Rational(nL, dH);
+    bool lowerSet = false;
+    if (stripBest(X, Y, max(dL, floorReaches(nL)),
+                  min(dH, floorReaches(nH + 1) - 1), false, p, q)) {
+        lower = Rational(p, q);
+        lowerSet = true;
+    }
+    q = max(dL, floorReaches(nH + 1));
+    if ((q <= dH) && (!lowerSet || (lower < Rational(nH, q)))) {
+        lower = Rational(nH, q);
+    }
 
-        if (((double) val < (double) bestUpper) && ((double) val >= f)) {
-            bestUpper = val;
+    // Upper: floor(q * f) + 1 within nRange, or else nRange.lower() with
+    // the greatest denominator for which floor(q * f) + 1 is below it
+    upper = Rational(nH, dL);
+    bool upperSet = false;
+    if (nH > 0) {
+        uint64_t qa = (nL > 0) ? floorReaches(nL - 1) : 0;
+        if (stripBest(X, Y, max(dL, qa), min(dH, floorReaches(nH) - 1),
+                      true, p, q)) {
+            upper = Rational(p, q);
+            upperSet = true;
+        }
+    }
+    if (nL >= 2) {
+        q = min(dH, floorReaches(nL - 1) - 1);
+        if ((q >= max(dL, (uint64_t) 1))
+            && (!upperSet || !(upper < Rational(nL, q)))) {
+            upper = Rational(nL, q);
         }
     }
-
-    lower = bestLower;
-    upper = bestUpper;
 }
 
 // Local functions
 
-// Num Overlays
-// Given a list of rectangles, determine how many HWC will commit to render
-uint32_t numOverlays(list<Rectangle>& rectList)
+// Probe Key
+// Identifies a list of rectangles in the probe cache
+static vector<int32_t> probeKey(list<Rectangle>& rectList)
+{
+    vector<int32_t> key;
+
+    key.reserve(rectList.size() * 13);
+    for (std::list<Rectangle>::iterator it = rectList.begin();
+         it != rectList.end(); ++it) {
+        int32_t rect[] = {
+            (int32_t) it->format, (int32_t) it->transform, it->blend,
+            (int32_t) it->sourceDim.width(),
+            (int32_t) it->sourceDim.height(),
+            it->sourceCrop.left, it->sourceCrop.top,
+            it->sourceCrop.right, it->sourceCrop.bottom,
+            it->displayFrame.left, it->displayFrame.top,
+            it->displayFrame.right, it->displayFrame.bottom,
+        };
+        key.insert(key.end(), rect, rect + NUMA(rect));
+    }
+
+    return key;
+}
+
+// Probe Setup
+// Forms the HWC list of a list of rectangles, in the given arena, with
+// graphic buffers from the pool.  The buffers are added to buffers, so
+// that they stay in scope until the list has been prepared.
+static hwc_display_contents_1_t *probeSetup(list<Rectangle>& rectList,
+    HwcTestLayerArena& arena, vector<sp<GLTestBuffer> >& buffers)
 {
     hwc_display_contents_1_t *hwcList;
-    list<sp<GraphicBuffer> > buffers;
 
-    hwcList = hwcTestCreateLayerList(rectList.size());
+    arena.reset();
+    hwcList = arena.list(rectList.size(), 1);
     if (hwcList == NULL) {
         testPrintE("numOverlays create hwcList failed");
         exit(30);
@@ -1407,12 +2020,10 @@ uint32_t numOverlays(list<Rectangle>& rectList)
     for (std::list<Rectangle>::iterator it = rectList.begin();
          it != rectList.end(); ++it, ++layer) {
         // Allocate the texture for the source frame
-        // and push it onto the buffers list, so that it
-        // stays in scope until a return from this function.
-        sp<GraphicBuffer> texture;
-        texture  = new GraphicBuffer(it->sourceDim.width(),
-                                     it->sourceDim.height(),
-                                     it->format, texUsage);
+        sp<GLTestBuffer> texture;
+        texture = bufferPool.get(it->sourceDim.width(),
+                                 it->sourceDim.height(),
+                                 it->format, texUsage);
         buffers.push_back(texture);
 
         layer->handle = texture->handle;
@@ -1421,10 +2032,17 @@ uint32_t numOverlays(list<Rectangle>& rectList)
         layer->sourceCrop = it->sourceCrop;
         layer->displayFrame = it->displayFrame;
 
-        layer->visibleRegionScreen.numRects = 1;
-        layer->visibleRegionScreen.rects = &layer->displayFrame;
+        hwc_rect_t *visible = (hwc_rect_t *) layer->visibleRegionScreen.rects;
+        visible[0] = layer->displayFrame;
     }
 
+    return hwcList;
+}
+
+// Probe Prepare
+// Shows a list to the HWC and counts the overlays it commits to
+static uint32_t probePrepare(hwc_display_contents_1_t *hwcList)
+{
     // Perform prepare operation
     if (verbose) { testPrintI("Prepare:"); hwcTestDisplayList(hwcList); }
     hwcDevice->prepare(hwcDevice, 1, &hwcList);
@@ -1441,12 +2059,153 @@ uint32_t numOverlays(list<Rectangle>& rectList)
         }
     }
 
-    // Free the layer list and graphic buffers
-    hwcTestFreeLayerList(hwcList);
+    return total;
+}
+
+// Num Overlays
+// Given a list of rectangles, determine how many HWC will commit to render
+uint32_t numOverlays(list<Rectangle>& rectList)
+{
+    vector<sp<GLTestBuffer> > buffers;
+
+    vector<int32_t> key = probeKey(rectList);
+    probes++;
+    map<vector<int32_t>, uint32_t>::iterator cached = probeCache.find(key);
+    if (cached != probeCache.end()) {
+        probeCacheHits++;
+        return cached->second;
+    }
+
+    uint32_t total = probePrepare(probeSetup(rectList, layerArena, buffers));
+
+    // Return the graphic buffers to the pool, for the next probe of the
+    // same shapes.  The layer list is reused by the next probe.
+    for (vector<sp<GLTestBuffer> >::iterator it = buffers.begin();
+         it != buffers.end(); ++it) {
+        bufferPool.put(*it);
+    }
+
+    probeCache[key] = total;
 
     return total;
 }
 
+/*
+ * Probe Pipeline
+ *
+ * Probes that don't depend on each other's results, such as those of
+ * the overlap matrix, are given to numOverlaysBatch() together.  Only
+ * one list at a time is shown to the HWC, from the calling thread, but
+ * a worker thread sets up the lists of the next probeDepth probes, taking
+ * their buffers from the pool, while the HWC prepares the current one.
+ * During a batch the worker is the only user of the buffer pool.  The
+ * buffers of prepared probes are handed back to it to return to the
+ * pool, so that later probes of the same shapes take them over.
+ */
+static const unsigned int probeDepth = 4;
+
+struct probeSlot {
+    HwcTestLayerArena arena;
+    hwc_display_contents_1_t *list;
+    vector<sp<GLTestBuffer> > buffers;
+};
+
+// Num Overlays Batch
+// The overlays committed to for each of a batch of rectangle lists
+vector<uint32_t> numOverlaysBatch(vector<list<Rectangle> >& rectLists)
+{
+    vector<uint32_t> rv(rectLists.size());
+    vector<vector<int32_t> > keys(rectLists.size());
+    vector<size_t> pending;     // Probes to prepare
+    vector<size_t> repeats;     // Probes repeating one earlier in the batch
+
+    // Answer what can be from the cache
+    map<vector<int32_t>, size_t> inBatch;
+    for (size_t n1 = 0; n1 < rectLists.size(); n1++) {
+        keys[n1] = probeKey(rectLists[n1]);
+        probes++;
+        map<vector<int32_t>, uint32_t>::iterator cached
+            = probeCache.find(keys[n1]);
+        if (cached != probeCache.end()) {
+            probeCacheHits++;
+            rv[n1] = cached->second;
+        } else if (!inBatch.insert(make_pair(keys[n1], n1)).second) {
+            probeCacheHits++;
+            repeats.push_back(n1);
+        } else {
+            pending.push_back(n1);
+        }
+    }
+    if (pending.empty()) { return rv; }
+
+    probeSlot slots[probeDepth];
+    mutex lock;
+    condition_variable cond;
+    size_t setUp = 0;                   // Pending probes set up
+    size_t prepared = 0;                // Pending probes prepared
+    vector<sp<GLTestBuffer> > returned; // Buffers of prepared probes
+
+    thread worker([&]() {
+        vector<sp<GLTestBuffer> > recycle;
+
+        for (size_t n1 = 0; n1 < pending.size(); n1++) {
+            {
+                unique_lock<mutex> guard(lock);
+                cond.wait(guard, [&]() {
+                    return n1 < prepared + probeDepth;
+                });
+                recycle.swap(returned);
+            }
+            for (vector<sp<GLTestBuffer> >::iterator it = recycle.begin();
+                 it != recycle.end(); ++it) {
+                bufferPool.put(*it);
+            }
+            recycle.clear();
+
+            probeSlot& slot = slots[n1 % probeDepth];
+            slot.list = probeSetup(rectLists[pending[n1]], slot.arena,
+                                   slot.buffers);
+            {
+                lock_guard<mutex> guard(lock);
+                setUp = n1 + 1;
+            }
+            cond.notify_all();
+        }
+    });
+
+    for (size_t n1 = 0; n1 < pending.size(); n1++) {
+        {
+            unique_lock<mutex> guard(lock);
+            cond.wait(guard, [&]() { return n1 < setUp; });
+        }
+
+        probeSlot& slot = slots[n1 % probeDepth];
+        uint32_t num = probePrepare(slot.list);
+        rv[pending[n1]] = num;
+        probeCache[keys[pending[n1]]] = num;
+        {
+            lock_guard<mutex> guard(lock);
+            returned.insert(returned.end(), slot.buffers.begin(),
+                            slot.buffers.end());
+            slot.buffers.clear();
+            prepared = n1 + 1;
+        }
+        cond.notify_all();
+    }
+    worker.join();
+    for (vector<sp<GLTestBuffer> >::iterator it = returned.begin();
+         it != returned.end(); ++it) {
+        bufferPool.put(*it);
+    }
+
+    for (vector<size_t>::iterator it = repeats.begin();
+         it != repeats.end(); ++it) {
+        rv[*it] = rv[inBatch[keys[*it]]];
+    }
+
+    return rv;
+}
+
 string transformList2str(const list<uint32_t>& transformList)
 {
     ostringstream out;
@@ -1549,6 +2308,8 @@ void printSyntax(const char *cmd)
                cmd);
     testPrintE("    options:");
     testPrintE("      -s [width, height] - start dimension");
+    testPrintE("      -d file - capability database");
+    testPrintE("      -i - incremental, reuse current database entries");
     testPrintE("      -v - Verbose");
     testPrintE("");
     testPrintE("    graphic formats:");
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Hardware Composer Reference Compositor Benchmark
+ *
+ * Synopsis
+ *   hwcComposeBench [options]
+ *     options:
+ *       -w # - Display width, at least 16 (default 1920)
+ *       -h # - Display height, at least 16 (default 1080)
+ *       -l # - Number of layers (default 8)
+ *       -t # - Compositor threads, 0 for one per CPU (default 0)
+ *       -s # - Random seed (default 0)
+ *       -f format - Give every layer the given graphic format
+ *
+ * Description
+ *   Times HwcTestCompositor composing a list of layers, which is what a
+ *   composition that falls back from the overlays to the CPU costs.  The
+ *   first layer is an opaque full screen RGBA8888 layer.  The others are
+ *   random: format (of the non-legacy formats), size, source crop,
+ *   display frame within the display, transform, blending and plane
+ *   alpha.  Each layer's buffer is filled with a horizontal blend.
+ */
+
+#define LOG_TAG "hwcComposeBenchTest"
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <glTestBench.h>
+
+#include "hwcTestLib.h"
+
+using namespace std;
+using namespace android;
+
+static const uint32_t usage = GLTestBuffer::USAGE_SW_READ_OFTEN
+    | GLTestBuffer::USAGE_SW_WRITE_OFTEN;
+static const uint32_t minBufferDim = 16;  // Of the random layers' buffers
+static const int32_t blends[] = {
+    HWC_BLENDING_NONE, HWC_BLENDING_PREMULT, HWC_BLENDING_COVERAGE,
+};
+
+// Random format, of the ones not only used when asked for by name
+static const struct hwcTestGraphicFormat *randFormat(void)
+{
+    const struct hwcTestGraphicFormat *format;
+
+    do {
+        format = &hwcTestGraphicFormat[
+            testRandMod(hwcTestGraphicFormatCount)];
+    } while (format->flags & HWC_TEST_FORMAT_LEGACY);
+
+    return format;
+}
+
+// Random value from low to high, rounded down to a multiple of mod
+static uint32_t randRange(uint32_t low, uint32_t high, uint32_t mod)
+{
+    uint32_t value = low + testRandMod(high - low + 1);
+
+    return max(value - value % mod, mod);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    uint32_t width = 1920, height = 1080, numLayers = 8, threads = 0;
+    unsigned int seed = 0;
+    const struct hwcTestGraphicFormat *only = NULL;
+
+    testSetLogCatTag(LOG_TAG);
+
+    while ((opt = getopt(argc, argv, "w:h:l:t:s:f:?")) != -1) {
+        switch (opt) {
+        case 'w':
+            width = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'h':
+            height = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'l':
+            numLayers = strtoul(optarg, NULL, 0);
+            break;
+
+        case 't':
+            threads = strtoul(optarg, NULL, 0);
+            break;
+
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'f':
+            only = hwcTestGraphicFormatLookup(optarg);
+            if (only == NULL) {
+                testPrintE("Unknown graphic format: %s", optarg);
+                exit(1);
+            }
+            break;
+
+        case '?':
+        default:
+            testPrintE("  %s [options]", basename(argv[0]));
+            testPrintE("    options:");
+            testPrintE("      -w # Display width (default 1920)");
+            testPrintE("      -h # Display height (default 1080)");
+            testPrintE("      -l # Number of layers (default 8)");
+            testPrintE("      -t # Compositor threads (default one per CPU)");
+            testPrintE("      -s # Random seed (default 0)");
+            testPrintE("      -f format Give every layer the given format");
+            exit(((optopt == 0) || (optopt == '?')) ? 0 : 2);
+        }
+    }
+    if (width < minBufferDim || height < minBufferDim || numLayers < 1) {
+        testPrintE("Display of %ux%u with %u layers too small", width,
+                   height, numLayers);
+        exit(3);
+    }
+
+    srand48(seed);
+    hwc_display_contents_1_t *list = hwcTestCreateLayerList(numLayers);
+    if (list == NULL) {
+        testPrintE("Layer list allocation failed");
+        exit(4);
+    }
+    vector<sp<GLTestBuffer> > buffers(numLayers);
+    vector<HwcTestComposeSource> sources(numLayers);
+    for (uint32_t n1 = 0; n1 < numLayers; n1++) {
+        const struct hwcTestGraphicFormat *format = (n1 == 0)
+            ? hwcTestGraphicFormatLookup(HAL_PIXEL_FORMAT_RGBA_8888)
+            : (only ? only : randFormat());
+        uint32_t w = (n1 == 0) ? width
+            : randRange(minBufferDim, width, format->wMod);
+        uint32_t h = (n1 == 0) ? height
+            : randRange(minBufferDim, height, format->hMod);
+
+        buffers[n1] = new GLTestBuffer(w, h, format->format, usage);
+        if (buffers[n1]->initCheck() != NO_ERROR) {
+            testPrintE("%s buffer allocation failed: %d", format->desc,
+                       buffers[n1]->initCheck());
+            exit(5);
+        }
+        hwcTestFillColorHBlend(buffers[n1].get(), HAL_PIXEL_FORMAT_RGBA_8888,
+                               ColorFract(testRandFract(), 0.0, 1.0),
+                               ColorFract(1.0, testRandFract(), 0.0));
+        void *pixels;
+        if (buffers[n1]->lock(usage, &pixels) != NO_ERROR) {
+            testPrintE("%s buffer lock failed", format->desc);
+            exit(6);
+        }
+        sources[n1] = hwcTestComposeSource(buffers[n1].get(), pixels);
+
+        hwc_layer_1_t *layer = &list->hwLayers[n1];
+        layer->compositionType = HWC_FRAMEBUFFER;
+        layer->handle = buffers[n1]->handle;
+        if (n1 == 0) {
+            layer->blending = HWC_BLENDING_NONE;
+            layer->sourceCrop = HwcTestDim(w, h);
+            layer->displayFrame = HwcTestDim(width, height);
+            continue;
+        }
+        layer->transform = testRandMod(8);
+        layer->blending = blends[testRandMod(3)];
+        layer->planeAlpha = testRandMod(2) ? 255 : testRandMod(256);
+        layer->sourceCrop.left = testRandMod(w / 2);
+        layer->sourceCrop.top = testRandMod(h / 2);
+        layer->sourceCrop.right = layer->sourceCrop.left
+            + randRange(1, w - layer->sourceCrop.left, 1);
+        layer->sourceCrop.bottom = layer->sourceCrop.top
+            + randRange(1, h - layer->sourceCrop.top, 1);
+        uint32_t frameW = randRange(width / 4, width, 1);
+        uint32_t frameH = randRange(height / 4, height, 1);
+        layer->displayFrame.left = testRandMod(width - frameW + 1);
+        layer->displayFrame.top = testRandMod(height - frameH + 1);
+        layer->displayFrame.right = layer->displayFrame.left + frameW;
+        layer->displayFrame.bottom = layer->displayFrame.top + frameH;
+    }
+
+    HwcTestCompositor compositor(threads);
+    vector<uint32_t> output((size_t) width * height);
+    char name[64];
+    snprintf(name, sizeof(name), "compose %ux%u %u layers %u threads",
+             width, height, numLayers, compositor.threads());
+    GLTestBenchConfig config;
+    config.workPerIteration = (double) width * height / 1e6;
+    config.workUnits = "Mpixel";
+    GLTestBench bench(name, config);
+    while (bench.iterate()) {
+        compositor.compose(list, sources.data(), output.data(), width,
+                           height, width);
+    }
+    bench.report();
+
+    for (uint32_t n1 = 0; n1 < numLayers; n1++) {
+        buffers[n1]->unlock();
+    }
+    hwcTestFreeLayerList(list);
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Hardware Composer Buffer Fill Benchmark
+ *
+ * Synopsis
+ *   hwcFillBench [options]
+ *     options:
+ *       -w # - Buffer width (default 1280)
+ *       -h # - Buffer height (default 720)
+ *       -f format - Only benchmark the given graphic format
+ *
+ * Description
+ *   Times the CPU fills used by the other hwc tests, hwcTestFillColor(),
+ *   hwcTestFillColorHBlend() and a whole buffer of hwcTestSetPixel()
+ *   calls, for every graphic format.  Before timing a format, checks that
+ *   HwcTestColorConverter packs colors, including out of range ones, into
+ *   the same pixels as hwcTestColor2Pixel().  Nothing is displayed, so on build
+ *   hosts this runs against the GLTestBuffer stand-in for GraphicBuffer,
+ *   whose stride alignment, huge pages and cache behavior are set from
+ *   the environment (see glTestBuffer.h).
+ */
+
+#define LOG_TAG "hwcFillBenchTest"
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <glTestBench.h>
+
+#include "hwcTestLib.h"
+
+using namespace android;
+
+static const uint32_t usage = GLTestBuffer::USAGE_SW_READ_OFTEN
+    | GLTestBuffer::USAGE_SW_WRITE_OFTEN;
+
+// Exits when the span and the per-color paths disagree on a pixel
+static void checkFormat(const struct hwcTestGraphicFormat *format)
+{
+    static const ColorFract colors[] = {
+        ColorFract(0.0, 0.0, 0.0), ColorFract(1.0, 1.0, 1.0),
+        ColorFract(0.25, 0.5, 0.75), ColorFract(-0.25, 0.5, 1.25),
+        ColorFract(1.5, -1.0, 0.999), ColorFract(-0.001, 1.001, 0.5),
+    };
+    const size_t count = sizeof(colors) / sizeof(colors[0]);
+    uint32_t pixels[count];
+
+    HwcTestColorConverter(format->format, format->format)
+        .convertToPixels(colors, pixels, count, 0.5);
+    for (size_t n1 = 0; n1 < count; n1++) {
+        uint32_t expected = hwcTestColor2Pixel(format->format, colors[n1],
+                                               0.5);
+        if (pixels[n1] != expected) {
+            testPrintE("%s color <%g, %g, %g> packed to %#x, expected %#x",
+                       format->desc, colors[n1].c1(), colors[n1].c2(),
+                       colors[n1].c3(), pixels[n1], expected);
+            exit(4);
+        }
+    }
+}
+
+static void benchFormat(const struct hwcTestGraphicFormat *format,
+                        uint32_t width, uint32_t height)
+{
+    checkFormat(format);
+    width -= width % format->wMod;
+    height -= height % format->hMod;
+
+    sp<GLTestBuffer> gBuf = new GLTestBuffer(width, height, format->format,
+                                             usage);
+    if (gBuf->initCheck() != NO_ERROR) {
+        testPrintE("%s buffer allocation failed: %d", format->desc,
+                   gBuf->initCheck());
+        return;
+    }
+
+    GLTestBenchConfig config;
+    config.workPerIteration = (double) width * height / 1e6;
+    config.workUnits = "Mpixel";
+    char name[64];
+    ColorFract color(0.25, 0.5, 0.75);
+
+    snprintf(name, sizeof(name), "%s fill", format->desc);
+    {
+        GLTestBench bench(name, config);
+        while (bench.iterate()) {
+            hwcTestFillColor(gBuf.get(), color, 0.5);
+        }
+        bench.report();
+    }
+
+    snprintf(name, sizeof(name), "%s hblend", format->desc);
+    {
+        GLTestBench bench(name, config);
+        while (bench.iterate()) {
+            hwcTestFillColorHBlend(gBuf.get(), HAL_PIXEL_FORMAT_RGBA_8888,
+                                   ColorFract(0.0, 0.0, 0.0),
+                                   ColorFract(1.0, 1.0, 1.0));
+        }
+        bench.report();
+    }
+
+    snprintf(name, sizeof(name), "%s setPixel", format->desc);
+    {
+        uint32_t pixel = hwcTestColor2Pixel(format->format, color, 0.5);
+        unsigned char *buf;
+        if (gBuf->lock(usage, (void **) &buf) != NO_ERROR) {
+            testPrintE("%s buffer lock failed", format->desc);
+            return;
+        }
+        GLTestBench bench(name, config);
+        while (bench.iterate()) {
+            for (uint32_t y = 0; y < height; y++) {
+                for (uint32_t x = 0; x < width; x++) {
+                    hwcTestSetPixel(gBuf.get(), buf, x, y, pixel);
+                }
+            }
+        }
+        bench.report();
+        gBuf->unlock();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    uint32_t width = 1280, height = 720;
+    const struct hwcTestGraphicFormat *only = NULL;
+
+    testSetLogCatTag(LOG_TAG);
+
+    while ((opt = getopt(argc, argv, "w:h:f:?")) != -1) {
+        switch (opt) {
+        case 'w':
+            width = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'h':
+            height = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'f':
+            only = hwcTestGraphicFormatLookup(optarg);
+            if (only == NULL) {
+                testPrintE("Unknown graphic format: %s", optarg);
+                exit(1);
+            }
+            break;
+
+        case '?':
+        default:
+            testPrintE("  %s [options]", basename(argv[0]));
+            testPrintE("    options:");
+            testPrintE("      -w # Buffer width (default 1280)");
+            testPrintE("      -h # Buffer height (default 720)");
+            testPrintE("      -f format Only benchmark the given format");
+            exit(((optopt == 0) || (optopt == '?')) ? 0 : 2);
+        }
+    }
+    if (width < 2 || height < 2) {
+        testPrintE("Buffer of %ux%u too small", width, height);
+        exit(3);
+    }
+
+    srand48(0);
+    if (only) {
+        benchFormat(only, width, height);
+        return 0;
+    }
+    for (size_t n1 = 0; n1 < hwcTestGraphicFormatCount; n1++) {
+        benchFormat(&hwcTestGraphicFormat[n1], width, height);
+    }
+
+    return 0;
+}
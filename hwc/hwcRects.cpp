@@ -106,7 +106,6 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
-#include <ui/GraphicBuffer.h>
 #include <utils/Log.h>
 #include <testUtil.h>
 
@@ -157,13 +156,13 @@ public:
     struct hwc_rect   sourceCrop;
     struct hwc_rect   displayFrame;
 
-    sp<GraphicBuffer> texture;
+    sp<GLTestBuffer> texture;
 };
 
 // Globals
 list<Rectangle> rectangle;
-static const int texUsage = GraphicBuffer::USAGE_HW_TEXTURE |
-        GraphicBuffer::USAGE_SW_WRITE_RARELY;
+static const int texUsage = GLTestBuffer::USAGE_HW_TEXTURE |
+        GLTestBuffer::USAGE_SW_WRITE_RARELY;
 static hwc_composer_device_1_t *hwcDevice;
 static EGLDisplay dpy;
 static EGLSurface surface;
@@ -233,16 +232,18 @@ main(int argc, char *argv[])
         }
     }
 
-    // Stop framework
-    rv = snprintf(cmd, sizeof(cmd), "%s", CMD_STOP_FRAMEWORK);
-    if (rv >= (signed) sizeof(cmd) - 1) {
-        testPrintE("Command too long for: %s", CMD_STOP_FRAMEWORK);
-        exit(3);
+    // Stop framework, unless the mock hardware composer stands in for the HAL
+    if (!hwcTestMockActive()) {
+        rv = snprintf(cmd, sizeof(cmd), "%s", CMD_STOP_FRAMEWORK);
+        if (rv >= (signed) sizeof(cmd) - 1) {
+            testPrintE("Command too long for: %s", CMD_STOP_FRAMEWORK);
+            exit(3);
+        }
+        testExecCmd(cmd);
+        testDelay(1.0); // TODO - needs means to query whether asyncronous stop
+                        // framework operation has completed.  For now, just
+                        // wait a long time.
     }
-    testExecCmd(cmd);
-    testDelay(1.0); // TODO - needs means to query whether asyncronous stop
-                    // framework operation has completed.  For now, just wait
-                    // a long time.
 
     init();
 
@@ -345,13 +346,15 @@ main(int argc, char *argv[])
 
     testDelay(endDelay);
 
-    // Start framework
-    rv = snprintf(cmd, sizeof(cmd), "%s", CMD_START_FRAMEWORK);
-    if (rv >= (signed) sizeof(cmd) - 1) {
-        testPrintE("Command too long for: %s", CMD_START_FRAMEWORK);
-        exit(6);
+    // Start framework, unless the mock hardware composer stands in for the HAL
+    if (!hwcTestMockActive()) {
+        rv = snprintf(cmd, sizeof(cmd), "%s", CMD_START_FRAMEWORK);
+        if (rv >= (signed) sizeof(cmd) - 1) {
+            testPrintE("Command too long for: %s", CMD_START_FRAMEWORK);
+            exit(6);
+        }
+        testExecCmd(cmd);
     }
-    testExecCmd(cmd);
 
     return 0;
 }
@@ -504,7 +507,7 @@ static Rectangle parseRect(string rectStr)
     }
 
     // Create source texture
-    rect.texture = new GraphicBuffer(rect.sourceDim.width(),
+    rect.texture = new GLTestBuffer(rect.sourceDim.width(),
                                      rect.sourceDim.height(),
                                      rect.format, texUsage);
     if ((rv = rect.texture->initCheck()) != NO_ERROR) {
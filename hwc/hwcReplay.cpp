@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Hardware Composer Trace Replay
+ *
+ * Synopsis
+ *   hwcReplay [options] trace
+ *     options:
+ *       -s num - Starting pass (default first traced)
+ *       -e num - Ending pass (default last traced)
+ *       -p num - Replay the single pass specified by num
+ *       -l num - Number of times to replay the trace (default 1)
+ *       -v - Verbose
+ *
+ * Description
+ *   Issues the prepare and set calls of a trace, recorded by hwcStress -r,
+ *   to the HWC again.  The trace is memory mapped and each pass's layer
+ *   list is built straight from it, so the calls are made back to back,
+ *   without the random frame and list generation of the traced run.  The
+ *   buffers of a group of passes are allocated and filled with their
+ *   traced colors before the group's first pass in the replayed range,
+ *   outside of the timed calls.
+ *
+ *   A range of passes, given by -s and -e or by -p, bisects a failure of
+ *   the traced run.  Replaying a whole trace, a number of times with -l,
+ *   benchmarks the HWC, with the time spent in prepare and set reported
+ *   at the end.
+ */
+
+#define LOG_TAG "hwcReplayTest"
+
+#include <errno.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <glTestBench.h>
+
+#include "hwcTestLib.h"
+
+using namespace std;
+using namespace android;
+
+#define MAXCMD               200
+#define CMD_STOP_FRAMEWORK   "stop 2>&1"
+#define CMD_START_FRAMEWORK  "start 2>&1"
+
+static const int texUsage = GLTestBuffer::USAGE_HW_TEXTURE
+    | GLTestBuffer::USAGE_SW_WRITE_RARELY;
+static hwc_composer_device_1_t *hwcDevice;
+static EGLDisplay dpy;
+static EGLSurface surface;
+static EGLint width, height;
+static bool verbose;
+static HwcTestBufferPool bufferPool(20, 64 << 20);
+static HwcTestLayerArenaPair layerArenas;  // Lists of this and the last pass
+
+// Allocates and fills the buffers of a TRACE_FRAMES record, giving the
+// buffers of the previous group back to the pool
+static void loadFrames(const HwcTestTraceRecord *rec,
+                       vector<sp<GLTestBuffer> >& buffers)
+{
+    for (size_t n1 = 0; n1 < buffers.size(); n1++) {
+        bufferPool.put(buffers[n1]);
+    }
+    buffers.clear();
+
+    const HwcTestTraceBuffer *desc = HwcTestTraceReader::buffers(rec);
+    for (unsigned int n1 = 0; n1 < rec->count; n1++, desc++) {
+        sp<GLTestBuffer> buf = bufferPool.get(desc->width, desc->height,
+                                              desc->format, texUsage);
+        if (buf->initCheck() != NO_ERROR) {
+            testPrintE("GraphicBuffer initCheck failed, rv: %i",
+                       buf->initCheck());
+            testPrintE("  width: %u height: %u format: %u %s", desc->width,
+                       desc->height, desc->format,
+                       hwcTestGraphicFormat2str(desc->format));
+            exit(20);
+        }
+        hwcTestFillColor(buf.get(), ColorFract(desc->color[0],
+                         desc->color[1], desc->color[2]), desc->alpha);
+        buffers.push_back(buf);
+    }
+}
+
+// Handle of a traced buffer index
+static buffer_handle_t traceHandle(const vector<sp<GLTestBuffer> >& buffers,
+                                   uint16_t index)
+{
+    if (index >= buffers.size()) {
+        testPrintE("Trace layer of buffer %u, with %zu buffers", index,
+                   buffers.size());
+        exit(25);
+    }
+
+    return buffers[index]->handle;
+}
+
+int main(int argc, char *argv[])
+{
+    int rv, opt;
+    char *chptr;
+    char cmd[MAXCMD];
+    unsigned int startPass = 0, endPass = UINT32_MAX, loops = 1;
+    HwcTestTraceReader trace;
+
+    testSetLogCatTag(LOG_TAG);
+
+    while ((opt = getopt(argc, argv, "s:e:p:l:v?h")) != -1) {
+        switch (opt) {
+        case 's':
+            startPass = strtoul(optarg, &chptr, 10);
+            if (*chptr != '\0') {
+                testPrintE("Invalid starting pass of: %s", optarg);
+                exit(1);
+            }
+            break;
+
+        case 'e':
+            endPass = strtoul(optarg, &chptr, 10);
+            if (*chptr != '\0') {
+                testPrintE("Invalid ending pass of: %s", optarg);
+                exit(2);
+            }
+            break;
+
+        case 'p':
+            startPass = endPass = strtoul(optarg, &chptr, 10);
+            if (*chptr != '\0') {
+                testPrintE("Invalid pass of: %s", optarg);
+                exit(3);
+            }
+            break;
+
+        case 'l':
+            loops = strtoul(optarg, &chptr, 10);
+            if (*chptr != '\0') {
+                testPrintE("Invalid number of loops of: %s", optarg);
+                exit(4);
+            }
+            break;
+
+        case 'v':
+            verbose = true;
+            break;
+
+        case 'h':
+        case '?':
+        default:
+            testPrintE("  %s [options] trace", basename(argv[0]));
+            testPrintE("    options:");
+            testPrintE("      -s Starting pass");
+            testPrintE("      -e Ending pass");
+            testPrintE("      -p Replay specified pass");
+            testPrintE("      -l Number of times to replay the trace");
+            testPrintE("      -v Verbose");
+            exit(((optopt == 0) || (optopt == '?')) ? 0 : 5);
+        }
+    }
+    if (optind != argc - 1) {
+        testPrintE("Expected a trace file");
+        exit(6);
+    }
+    if (!trace.open(argv[optind])) {
+        testPrintE("Unable to open trace %s: %s", argv[optind],
+                   strerror(errno));
+        exit(7);
+    }
+
+    // Stop framework, unless the mock hardware composer stands in for the HAL
+    if (!hwcTestMockActive()) {
+        rv = snprintf(cmd, sizeof(cmd), "%s", CMD_STOP_FRAMEWORK);
+        if (rv >= (signed) sizeof(cmd) - 1) {
+            testPrintE("Command too long for: %s", CMD_STOP_FRAMEWORK);
+            exit(14);
+        }
+        testExecCmd(cmd);
+        testDelay(1.0); // TODO - need means to query whether asyncronous stop
+                        // framework operation has completed.  For now, just
+                        // wait a long time.
+    }
+
+    hwcTestInitDisplay(verbose, &dpy, &surface, &width, &height);
+    hwcTestOpenHwc(&hwcDevice);
+    if ((trace.header().width != (uint32_t) width)
+        || (trace.header().height != (uint32_t) height)) {
+        testPrintI("Trace of a %ux%u display replayed on %ux%u",
+                   trace.header().width, trace.header().height, width,
+                   height);
+    }
+
+    uint64_t passes = 0, prepares = 0, sets = 0;
+    uint64_t prepareNs = 0, setNs = 0;
+    vector<sp<GLTestBuffer> > buffers;
+    for (unsigned int loop = 0; loop < loops; loop++) {
+        const HwcTestTraceRecord *frames = NULL;
+        bool framesLoaded = false;
+        bool inRange = false;
+        hwc_display_contents_1_t *list = NULL;
+
+        trace.rewind();
+        for (const HwcTestTraceRecord *rec = trace.next(); rec != NULL;
+             rec = trace.next()) {
+            switch (rec->type) {
+            case HwcTestTraceRecord::TRACE_FRAMES:
+                frames = rec;
+                framesLoaded = false;
+                break;
+
+            case HwcTestTraceRecord::TRACE_PREPARE: {
+                uint32_t pass = HwcTestTraceReader::pass(rec);
+                inRange = (pass >= startPass) && (pass <= endPass);
+                if (!inRange) { break; }
+                if (frames == NULL) {
+                    testPrintE("Trace pass %u before any frames", pass);
+                    exit(22);
+                }
+                if (!framesLoaded) {
+                    loadFrames(frames, buffers);
+                    framesLoaded = true;
+                }
+                if (verbose) { testPrintI("==== Replaying pass: %u", pass); }
+
+                list = layerArenas.next().list(rec->count, 1);
+                if (list == NULL) {
+                    testPrintE("Layer list allocation failed");
+                    exit(23);
+                }
+                const HwcTestTraceLayer *traced
+                    = HwcTestTraceReader::layers(rec);
+                for (unsigned int n1 = 0; n1 < rec->count; n1++, traced++) {
+                    hwc_layer_1_t *layer = &list->hwLayers[n1];
+                    layer->handle = traceHandle(buffers, traced->buffer);
+                    layer->blending = traced->blending;
+                    layer->transform = traced->transform;
+                    layer->flags = traced->flags;
+                    layer->sourceCrop.left = traced->sourceCrop[0];
+                    layer->sourceCrop.top = traced->sourceCrop[1];
+                    layer->sourceCrop.right = traced->sourceCrop[2];
+                    layer->sourceCrop.bottom = traced->sourceCrop[3];
+                    layer->displayFrame.left = traced->displayFrame[0];
+                    layer->displayFrame.top = traced->displayFrame[1];
+                    layer->displayFrame.right = traced->displayFrame[2];
+                    layer->displayFrame.bottom = traced->displayFrame[3];
+
+                    hwc_rect_t *visible
+                        = (hwc_rect_t *) layer->visibleRegionScreen.rects;
+                    visible[0] = layer->displayFrame;
+                }
+
+                if (verbose) {
+                    testPrintI("Prepare:");
+                    hwcTestDisplayList(list);
+                }
+                uint64_t start = glTestBenchNow();
+                hwcDevice->prepare(hwcDevice, 1, &list);
+                prepareNs += glTestBenchNow() - start;
+                if (verbose) {
+                    testPrintI("Post Prepare:");
+                    hwcTestDisplayListPrepareModifiable(list);
+                }
+                list->flags &= ~HWC_GEOMETRY_CHANGED;
+                passes++;
+                prepares++;
+                break;
+            }
+
+            case HwcTestTraceRecord::TRACE_SET: {
+                if (!inRange) { break; }
+                if (rec->count != list->numHwLayers) {
+                    testPrintE("Trace set of %u layers, for a list of %zu",
+                               rec->count, list->numHwLayers);
+                    exit(24);
+                }
+                const uint16_t *traced = HwcTestTraceReader::handles(rec);
+                for (unsigned int n1 = 0; n1 < rec->count; n1++) {
+                    list->hwLayers[n1].handle = traceHandle(buffers,
+                                                            traced[n1]);
+                }
+                if (verbose) {
+                    testPrintI("Set:");
+                    hwcTestDisplayListHandles(list);
+                }
+                list->dpy = dpy;
+                list->sur = surface;
+                uint64_t start = glTestBenchNow();
+                hwcDevice->set(hwcDevice, 1, &list);
+                setNs += glTestBenchNow() - start;
+                sets++;
+                break;
+            }
+            }
+        }
+        if (trace.bad()) {
+            testPrintE("Malformed or truncated record in trace %s",
+                       argv[optind]);
+            exit(26);
+        }
+    }
+
+    // Start framework, unless the mock hardware composer stands in for the HAL
+    if (!hwcTestMockActive()) {
+        rv = snprintf(cmd, sizeof(cmd), "%s", CMD_START_FRAMEWORK);
+        if (rv >= (signed) sizeof(cmd) - 1) {
+            testPrintE("Command too long for: %s", CMD_START_FRAMEWORK);
+            exit(21);
+        }
+        testExecCmd(cmd);
+    }
+
+    testPrintI("Replayed %llu passes: %llu prepares, %llu sets",
+               (unsigned long long) passes, (unsigned long long) prepares,
+               (unsigned long long) sets);
+    testPrintI("  prepare %.3f ms total, %.1f us each",
+               prepareNs / 1e6, prepares ? prepareNs / 1e3 / prepares : 0.0);
+    testPrintI("  set %.3f ms total, %.1f us each",
+               setNs / 1e6, sets ? setNs / 1e3 / sets : 0.0);
+
+    return 0;
+}
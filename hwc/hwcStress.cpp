@@ -47,7 +47,16 @@
  * graphic buffer within the same row.  Since the graphic buffers
  * in a particular row have the same pixel format and dimension,
  * additional HWC set calls can be made, without having to perform
- * an HWC prepare call.
+ * an HWC prepare call.  The buffers of a finished group are given back
+ * to a HwcTestBufferPool, so a later group that picks the same format
+ * and dimension for a row takes them over instead of allocating.
+ *
+ * The frames of a group are picked from prandom streams of their own,
+ * keyed by the group and counted by the row and column of each buffer,
+ * rather than from the drand48 stream of the passes.  So the buffers are
+ * filled in parallel, and the frames of the next group are generated in
+ * the background while the passes of the current group run, with the
+ * same frames as when generated alone at the start of the group.
  *
  * This test supports the following command-line options:
  *
@@ -59,6 +68,8 @@
  *   -t float  Maximum time in seconds to execute the test
  *   -d float  Delay in seconds performed after each set operation
  *   -D float  Delay in seconds performed after the last pass is executed
+ *   -r file   Record a trace of the prepare and set calls to file
+ *   -b        Benchmark the prepare and set calls
  *
  * Typically the test is executed for a large range of passes.  By default
  * passes 0 through 99999 (100,000 passes) are executed.  Although this test
@@ -76,21 +87,41 @@
  * color and have a blending operation that causes the color in overlapping
  * rectangles to be mixed.  In such cases the overlapping portions may have
  * a different color from the rest of the rectangle.
+ *
+ * With -r, the buffers of each group, and the layer lists of each pass's
+ * prepare and set calls, are recorded to a trace.  hwcReplay issues the
+ * calls of a trace again, back to back, without regenerating the frames
+ * or lists, so a failing pass can be bisected and a stress session
+ * rerun as a benchmark.
+ *
+ * With -b, the passes run without delays and the latency of every prepare
+ * and set call is kept.  At the end the latency percentiles are reported,
+ * through the glTestBench harness, for all the calls, by number of layers,
+ * and by number of layers, format mix and number of layers the HWC took
+ * as overlays, along with the number of calls per second.  The frames
+ * of each group are generated at its start, rather than in the
+ * background, so that filling buffers on every CPU doesn't inflate the
+ * timed calls.  -d can't be used with -b.
  */
 
 #define LOG_TAG "hwcStressTest"
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <cerrno>
+#include <cfloat>
 #include <cmath>
 #include <cstdlib>
 #include <ctime>
 #include <libgen.h>
+#include <map>
 #include <sched.h>
+#include <set>
 #include <sstream>
 #include <stdint.h>
 #include <string.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
@@ -103,14 +134,13 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
-#include <ui/GraphicBuffer.h>
 
 #include <utils/Log.h>
 #include <testUtil.h>
+#include <glTestBench.h>
 
 #include <hardware/hwcomposer.h>
 
-#include <glTestLib.h>
 #include "hwcTestLib.h"
 
 using namespace std;
@@ -149,6 +179,8 @@ static unsigned int numSet = defaultPerPassNumSet;
 static float perSetDelay = defaultPerSetDelay;
 static float endDelay = defaultEndDelay;
 static float duration = defaultDuration;
+static const char *tracePath;
+static bool benchmark;
 
 // Command-line mutual exclusion detection flags.
 // Corresponding flag set true once an option is used.
@@ -190,17 +222,75 @@ const vector<unsigned int> vecTransformFlags(transformFlags,
     transformFlags + NUMA(transformFlags));
 
 // File scope globals
-static const int texUsage = GraphicBuffer::USAGE_HW_TEXTURE |
-        GraphicBuffer::USAGE_SW_WRITE_RARELY;
+static const int texUsage = GLTestBuffer::USAGE_HW_TEXTURE |
+        GLTestBuffer::USAGE_SW_WRITE_RARELY;
 static hwc_composer_device_1_t *hwcDevice;
 static EGLDisplay dpy;
 static EGLSurface surface;
 static EGLint width, height;
-static vector <vector <sp<GraphicBuffer> > > frames;
+static vector <vector <sp<GLTestBuffer> > > frames;
+// Frames of earlier pass groups.  Their sizes are random, so few are
+// reused, and only a group's worth is kept idle.
+static HwcTestBufferPool bufferPool(20, 64 << 20);
+// Layer lists of the current and previous passes.  The HWC may still
+// reference the list last set while the next one is built.
+static HwcTestLayerArenaPair layerArenas;
+static HwcTestTraceWriter trace;
+
+/*
+ * Frame Generation
+ *
+ * The frames of a group are drawn from HwcTestRand streams keyed by the
+ * seed of the group and identified by the row and column of a buffer, so
+ * every buffer has streams of its own, which don't depend on the order
+ * that the buffers are generated in.  Stream 0 picks a buffer's color and
+ * stream 1 the random pad of its rows.  Draws that pick a row's format and
+ * dimension, or the number of rows, use a column or row of frameRandAny.
+ * Only the passes, on the main thread, draw from testRand().
+ *
+ * generateFrames() describes a group serially, takes its buffers from the
+ * pool, and fills them from a pool of threads.  While the passes of a
+ * group run, a prefetch thread generates the frames of the next group,
+ * unless there is only one CPU.  The main thread leaves the buffer pool
+ * alone until it joins the prefetch, at the start of the next group.
+ */
+static const uint32_t frameRandAny = UINT32_MAX;
+
+struct FrameGroup {
+    unsigned int seed;
+    vector <vector <sp<GLTestBuffer> > > frames;
+    vector <vector <HwcTestTraceBuffer> > descs;
+};
+
+static FrameGroup prefetched;   // Frames of the next group
+static thread prefetcher;       // Generating prefetched
+
+// Frames of the previous group.  The HWC may still be scanning out the
+// buffers of the last set of a group, or be about to release them, so
+// they go back to the pool, to be refilled, only a group later.
+static vector <vector <sp<GLTestBuffer> > > retiring;
+
+// Benchmark
+// Latencies of the prepare and set calls, in nanoseconds, by the number
+// of layers, their formats, and the number the HWC took as overlays
+struct BenchKey {
+    unsigned int layers;
+    string formats;         // Distinct formats of the layers, '+' separated
+    unsigned int overlays;
+
+    bool operator<(const BenchKey& other) const;
+};
+static map<BenchKey, vector<double> > benchPrepare, benchSet;
 
 // File scope prototypes
 void init(void);
-void initFrames(unsigned int seed);
+void initFrames(unsigned int seed, bool prefetchNext);
+FrameGroup generateFrames(unsigned int seed);
+void putFrames(vector <vector <sp<GLTestBuffer> > >& groupFrames);
+BenchKey benchKey(const hwc_display_contents_1_t *list,
+                  const vector <vector <sp<GLTestBuffer> > >& selectedFrames);
+void benchReport(const char *call,
+                 const map<BenchKey, vector<double> >& latencies);
 template <class T> vector<T> vectorRandSelect(const vector<T>& vec, size_t num);
 template <class T> T vectorOr(const vector<T>& vec);
 
@@ -248,7 +338,7 @@ main(int argc, char *argv[])
     testSetLogCatTag(LOG_TAG);
 
     // Parse command line arguments
-    while ((opt = getopt(argc, argv, "vp:d:D:n:s:e:t:?h")) != -1) {
+    while ((opt = getopt(argc, argv, "vp:d:D:n:s:e:t:r:b?h")) != -1) {
         switch (opt) {
           case 'd': // Delay after each set operation
             perSetDelay = strtod(optarg, &chptr);
@@ -336,6 +426,14 @@ main(int argc, char *argv[])
             }
             break;
 
+          case 'r': // Record trace
+            tracePath = optarg;
+            break;
+
+          case 'b': // Benchmark
+            benchmark = true;
+            break;
+
           case 'v': // Verbose
             verbose = true;
             break;
@@ -352,6 +450,8 @@ main(int argc, char *argv[])
             testPrintE("      -d Delay after each set operation");
             testPrintE("      -D End of test delay");
             testPrintE("      -n Num set operations per pass");
+            testPrintE("      -r Record a trace to the given file");
+            testPrintE("      -b Benchmark prepare and set calls");
             testPrintE("      -v Verbose");
             exit(((optopt == 0) || (optopt == '?')) ? 0 : 11);
         }
@@ -367,26 +467,44 @@ main(int argc, char *argv[])
             basename(argv[0]));
         exit(13);
     }
+    if (benchmark && (perSetDelay != 0.0)) {
+        testPrintE("Invalid combination of command-line options.");
+        testPrintE("  The -d option can't be used with -b.");
+        exit(16);
+    }
     testPrintI("duration: %g", duration);
     testPrintI("startPass: %u", startPass);
     testPrintI("endPass: %u", endPass);
     testPrintI("numSet: %u", numSet);
 
-    // Stop framework
-    rv = snprintf(cmd, sizeof(cmd), "%s", CMD_STOP_FRAMEWORK);
-    if (rv >= (signed) sizeof(cmd) - 1) {
-        testPrintE("Command too long for: %s", CMD_STOP_FRAMEWORK);
-        exit(14);
+    // Stop framework, unless the mock hardware composer stands in for the HAL
+    if (!hwcTestMockActive()) {
+        rv = snprintf(cmd, sizeof(cmd), "%s", CMD_STOP_FRAMEWORK);
+        if (rv >= (signed) sizeof(cmd) - 1) {
+            testPrintE("Command too long for: %s", CMD_STOP_FRAMEWORK);
+            exit(14);
+        }
+        testExecCmd(cmd);
+        testDelay(1.0); // TODO - need means to query whether asyncronous stop
+                        // framework operation has completed.  For now, just
+                        // wait a long time.
     }
-    testExecCmd(cmd);
-    testDelay(1.0); // TODO - need means to query whether asyncronous stop
-                    // framework operation has completed.  For now, just wait
-                    // a long time.
 
     init();
+    if ((tracePath != NULL) && !trace.open(tracePath, width, height)) {
+        testPrintE("Unable to create trace %s: %s", tracePath,
+                   strerror(errno));
+        exit(15);
+    }
+
+    // With a single CPU, generating the next group's frames in the
+    // background would only take time from the passes.  When benchmarking,
+    // its filler threads would contend with the timed calls on every CPU.
+    bool prefetch = !benchmark && (thread::hardware_concurrency() > 1);
 
     // For each pass
     gettimeofday(&startTime, NULL);
+    uint64_t loopNs = glTestBenchNow();
     for (pass = startPass; pass <= endPass; pass++) {
         // Stop if duration of work has already been performed
         gettimeofday(&currentTime, NULL);
@@ -400,7 +518,9 @@ main(int argc, char *argv[])
         // divided by passesPerGroup.
         if ((pass == startPass)
             || ((pass / passesPerGroup) != ((pass - 1) / passesPerGroup))) {
-            initFrames(pass / passesPerGroup);
+            initFrames(pass / passesPerGroup, prefetch
+                       && ((pass / passesPerGroup)
+                           < (endPass / passesPerGroup)));
         }
 
         testPrintI("==== Starting pass: %u", pass);
@@ -410,14 +530,14 @@ main(int argc, char *argv[])
         srand48(pass);
 
         hwc_display_contents_1_t *list;
-        list = hwcTestCreateLayerList(testRandMod(frames.size()) + 1);
+        list = layerArenas.next().list(testRandMod(frames.size()) + 1, 1);
         if (list == NULL) {
-            testPrintE("hwcTestCreateLayerList failed");
+            testPrintE("Layer list allocation failed");
             exit(20);
         }
 
         // Prandomly select a subset of frames to be used by this pass.
-        vector <vector <sp<GraphicBuffer> > > selectedFrames;
+        vector <vector <sp<GLTestBuffer> > > selectedFrames;
         selectedFrames = vectorRandSelect(frames, list->numHwLayers);
 
         // Any transform tends to create a layer that the hardware
@@ -427,7 +547,7 @@ main(int argc, char *argv[])
 
         for (unsigned int n1 = 0; n1 < list->numHwLayers; n1++) {
             unsigned int idx = testRandMod(selectedFrames[n1].size());
-            sp<GraphicBuffer> gBuf = selectedFrames[n1][idx];
+            sp<GLTestBuffer> gBuf = selectedFrames[n1][idx];
             hwc_layer_1_t *layer = &list->hwLayers[n1];
             layer->handle = gBuf->handle;
 
@@ -472,17 +592,26 @@ main(int argc, char *argv[])
                 }
             }
 
-            layer->visibleRegionScreen.numRects = 1;
-            layer->visibleRegionScreen.rects = &layer->displayFrame;
+            hwc_rect_t *visible
+                = (hwc_rect_t *) layer->visibleRegionScreen.rects;
+            visible[0] = layer->displayFrame;
         }
 
         // Perform prepare operation
         if (verbose) { testPrintI("Prepare:"); hwcTestDisplayList(list); }
+        trace.prepare(pass, list);
+        uint64_t callNs = glTestBenchNow();
         hwcDevice->prepare(hwcDevice, 1, &list);
+        callNs = glTestBenchNow() - callNs;
         if (verbose) {
             testPrintI("Post Prepare:");
             hwcTestDisplayListPrepareModifiable(list);
         }
+        BenchKey key;
+        if (benchmark) {
+            key = benchKey(list, selectedFrames);
+            benchPrepare[key].push_back(callNs);
+        }
 
         // Turn off the geometry changed flag
         list->flags &= ~HWC_GEOMETRY_CHANGED;
@@ -493,34 +622,71 @@ main(int argc, char *argv[])
             if (verbose) { hwcTestDisplayListHandles(list); }
             list->dpy = dpy;
             list->sur = surface;
+            trace.set(list);
+            callNs = glTestBenchNow();
             hwcDevice->set(hwcDevice, 1, &list);
+            callNs = glTestBenchNow() - callNs;
+            if (benchmark) { benchSet[key].push_back(callNs); }
 
             // Prandomly select a new set of handles
             for (unsigned int n1 = 0; n1 < list->numHwLayers; n1++) {
                 unsigned int idx = testRandMod(selectedFrames[n1].size());
-                sp<GraphicBuffer> gBuf = selectedFrames[n1][idx];
+                sp<GLTestBuffer> gBuf = selectedFrames[n1][idx];
                 hwc_layer_1_t *layer = &list->hwLayers[n1];
                 layer->handle = (native_handle_t *) gBuf->handle;
             }
 
-            testDelay(perSetDelay);
+            if (!benchmark) { testDelay(perSetDelay); }
         }
 
-        hwcTestFreeLayerList(list);
         testPrintI("==== Completed pass: %u", pass);
     }
+    loopNs = glTestBenchNow() - loopNs;
 
+    trace.close();
+
+    // A prefetch of a group past the duration is never used
+    if (prefetcher.joinable()) {
+        prefetcher.join();
+        putFrames(prefetched.frames);
+    }
     testDelay(endDelay);
 
-    // Start framework
-    rv = snprintf(cmd, sizeof(cmd), "%s", CMD_START_FRAMEWORK);
-    if (rv >= (signed) sizeof(cmd) - 1) {
-        testPrintE("Command too long for: %s", CMD_START_FRAMEWORK);
-        exit(21);
+    // Start framework, unless the mock hardware composer stands in for the HAL
+    if (!hwcTestMockActive()) {
+        rv = snprintf(cmd, sizeof(cmd), "%s", CMD_START_FRAMEWORK);
+        if (rv >= (signed) sizeof(cmd) - 1) {
+            testPrintE("Command too long for: %s", CMD_START_FRAMEWORK);
+            exit(21);
+        }
+        testExecCmd(cmd);
     }
-    testExecCmd(cmd);
 
     testPrintI("Successfully completed %u passes", pass - startPass);
+    bufferPool.report("hwcStress");
+
+    if (benchmark) {
+        uint64_t calls = 0;
+        double callsNs = 0.0;
+        for (unsigned int n1 = 0; n1 < 2; n1++) {
+            const map<BenchKey, vector<double> >& latencies
+                = (n1 == 0) ? benchPrepare : benchSet;
+            for (map<BenchKey, vector<double> >::const_iterator it
+                     = latencies.begin(); it != latencies.end(); ++it) {
+                calls += it->second.size();
+                for (size_t n2 = 0; n2 < it->second.size(); n2++) {
+                    callsNs += it->second[n2];
+                }
+            }
+        }
+        benchReport("prepare", benchPrepare);
+        benchReport("set", benchSet);
+        testPrintI("hwcStress benchmark: %llu calls in %.3f s, "
+                   "%.1f calls/sec, %.1f calls/sec of HWC time",
+                   (unsigned long long) calls, loopNs / 1e9,
+                   loopNs ? calls * 1e9 / loopNs : 0.0,
+                   (callsNs > 0.0) ? calls * 1e9 / callsNs : 0.0);
+    }
 
     return 0;
 }
@@ -546,34 +712,105 @@ void init(void)
  * vectors.  All the graphic buffers in a particular row are of the same
  * format and dimension.  Each graphic buffer is uniformly filled with a
  * prandomly selected color.  It is likely that each buffer, even
- * in the same row, will be filled with a unique color.
+ * in the same row, will be filled with a unique color.  Legacy formats,
+ * which gralloc may no longer allocate, aren't selected.
+ *
+ * The frames are taken from the prefetch of the previous group, when it
+ * was for this seed, and otherwise generated now.  With prefetchNext,
+ * the frames of the following group are then prefetched.
  */
-void initFrames(unsigned int seed)
+void initFrames(unsigned int seed, bool prefetchNext)
+{
+    if (verbose) { testPrintI("initFrames seed: %u", seed); }
+
+    // Give the frames of the pass group before the previous one back to
+    // the pool, which hands them out again for rows of the same format
+    // and size, and hold the previous group's back until the next group
+    FrameGroup group;
+    if (prefetcher.joinable()) { prefetcher.join(); }
+    putFrames(retiring);
+    retiring = move(frames);
+    frames.clear();
+    if (!prefetched.frames.empty() && (prefetched.seed == seed)) {
+        group = move(prefetched);
+    } else {
+        putFrames(prefetched.frames);
+        group = generateFrames(seed);
+    }
+    prefetched = FrameGroup();
+    frames = move(group.frames);
+
+    vector<buffer_handle_t> traceHandles;
+    vector<HwcTestTraceBuffer> traceBuffers;
+    for (unsigned int row = 0; row < frames.size(); row++) {
+        const HwcTestTraceBuffer& rowDesc = group.descs[row][0];
+        if (verbose) {
+            testPrintI("  frame %u width: %u height: %u format: %u %s",
+                       row, rowDesc.width, rowDesc.height, rowDesc.format,
+                       hwcTestGraphicFormat2str(rowDesc.format));
+        }
+        for (unsigned int col = 0; col < frames[row].size(); col++) {
+            const HwcTestTraceBuffer& desc = group.descs[row][col];
+            traceHandles.push_back(frames[row][col]->handle);
+            traceBuffers.push_back(desc);
+            if (verbose) {
+                ColorFract color(desc.color[0], desc.color[1], desc.color[2]);
+                testPrintI("    buf: %p handle: %p color: %s alpha: %f",
+                           frames[row][col].get(), frames[row][col]->handle,
+                           string(color).c_str(), desc.alpha);
+            }
+        }
+    }
+    trace.frames(traceHandles, traceBuffers);
+
+    if (prefetchNext) {
+        prefetcher = thread([seed]() {
+            prefetched = generateFrames(seed + 1);
+        });
+    }
+}
+
+/*
+ * Generate Frames
+ *
+ * Describes the frames of the group given by seed, from HwcTestRand
+ * streams, takes their buffers from the pool and fills them.
+ */
+FrameGroup generateFrames(unsigned int seed)
 {
     int rv;
     const size_t maxRows = 5;
     const size_t minCols = 2;  // Need at least double buffering
     const size_t maxCols = 4;  // One more than triple buffering
+    FrameGroup group;
+
+    group.seed = seed;
+    HwcTestRand groupRand(seed, frameRandAny, frameRandAny);
+    size_t rows = groupRand.mod(maxRows) + 1;
+    group.frames.resize(rows);
+    group.descs.resize(rows);
+
+    vector<const struct hwcTestGraphicFormat *> formats;
+    for (unsigned int n1 = 0; n1 < NUMA(hwcTestGraphicFormat); n1++) {
+        if (!(hwcTestGraphicFormat[n1].flags & HWC_TEST_FORMAT_LEGACY)) {
+            formats.push_back(&hwcTestGraphicFormat[n1]);
+        }
+    }
 
-    if (verbose) { testPrintI("initFrames seed: %u", seed); }
-    srand48(seed);
-    size_t rows = testRandMod(maxRows) + 1;
-
-    frames.clear();
-    frames.resize(rows);
-
+    vector<pair<unsigned int, unsigned int> > toFill;
     for (unsigned int row = 0; row < rows; row++) {
+        HwcTestRand rowRand(seed, row, frameRandAny);
+
         // All frames within a row have to have the same format and
         // dimensions.  Width and height need to be >= 1.
-        unsigned int formatIdx = testRandMod(NUMA(hwcTestGraphicFormat));
-        const struct hwcTestGraphicFormat *formatPtr
-            = &hwcTestGraphicFormat[formatIdx];
+        unsigned int formatIdx = rowRand.mod(formats.size());
+        const struct hwcTestGraphicFormat *formatPtr = formats[formatIdx];
         int format = formatPtr->format;
 
         // Pick width and height, which must be >= 1 and the size
         // mod the wMod/hMod value must be equal to 0.
-        size_t w = (width * maxSizeRatio) * testRandFract();
-        size_t h = (height * maxSizeRatio) * testRandFract();
+        size_t w = (width * maxSizeRatio) * rowRand.fract();
+        size_t h = (height * maxSizeRatio) * rowRand.fract();
         w = max(size_t(1u), w);
         h = max(size_t(1u), h);
         if ((w % formatPtr->wMod) != 0) {
@@ -582,33 +819,160 @@ void initFrames(unsigned int seed)
         if ((h % formatPtr->hMod) != 0) {
             h += formatPtr->hMod - (h % formatPtr->hMod);
         }
-        if (verbose) {
-            testPrintI("  frame %u width: %u height: %u format: %u %s",
-                       row, w, h, format, hwcTestGraphicFormat2str(format));
-        }
 
-        size_t cols = testRandMod((maxCols + 1) - minCols) + minCols;
-        frames[row].resize(cols);
+        size_t cols = rowRand.mod((maxCols + 1) - minCols) + minCols;
+        group.frames[row].resize(cols);
+        group.descs[row].resize(cols);
         for (unsigned int col = 0; col < cols; col++) {
-            ColorFract color(testRandFract(), testRandFract(), testRandFract());
-            float alpha = testRandFract();
+            HwcTestRand bufRand(seed, row, col);
+            HwcTestTraceBuffer& desc = group.descs[row][col];
+            desc.width = w;
+            desc.height = h;
+            desc.format = format;
+            for (unsigned int n1 = 0; n1 < NUMA(desc.color); n1++) {
+                desc.color[n1] = bufRand.fract();
+            }
+            desc.alpha = bufRand.fract();
 
-            frames[row][col] = new GraphicBuffer(w, h, format, texUsage);
-            if ((rv = frames[row][col]->initCheck()) != NO_ERROR) {
+            group.frames[row][col] = bufferPool.get(w, h, format, texUsage);
+            if ((rv = group.frames[row][col]->initCheck()) != NO_ERROR) {
                 testPrintE("GraphicBuffer initCheck failed, rv: %i", rv);
                 testPrintE("  frame %u width: %u height: %u format: %u %s",
                            row, w, h, format, hwcTestGraphicFormat2str(format));
                 exit(80);
             }
+            toFill.push_back(make_pair(row, col));
+        }
+    }
 
-            hwcTestFillColor(frames[row][col].get(), color, alpha);
-            if (verbose) {
-                testPrintI("    buf: %p handle: %p color: %s alpha: %f",
-                           frames[row][col].get(), frames[row][col]->handle,
-                           string(color).c_str(), alpha);
-            }
+    // Fill the buffers, each from whichever thread takes it first
+    atomic<size_t> next(0);
+    auto fill = [&]() {
+        for (size_t n1 = next++; n1 < toFill.size(); n1 = next++) {
+            unsigned int row = toFill[n1].first, col = toFill[n1].second;
+            const HwcTestTraceBuffer& desc = group.descs[row][col];
+            HwcTestRand padRand(seed, row, col, 1);
+            hwcTestFillColor(group.frames[row][col].get(),
+                             ColorFract(desc.color[0], desc.color[1],
+                                        desc.color[2]), desc.alpha,
+                             &padRand);
+        }
+    };
+    size_t numThreads = min<size_t>(max(thread::hardware_concurrency(), 1u),
+                                    toFill.size());
+    vector<thread> fillers;
+    for (size_t n1 = 1; n1 < numThreads; n1++) {
+        fillers.push_back(thread(fill));
+    }
+    fill();
+    for (size_t n1 = 0; n1 < fillers.size(); n1++) {
+        fillers[n1].join();
+    }
+
+    return group;
+}
+
+// Put Frames
+// Gives the buffers of a group back to the pool
+void putFrames(vector <vector <sp<GLTestBuffer> > >& groupFrames)
+{
+    for (unsigned int row = 0; row < groupFrames.size(); row++) {
+        for (unsigned int col = 0; col < groupFrames[row].size(); col++) {
+            bufferPool.put(groupFrames[row][col]);
+        }
+    }
+    groupFrames.clear();
+}
+
+bool BenchKey::operator<(const BenchKey& other) const
+{
+    if (layers != other.layers) { return layers < other.layers; }
+    if (formats != other.formats) { return formats < other.formats; }
+
+    return overlays < other.overlays;
+}
+
+/*
+ * Benchmark Key
+ *
+ * Bucket of the calls made with list, as prepared, whose layers show
+ * buffers of the rows in selectedFrames.
+ */
+BenchKey benchKey(const hwc_display_contents_1_t *list,
+                  const vector <vector <sp<GLTestBuffer> > >& selectedFrames)
+{
+    BenchKey key;
+    set<uint32_t> formats;
+
+    key.layers = list->numHwLayers;
+    key.overlays = 0;
+    for (unsigned int n1 = 0; n1 < list->numHwLayers; n1++) {
+        formats.insert(selectedFrames[n1][0]->getPixelFormat());
+        if (list->hwLayers[n1].compositionType == HWC_OVERLAY) {
+            key.overlays++;
         }
     }
+    for (set<uint32_t>::iterator it = formats.begin(); it != formats.end();
+         ++it) {
+        if (!key.formats.empty()) { key.formats += "+"; }
+        key.formats += hwcTestGraphicFormat2str(*it);
+    }
+
+    return key;
+}
+
+// Benchmark Summary
+// Reports the latency percentiles of samples, all of which are kept
+static void benchSummary(const string& name, vector<double>& samples)
+{
+    GLTestBenchConfig config;
+    GLTestBenchResult result;
+
+    config.checkConvergence = false;
+    config.outlierMads = 0.0;
+    config.workPerIteration = 1.0;
+    config.workUnits = "calls";
+    glTestBenchSummarize(name.c_str(), config, samples, result);
+    glTestBenchReport(result);
+}
+
+/*
+ * Benchmark Report
+ *
+ * Reports the latencies of a call over all the passes, by number of
+ * layers, and by bucket.
+ */
+void benchReport(const char *call,
+                 const map<BenchKey, vector<double> >& latencies)
+{
+    vector<double> all;
+    map<unsigned int, vector<double> > byLayers;
+
+    for (map<BenchKey, vector<double> >::const_iterator it
+             = latencies.begin(); it != latencies.end(); ++it) {
+        all.insert(all.end(), it->second.begin(), it->second.end());
+        vector<double>& layers = byLayers[it->first.layers];
+        layers.insert(layers.end(), it->second.begin(), it->second.end());
+    }
+
+    ostringstream name;
+    name << "hwcStress " << call;
+    benchSummary(name.str(), all);
+    for (map<unsigned int, vector<double> >::iterator it = byLayers.begin();
+         it != byLayers.end(); ++it) {
+        name.str("");
+        name << "hwcStress " << call << " " << it->first << " layers";
+        benchSummary(name.str(), it->second);
+    }
+    for (map<BenchKey, vector<double> >::const_iterator it
+             = latencies.begin(); it != latencies.end(); ++it) {
+        vector<double> samples = it->second;
+        name.str("");
+        name << "hwcStress " << call << " " << it->first.layers
+             << " layers " << it->first.formats << " "
+             << it->first.overlays << " overlays";
+        benchSummary(name.str(), samples);
+    }
 }
 
 /*
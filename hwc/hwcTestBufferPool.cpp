@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Hardware Composer Test Library - Graphic Buffer Pool
+ *
+ * Capability sweeps, such as the binary searches of hwcCommit, prepare
+ * the same few layer shapes hundreds of times, and allocating their
+ * buffers from gralloc costs more than the prepare() calls themselves.
+ * HwcTestBufferPool keeps the buffers of finished probes idle, keyed by
+ * their geometry, format and usage, so the next probe of the same shape
+ * takes them over instead of allocating.
+ *
+ * Idle buffers are kept in a list, most recently returned first, for
+ * trimming, and in a multimap from their key to their place in the list,
+ * for lookups.  Among idle buffers of the same key the most recently
+ * returned one is handed out, as it is the most likely to still be in
+ * the CPU caches.
+ */
+
+#include <stdint.h>
+
+#include <list>
+#include <map>
+
+#include "hwcTestLib.h"
+
+using namespace std;
+using namespace android;
+
+bool HwcTestBufferPool::Key::operator<(const Key& other) const
+{
+    if (width != other.width) { return width < other.width; }
+    if (height != other.height) { return height < other.height; }
+    if (format != other.format) { return format < other.format; }
+
+    return usage < other.usage;
+}
+
+// Bytes held by a buffer, as laid out by hwcTestPlanes() for planar
+// formats, for the idle limit
+static size_t poolBufferBytes(const sp<GLTestBuffer>& buf)
+{
+    const struct hwcTestGraphicFormat *format
+        = hwcTestGraphicFormatLookup(buf->getPixelFormat());
+    size_t stride = buf->getStride();
+    size_t height = buf->getHeight();
+
+    if (format == NULL) { return stride * height * 4; }
+    if (format->flags & HWC_TEST_FORMAT_PLANAR) {
+        struct hwcTestPlaneLayout layout = hwcTestPlanes(*format, stride,
+                                                         height);
+        return layout.uOffset + layout.cStride * (height / format->vSub);
+    }
+
+    return stride * height * format->bytes;
+}
+
+HwcTestBufferPool::HwcTestBufferPool(size_t maxIdle, size_t maxIdleBytes)
+    : _maxIdle(maxIdle), _maxIdleBytes(maxIdleBytes)
+{
+    _stats.hits = 0;
+    _stats.misses = 0;
+    _stats.evictions = 0;
+    _stats.idle = 0;
+    _stats.idleBytes = 0;
+}
+
+sp<GLTestBuffer> HwcTestBufferPool::get(uint32_t width, uint32_t height,
+                                        uint32_t format, uint32_t usage)
+{
+    Key key = { width, height, format, usage };
+    multimap<Key, LruList::iterator>::iterator it = _idle.upper_bound(key);
+
+    // Equal keys are in insertion order, so the one before the upper
+    // bound was returned last
+    if (it != _idle.begin() && !((--it)->first < key)) {
+        LruList::iterator entry = it->second;
+        sp<GLTestBuffer> buf = entry->buf;
+
+        _stats.idle--;
+        _stats.idleBytes -= entry->bytes;
+        _lru.erase(entry);
+        _idle.erase(it);
+        _stats.hits++;
+
+        return buf;
+    }
+
+    _stats.misses++;
+
+    return new GLTestBuffer(width, height, format, usage);
+}
+
+void HwcTestBufferPool::put(const sp<GLTestBuffer>& buf)
+{
+    // Failed allocations aren't worth keeping
+    if (buf.get() == NULL || buf->initCheck() != NO_ERROR) { return; }
+
+    Entry entry;
+    entry.key.width = buf->getWidth();
+    entry.key.height = buf->getHeight();
+    entry.key.format = buf->getPixelFormat();
+    entry.key.usage = buf->getUsage();
+    entry.buf = buf;
+    entry.bytes = poolBufferBytes(buf);
+
+    _lru.push_front(entry);
+    _idle.insert(_idle.upper_bound(entry.key),
+                 make_pair(entry.key, _lru.begin()));
+    _stats.idle++;
+    _stats.idleBytes += entry.bytes;
+
+    trim(_maxIdle, _maxIdleBytes);
+}
+
+void HwcTestBufferPool::trim(size_t maxIdle, size_t maxIdleBytes)
+{
+    while (!_lru.empty()
+           && (_stats.idle > maxIdle || _stats.idleBytes > maxIdleBytes)) {
+        LruList::iterator entry = --_lru.end();
+        pair<multimap<Key, LruList::iterator>::iterator,
+             multimap<Key, LruList::iterator>::iterator> range
+            = _idle.equal_range(entry->key);
+        for (multimap<Key, LruList::iterator>::iterator it = range.first;
+             it != range.second; ++it) {
+            if (it->second == entry) {
+                _idle.erase(it);
+                break;
+            }
+        }
+
+        _stats.idle--;
+        _stats.idleBytes -= entry->bytes;
+        _lru.erase(entry);
+        _stats.evictions++;
+    }
+}
+
+void HwcTestBufferPool::report(const char *name) const
+{
+    uint64_t gets = _stats.hits + _stats.misses;
+
+    testPrintI("%s buffer pool: %llu gets, %llu hits (%.1f%%), "
+               "%llu allocations, %llu evictions",
+               name, (unsigned long long) gets,
+               (unsigned long long) _stats.hits,
+               gets ? 100.0 * _stats.hits / gets : 0.0,
+               (unsigned long long) _stats.misses,
+               (unsigned long long) _stats.evictions);
+    testPrintI("  idle: %zu buffers, %.1f MiB", _stats.idle,
+               _stats.idleBytes / (1024.0 * 1024.0));
+}
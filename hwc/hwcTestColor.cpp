@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Hardware Composer Test Library - Color Conversion
+ *
+ * When possible, converts colors specified as a full range value in
+ * the fromFormat, into an equivalent full range color in the toFormat.
+ * When conversion is impossible (e.g. out of gamut color) a color
+ * or black in the full range output format is produced.
+ *
+ * Each graphic format has 3 color components and each of these
+ * components has both a full and in gamut range.  The format registry
+ * (hwcTestFormat.h) gives the in gamut range of each component as low
+ * to high, within its full range of 0 to max.  In most cases the full
+ * and in gamut ranges are equivalent, while YUV formats in limited
+ * (video) range only use part of the full range.
+ *
+ * The input and produced colors are both specified as a fractional amount
+ * of the full range.  The diagram below provides an overview of the
+ * conversion process.  The main steps are:
+ *
+ *   1. Produce black if the input color is out of gamut.
+ *
+ *   2. Convert the in gamut color into the fraction of the fromFromat
+ *      in gamut range.
+ *
+ *   3. Convert from the fraction of the in gamut from format range to
+ *      the fraction of the in gamut to format range.  Produce black
+ *      if an equivalent color does not exists.
+ *
+ *   4. Covert from the fraction of the in gamut to format to the
+ *      fraction of the full range to format.
+ *
+ *       From Format                 To Format
+ *    max           high            high        max
+ *    ----+                 +-----------+
+ *    high \               /             \      high
+ *    ------\-------------+               +-------->
+ *           \
+ *            \                   +--- black --+
+ *             \                 /              \
+ *              \               /                +-->
+ *    low        \             /                  low
+ *    -------- ---+-- black --+
+ *    0               low           low             0
+ *     ^               ^      ^      ^             ^
+ *     |               |      |      |             |
+ *     |               |      |      |             +-- fraction of full range
+ *     |               |      |      +-- fraction of valid range
+ *     |               |      +-- fromFormat to toFormat color conversion
+ *     |               +-- fraction of valid range
+ *     +-- fraction of full range
+ *
+ * HwcTestColorConverter looks the formats up and reduces step 3 to a
+ * matrix once, then runs whole spans of colors through the steps with
+ * vector arithmetic.  Spans are worked on in blocks, with each color
+ * component in its own array, using the compiler's generic vector
+ * types, which map to AVX2, SSE2 or NEON registers.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "hwcTestLib.h"
+
+// Defines
+#define NUMA(a) (sizeof(a) / sizeof((a)[0]))
+
+#if defined(__AVX2__)
+#define VEC_LANES 8
+#else
+#define VEC_LANES 4
+#endif
+
+typedef float vecFloat __attribute__((vector_size(VEC_LANES * sizeof(float))));
+typedef int32_t vecInt
+    __attribute__((vector_size(VEC_LANES * sizeof(int32_t))));
+typedef uint32_t vecUint
+    __attribute__((vector_size(VEC_LANES * sizeof(uint32_t))));
+
+// Colors converted per block, a multiple of VEC_LANES
+static const size_t blockSize = 256;
+
+static inline vecFloat loadVec(const float *src)
+{
+    vecFloat v;
+    memcpy(&v, src, sizeof(v));
+    return v;
+}
+
+static inline void storeVec(float *dst, vecFloat v)
+{
+    memcpy(dst, &v, sizeof(v));
+}
+
+static inline vecFloat selectVec(vecInt mask, vecFloat a, vecFloat b)
+{
+    return (vecFloat) ((mask & (vecInt) a) | (~mask & (vecInt) b));
+}
+
+HwcTestColorConverter::HwcTestColorConverter(uint32_t fromFormat,
+    uint32_t toFormat, Matrix matrix, Range range)
+    : _fromFormat(fromFormat), _toFormat(toFormat),
+      _identity(fromFormat == toFormat), _modelConversion(false)
+{
+    const struct hwcTestGraphicFormat *fromAttrib
+        = hwcTestGraphicFormatLookup(fromFormat);
+    if (fromAttrib == NULL) {
+        testPrintE("hwcTestColorConvert unsupported from format of: %u",
+                   fromFormat);
+        exit(120);
+    }
+    const struct hwcTestGraphicFormat *toAttrib
+        = hwcTestGraphicFormatLookup(toFormat);
+    if (toAttrib == NULL) {
+        testPrintE("hwcTestColorConvert unsupported to format of: %u",
+                   toFormat);
+        exit(121);
+    }
+    bool fromYuv = (fromAttrib->flags & HWC_TEST_FORMAT_YUV) != 0;
+    bool toYuv = (toAttrib->flags & HWC_TEST_FORMAT_YUV) != 0;
+
+    // Per component ranges, with full range YUV using every code
+    const struct hwcTestGraphicFormat *attribs[] = {fromAttrib, toAttrib};
+    for (unsigned int side = 0; side < NUMA(attribs); side++) {
+        const struct hwcTestGraphicFormat *attrib = attribs[side];
+        struct componentRange *ranges = side ? _to : _from;
+        bool full = (attrib->flags & HWC_TEST_FORMAT_YUV)
+            && (range == RANGE_FULL);
+        for (unsigned int c = 0; c < 3; c++) {
+            const struct hwcTestFormatComponent& comp = attrib->c[c];
+            ranges[c].min = 0;
+            ranges[c].max = (1 << comp.bits) - 1;
+            ranges[c].low = full ? ranges[c].min : comp.low;
+            ranges[c].high = full ? ranges[c].max : comp.high;
+        }
+    }
+
+    // Step 3 as a matrix and offset, from the fraction of the from format
+    // valid range to that of the to format
+    double wr, wb;
+    switch (matrix) {
+    case MATRIX_BT601: wr = 0.299; wb = 0.114; break;
+    default: wr = 0.2126; wb = 0.0722; break; // ITU709 recommended constants
+    }
+    double wg = 1.0 - wr - wb;
+    double m[3][4] = {
+        {1.0, 0.0, 0.0, 0.0},
+        {0.0, 1.0, 0.0, 0.0},
+        {0.0, 0.0, 1.0, 0.0},
+    };
+    if (!fromYuv && toYuv) {
+        // y = wr * r + wg * g + wb * b
+        // u = 0.5 * ((b - y) / (1.0 - wb)) + 0.5
+        // v = 0.5 * ((r - y) / (1.0 - wr)) + 0.5
+        const double rgb2yuv[3][4] = {
+            {wr, wg, wb, 0.0},
+            {-0.5 * wr / (1.0 - wb), -0.5 * wg / (1.0 - wb), 0.5, 0.5},
+            {0.5, -0.5 * wg / (1.0 - wr), -0.5 * wb / (1.0 - wr), 0.5},
+        };
+        memcpy(m, rgb2yuv, sizeof(m));
+        _modelConversion = true;
+    }
+    if (fromYuv && !toYuv) {
+        // r = 2.0 * (v - 0.5) * (1.0 - wr) + y
+        // b = 2.0 * (u - 0.5) * (1.0 - wb) + y
+        // g = (y - wr * r - wb * b) / wg
+        double rv = 2.0 * (1.0 - wr), bu = 2.0 * (1.0 - wb);
+        const double yuv2rgb[3][4] = {
+            {1.0, 0.0, rv, -0.5 * rv},
+            {1.0, -wb * bu / wg, -wr * rv / wg, 0.5 * (wb * bu + wr * rv) / wg},
+            {1.0, bu, 0.0, -0.5 * bu},
+        };
+        memcpy(m, yuv2rgb, sizeof(m));
+        _modelConversion = true;
+    }
+    for (unsigned int row = 0; row < 3; row++) {
+        for (unsigned int col = 0; col < 4; col++) {
+            _matrix[row][col] = m[row][col];
+        }
+    }
+
+    // Black in the to format, as a fraction of its full range
+    float black[3] = {0.0, 0.0, 0.0};
+    if (toYuv) { black[1] = black[2] = 0.5; }
+    for (unsigned int c = 0; c < 3; c++) {
+        float val = _to[c].low + (_to[c].high - _to[c].low) * black[c];
+        _black[c] = (val - _to[c].min) / (_to[c].max - _to[c].min);
+    }
+
+    // Packing of the to format
+    for (unsigned int c = 0; c < 3; c++) {
+        _shift[c] = toAttrib->c[c].shift;
+        _scale[c] = (1 << toAttrib->c[c].bits) - 1;
+    }
+}
+
+/*
+ * Converts n colors, held one component per array.  n is a multiple of
+ * VEC_LANES.  The arrays are converted in place.
+ */
+void HwcTestColorConverter::convertBlock(float *c1, float *c2, float *c3,
+                                         size_t n) const
+{
+    float *comps[3] = {c1, c2, c3};
+
+    for (size_t i = 0; i < n; i += VEC_LANES) {
+        vecFloat v[3];
+        vecInt outOfGamut = {0};
+
+        // Steps 1 and 2, within the from format
+        for (unsigned int c = 0; c < 3; c++) {
+            const struct componentRange& r = _from[c];
+            vecFloat val = r.min + (r.max - r.min) * loadVec(comps[c] + i);
+            outOfGamut |= (val < r.low) | (val > r.high);
+            v[c] = (val - r.low) / (r.high - r.low);
+        }
+
+        // Step 3
+        if (_modelConversion) {
+            vecFloat t[3];
+            for (unsigned int row = 0; row < 3; row++) {
+                t[row] = _matrix[row][0] * v[0] + _matrix[row][1] * v[1]
+                    + _matrix[row][2] * v[2] + _matrix[row][3];
+                outOfGamut |= (t[row] < 0.0f) | (t[row] > 1.0f);
+            }
+            for (unsigned int c = 0; c < 3; c++) { v[c] = t[c]; }
+        }
+
+        // Step 4, within the to format
+        for (unsigned int c = 0; c < 3; c++) {
+            const struct componentRange& r = _to[c];
+            vecFloat val = r.low + (r.high - r.low) * v[c];
+            vecFloat out = (val - r.min) / (r.max - r.min);
+            vecFloat black = _black[c] + (vecFloat) {0};
+            storeVec(comps[c] + i, selectVec(outOfGamut, black, out));
+        }
+    }
+}
+
+/*
+ * Runs count colors through the conversion a block at a time, passing
+ * each converted block to the given function
+ */
+template <typename Output>
+void HwcTestColorConverter::convertSpan(const ColorFract *in, size_t count,
+                                        Output output) const
+{
+    float c1[blockSize], c2[blockSize], c3[blockSize];
+
+    for (size_t start = 0; start < count; start += blockSize) {
+        size_t n = count - start;
+        if (n > blockSize) { n = blockSize; }
+        size_t padded = (n + VEC_LANES - 1) & ~((size_t) VEC_LANES - 1);
+
+        for (size_t i = 0; i < n; i++) {
+            c1[i] = in[start + i].c1();
+            c2[i] = in[start + i].c2();
+            c3[i] = in[start + i].c3();
+        }
+        for (size_t i = n; i < padded; i++) {
+            c1[i] = c2[i] = c3[i] = 0.0;
+        }
+
+        if (!_identity) { convertBlock(c1, c2, c3, padded); }
+        output(start, n, padded, c1, c2, c3);
+    }
+}
+
+void HwcTestColorConverter::convert(const ColorFract *in, ColorFract *out,
+                                    size_t count) const
+{
+    convertSpan(in, count, [out](size_t start, size_t n, size_t,
+                                 const float *c1, const float *c2,
+                                 const float *c3) {
+        for (size_t i = 0; i < n; i++) {
+            out[start + i] = ColorFract(c1[i], c2[i], c3[i]);
+        }
+    });
+}
+
+void HwcTestColorConverter::convertToPixels(const ColorFract *in,
+    uint32_t *pixels, size_t count, float alpha) const
+{
+    uint32_t alphaBits = hwcTestColor2Pixel(_toFormat,
+                                            ColorFract(0.0, 0.0, 0.0), alpha);
+
+    convertSpan(in, count, [&](size_t start, size_t n, size_t padded,
+                               const float *c1, const float *c2,
+                               const float *c3) {
+        const float *comps[3] = {c1, c2, c3};
+        uint32_t block[blockSize];
+
+        for (size_t i = 0; i < padded; i += VEC_LANES) {
+            vecUint pixel = alphaBits + (vecUint) {0};
+            for (unsigned int c = 0; c < 3; c++) {
+                // Rounded to the nearest code, clamped to the component
+                float maxCode = _scale[c];
+                vecFloat scaled = loadVec(comps[c] + i) * maxCode;
+                scaled = selectVec(scaled < 0.0f, (vecFloat) {0}, scaled);
+                scaled = selectVec(scaled > maxCode,
+                                   maxCode + (vecFloat) {0}, scaled);
+                vecUint code = __builtin_convertvector(scaled + 0.5f, vecUint);
+                pixel |= code << _shift[c];
+            }
+            memcpy(block + i, &pixel, sizeof(pixel));
+        }
+        memcpy(pixels + start, block, n * sizeof(uint32_t));
+    });
+}
+
+// Converts a single color, given as a fraction of the full range of
+// fromFormat, to the full range of toFormat.  The produced color is
+// written over the same parameter used to provide the input color.
+void hwcTestColorConvert(uint32_t fromFormat, uint32_t toFormat,
+                  ColorFract& color)
+{
+    HwcTestColorConverter(fromFormat, toFormat).convert(&color, &color, 1);
+}
@@ -0,0 +1,668 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Hardware Composer Test Library - Reference Compositor
+ *
+ * HwcTestCompositor produces the display contents a hardware composer
+ * is expected to show for a layer list: each layer's source crop is
+ * sampled at the nearest pixel, transformed, scaled into its display
+ * frame and blended, in list order, over opaque black.  It serves as the
+ * golden model for checks of composed output and as a measure of what
+ * composing on the CPU costs.
+ *
+ * The source is flipped horizontally, then vertically, then rotated 90
+ * degrees clockwise, as given by the transform.  The color of a layer
+ * is multiplied by its plane alpha and, for HWC_BLENDING_COVERAGE, by
+ * its pixel alpha, then blended with the premultiplied "over" operator.
+ * HWC_BLENDING_NONE layers replace what is under them.  YUV formats are
+ * converted with BT.709 in the range of the format, clamped to RGB.
+ *
+ * The work is per layer setup, which maps every column and row of the
+ * display frame to byte offsets into the source, followed by tiles of
+ * the display handed out to the threads.  Within a tile a per-format
+ * kernel converts one row of a layer into RGBA8888, and a blend kernel
+ * combines it with the output.  As with the fills, the blend vector
+ * width is chosen at compile time: AVX2, else SSE2, else NEON, else
+ * scalar.  Tiles under an opaque layer that covers them start at that
+ * layer.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "hwcTestLib.h"
+
+using namespace std;
+using namespace android;
+
+// Size of the tiles the display is split into, in pixels
+static const uint32_t tileWidth = 256;
+static const uint32_t tileHeight = 32;
+
+// Below this many pixels the threads aren't worth waking
+static const uint64_t minThreadedPixels = 64 * 1024;
+
+static const uint32_t opaqueBlack = 0xff000000;
+
+// One layer, as set up by compose()
+struct HwcTestCompositor::Layer {
+    typedef void (*RowKernel)(const Layer& layer, uint32_t y, uint32_t x,
+                              uint32_t count, uint32_t *out);
+
+    RowKernel row;
+    const unsigned char *pixels;
+    bool hasAlpha;
+    uint32_t uOffset, vOffset;      // Chroma planes of planar formats
+    uint32_t left, top, right, bottom;  // Display frame, clipped
+    uint32_t planeAlpha;
+    int32_t blending;
+    bool opaque;                    // Replaces what is under it
+
+    // Byte offsets of the source pixel for each column and row of the
+    // clipped frame.  Sums of a column and a row offset give the pixel,
+    // or its chroma for planar formats.
+    vector<uint32_t> colOffset, rowOffset;
+    vector<uint32_t> colChroma, rowChroma;
+};
+
+// Rounded x * y / 255, for x and y from 0 to 255
+static inline uint32_t mul255(uint32_t x, uint32_t y)
+{
+    uint32_t t = x * y + 128;
+
+    return (t + (t >> 8)) >> 8;
+}
+
+// Pixel value of a packed format, loaded through types of the pixel's
+// size, as a copy into a larger value stalls on store forwarding
+template <size_t Bytes>
+static inline uint32_t loadPixel(const unsigned char *src)
+{
+    uint8_t v8;
+    uint16_t v16;
+    uint32_t v32 = 0;
+
+    switch (Bytes) {
+    case 1:
+        memcpy(&v8, src, sizeof(v8));
+        return v8;
+
+    case 2:
+        memcpy(&v16, src, sizeof(v16));
+        return v16;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    case 3:
+        memcpy(&v16, src, sizeof(v16));
+        return v16 | (src[2] << 16);
+#endif
+
+    case 4:
+        memcpy(&v32, src, sizeof(v32));
+        return v32;
+    }
+    memcpy(&v32, src, Bytes);
+
+    return v32;
+}
+
+// Rounded 8-bit expansion of each code of a Bits wide component
+template <int Bits>
+struct composeExpand {
+    struct Table {
+        uint8_t code[1 << Bits];
+
+        constexpr Table() : code() {
+            for (uint32_t n1 = 0; n1 < (1 << Bits); n1++) {
+                code[n1] = (n1 * 255 + (1 << Bits) / 2 - 1)
+                    / ((1 << Bits) - 1);
+            }
+        }
+    };
+
+    static constexpr Table table = Table();
+};
+
+template <int Bits>
+constexpr typename composeExpand<Bits>::Table composeExpand<Bits>::table;
+
+/*
+ * Converts count pixels of one row of a layer, starting at display
+ * column x of display row y, to RGBA8888.  Components are expanded to
+ * 8 bits, and formats without alpha get opaque pixels.
+ */
+template <size_t Index>
+struct composeRowKernel {
+    typedef HwcTestFormat<Index> Format;
+
+    static constexpr const struct hwcTestFormatComponent& comp(int n) {
+        return Format::desc().c[n];
+    }
+
+    // Component of a pixel value, expanded to 8 bits
+    template <int Shift, int Bits>
+    static inline uint32_t expand(uint32_t pixel) {
+        uint32_t code = (pixel >> Shift) & ((1 << Bits) - 1);
+
+        return (Bits == 8) ? code : composeExpand<Bits>::table.code[code];
+    }
+
+    static void run(const HwcTestCompositor::Layer& layer, uint32_t y,
+                    uint32_t x, uint32_t count, uint32_t *out) {
+        if (Format::planar) {
+            runPlanar(layer, y, x, count, out);
+            return;
+        }
+
+        const unsigned char *src = layer.pixels
+            + layer.rowOffset[y - layer.top];
+        const uint32_t *cols = &layer.colOffset[x - layer.left];
+        constexpr const struct hwcTestGraphicFormat& desc = Format::desc();
+        for (uint32_t n1 = 0; n1 < count; n1++) {
+            uint32_t pixel = loadPixel<Format::bytes>(src + cols[n1]);
+
+            uint32_t a = 255;
+            if (desc.a.bits) {
+                a = expand<desc.a.shift, desc.a.bits ? desc.a.bits : 8>(pixel);
+            }
+            out[n1] = expand<comp(0).shift, comp(0).bits>(pixel)
+                | (expand<comp(1).shift, comp(1).bits>(pixel) << 8)
+                | (expand<comp(2).shift, comp(2).bits>(pixel) << 16)
+                | (a << 24);
+        }
+    }
+
+    // Fixed point, 8 fraction bits, YUV to RGB factors for the range of
+    // the format
+    static constexpr int yScale(void) {
+        return (int) (255.0 * 256 / (comp(0).high - comp(0).low) + 0.5);
+    }
+    static constexpr int cScale(double factor) {
+        return (int) (factor * 255.0 * 256 / (comp(1).high - comp(1).low)
+                      + 0.5);
+    }
+    static inline uint32_t clamp8(int value) {
+        value = (value + 128) >> 8;
+        return (value < 0) ? 0 : (value > 255) ? 255 : value;
+    }
+
+    static void runPlanar(const HwcTestCompositor::Layer& layer, uint32_t y,
+                          uint32_t x, uint32_t count, uint32_t *out) {
+        const unsigned char *yRow = layer.pixels
+            + layer.rowOffset[y - layer.top];
+        const unsigned char *uRow = layer.pixels + layer.uOffset
+            + layer.rowChroma[y - layer.top];
+        const unsigned char *vRow = layer.pixels + layer.vOffset
+            + layer.rowChroma[y - layer.top];
+        const uint32_t *cols = &layer.colOffset[x - layer.left];
+        const uint32_t *chromaCols = &layer.colChroma[x - layer.left];
+        constexpr int yLow = comp(0).low;
+        constexpr int cMid = (comp(1).low + comp(1).high) / 2;
+        constexpr int kY = yScale();
+        constexpr int kRV = cScale(1.5748);
+        constexpr int kGU = cScale(0.1873);
+        constexpr int kGV = cScale(0.4681);
+        constexpr int kBU = cScale(1.8556);
+
+        for (uint32_t n1 = 0; n1 < count; n1++) {
+            int luma = (yRow[cols[n1]] - yLow) * kY;
+            int u = uRow[chromaCols[n1]] - cMid;
+            int v = vRow[chromaCols[n1]] - cMid;
+
+            out[n1] = clamp8(luma + kRV * v)
+                | (clamp8(luma - kGU * u - kGV * v) << 8)
+                | (clamp8(luma + kBU * u) << 16)
+                | (opaqueBlack);
+        }
+    }
+};
+
+// Looks up the row kernel of a format
+template <size_t Index>
+struct composeRowLookup {
+    static void run(HwcTestCompositor::Layer::RowKernel& row) {
+        row = composeRowKernel<Index>::run;
+    }
+};
+
+/*
+ * Blends count RGBA8888 pixels of src, as converted by a row kernel,
+ * over dst.  The color of src is first multiplied by the plane alpha,
+ * and for coverage blending by the alpha of src.
+ */
+static void composeBlendScalar(const uint32_t *src, uint32_t *dst,
+                               uint32_t count, uint32_t planeAlpha,
+                               int32_t blending)
+{
+    for (uint32_t n1 = 0; n1 < count; n1++) {
+        uint32_t s = src[n1], d = dst[n1];
+        uint32_t a = (blending == HWC_BLENDING_NONE) ? planeAlpha
+            : mul255(s >> 24, planeAlpha);
+        uint32_t m = (blending == HWC_BLENDING_COVERAGE) ? a : planeAlpha;
+        uint32_t out = 0;
+
+        for (int shift = 0; shift < 32; shift += 8) {
+            uint32_t c = (shift == 24) ? a : mul255((s >> shift) & 0xff, m);
+            c += mul255((d >> shift) & 0xff, 255 - a);
+            out |= min(c, 255u) << shift;
+        }
+        dst[n1] = out;
+    }
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+#if defined(__AVX2__)
+typedef __m256i composeVec;
+static const uint32_t vecPixels = 8;
+#define VEC(op) _mm256_##op
+#define VEC_SI(op) _mm256_##op##_si256
+#define VEC_LOAD(p) _mm256_loadu_si256((const __m256i *) (p))
+#define VEC_STORE(p, v) _mm256_storeu_si256((__m256i *) (p), (v))
+#else
+typedef __m128i composeVec;
+static const uint32_t vecPixels = 4;
+#define VEC(op) _mm_##op
+#define VEC_SI(op) _mm_##op##_si128
+#define VEC_LOAD(p) _mm_loadu_si128((const __m128i *) (p))
+#define VEC_STORE(p, v) _mm_storeu_si128((__m128i *) (p), (v))
+#endif
+
+// Rounded x * y / 255 of 16-bit lanes
+static inline composeVec vecMul255(composeVec x, composeVec y)
+{
+    composeVec t = VEC(add_epi16)(VEC(mullo_epi16)(x, y),
+                                  VEC(set1_epi16)(128));
+
+    return VEC(srli_epi16)(VEC(add_epi16)(t, VEC(srli_epi16)(t, 8)), 8);
+}
+
+// Blends the 16-bit lanes of two pixels
+static inline composeVec vecBlend(composeVec s, composeVec d,
+                                  composeVec planeAlpha, int32_t blending)
+{
+    const composeVec alphaLanes = VEC(set1_epi64x)(0xffff000000000000ll);
+    composeVec a = planeAlpha;
+
+    if (blending != HWC_BLENDING_NONE) {
+        composeVec sa = VEC(shufflehi_epi16)(
+            VEC(shufflelo_epi16)(s, 0xff), 0xff);
+        a = vecMul255(sa, planeAlpha);
+    }
+    composeVec m = (blending == HWC_BLENDING_COVERAGE) ? a : planeAlpha;
+    s = vecMul255(s, m);
+    s = VEC_SI(or)(VEC_SI(andnot)(alphaLanes, s), VEC_SI(and)(alphaLanes, a));
+    d = vecMul255(d, VEC(sub_epi16)(VEC(set1_epi16)(255), a));
+
+    return VEC(add_epi16)(s, d);
+}
+
+static void composeBlend(const uint32_t *src, uint32_t *dst, uint32_t count,
+                         uint32_t planeAlpha, int32_t blending)
+{
+    const composeVec zero = VEC_SI(setzero)();
+    const composeVec pa = VEC(set1_epi16)(planeAlpha);
+    uint32_t n1 = 0;
+
+    for (; n1 + vecPixels <= count; n1 += vecPixels) {
+        composeVec s = VEC_LOAD(src + n1);
+        composeVec d = VEC_LOAD(dst + n1);
+        composeVec lo = vecBlend(VEC(unpacklo_epi8)(s, zero),
+                                 VEC(unpacklo_epi8)(d, zero), pa, blending);
+        composeVec hi = vecBlend(VEC(unpackhi_epi8)(s, zero),
+                                 VEC(unpackhi_epi8)(d, zero), pa, blending);
+        VEC_STORE(dst + n1, VEC(packus_epi16)(lo, hi));
+    }
+    composeBlendScalar(src + n1, dst + n1, count - n1, planeAlpha, blending);
+}
+
+#undef VEC
+#undef VEC_SI
+#undef VEC_LOAD
+#undef VEC_STORE
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+// Rounded x * y / 255 of 8-bit lanes
+static inline uint8x8_t vecMul255(uint8x8_t x, uint8x8_t y)
+{
+    uint16x8_t t = vmull_u8(x, y);
+
+    return vraddhn_u16(t, vrshrq_n_u16(t, 8));
+}
+
+static void composeBlend(const uint32_t *src, uint32_t *dst, uint32_t count,
+                         uint32_t planeAlpha, int32_t blending)
+{
+    const uint8x8_t pa = vdup_n_u8(planeAlpha);
+    const uint8x8_t full = vdup_n_u8(255);
+    uint32_t n1 = 0;
+
+    for (; n1 + 8 <= count; n1 += 8) {
+        uint8x8x4_t s = vld4_u8((const uint8_t *) (src + n1));
+        uint8x8x4_t d = vld4_u8((const uint8_t *) (dst + n1));
+        uint8x8_t a = (blending == HWC_BLENDING_NONE) ? pa
+            : vecMul255(s.val[3], pa);
+        uint8x8_t m = (blending == HWC_BLENDING_COVERAGE) ? a : pa;
+        uint8x8_t under = vsub_u8(full, a);
+
+        for (int n2 = 0; n2 < 3; n2++) {
+            d.val[n2] = vqadd_u8(vecMul255(s.val[n2], m),
+                                 vecMul255(d.val[n2], under));
+        }
+        d.val[3] = vqadd_u8(a, vecMul255(d.val[3], under));
+        vst4_u8((uint8_t *) (dst + n1), d);
+    }
+    composeBlendScalar(src + n1, dst + n1, count - n1, planeAlpha, blending);
+}
+
+#else
+
+static void composeBlend(const uint32_t *src, uint32_t *dst, uint32_t count,
+                         uint32_t planeAlpha, int32_t blending)
+{
+    composeBlendScalar(src, dst, count, planeAlpha, blending);
+}
+
+#endif
+
+// Source coordinate sampled by the center of frame pixel pos, of size
+// frame pixels, reversed when flip is set
+static uint32_t composeSample(int pos, int frame, bool flip, int cropStart,
+                              int cropSize, uint32_t limit)
+{
+    double fract = (pos + 0.5) / frame;
+    if (flip) { fract = 1.0 - fract; }
+    int coord = cropStart + min((int) (fract * cropSize), cropSize - 1);
+
+    return min((uint32_t) max(coord, 0), limit - 1);
+}
+
+// Sets up layer from hwcLayer and its source.  Returns false when
+// nothing of the layer is shown.
+static bool composeSetup(const hwc_layer_1_t& hwcLayer,
+                         const HwcTestComposeSource& source,
+                         uint32_t width, uint32_t height,
+                         HwcTestCompositor::Layer& layer)
+{
+    const hwc_rect_t& frame = hwcLayer.displayFrame;
+    const hwc_rect_t& crop = hwcLayer.sourceCrop;
+    const struct hwcTestGraphicFormat *format
+        = hwcTestGraphicFormatLookup(source.format);
+    if (source.pixels == NULL || format == NULL
+        || source.width == 0 || source.height == 0
+        || crop.right <= crop.left || crop.bottom <= crop.top
+        || frame.right <= frame.left || frame.bottom <= frame.top
+        || hwcLayer.transform > 7) {
+        return false;
+    }
+
+    layer.left = max(frame.left, 0);
+    layer.top = max(frame.top, 0);
+    layer.right = min(frame.right, (int) width);
+    layer.bottom = min(frame.bottom, (int) height);
+    if ((int) layer.left >= (int) layer.right
+        || (int) layer.top >= (int) layer.bottom) {
+        return false;
+    }
+
+    HwcTestFormatDispatch<composeRowLookup>::run(source.format, layer.row);
+    layer.pixels = source.pixels;
+    layer.hasAlpha = format->a.bits != 0;
+    layer.planeAlpha = hwcLayer.planeAlpha;
+    layer.blending = hwcLayer.blending;
+    layer.opaque = layer.planeAlpha == 255
+        && (layer.blending == HWC_BLENDING_NONE || !layer.hasAlpha);
+
+    // Strides in bytes of the planes.  Packed formats are a single plane
+    // with chroma taken from the same pixel.
+    bool planar = (format->flags & HWC_TEST_FORMAT_PLANAR) != 0;
+    struct hwcTestPlaneLayout planes = hwcTestPlanes(*format, source.stride,
+                                                     source.height);
+    uint32_t yStride = planar ? planes.yStride
+        : source.stride * format->bytes;
+    uint32_t xBytes = planar ? 1 : format->bytes;
+    uint32_t hSub = planar ? format->hSub : 1;
+    uint32_t vSub = planar ? format->vSub : 1;
+    layer.uOffset = planes.uOffset;
+    layer.vOffset = planes.vOffset;
+
+    // With a 90 degree rotation the frame columns scan the crop rows,
+    // bottom to top, and the frame rows scan the crop columns
+    const bool rot90 = (hwcLayer.transform & HWC_TRANSFORM_ROT_90) != 0;
+    const bool flipH = (hwcLayer.transform & HWC_TRANSFORM_FLIP_H) != 0;
+    const bool flipV = (hwcLayer.transform & HWC_TRANSFORM_FLIP_V) != 0;
+    const int frameW = frame.right - frame.left;
+    const int frameH = frame.bottom - frame.top;
+    const int cropW = crop.right - crop.left;
+    const int cropH = crop.bottom - crop.top;
+
+    layer.colOffset.resize(layer.right - layer.left);
+    layer.colChroma.resize(layer.right - layer.left);
+    for (uint32_t x = layer.left; x < layer.right; x++) {
+        uint32_t n1 = x - layer.left;
+        int pos = x - frame.left;
+        if (rot90) {
+            uint32_t sy = composeSample(pos, frameW, !flipV, crop.top, cropH,
+                                        source.height);
+            layer.colOffset[n1] = sy * yStride;
+            layer.colChroma[n1] = (sy / vSub) * planes.cStride;
+        } else {
+            uint32_t sx = composeSample(pos, frameW, flipH, crop.left, cropW,
+                                        source.width);
+            layer.colOffset[n1] = sx * xBytes;
+            layer.colChroma[n1] = sx / hSub;
+        }
+    }
+
+    layer.rowOffset.resize(layer.bottom - layer.top);
+    layer.rowChroma.resize(layer.bottom - layer.top);
+    for (uint32_t y = layer.top; y < layer.bottom; y++) {
+        uint32_t n1 = y - layer.top;
+        int pos = y - frame.top;
+        if (rot90) {
+            uint32_t sx = composeSample(pos, frameH, flipH, crop.left, cropW,
+                                        source.width);
+            layer.rowOffset[n1] = sx * xBytes;
+            layer.rowChroma[n1] = sx / hSub;
+        } else {
+            uint32_t sy = composeSample(pos, frameH, flipV, crop.top, cropH,
+                                        source.height);
+            layer.rowOffset[n1] = sy * yStride;
+            layer.rowChroma[n1] = (sy / vSub) * planes.cStride;
+        }
+    }
+
+    return true;
+}
+
+HwcTestCompositor::HwcTestCompositor(unsigned int threads)
+    : _generation(0), _busy(0), _quit(false), _layers(NULL), _dst(NULL),
+      _width(0), _height(0), _stride(0), _tilesX(0), _tiles(0), _nextTile(0)
+{
+    if (threads == 0) {
+        threads = max(thread::hardware_concurrency(), 1u);
+    }
+    for (unsigned int n1 = 1; n1 < threads; n1++) {
+        _workers.push_back(thread(&HwcTestCompositor::workerLoop, this));
+    }
+}
+
+HwcTestCompositor::~HwcTestCompositor()
+{
+    {
+        lock_guard<mutex> lock(_lock);
+        _quit = true;
+    }
+    _start.notify_all();
+    for (size_t n1 = 0; n1 < _workers.size(); n1++) {
+        _workers[n1].join();
+    }
+}
+
+void HwcTestCompositor::workerLoop(void)
+{
+    uint64_t seen = 0;
+
+    for (;;) {
+        {
+            unique_lock<mutex> lock(_lock);
+            _start.wait(lock, [&] { return _quit || _generation != seen; });
+            if (_quit) { return; }
+            seen = _generation;
+        }
+
+        composeTiles();
+
+        lock_guard<mutex> lock(_lock);
+        if (--_busy == 0) { _done.notify_one(); }
+    }
+}
+
+void HwcTestCompositor::composeTiles(void)
+{
+    const vector<Layer>& layers = *_layers;
+    uint32_t scratch[tileWidth];
+
+    for (;;) {
+        uint32_t tile = _nextTile.fetch_add(1, memory_order_relaxed);
+        if (tile >= _tiles) { break; }
+
+        uint32_t left = (tile % _tilesX) * tileWidth;
+        uint32_t top = (tile / _tilesX) * tileHeight;
+        uint32_t right = min(left + tileWidth, _width);
+        uint32_t bottom = min(top + tileHeight, _height);
+
+        // Nothing under the last opaque layer that covers the whole
+        // tile is seen
+        size_t first = layers.size();
+        while (first > 0) {
+            const Layer& layer = layers[first - 1];
+            if (layer.opaque && layer.left <= left && layer.right >= right
+                && layer.top <= top && layer.bottom >= bottom) {
+                break;
+            }
+            first--;
+        }
+        if (first == 0) {
+            for (uint32_t y = top; y < bottom; y++) {
+                uint32_t *row = _dst + (size_t) y * _stride;
+                fill(row + left, row + right, opaqueBlack);
+            }
+        } else {
+            first--;
+        }
+
+        for (size_t n1 = first; n1 < layers.size(); n1++) {
+            const Layer& layer = layers[n1];
+            uint32_t x0 = max(left, layer.left);
+            uint32_t x1 = min(right, layer.right);
+            uint32_t y0 = max(top, layer.top);
+            uint32_t y1 = min(bottom, layer.bottom);
+            if (x0 >= x1 || y0 >= y1) { continue; }
+
+            for (uint32_t y = y0; y < y1; y++) {
+                uint32_t *out = _dst + (size_t) y * _stride + x0;
+                if (layer.opaque) {
+                    layer.row(layer, y, x0, x1 - x0, out);
+                    if (layer.hasAlpha) {
+                        for (uint32_t x = 0; x < x1 - x0; x++) {
+                            out[x] |= opaqueBlack;
+                        }
+                    }
+                    continue;
+                }
+                layer.row(layer, y, x0, x1 - x0, scratch);
+                composeBlend(scratch, out, x1 - x0, layer.planeAlpha,
+                             layer.blending);
+            }
+        }
+    }
+}
+
+size_t HwcTestCompositor::compose(const hwc_display_contents_1_t *list,
+                                  const HwcTestComposeSource *sources,
+                                  uint32_t *dst, uint32_t width,
+                                  uint32_t height, uint32_t stride)
+{
+    vector<Layer> layers;
+
+    for (size_t n1 = 0; n1 < list->numHwLayers; n1++) {
+        const hwc_layer_1_t& hwcLayer = list->hwLayers[n1];
+        if (hwcLayer.compositionType == HWC_FRAMEBUFFER_TARGET) { continue; }
+
+        layers.push_back(Layer());
+        if (!composeSetup(hwcLayer, sources[n1], width, height,
+                          layers.back())) {
+            layers.pop_back();
+        }
+    }
+
+    _layers = &layers;
+    _dst = dst;
+    _width = width;
+    _height = height;
+    _stride = stride;
+    _tilesX = (width + tileWidth - 1) / tileWidth;
+    _tiles = _tilesX * ((height + tileHeight - 1) / tileHeight);
+    _nextTile = 0;
+
+    if (_workers.empty() || (uint64_t) width * height < minThreadedPixels) {
+        composeTiles();
+    } else {
+        {
+            lock_guard<mutex> lock(_lock);
+            _busy = _workers.size();
+            _generation++;
+        }
+        _start.notify_all();
+        composeTiles();
+
+        unique_lock<mutex> lock(_lock);
+        _done.wait(lock, [&] { return _busy == 0; });
+    }
+    _layers = NULL;
+
+    return layers.size();
+}
+
+// Source of a layer showing gBuf, whose pixels are mapped at pixels
+HwcTestComposeSource hwcTestComposeSource(GLTestBuffer *gBuf,
+                                          const void *pixels)
+{
+    HwcTestComposeSource source;
+
+    source.pixels = static_cast<const unsigned char *>(pixels);
+    source.width = gBuf->getWidth();
+    source.height = gBuf->getHeight();
+    source.stride = gBuf->getStride();
+    source.format = gBuf->getPixelFormat();
+
+    return source;
+}
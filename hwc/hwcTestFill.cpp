@@ -0,0 +1,466 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Hardware Composer Test Library - Buffer Fills
+ *
+ * Format lookups, pixel packing and the CPU fills of graphic buffers.
+ * Nothing here needs a display or the composer, so the same code also
+ * builds for hosts, where GLTestBuffer stands in for GraphicBuffer.
+ *
+ * The span kernels write runs of a single pixel value along one row of
+ * a buffer.  The vector width is chosen at compile time: AVX2, else
+ * SSE2, else NEON, else a 64-bit scalar pattern.  All stores are
+ * unaligned, as the graphic buffer rows are only guaranteed to be pixel
+ * aligned.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "hwcTestLib.h"
+
+using namespace std;
+using namespace android;
+
+// Bytes written by one vector store
+#if defined(__AVX2__)
+static const size_t vecBytes = 32;
+#elif defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+static const size_t vecBytes = 16;
+#else
+static const size_t vecBytes = 8;
+#endif
+
+/*
+ * Repeats the pattern in the first 3 * vecBytes bytes of pattern, which
+ * is a whole number of pixels of any size up to 4 bytes, over the given
+ * number of bytes.  Three vectors are a whole number of 24-bit pixels,
+ * so one loop covers every packed format.
+ */
+static void storePattern(unsigned char *dst, const unsigned char *pattern,
+                         size_t bytes)
+{
+    const size_t chunk = 3 * vecBytes;
+    unsigned char *end = dst + (bytes - bytes % chunk);
+
+#if defined(__AVX2__)
+    __m256i v0 = _mm256_loadu_si256((const __m256i *) pattern);
+    __m256i v1 = _mm256_loadu_si256((const __m256i *) (pattern + 32));
+    __m256i v2 = _mm256_loadu_si256((const __m256i *) (pattern + 64));
+    for (; dst < end; dst += chunk) {
+        _mm256_storeu_si256((__m256i *) dst, v0);
+        _mm256_storeu_si256((__m256i *) (dst + 32), v1);
+        _mm256_storeu_si256((__m256i *) (dst + 64), v2);
+    }
+#elif defined(__SSE2__)
+    __m128i v0 = _mm_loadu_si128((const __m128i *) pattern);
+    __m128i v1 = _mm_loadu_si128((const __m128i *) (pattern + 16));
+    __m128i v2 = _mm_loadu_si128((const __m128i *) (pattern + 32));
+    for (; dst < end; dst += chunk) {
+        _mm_storeu_si128((__m128i *) dst, v0);
+        _mm_storeu_si128((__m128i *) (dst + 16), v1);
+        _mm_storeu_si128((__m128i *) (dst + 32), v2);
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint8x16x3_t v;
+    v.val[0] = vld1q_u8(pattern);
+    v.val[1] = vld1q_u8(pattern + 16);
+    v.val[2] = vld1q_u8(pattern + 32);
+    for (; dst < end; dst += chunk) {
+        vst1q_u8(dst, v.val[0]);
+        vst1q_u8(dst + 16, v.val[1]);
+        vst1q_u8(dst + 32, v.val[2]);
+    }
+#else
+    uint64_t v0, v1, v2;
+    memcpy(&v0, pattern, sizeof(v0));
+    memcpy(&v1, pattern + 8, sizeof(v1));
+    memcpy(&v2, pattern + 16, sizeof(v2));
+    for (; dst < end; dst += chunk) {
+        memcpy(dst, &v0, sizeof(v0));
+        memcpy(dst + 8, &v1, sizeof(v1));
+        memcpy(dst + 16, &v2, sizeof(v2));
+    }
+#endif
+
+    // Partial chunk.  It starts on a chunk boundary, so the pattern
+    // still lines up.
+    memcpy(dst, pattern, bytes % chunk);
+}
+
+// Fills count pixels of the given size with pixel, which holds the
+// pixel bytes in host memory order as from hwcTestColor2Pixel()
+void hwcTestFillSpan(unsigned char *dst, size_t bytesPerPixel,
+                     uint32_t pixel, size_t count)
+{
+    unsigned char bytes[sizeof(pixel)];
+    memcpy(bytes, &pixel, sizeof(bytes));
+
+    // Spans of a repeated byte, such as black, white and the YV12
+    // planes, are left to memset
+    bool uniform = true;
+    for (size_t n = 1; n < bytesPerPixel; n++) {
+        if (bytes[n] != bytes[0]) { uniform = false; }
+    }
+    if (uniform) {
+        memset(dst, bytes[0], bytesPerPixel * count);
+        return;
+    }
+
+    // Short spans aren't worth building the pattern for
+    if (count * bytesPerPixel < 3 * vecBytes) {
+        for (size_t n = 0; n < count; n++) {
+            memcpy(dst + n * bytesPerPixel, bytes, bytesPerPixel);
+        }
+        return;
+    }
+
+    unsigned char pattern[3 * vecBytes];
+    for (size_t n = 0; n < sizeof(pattern); n++) {
+        pattern[n] = bytes[n % bytesPerPixel];
+    }
+    storePattern(dst, pattern, count * bytesPerPixel);
+}
+
+// Look up and return pointer to structure with the characteristics
+// of the graphic format named by the desc parameter.  Search failure
+// indicated by the return of NULL.
+const struct hwcTestGraphicFormat *hwcTestGraphicFormatLookup(const char *desc)
+{
+    for (unsigned int n1 = 0; n1 < hwcTestGraphicFormatCount; n1++) {
+        if (string(desc) == string(hwcTestGraphicFormat[n1].desc)) {
+            return &hwcTestGraphicFormat[n1];
+        }
+    }
+
+    return NULL;
+}
+
+// Look up and return pointer to structure with the characteristics
+// of the graphic format specified by the id parameter.  Search failure
+// indicated by the return of NULL.
+const struct hwcTestGraphicFormat *hwcTestGraphicFormatLookup(uint32_t id)
+{
+    for (unsigned int n1 = 0; n1 < hwcTestGraphicFormatCount; n1++) {
+        if (id == hwcTestGraphicFormat[n1].format) {
+            return &hwcTestGraphicFormat[n1];
+        }
+    }
+
+    return NULL;
+}
+
+// Given the integer ID of a graphic format, return a pointer to
+// a string that describes the format.
+const char *hwcTestGraphicFormat2str(uint32_t format)
+{
+    const static char *unknown = "unknown";
+
+    for (unsigned int n1 = 0; n1 < hwcTestGraphicFormatCount; n1++) {
+        if (format == hwcTestGraphicFormat[n1].format) {
+            return hwcTestGraphicFormat[n1].desc;
+        }
+    }
+
+    return unknown;
+}
+
+// Returns a uint32_t that contains a format specific representation of a
+// single pixel of the given color and alpha values.
+template <size_t Index>
+struct color2PixelKernel {
+    static void run(const ColorFract& color, float alpha, uint32_t& pixel) {
+        pixel = HwcTestFormat<Index>::pack(color.c1(), color.c2(), color.c3(),
+                                           alpha);
+    }
+};
+
+uint32_t hwcTestColor2Pixel(uint32_t format, ColorFract color, float alpha)
+{
+    uint32_t pixel = 0;
+
+    if (!HwcTestFormatDispatch<color2PixelKernel>::run(format, color, alpha,
+                                                       pixel)) {
+        testPrintE("colorFract2Pixel unsupported format of: %u", format);
+        exit(80);
+    }
+
+    return pixel;
+}
+
+// Returns the color and alpha held by a format specific representation of
+// a single pixel, the reverse of hwcTestColor2Pixel().  Alpha is 1.0 for
+// formats without it.
+template <size_t Index>
+struct pixel2ColorKernel {
+    static void run(uint32_t pixel, ColorFract& color, float& alpha) {
+        float c1, c2, c3;
+        HwcTestFormat<Index>::unpack(pixel, &c1, &c2, &c3, &alpha);
+        color = ColorFract(c1, c2, c3);
+    }
+};
+
+ColorFract hwcTestPixel2Color(uint32_t format, uint32_t pixel, float& alpha)
+{
+    ColorFract color;
+
+    if (!HwcTestFormatDispatch<pixel2ColorKernel>::run(format, pixel, color,
+                                                       alpha)) {
+        testPrintE("hwcTestPixel2Color unsupported format of: %u", format);
+        exit(81);
+    }
+
+    return color;
+}
+
+// Sets the pixel at the given x and y coordinates to the color and alpha
+// value given by pixel.  The contents of pixel is format specific.  It's
+// value should come from a call to hwcTestColor2Pixel().
+template <size_t Index>
+struct setPixelKernel {
+    static void run(GLTestBuffer *gBuf, unsigned char *buf, uint32_t x,
+                    uint32_t y, uint32_t pixel) {
+        typedef HwcTestFormat<Index> Format;
+
+        if (Format::planar) {
+            struct hwcTestPlaneLayout layout = hwcTestPlanes(Format::desc(),
+                gBuf->getStride(), gBuf->getHeight());
+            uint32_t cOffset = (y / Format::desc().vSub) * layout.cStride
+                + (x / Format::desc().hSub);
+            buf[y * layout.yStride + x] = pixel & 0xff;
+            buf[layout.uOffset + cOffset] = (pixel & 0xff00) >> 8;
+            buf[layout.vOffset + cOffset] = (pixel & 0xff0000) >> 16;
+            return;
+        }
+
+        memcpy(buf + (gBuf->getStride() * y + x) * Format::bytes, &pixel,
+               Format::bytes);
+    }
+};
+
+void hwcTestSetPixel(GLTestBuffer *gBuf, unsigned char *buf,
+              uint32_t x, uint32_t y, uint32_t pixel)
+{
+    if (!HwcTestFormatDispatch<setPixelKernel>::run(gBuf->getPixelFormat(),
+                                                    gBuf, buf, x, y, pixel)) {
+        testPrintE("setPixel unsupported format of: %u",
+                   gBuf->getPixelFormat());
+        exit(90);
+    }
+}
+
+// Fills the locked buffer of gBuf with pixel, a row at a time through the
+// span fill kernels.  The pad between the width and stride of each row
+// then gets random values, one per pixel, a column at a time, so they
+// are drawn in the same order as by a fill through hwcTestSetPixel().
+// They come from padRand, or from testRand() when it is NULL.
+template <size_t Index>
+struct fillColorKernel {
+    static void run(GLTestBuffer *gBuf, unsigned char *buf, uint32_t pixel,
+                    HwcTestRand *padRand) {
+        typedef HwcTestFormat<Index> Format;
+        const uint32_t width = gBuf->getWidth();
+        const uint32_t height = gBuf->getHeight();
+        const uint32_t stride = gBuf->getStride();
+
+        if (Format::planar) {
+            const uint32_t hSub = Format::desc().hSub;
+            const uint32_t vSub = Format::desc().vSub;
+            struct hwcTestPlaneLayout layout = hwcTestPlanes(Format::desc(),
+                stride, height);
+            for (uint32_t y = 0; y < height; y++) {
+                unsigned char *yRow = buf + y * layout.yStride;
+                unsigned char *uRow = buf + layout.uOffset
+                    + (y / vSub) * layout.cStride;
+                unsigned char *vRow = buf + layout.vOffset
+                    + (y / vSub) * layout.cStride;
+
+                hwcTestFillSpan(yRow, 1, pixel & 0xff, width);
+                if ((y % vSub) == 0) {
+                    hwcTestFillSpan(uRow, 1, (pixel & 0xff00) >> 8,
+                                    width / hSub);
+                    hwcTestFillSpan(vRow, 1, (pixel & 0xff0000) >> 16,
+                                    width / hSub);
+                }
+            }
+        } else {
+            for (uint32_t y = 0; y < height; y++) {
+                hwcTestFillSpan(buf + y * stride * Format::bytes,
+                                Format::bytes, pixel, width);
+            }
+        }
+
+        for (uint32_t x = width; x < stride; x++) {
+            for (uint32_t y = 0; y < height; y++) {
+                uint32_t pad = (padRand != NULL) ? padRand->next()
+                    : testRand();
+                setPixelKernel<Index>::run(gBuf, buf, x, y, pad);
+            }
+        }
+    }
+};
+
+// Fill a given graphic buffer with a uniform color and alpha.  Threads
+// other than the one drawing from testRand() give padRand.
+void hwcTestFillColor(GLTestBuffer *gBuf, ColorFract color, float alpha,
+                      HwcTestRand *padRand)
+{
+    unsigned char* buf = NULL;
+    status_t err;
+    uint32_t pixel;
+
+    pixel = hwcTestColor2Pixel(gBuf->getPixelFormat(), color, alpha);
+
+    err = gBuf->lock(GLTestBuffer::USAGE_SW_WRITE_OFTEN, (void**)(&buf));
+    if (err != 0) {
+        testPrintE("hwcTestFillColor lock failed: %d", err);
+        exit(100);
+    }
+
+    if (!HwcTestFormatDispatch<fillColorKernel>::run(gBuf->getPixelFormat(),
+                                                     gBuf, buf, pixel,
+                                                     padRand)) {
+        testPrintE("hwcTestFillColor unsupported format of: %u",
+                   gBuf->getPixelFormat());
+        exit(102);
+    }
+
+    err = gBuf->unlock();
+    if (err != 0) {
+        testPrintE("hwcTestFillColor unlock failed: %d", err);
+        exit(101);
+    }
+}
+
+// Copies one row of pixels, pad included, to every row of the locked
+// buffer of gBuf.  Each chroma sample of a planar format takes the value
+// of the last pixel that covers it, as with hwcTestSetPixel().
+template <size_t Index>
+struct fillRowsKernel {
+    static void run(GLTestBuffer *gBuf, unsigned char *buf,
+                    const vector<uint32_t>& pixels) {
+        typedef HwcTestFormat<Index> Format;
+        const uint32_t height = gBuf->getHeight();
+        const uint32_t stride = gBuf->getStride();
+
+        if (Format::planar) {
+            const uint32_t hSub = Format::desc().hSub;
+            const uint32_t vSub = Format::desc().vSub;
+            struct hwcTestPlaneLayout layout = hwcTestPlanes(Format::desc(),
+                stride, height);
+            const uint32_t cWidth = (stride + hSub - 1) / hSub;
+            vector<unsigned char> yRow(stride), uRow(cWidth), vRow(cWidth);
+            for (uint32_t x = 0; x < stride; x++) {
+                yRow[x] = pixels[x] & 0xff;
+                uRow[x / hSub] = (pixels[x] & 0xff00) >> 8;
+                vRow[x / hSub] = (pixels[x] & 0xff0000) >> 16;
+            }
+
+            for (uint32_t y = 0; y < height; y++) {
+                memcpy(buf + y * layout.yStride, &yRow[0], stride);
+            }
+            for (uint32_t y = 0; y < (height + vSub - 1) / vSub; y++) {
+                memcpy(buf + layout.uOffset + y * layout.cStride, &uRow[0],
+                       cWidth);
+                memcpy(buf + layout.vOffset + y * layout.cStride, &vRow[0],
+                       cWidth);
+            }
+            return;
+        }
+
+        unsigned char *row = buf;
+        for (uint32_t x = 0; x < stride; x++) {
+            memcpy(row + x * Format::bytes, &pixels[x], Format::bytes);
+        }
+        for (uint32_t y = 1; y < height; y++) {
+            memcpy(buf + y * stride * Format::bytes, row,
+                   stride * Format::bytes);
+        }
+    }
+};
+
+// Fill the given buffer with a horizontal blend of colors, with the left
+// side color given by startColor and the right side color given by
+// endColor.  The startColor and endColor values are specified in the format
+// given by colorFormat, which might be different from the format of the
+// graphic buffer.  When different, a color conversion is done when possible
+// to the graphic format of the graphic buffer.  A color of black is
+// produced for cases where the conversion is impossible (e.g. out of gamut
+// values).
+//
+// Every row is the same, so the first row is computed, pad included,
+// and then copied to the rest of the buffer.
+void hwcTestFillColorHBlend(GLTestBuffer *gBuf, uint32_t colorFormat,
+                            ColorFract startColor, ColorFract endColor)
+{
+    status_t err;
+    unsigned char* buf = NULL;
+    const uint32_t format = gBuf->getPixelFormat();
+    const uint32_t width = gBuf->getWidth();
+    const uint32_t stride = gBuf->getStride();
+
+    // One row of pixels, in the buffer format.  The converter leaves the
+    // colors alone when the formats are the same, so that out of gamut
+    // colors given in the buffer format aren't turned black.
+    vector<ColorFract> colors(width);
+    for (unsigned int x = 0; x < width; x++) {
+        float fract = (width > 1) ? (float) x / (float) (width - 1) : 0.0;
+        colors[x] = ColorFract(
+            startColor.c1() + (endColor.c1() - startColor.c1()) * fract,
+            startColor.c2() + (endColor.c2() - startColor.c2()) * fract,
+            startColor.c3() + (endColor.c3() - startColor.c3()) * fract);
+    }
+    vector<uint32_t> pixels(stride);
+    HwcTestColorConverter converter(colorFormat, format);
+    converter.convertToPixels(colors.data(), pixels.data(), width);
+
+    // Fill pad with random values
+    for (unsigned int x = width; x < stride; x++) {
+        pixels[x] = testRand();
+    }
+
+    err = gBuf->lock(GLTestBuffer::USAGE_SW_WRITE_OFTEN, (void**)(&buf));
+    if (err != 0) {
+        testPrintE("hwcTestFillColorHBlend lock failed: %d", err);
+        exit(110);
+    }
+
+    if (!HwcTestFormatDispatch<fillRowsKernel>::run(format, gBuf, buf,
+                                                    pixels)) {
+        testPrintE("hwcTestFillColorHBlend unsupported format of: %u",
+                   format);
+        exit(112);
+    }
+
+    err = gBuf->unlock();
+    if (err != 0) {
+        testPrintE("hwcTestFillColorHBlend unlock failed: %d", err);
+        exit(111);
+    }
+}
@@ -20,35 +20,59 @@
  * Utility library functions for use by the Hardware Composer test cases
  */
 
-#include <arpa/inet.h> // For ntohl() and htonl()
+#include <stdlib.h>
+#include <string.h>
 
+#include <algorithm>
 #include <cmath>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "hwcTestLib.h"
 
+#ifdef __ANDROID__
 #include "EGLUtils.h"
+#endif
 
 // Defines
 #define NUMA(a) (sizeof(a) / sizeof((a)[0]))
 
 // Function Prototypes
+#ifdef __ANDROID__
 static void printGLString(const char *name, GLenum s);
 static void checkEglError(const char* op, EGLBoolean returnVal = EGL_TRUE);
 static void printEGLConfiguration(EGLDisplay dpy, EGLConfig config);
+#endif
 
 using namespace std;
 using namespace android;
 
 
-#define BITSPERBYTE            8 // TODO: Obtain from <values.h>, once
-                                 // it has been added
-
 // Initialize Display
+//
+// With the mock hardware composer nothing is drawn with GL, so there is
+// no display or surface and the size is the one of the mock's model.
+// Hosts only have the mock.
 void hwcTestInitDisplay(bool verbose, EGLDisplay *dpy, EGLSurface *surface,
     EGLint *width, EGLint *height)
 {
+    if (hwcTestMockActive()) {
+        const HwcTestMockModel& model = hwcTestMockEnvModel();
+        *dpy = EGL_NO_DISPLAY;
+        *surface = EGL_NO_SURFACE;
+        *width = model.display.width();
+        *height = model.display.height();
+        if (verbose) {
+            testPrintI("Mock display dimensions: %d x %d", *width, *height);
+        }
+        return;
+    }
+
+#ifndef __ANDROID__
+    testPrintE("hwcTestInitDisplay: hosts need GLTEST_HWC_MOCK");
+    exit(79);
+#else
     static EGLContext context;
 
     EGLBoolean returnValue;
@@ -133,11 +157,35 @@ void hwcTestInitDisplay(bool verbose, EGLDisplay *dpy, EGLSurface *surface,
         printGLString("Renderer", GL_RENDERER);
         printGLString("Extensions", GL_EXTENSIONS);
     }
+#endif
+}
+
+static hwc_composer_device_1_t *mockDevice;
+
+static void mockReport(void)
+{
+    hwcTestMockReport(mockDevice);
 }
 
 // Open Hardware Composer Device
+//
+// Opens the mock hardware composer instead when GLTEST_HWC_MOCK is set,
+// and reports what the mock did when the test exits.
 void hwcTestOpenHwc(hwc_composer_device_1_t **hwcDevicePtr)
 {
+    if (hwcTestMockActive()) {
+        *hwcDevicePtr = hwcTestMockOpen(hwcTestMockEnvModel());
+        if (mockDevice == NULL) {
+            atexit(mockReport);
+        }
+        mockDevice = *hwcDevicePtr;
+        return;
+    }
+
+#ifndef __ANDROID__
+    testPrintE("hwcTestOpenHwc: hosts need GLTEST_HWC_MOCK");
+    exit(79);
+#else
     int rv;
     hw_module_t const *hwcModule;
 
@@ -153,6 +201,7 @@ void hwcTestOpenHwc(hwc_composer_device_1_t **hwcDevicePtr)
         perror(NULL);
         exit(78);
     }
+#endif
 }
 
 // Color fraction class to string conversion
@@ -191,6 +240,45 @@ HwcTestDim::operator hwc_rect() const
     return rect;
 }
 
+HwcTestRand::HwcTestRand(uint32_t seed, uint32_t id0, uint32_t id1,
+                         uint32_t stream)
+    : _used(NUMA(_out))
+{
+    _key[0] = seed;
+    _key[1] = 0x68776353;   // "hwcS"
+    _ctr[0] = id0;
+    _ctr[1] = id1;
+    _ctr[2] = 0;
+    _ctr[3] = stream;
+}
+
+// Next random number, from the next block of four once the last one is
+// used up
+uint32_t HwcTestRand::next(void)
+{
+    if (_used == NUMA(_out)) {
+        uint32_t k0 = _key[0], k1 = _key[1];
+
+        for (unsigned int n1 = 0; n1 < NUMA(_out); n1++) {
+            _out[n1] = _ctr[n1];
+        }
+        for (unsigned int round = 0; round < 10; round++) {
+            uint64_t p0 = (uint64_t) 0xD2511F53 * _out[0];
+            uint64_t p1 = (uint64_t) 0xCD9E8D57 * _out[2];
+            _out[0] = (uint32_t) (p1 >> 32) ^ _out[1] ^ k0;
+            _out[1] = (uint32_t) p1;
+            _out[2] = (uint32_t) (p0 >> 32) ^ _out[3] ^ k1;
+            _out[3] = (uint32_t) p0;
+            k0 += 0x9E3779B9;
+            k1 += 0xBB67AE85;
+        }
+        _ctr[2]++;
+        _used = 0;
+    }
+
+    return _out[_used++];
+}
+
 // Hardware Composer rectangle to string conversion
 string hwcTestRect2str(const struct hwc_rect& rect)
 {
@@ -352,55 +440,26 @@ ColorFract hwcTestParseColor(istringstream& in, bool& error)
     return ColorFract(c1, c2, c3);
 }
 
-// Look up and return pointer to structure with the characteristics
-// of the graphic format named by the desc parameter.  Search failure
-// indicated by the return of NULL.
-const struct hwcTestGraphicFormat *hwcTestGraphicFormatLookup(const char *desc)
-{
-    for (unsigned int n1 = 0; n1 < NUMA(hwcTestGraphicFormat); n1++) {
-        if (string(desc) == string(hwcTestGraphicFormat[n1].desc)) {
-            return &hwcTestGraphicFormat[n1];
-        }
-    }
-
-    return NULL;
-}
-
-// Look up and return pointer to structure with the characteristics
-// of the graphic format specified by the id parameter.  Search failure
-// indicated by the return of NULL.
-const struct hwcTestGraphicFormat *hwcTestGraphicFormatLookup(uint32_t id)
-{
-    for (unsigned int n1 = 0; n1 < NUMA(hwcTestGraphicFormat); n1++) {
-        if (id == hwcTestGraphicFormat[n1].format) {
-            return &hwcTestGraphicFormat[n1];
-        }
-    }
-
-    return NULL;
-}
-
-
-// Given the integer ID of a graphic format, return a pointer to
-// a string that describes the format.
-const char *hwcTestGraphicFormat2str(uint32_t format)
-{
-    const static char *unknown = "unknown";
-
-    for (unsigned int n1 = 0; n1 < NUMA(hwcTestGraphicFormat); n1++) {
-        if (format == hwcTestGraphicFormat[n1].format) {
-            return hwcTestGraphicFormat[n1].desc;
-        }
-    }
-
-    return unknown;
-}
-
 /*
  * hwcTestCreateLayerList
  * Dynamically creates layer list with numLayers worth
  * of hwLayers entries.
  */
+// Sets up a zeroed list of numLayers layers
+static void layerListInit(hwc_display_contents_1_t *list, size_t numLayers)
+{
+    list->retireFenceFd = -1;
+    list->flags = HWC_GEOMETRY_CHANGED;
+    list->numHwLayers = numLayers;
+
+    // No fences, and layers fully shown unless the caller says otherwise
+    for (size_t n1 = 0; n1 < numLayers; n1++) {
+        list->hwLayers[n1].acquireFenceFd = -1;
+        list->hwLayers[n1].releaseFenceFd = -1;
+        list->hwLayers[n1].planeAlpha = 255;
+    }
+}
+
 hwc_display_contents_1_t *hwcTestCreateLayerList(size_t numLayers)
 {
     hwc_display_contents_1_t *list;
@@ -409,8 +468,7 @@ hwc_display_contents_1_t *hwcTestCreateLayerList(size_t numLayers)
     if ((list = (hwc_display_contents_1_t *) calloc(1, size)) == NULL) {
         return NULL;
     }
-    list->flags = HWC_GEOMETRY_CHANGED;
-    list->numHwLayers = numLayers;
+    layerListInit(list, numLayers);
 
     return list;
 }
@@ -424,6 +482,86 @@ void hwcTestFreeLayerList(hwc_display_contents_1_t *list)
     free(list);
 }
 
+// Alignment of everything handed out by a HwcTestLayerArena
+static const size_t arenaAlign = 16;
+
+HwcTestLayerArena::HwcTestLayerArena()
+    : _block(NULL), _size(0), _used(0), _highWater(0)
+{
+}
+
+HwcTestLayerArena::~HwcTestLayerArena()
+{
+    for (size_t n1 = 0; n1 < _overflow.size(); n1++) {
+        free(_overflow[n1]);
+    }
+    free(_block);
+}
+
+void *HwcTestLayerArena::alloc(size_t bytes)
+{
+    bytes = (bytes + arenaAlign - 1) & ~(arenaAlign - 1);
+
+    // Once the block is full, the rest of the frame is from the heap
+    void *ptr;
+    if (_used + bytes <= _size) {
+        ptr = _block + _used;
+    } else {
+        if ((ptr = malloc(bytes)) == NULL) { return NULL; }
+        _overflow.push_back(ptr);
+    }
+    _used += bytes;
+    _highWater = std::max(_highWater, _used);
+
+    return ptr;
+}
+
+hwc_display_contents_1_t *HwcTestLayerArena::list(size_t numLayers,
+                                                  size_t rectsPerLayer)
+{
+    size_t listBytes = sizeof(hwc_display_contents_1_t)
+        + numLayers * sizeof(hwc_layer_1_t);
+    listBytes = (listBytes + arenaAlign - 1) & ~(arenaAlign - 1);
+    size_t rectBytes = numLayers * rectsPerLayer * sizeof(hwc_rect_t);
+
+    unsigned char *mem = (unsigned char *) alloc(listBytes + rectBytes);
+    if (mem == NULL) { return NULL; }
+    memset(mem, 0, listBytes + rectBytes);
+
+    hwc_display_contents_1_t *list = (hwc_display_contents_1_t *) mem;
+    layerListInit(list, numLayers);
+    if (rectsPerLayer) {
+        hwc_rect_t *rects = (hwc_rect_t *) (mem + listBytes);
+        for (size_t n1 = 0; n1 < numLayers; n1++) {
+            list->hwLayers[n1].visibleRegionScreen.numRects = rectsPerLayer;
+            list->hwLayers[n1].visibleRegionScreen.rects
+                = rects + n1 * rectsPerLayer;
+        }
+    }
+
+    return list;
+}
+
+void HwcTestLayerArena::reset(void)
+{
+    // Nothing is handed out at this point, so the block can be replaced
+    // by one that holds the largest frame so far
+    if (!_overflow.empty()) {
+        for (size_t n1 = 0; n1 < _overflow.size(); n1++) {
+            free(_overflow[n1]);
+        }
+        _overflow.clear();
+
+        unsigned char *block = (unsigned char *) malloc(_highWater);
+        if (block != NULL) {
+            free(_block);
+            _block = block;
+            _size = _highWater;
+        }
+    }
+    _used = 0;
+}
+
 // Display the settings of the layer list pointed to by list
 void hwcTestDisplayList(hwc_display_contents_1_t *list)
 {
@@ -540,402 +678,7 @@ void hwcTestDisplayListHandles(hwc_display_contents_1_t *list)
     testPrintI("%s", str.str().c_str());
 }
 
-// Returns a uint32_t that contains a format specific representation of a
-// single pixel of the given color and alpha values.
-uint32_t hwcTestColor2Pixel(uint32_t format, ColorFract color, float alpha)
-{
-    const struct attrib {
-        uint32_t format;
-        bool   hostByteOrder;
-        size_t bytes;
-        size_t c1Offset;
-        size_t c1Size;
-        size_t c2Offset;
-        size_t c2Size;
-        size_t c3Offset;
-        size_t c3Size;
-        size_t aOffset;
-        size_t aSize;
-    } attributes[] = {
-        {HAL_PIXEL_FORMAT_RGBA_8888, false, 4,  0, 8,  8, 8, 16, 8, 24, 8},
-        {HAL_PIXEL_FORMAT_RGBX_8888, false, 4,  0, 8,  8, 8, 16, 8,  0, 0},
-        {HAL_PIXEL_FORMAT_RGB_888,   false, 3,  0, 8,  8, 8, 16, 8,  0, 0},
-        {HAL_PIXEL_FORMAT_RGB_565,   true,  2,  0, 5,  5, 6, 11, 5,  0, 0},
-        {HAL_PIXEL_FORMAT_BGRA_8888, false, 4, 16, 8,  8, 8,  0, 8, 24, 8},
-        {HAL_PIXEL_FORMAT_YV12,      true,  3, 16, 8,  8, 8,  0, 8,  0, 0},  
-    };
-
-    const struct attrib *attrib;
-    for (attrib = attributes; attrib < attributes + NUMA(attributes);
-         attrib++) {
-        if (attrib->format == format) { break; }
-    }
-    if (attrib >= attributes + NUMA(attributes)) {
-        testPrintE("colorFract2Pixel unsupported format of: %u", format);
-        exit(80);
-    }
-
-    uint32_t pixel;
-    pixel = htonl((uint32_t) round((((1 << attrib->c1Size) - 1) * color.c1()))
-         << ((sizeof(pixel) * BITSPERBYTE)
-             - (attrib->c1Offset + attrib->c1Size)));
-    pixel |= htonl((uint32_t) round((((1 << attrib->c2Size) - 1) * color.c2()))
-         << ((sizeof(pixel) * BITSPERBYTE)
-             - (attrib->c2Offset + attrib->c2Size)));
-    pixel |= htonl((uint32_t) round((((1 << attrib->c3Size) - 1) * color.c3()))
-         << ((sizeof(pixel) * BITSPERBYTE)
-             - (attrib->c3Offset + attrib->c3Size)));
-    if (attrib->aSize) {
-        pixel |= htonl((uint32_t) round((((1 << attrib->aSize) - 1) * alpha))
-             << ((sizeof(pixel) * BITSPERBYTE)
-                 - (attrib->aOffset + attrib->aSize)));
-    }
-    if (attrib->hostByteOrder) {
-        pixel = ntohl(pixel);
-        pixel >>= sizeof(pixel) * BITSPERBYTE - attrib->bytes * BITSPERBYTE;
-    }
-
-    return pixel;
-}
-
-// Sets the pixel at the given x and y coordinates to the color and alpha
-// value given by pixel.  The contents of pixel is format specific.  It's
-// value should come from a call to hwcTestColor2Pixel().
-void hwcTestSetPixel(GraphicBuffer *gBuf, unsigned char *buf,
-              uint32_t x, uint32_t y, uint32_t pixel)
-{
-
-    const struct attrib {
-        int format;
-        size_t bytes;
-    } attributes[] = {
-        {HAL_PIXEL_FORMAT_RGBA_8888,  4},
-        {HAL_PIXEL_FORMAT_RGBX_8888,  4},
-        {HAL_PIXEL_FORMAT_RGB_888,    3},
-        {HAL_PIXEL_FORMAT_RGB_565,    2},
-        {HAL_PIXEL_FORMAT_BGRA_8888,  4},
-    };
-
-    if (gBuf->getPixelFormat() == HAL_PIXEL_FORMAT_YV12) {
-        uint32_t yPlaneOffset, uPlaneOffset, vPlaneOffset;
-        uint32_t yPlaneStride = gBuf->getStride();
-        uint32_t uPlaneStride = ((gBuf->getStride() / 2) + 0xf) & ~0xf;
-        uint32_t vPlaneStride = uPlaneStride;
-        yPlaneOffset = 0;
-        vPlaneOffset = yPlaneOffset + yPlaneStride * gBuf->getHeight();
-        uPlaneOffset = vPlaneOffset
-                       + vPlaneStride * (gBuf->getHeight() / 2);
-        *(buf + yPlaneOffset + y * yPlaneStride + x) = pixel & 0xff;
-        *(buf + uPlaneOffset + (y / 2) * uPlaneStride + (x / 2))
-            = (pixel & 0xff00) >> 8;
-        *(buf + vPlaneOffset + (y / 2) * vPlaneStride + (x / 2))
-            = (pixel & 0xff0000) >> 16;
-
-        return;
-    }
-
-    const struct attrib *attrib;
-    for (attrib = attributes; attrib < attributes + NUMA(attributes);
-         attrib++) {
-        if (attrib->format == gBuf->getPixelFormat()) { break; }
-    }
-    if (attrib >= attributes + NUMA(attributes)) {
-        testPrintE("setPixel unsupported format of: %u",
-                   gBuf->getPixelFormat());
-        exit(90);
-    }
-
-    memmove(buf + ((gBuf->getStride() * attrib->bytes) * y)
-            + (attrib->bytes * x), &pixel, attrib->bytes);
-}
-
-// Fill a given graphic buffer with a uniform color and alpha
-void hwcTestFillColor(GraphicBuffer *gBuf, ColorFract color, float alpha)
-{
-    unsigned char* buf = NULL;
-    status_t err;
-    uint32_t pixel;
-
-    pixel = hwcTestColor2Pixel(gBuf->getPixelFormat(), color, alpha);
-
-    err = gBuf->lock(GRALLOC_USAGE_SW_WRITE_OFTEN, (void**)(&buf));
-    if (err != 0) {
-        testPrintE("hwcTestFillColor lock failed: %d", err);
-        exit(100);
-    }
-
-    for (unsigned int x = 0; x < gBuf->getStride(); x++) {
-        for (unsigned int y = 0; y < gBuf->getHeight(); y++) {
-            hwcTestSetPixel(gBuf, buf, x, y, (x < gBuf->getWidth())
-                            ? pixel : testRand());
-        }
-    }
-
-    err = gBuf->unlock();
-    if (err != 0) {
-        testPrintE("hwcTestFillColor unlock failed: %d", err);
-        exit(101);
-    }
-}
-
-// Fill the given buffer with a horizontal blend of colors, with the left
-// side color given by startColor and the right side color given by
-// endColor.  The startColor and endColor values are specified in the format
-// given by colorFormat, which might be different from the format of the
-// graphic buffer.  When different, a color conversion is done when possible
-// to the graphic format of the graphic buffer.  A color of black is
-// produced for cases where the conversion is impossible (e.g. out of gamut
-// values).
-void hwcTestFillColorHBlend(GraphicBuffer *gBuf, uint32_t colorFormat,
-                            ColorFract startColor, ColorFract endColor)
-{
-    status_t err;
-    unsigned char* buf = NULL;
-    const uint32_t width = gBuf->getWidth();
-    const uint32_t height = gBuf->getHeight();
-    const uint32_t stride = gBuf->getStride();
-
-    err = gBuf->lock(GRALLOC_USAGE_SW_WRITE_OFTEN, (void**)(&buf));
-    if (err != 0) {
-        testPrintE("hwcTestFillColorHBlend lock failed: %d", err);
-        exit(110);
-    }
-
-    for (unsigned int x = 0; x < stride; x++) {
-        uint32_t pixel;
-        if (x < width) {
-            ColorFract color(startColor.c1() + (endColor.c1() - startColor.c1())
-                                 * ((float) x / (float) (width - 1)),
-                             startColor.c2() + (endColor.c2() - startColor.c2())
-                                 * ((float) x / (float) (width - 1)),
-                             startColor.c3() + (endColor.c3() - startColor.c3())
-                                 * ((float) x / (float) (width - 1)));
-
-            // When formats differ, convert colors.
-            // Important to not convert when formats are the same, since
-            // out of gamut colors are always converted to black.
-            if (colorFormat != (uint32_t) gBuf->getPixelFormat()) {
-                hwcTestColorConvert(colorFormat, gBuf->getPixelFormat(), color);
-            }
-            pixel = hwcTestColor2Pixel(gBuf->getPixelFormat(), color, 1.0);
-        } else {
-            // Fill pad with random values
-            pixel = testRand();
-        }
-
-        for (unsigned int y = 0; y < height; y++) {
-            hwcTestSetPixel(gBuf, buf, x, y, pixel);
-        }
-    }
-
-    err = gBuf->unlock();
-    if (err != 0) {
-        testPrintE("hwcTestFillColorHBlend unlock failed: %d", err);
-        exit(111);
-    }
-}
-
-/*
- * When possible, converts color specified as a full range value in
- * the fromFormat, into an equivalent full range color in the toFormat.
- * When conversion is impossible (e.g. out of gamut color) a color
- * or black in the full range output format is produced.  The input
- * color is given as a fractional color in the parameter named color.
- * The produced color is written over the same parameter used to
- * provide the input color.
- *
- * Each graphic format has 3 color components and each of these
- * components has both a full and in gamut range.  This function uses
- * a table that provides the full and in gamut ranges of each of the
- * supported graphic formats.  The full range is given by members named
- * c[123]Min to c[123]Max, while the in gamut range is given by members
- * named c[123]Low to c[123]High.  In most cases the full and in gamut
- * ranges are equivalent.  This occurs when the c[123]Min == c[123]Low and
- * c[123]High == c[123]Max.
- *
- * The input and produced colors are both specified as a fractional amount
- * of the full range.  The diagram below provides an overview of the
- * conversion process.  The main steps are:
- *
- *   1. Produce black if the input color is out of gamut.
- *
- *   2. Convert the in gamut color into the fraction of the fromFromat
- *      in gamut range.
- *
- *   3. Convert from the fraction of the in gamut from format range to
- *      the fraction of the in gamut to format range.  Produce black
- *      if an equivalent color does not exists.
- *
- *   4. Covert from the fraction of the in gamut to format to the
- *      fraction of the full range to format.
- *
- *       From Format                 To Format
- *    max           high            high        max
- *    ----+                 +-----------+
- *    high \               /             \      high
- *    ------\-------------+               +-------->
- *           \
- *            \                   +--- black --+
- *             \                 /              \
- *              \               /                +-->
- *    low        \             /                  low
- *    -------- ---+-- black --+
- *    min             low           low           min
- *     ^               ^      ^      ^             ^
- *     |               |      |      |             |
- *     |               |      |      |             +-- fraction of full range
- *     |               |      |      +-- fraction of valid range
- *     |               |      +-- fromFormat to toFormat color conversion
- *     |               +-- fraction of valid range
- *     +-- fraction of full range
- */
-void hwcTestColorConvert(uint32_t fromFormat, uint32_t toFormat,
-                  ColorFract& color)
-{
-    const struct attrib {
-        uint32_t     format;
-        bool         rgb;
-        bool         yuv;
-        int          c1Min, c1Low, c1High, c1Max;
-        int          c2Min, c2Low, c2High, c2Max;
-        int          c3Min, c3Low, c3High, c3Max;
-    } attributes[] = {
-        {HAL_PIXEL_FORMAT_RGBA_8888, true,  false,
-         0, 0, 255, 255, 0, 0, 255, 255, 0, 0, 255, 255},
-        {HAL_PIXEL_FORMAT_RGBX_8888, true,  false,
-         0, 0, 255, 255, 0, 0, 255, 255, 0, 0, 255, 255},
-        {HAL_PIXEL_FORMAT_RGB_888,   true,  false,
-         0, 0, 255, 255, 0, 0, 255, 255, 0, 0, 255, 255},
-        {HAL_PIXEL_FORMAT_RGB_565,   true,  false,
-         0, 0, 31, 31, 0, 0, 63, 63, 0, 0, 31, 31},
-        {HAL_PIXEL_FORMAT_BGRA_8888, true,  false,
-         0, 0, 255, 255, 0, 0, 255, 255, 0, 0, 255, 255},
-        {HAL_PIXEL_FORMAT_YV12,      false, true,
-         0, 16, 235, 255, 0, 16, 240, 255, 0, 16, 240, 255},
-    };
-
-    const struct attrib *fromAttrib;
-    for (fromAttrib = attributes; fromAttrib < attributes + NUMA(attributes);
-         fromAttrib++) {
-        if (fromAttrib->format == fromFormat) { break; }
-    }
-    if (fromAttrib >= attributes + NUMA(attributes)) {
-        testPrintE("hwcTestColorConvert unsupported from format of: %u",
-                   fromFormat);
-        exit(120);
-    }
-
-    const struct attrib *toAttrib;
-    for (toAttrib = attributes; toAttrib < attributes + NUMA(attributes);
-         toAttrib++) {
-        if (toAttrib->format == toFormat) { break; }
-    }
-    if (toAttrib >= attributes + NUMA(attributes)) {
-        testPrintE("hwcTestColorConvert unsupported to format of: %u",
-                   toFormat);
-        exit(121);
-    }
-
-    // Produce black if any of the from components are outside the
-    // valid color range
-    float c1Val = fromAttrib->c1Min
-        + ((float) (fromAttrib->c1Max - fromAttrib->c1Min) * color.c1());
-    float c2Val = fromAttrib->c2Min
-        + ((float) (fromAttrib->c2Max - fromAttrib->c2Min) * color.c2());
-    float c3Val = fromAttrib->c3Min
-        + ((float) (fromAttrib->c3Max - fromAttrib->c3Min) * color.c3());
-    if ((c1Val < fromAttrib->c1Low) || (c1Val > fromAttrib->c1High)
-        || (c2Val < fromAttrib->c2Low) || (c2Val > fromAttrib->c2High)
-        || (c3Val < fromAttrib->c3Low) || (c3Val > fromAttrib->c3High)) {
-
-        // Return black
-        // Will use representation of black from RGBA8888 graphic format
-        // and recursively convert it to the requested graphic format.
-        color = ColorFract(0.0, 0.0, 0.0);
-        hwcTestColorConvert(HAL_PIXEL_FORMAT_RGBA_8888, toFormat, color);
-        return;
-    }
-
-    // Within from format, convert from fraction of full range
-    // to fraction of valid range
-    color = ColorFract((c1Val - fromAttrib->c1Low)
-                           / (fromAttrib->c1High - fromAttrib->c1Low),
-                       (c2Val - fromAttrib->c2Low)
-                           / (fromAttrib->c2High - fromAttrib->c2Low),
-                       (c3Val - fromAttrib->c3Low)
-                           / (fromAttrib->c3High - fromAttrib->c3Low));
-
-    // If needed perform RGB to YUV conversion
-    float wr = 0.2126, wg = 0.7152, wb = 0.0722; // ITU709 recommended constants
-    if (fromAttrib->rgb && toAttrib->yuv) {
-        float r = color.c1(), g = color.c2(), b = color.c3();
-        float y = wr * r + wg * g + wb * b;
-        float u = 0.5 * ((b - y) / (1.0 - wb)) + 0.5;
-        float v = 0.5 * ((r - y) / (1.0 - wr)) + 0.5;
-
-        // Produce black if color is outside the YUV gamut
-        if ((y < 0.0) || (y > 1.0)
-            || (u < 0.0) || (u > 1.0)
-            || (v < 0.0) || (v > 1.0)) {
-            y = 0.0;
-            u = v = 0.5;
-        }
-
-        color = ColorFract(y, u, v);
-    }
-
-    // If needed perform YUV to RGB conversion
-    // Equations determined from the ITU709 equations for RGB to YUV
-    // conversion, plus the following algebra:
-    //
-    //   u = 0.5 * ((b - y) / (1.0 - wb)) + 0.5
-    //   0.5 * ((b - y) / (1.0 - wb)) = u - 0.5
-    //   (b - y) / (1.0 - wb) = 2 * (u - 0.5)
-    //   b - y = 2 * (u - 0.5) * (1.0 - wb)
-    //   b = 2 * (u - 0.5) * (1.0 - wb) + y
-    //
-    //   v = 0.5 * ((r -y) / (1.0 - wr)) + 0.5
-    //   0.5 * ((r - y) / (1.0 - wr)) = v - 0.5
-    //   (r - y) / (1.0 - wr) = 2 * (v - 0.5)
-    //   r - y = 2 * (v - 0.5) * (1.0 - wr)
-    //   r = 2 * (v - 0.5) * (1.0 - wr) + y
-    //
-    //   y = wr * r + wg * g + wb * b
-    //   wr * r + wg * g + wb * b = y
-    //   wg * g = y - wr * r - wb * b
-    //   g = (y - wr * r - wb * b) / wg
-    if (fromAttrib->yuv && toAttrib->rgb) {
-        float y = color.c1(), u = color.c2(), v = color.c3();
-        float r = 2.0 * (v - 0.5) * (1.0 - wr) + y;
-        float b = 2.0 * (u - 0.5) * (1.0 - wb) + y;
-        float g = (y - wr * r - wb * b) / wg;
-
-        // Produce black if color is outside the RGB gamut
-        if ((r < 0.0) || (r > 1.0)
-            || (g < 0.0) || (g > 1.0)
-            || (b < 0.0) || (b > 1.0)) {
-            r = g = b = 0.0;
-        }
-
-        color = ColorFract(r, g, b);
-    }
-
-    // Within to format, convert from fraction of valid range
-    // to fraction of full range
-    c1Val = (toAttrib->c1Low
-        + (float) (toAttrib->c1High - toAttrib->c1Low) * color.c1());
-    c2Val = (toAttrib->c1Low
-        + (float) (toAttrib->c2High - toAttrib->c2Low) * color.c2());
-    c3Val = (toAttrib->c1Low
-        + (float) (toAttrib->c3High - toAttrib->c3Low) * color.c3());
-    color = ColorFract((float) (c1Val - toAttrib->c1Min)
-                           / (float) (toAttrib->c1Max - toAttrib->c1Min),
-                       (float) (c2Val - toAttrib->c2Min)
-                           / (float) (toAttrib->c2Max - toAttrib->c2Min),
-                       (float) (c3Val - toAttrib->c3Min)
-                           / (float) (toAttrib->c3Max - toAttrib->c3Min));
-}
-
+#ifdef __ANDROID__
 // TODO: Use PrintGLString, CechckGlError, and PrintEGLConfiguration
 //       from libglTest
 static void printGLString(const char *name, GLenum s)
@@ -1013,3 +756,4 @@ static void printEGLConfiguration(EGLDisplay dpy, EGLConfig config)
     }
     testPrintI("");
 }
+#endif
@@ -19,34 +19,31 @@
  * Hardware Composer Test Library Header
  */
 
+#include <stdio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
-#include <ui/GraphicBuffer.h>
+#include <glTestBuffer.h>
 
 #include <utils/Log.h>
 #include <testUtil.h>
 
 #include <hardware/hwcomposer.h>
 
-// Characteristics of known graphic formats
-const struct hwcTestGraphicFormat {
-    uint32_t format;
-    const char *desc;
-    uint32_t wMod, hMod; // Width/height mod this value must equal zero
-} hwcTestGraphicFormat[] = {
-    {HAL_PIXEL_FORMAT_RGBA_8888, "RGBA8888", 1, 1},
-    {HAL_PIXEL_FORMAT_RGBX_8888, "RGBX8888", 1, 1},
-    {HAL_PIXEL_FORMAT_RGB_888,   "RGB888",   1, 1},
-    {HAL_PIXEL_FORMAT_RGB_565,   "RGB565",   1, 1},
-    {HAL_PIXEL_FORMAT_BGRA_8888, "BGRA8888", 1, 1},
-    {HAL_PIXEL_FORMAT_YV12,      "YV12",     2, 2},
-};
+#include <hwcTestFormat.h>
 
 // Represent RGB color as fraction of color components.
 // Each of the color components are expected in the range [0.0, 1.0]
@@ -101,6 +98,410 @@ class HwcTestDim {
     uint32_t _h;
 };
 
+// Philox4x32-10 counter based random numbers.  The key is a seed and the
+// counter starts at (id0, id1, block 0, stream), so each pair of ids has
+// streams of its own, which don't depend on the order that they are drawn
+// in, nor on the drand48 state of testRand().  See hwcTestLib.cpp.
+class HwcTestRand {
+  public:
+    HwcTestRand(uint32_t seed, uint32_t id0, uint32_t id1,
+                uint32_t stream = 0);
+    uint32_t next(void);
+    double fract(void) { return next() / 4294967296.0; }
+    uint32_t mod(uint32_t n) { return ((uint64_t) next() * n) >> 32; }
+
+  private:
+    uint32_t _key[2];
+    uint32_t _ctr[4];
+    uint32_t _out[4];
+    unsigned int _used;
+};
+
+// Converts spans of colors from one format to another, in the manner of
+// hwcTestColorConvert().  The formats, and for YUV formats the matrix and
+// range, are looked up once at construction.  Colors given in the same
+// format as they are converted to pass through unchanged.
+class HwcTestColorConverter {
+  public:
+    enum Matrix {
+        MATRIX_BT601,
+        MATRIX_BT709,
+    };
+    enum Range {
+        RANGE_LIMITED,  // Video range, e.g. Y 16 to 235
+        RANGE_FULL,
+    };
+
+    HwcTestColorConverter(uint32_t fromFormat, uint32_t toFormat,
+                          Matrix matrix = MATRIX_BT709,
+                          Range range = RANGE_LIMITED);
+
+    // Converts count colors, which may be converted in place
+    void convert(const ColorFract *in, ColorFract *out, size_t count) const;
+
+    // Converts count colors to pixels of the to format, as given by
+    // hwcTestColor2Pixel()
+    void convertToPixels(const ColorFract *in, uint32_t *pixels,
+                         size_t count, float alpha = 1.0) const;
+
+  private:
+    struct componentRange {
+        float min, low, high, max;
+    };
+
+    void convertBlock(float *c1, float *c2, float *c3, size_t n) const;
+    template <typename Output>
+    void convertSpan(const ColorFract *in, size_t count,
+                     Output output) const;
+
+    uint32_t _fromFormat;
+    uint32_t _toFormat;
+    bool _identity;
+    bool _modelConversion;  // RGB to YUV or YUV to RGB
+    struct componentRange _from[3];
+    struct componentRange _to[3];
+    float _matrix[3][4];
+    float _black[3];
+    uint32_t _scale[3];     // Pixel packing of each component
+    unsigned int _shift[3];
+};
+
+// Capability model of the mock hardware composer, which decides the
+// layers prepare() gives an overlay.  See hwcTestMock.cpp for the script
+// that describes a model.
+class HwcTestMockModel {
+  public:
+    enum {
+        BLEND_NONE = 0x1,
+        BLEND_PREMULT = 0x2,
+        BLEND_COVERAGE = 0x4,
+        BLEND_ALL = 0x7,
+        TRANSFORM_ALL = 0xff,   // Bit (1 << transform) for each transform
+    };
+
+    // Overlay capabilities of one graphic format
+    struct FormatCaps {
+        uint32_t format;
+        bool overlay;           // Format can be shown on an overlay
+        uint32_t transforms;
+        uint32_t blends;
+    };
+
+    HwcTestMockModel();
+
+    // Applies the settings of script over the current ones.  Returns
+    // false, with a description in error, for a malformed script.
+    bool parse(const char *script, std::string& error);
+
+    // Capabilities of format, or of every other format when unknown
+    const FormatCaps& caps(uint32_t format) const;
+
+    HwcTestDim display;
+    uint32_t maxOverlays;
+    HwcTestDim minFrame;        // Display frame size limits
+    HwcTestDim maxFrame;
+    float minScale;             // Display frame to source crop ratio
+    float maxScale;             // limits, per axis
+    FormatCaps defaults;        // Formats not listed in formatCaps
+    std::vector<FormatCaps> formatCaps;
+
+  private:
+    FormatCaps& editCaps(uint32_t format);
+};
+
+// Counters kept by the mock hardware composer.  Times are spent inside
+// the mock, so that they can be told apart from the caller's time.
+struct HwcTestMockStats {
+    uint64_t prepares;
+    uint64_t sets;
+    uint64_t layers;            // Layers seen by prepare()
+    uint64_t overlays;          // Layers given an overlay
+    uint64_t composed;          // Overlay layers composed by set()
+    uint64_t rejectSkip;        // Layers left to the framebuffer, by reason
+    uint64_t rejectFormat;
+    uint64_t rejectFrame;
+    uint64_t rejectScale;
+    uint64_t rejectTransform;
+    uint64_t rejectBlend;
+    uint64_t rejectOverlays;
+    uint64_t prepareNs;
+    uint64_t setNs;
+    uint64_t composeNs;         // Part of setNs
+};
+
+// Recycles graphic buffers between the probes of a test.  get() hands
+// out the most recently returned idle buffer of the same width, height,
+// format and usage, and only allocates when there is none.  Buffers
+// given back with put() stay idle, least recently used first out, within
+// the idle limits.  Recycled buffers keep their contents.  Not thread
+// safe.  See hwcTestBufferPool.cpp.
+class HwcTestBufferPool {
+  public:
+    struct Stats {
+        uint64_t hits;          // get() calls served from the idle buffers
+        uint64_t misses;        // get() calls that allocated
+        uint64_t evictions;     // Idle buffers freed by the limits
+        size_t idle;
+        size_t idleBytes;
+    };
+
+    explicit HwcTestBufferPool(size_t maxIdle = 64,
+                               size_t maxIdleBytes = 256 << 20);
+
+    // The caller checks initCheck(), as for a new buffer
+    android::sp<GLTestBuffer> get(uint32_t width, uint32_t height,
+                                  uint32_t format, uint32_t usage);
+    void put(const android::sp<GLTestBuffer>& buf);
+
+    // Frees idle buffers until within the given limits
+    void trim(size_t maxIdle, size_t maxIdleBytes);
+    void clear(void) { trim(0, 0); }
+
+    const Stats& stats(void) const { return _stats; }
+    void report(const char *name) const;
+
+  private:
+    struct Key {
+        uint32_t width, height, format, usage;
+
+        bool operator<(const Key& other) const;
+    };
+    struct Entry {
+        Key key;
+        android::sp<GLTestBuffer> buf;
+        size_t bytes;
+    };
+    typedef std::list<Entry> LruList;
+
+    size_t _maxIdle;
+    size_t _maxIdleBytes;
+    LruList _lru;               // Most recently returned first
+    std::multimap<Key, LruList::iterator> _idle;
+    Stats _stats;
+};
+
+// Layer lists carved out of one block of memory, for loops that build a
+// list per frame.  A list and the visible region rects of its layers are
+// stored contiguously.  Everything handed out stays valid until reset(),
+// which takes constant time.  When a frame needs more than the block
+// holds, the excess comes from separate allocations, and the next
+// reset() grows the block to the high-water mark, so that steady state
+// frames allocate nothing.  See hwcTestLib.cpp.
+class HwcTestLayerArena {
+  public:
+    HwcTestLayerArena();
+    ~HwcTestLayerArena();
+
+    // A list of numLayers layers, set up as by hwcTestCreateLayerList().
+    // With rectsPerLayer, each layer's visibleRegionScreen points at that
+    // many zeroed rects of its own.  NULL when out of memory.
+    hwc_display_contents_1_t *list(size_t numLayers,
+                                   size_t rectsPerLayer = 0);
+    void reset(void);
+
+    size_t capacity(void) const { return _size; }
+    size_t highWater(void) const { return _highWater; }
+
+  private:
+    HwcTestLayerArena(const HwcTestLayerArena&);
+    HwcTestLayerArena& operator=(const HwcTestLayerArena&);
+
+    void *alloc(size_t bytes);
+
+    unsigned char *_block;
+    size_t _size;
+    size_t _used;               // Of the block and the overflow
+    size_t _highWater;
+    std::vector<void *> _overflow;
+};
+
+// Two layer arenas used in turn, for pipelines that build the list of
+// the next frame while the last one is still being set
+class HwcTestLayerArenaPair {
+  public:
+    HwcTestLayerArenaPair() : _current(0) {}
+
+    // Resets and returns the arena not handed out last
+    HwcTestLayerArena& next(void) {
+        _current ^= 1;
+        _arenas[_current].reset();
+        return _arenas[_current];
+    }
+    HwcTestLayerArena& current(void) { return _arenas[_current]; }
+
+  private:
+    HwcTestLayerArena _arenas[2];
+    unsigned int _current;
+};
+
+// Pixels of the buffer behind one layer, for HwcTestCompositor
+struct HwcTestComposeSource {
+    const unsigned char *pixels;    // NULL to leave the layer out
+    uint32_t width, height;
+    uint32_t stride;                // In pixels
+    uint32_t format;
+};
+
+// CPU reference compositor.  Composes the layers of a display contents
+// list, as the hardware composer would, into RGBA8888 pixels.  The work
+// is split into tiles, shared by threads - 1 worker threads and the
+// calling thread.  See hwcTestCompose.cpp.
+class HwcTestCompositor {
+  public:
+    // Zero threads means one per CPU
+    explicit HwcTestCompositor(unsigned int threads = 0);
+    ~HwcTestCompositor();
+
+    // Composes the layers of list, with the pixels of layer n given by
+    // sources[n], over opaque black.  HWC_FRAMEBUFFER_TARGET layers and
+    // layers without pixels are skipped.  The stride of dst is in pixels.
+    // Returns the number of layers composed.
+    size_t compose(const hwc_display_contents_1_t *list,
+                 const HwcTestComposeSource *sources,
+                 uint32_t *dst, uint32_t width, uint32_t height,
+                 uint32_t stride);
+
+    unsigned int threads(void) const { return _workers.size() + 1; }
+
+    struct Layer;
+
+  private:
+    HwcTestCompositor(const HwcTestCompositor&);
+    HwcTestCompositor& operator=(const HwcTestCompositor&);
+
+    void workerLoop(void);
+    void composeTiles(void);
+
+    std::vector<std::thread> _workers;
+    std::mutex _lock;
+    std::condition_variable _start;
+    std::condition_variable _done;
+    uint64_t _generation;
+    unsigned int _busy;
+    bool _quit;
+
+    // The compose() in progress
+    std::vector<Layer> *_layers;
+    uint32_t *_dst;
+    uint32_t _width, _height, _stride;
+    uint32_t _tilesX, _tiles;
+    std::atomic<uint32_t> _nextTile;
+};
+
+// Trace of the prepare() and set() calls of a test, for hwcReplay.  A
+// trace is a header followed by records, each a HwcTestTraceRecord and
+// its payload, padded to 4 bytes.  Buffers are given by their index in
+// the last TRACE_FRAMES record.  Fields are in host byte order.  See
+// hwcTestTrace.cpp.
+struct HwcTestTraceHeader {
+    char magic[8];                  // "hwcTrace"
+    uint32_t version;
+    uint32_t width, height;         // Of the display traced
+};
+
+struct HwcTestTraceRecord {
+    enum Type {
+        TRACE_FRAMES = 1,   // count HwcTestTraceBuffer, replacing the last
+        TRACE_PREPARE,      // Pass number, then count HwcTestTraceLayer
+        TRACE_SET,          // count uint16_t buffer indices, one per layer
+    };
+
+    uint16_t type;
+    uint16_t count;
+};
+
+// Buffer filled with a solid color by hwcTestFillColor()
+struct HwcTestTraceBuffer {
+    uint32_t width, height;
+    uint32_t format;
+    float color[3];
+    float alpha;
+};
+
+struct HwcTestTraceLayer {
+    uint16_t buffer;
+    uint16_t blending;
+    uint8_t transform;
+    uint8_t flags;
+    uint16_t reserved;
+    int32_t sourceCrop[4];          // left, top, right, bottom
+    int32_t displayFrame[4];
+};
+
+// Appends records to a trace file, flushed after each prepare() and set()
+// so they reach the file before the HWC call does.  The buffers passed to
+// frames() are looked up by handle for the layers of the later lists.
+// Write errors, and lists or frames too large for the 16-bit counts and
+// indices of a record, exit.
+class HwcTestTraceWriter {
+  public:
+    HwcTestTraceWriter() : _fp(NULL) {}
+    ~HwcTestTraceWriter() { close(); }
+
+    bool open(const char *path, uint32_t width, uint32_t height);
+    void close(void);
+    bool active(void) const { return _fp != NULL; }
+
+    void frames(const std::vector<buffer_handle_t>& handles,
+                const std::vector<HwcTestTraceBuffer>& buffers);
+    void prepare(uint32_t pass, const hwc_display_contents_1_t *list);
+    void set(const hwc_display_contents_1_t *list);
+
+  private:
+    HwcTestTraceWriter(const HwcTestTraceWriter&);
+    HwcTestTraceWriter& operator=(const HwcTestTraceWriter&);
+
+    void write(const void *data, size_t bytes);
+    void flush(void);
+    uint16_t bufferIndex(buffer_handle_t handle);
+
+    FILE *_fp;
+    std::map<buffer_handle_t, uint16_t> _index;
+};
+
+// Maps a trace file and walks its records.  next() returns the records
+// in turn, pointing into the mapping, and NULL at the end of the trace
+// or at a record that is malformed or cut short, which leaves bad() set.
+class HwcTestTraceReader {
+  public:
+    HwcTestTraceReader() : _base(NULL), _size(0), _pos(0), _bad(false) {}
+    ~HwcTestTraceReader() { close(); }
+
+    bool open(const char *path);
+    void close(void);
+
+    const HwcTestTraceHeader& header(void) const {
+        return *static_cast<const HwcTestTraceHeader *>(_base);
+    }
+    const HwcTestTraceRecord *next(void);
+    bool bad(void) const { return _bad; }
+    void rewind(void) { _pos = sizeof(HwcTestTraceHeader); _bad = false; }
+
+    // Payloads of a record
+    static const HwcTestTraceBuffer *buffers(const HwcTestTraceRecord *rec) {
+        return reinterpret_cast<const HwcTestTraceBuffer *>(rec + 1);
+    }
+    static uint32_t pass(const HwcTestTraceRecord *rec) {
+        return *reinterpret_cast<const uint32_t *>(rec + 1);
+    }
+    static const HwcTestTraceLayer *layers(const HwcTestTraceRecord *rec) {
+        return reinterpret_cast<const HwcTestTraceLayer *>(
+            reinterpret_cast<const uint32_t *>(rec + 1) + 1);
+    }
+    static const uint16_t *handles(const HwcTestTraceRecord *rec) {
+        return reinterpret_cast<const uint16_t *>(rec + 1);
+    }
+
+  private:
+    HwcTestTraceReader(const HwcTestTraceReader&);
+    HwcTestTraceReader& operator=(const HwcTestTraceReader&);
+
+    void *_base;
+    size_t _size;
+    size_t _pos;
+    bool _bad;
+};
+
 // Function Prototypes
 void hwcTestInitDisplay(bool verbose, EGLDisplay *dpy, EGLSurface *surface,
     EGLint *width, EGLint *height);
@@ -117,15 +518,28 @@ void hwcTestDisplayListPrepareModifiable(hwc_display_contents_1_t *list);
 void hwcTestDisplayListHandles(hwc_display_contents_1_t *list);
 
 uint32_t hwcTestColor2Pixel(uint32_t format, ColorFract color, float alpha);
+ColorFract hwcTestPixel2Color(uint32_t format, uint32_t pixel, float& alpha);
 void hwcTestColorConvert(uint32_t fromFormat, uint32_t toFormat,
                   ColorFract& color);
-void hwcTestSetPixel(android::GraphicBuffer *gBuf, unsigned char *buf,
+void hwcTestSetPixel(GLTestBuffer *gBuf, unsigned char *buf,
                      uint32_t x, uint32_t y, uint32_t pixel);
-void hwcTestFillColor(android::GraphicBuffer *gBuf, ColorFract color,
-                      float alpha);
-void hwcTestFillColorHBlend(android::GraphicBuffer *gBuf,
+void hwcTestFillColor(GLTestBuffer *gBuf, ColorFract color, float alpha,
+                      HwcTestRand *padRand = NULL);
+void hwcTestFillColorHBlend(GLTestBuffer *gBuf,
                             uint32_t colorFormat,
                             ColorFract startColor, ColorFract endColor);
+void hwcTestFillSpan(unsigned char *dst, size_t bytesPerPixel,
+                     uint32_t pixel, size_t count);
+HwcTestComposeSource hwcTestComposeSource(GLTestBuffer *gBuf,
+                                          const void *pixels);
 ColorFract hwcTestParseColor(std::istringstream& in, bool& error);
 struct hwc_rect hwcTestParseHwcRect(std::istringstream& in, bool& error);
 HwcTestDim hwcTestParseDim(std::istringstream& in, bool& error);
+
+bool hwcTestMockActive(void);
+const HwcTestMockModel& hwcTestMockEnvModel(void);
+hwc_composer_device_1_t *hwcTestMockOpen(const HwcTestMockModel& model);
+bool hwcTestMockIsMock(const hwc_composer_device_1_t *dev);
+const HwcTestMockStats& hwcTestMockGetStats(hwc_composer_device_1_t *dev);
+GLTestBuffer *hwcTestMockOutput(hwc_composer_device_1_t *dev);
+void hwcTestMockReport(hwc_composer_device_1_t *dev);
@@ -0,0 +1,804 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Hardware Composer Test Library - Mock Hardware Composer
+ *
+ * A software hwc_composer_device_1_t, used by hwcTestOpenHwc() in place
+ * of the HAL when GLTEST_HWC_MOCK is set.  Its prepare() gives layers an
+ * overlay according to a capability model, and its set() composes the
+ * overlay layers into a display sized RGBA8888 buffer, with
+ * HwcTestCompositor.  This lets the hwc tests run without composer
+ * hardware, against a known model, and separates the time spent in the
+ * tests from the time spent in the composer.
+ *
+ * GLTEST_HWC_MOCK holds the model script, or @ followed by the name of
+ * a file that holds it.  An empty script (e.g. GLTEST_HWC_MOCK=) selects
+ * the default model.  The script is a list of settings, separated by
+ * white space, newlines or semicolons, with # starting a comment:
+ *
+ *   display=WxH           Display size (default 1920x1080)
+ *   overlays=N            Overlays available (default 4)
+ *   minFrame=WxH          Smallest display frame (default 1x1)
+ *   maxFrame=WxH          Largest display frame (default no limit)
+ *   scale=MIN:MAX         Display frame to source crop ratio limits,
+ *                         per axis (default no limit)
+ *   formats=F,...         Formats that can be on an overlay (default all)
+ *   transforms=T,...      Transforms of every format (default all)
+ *   blends=B,...          Blends of every format (default all)
+ *   F.transforms=T,...    Transforms of format F only
+ *   F.blends=B,...        Blends of format F only
+ *
+ * Formats are named as in hwcTestGraphicFormat[].  Transforms are none,
+ * fliph, flipv, rot90, rot180 and rot270, or all.  Blends are none,
+ * premult and coverage, or all.  For example:
+ *
+ *   GLTEST_HWC_MOCK="overlays=2 formats=RGBA8888,YV12 YV12.blends=none"
+ *
+ * prepare() walks the layers in order.  Layers with HWC_SKIP_LAYER, no
+ * buffer, or a format, frame, scale, transform or blend outside of the
+ * model are left to the framebuffer.  The other layers get an overlay
+ * while any are left.  Only the formats of GLTestBuffer stand-in handles
+ * can be read, so on device, where the handles are gralloc's, every
+ * layer gets the capabilities of unlisted formats and set() composes
+ * nothing.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glTestBench.h>
+
+#include "hwcTestLib.h"
+
+using namespace std;
+using namespace android;
+
+static const struct {
+    const char *desc;
+    uint32_t transform;
+} mockTransforms[] = {
+    {"none",   0},
+    {"fliph",  HWC_TRANSFORM_FLIP_H},
+    {"flipv",  HWC_TRANSFORM_FLIP_V},
+    {"rot90",  HWC_TRANSFORM_ROT_90},
+    {"rot180", HWC_TRANSFORM_ROT_180},
+    {"rot270", HWC_TRANSFORM_ROT_270},
+};
+
+static const struct {
+    const char *desc;
+    uint32_t blending;
+    uint32_t bit;
+} mockBlends[] = {
+    {"none",     HWC_BLENDING_NONE,     HwcTestMockModel::BLEND_NONE},
+    {"premult",  HWC_BLENDING_PREMULT,  HwcTestMockModel::BLEND_PREMULT},
+    {"coverage", HWC_BLENDING_COVERAGE, HwcTestMockModel::BLEND_COVERAGE},
+};
+
+static const size_t mockNumTransforms
+    = sizeof(mockTransforms) / sizeof(mockTransforms[0]);
+static const size_t mockNumBlends = sizeof(mockBlends) / sizeof(mockBlends[0]);
+
+HwcTestMockModel::HwcTestMockModel()
+    : display(1920, 1080), maxOverlays(4), minFrame(1, 1),
+      maxFrame(UINT32_MAX, UINT32_MAX), minScale(0.0), maxScale(FLT_MAX)
+{
+    defaults.format = 0;
+    defaults.overlay = true;
+    defaults.transforms = TRANSFORM_ALL;
+    defaults.blends = BLEND_ALL;
+}
+
+const HwcTestMockModel::FormatCaps& HwcTestMockModel::caps(
+    uint32_t format) const
+{
+    for (size_t n1 = 0; n1 < formatCaps.size(); n1++) {
+        if (formatCaps[n1].format == format) { return formatCaps[n1]; }
+    }
+
+    return defaults;
+}
+
+HwcTestMockModel::FormatCaps& HwcTestMockModel::editCaps(uint32_t format)
+{
+    for (size_t n1 = 0; n1 < formatCaps.size(); n1++) {
+        if (formatCaps[n1].format == format) { return formatCaps[n1]; }
+    }
+
+    FormatCaps caps = defaults;
+    caps.format = format;
+    formatCaps.push_back(caps);
+
+    return formatCaps.back();
+}
+
+// Splits a comma separated list
+static vector<string> splitList(const string& list)
+{
+    vector<string> items;
+    size_t start = 0;
+
+    for (;;) {
+        size_t end = list.find(',', start);
+        items.push_back(list.substr(start, end - start));
+        if (end == string::npos) { break; }
+        start = end + 1;
+    }
+
+    return items;
+}
+
+static bool parseDim(const string& value, HwcTestDim& dim)
+{
+    unsigned int w, h;
+    char extra;
+
+    if (sscanf(value.c_str(), "%ux%u%c", &w, &h, &extra) != 2
+        || w == 0 || h == 0) {
+        return false;
+    }
+    dim = HwcTestDim(w, h);
+
+    return true;
+}
+
+// Mask of the named transforms, with bit (1 << transform) per transform
+static bool parseTransforms(const string& value, uint32_t& mask)
+{
+    vector<string> names = splitList(value);
+
+    mask = 0;
+    for (size_t n1 = 0; n1 < names.size(); n1++) {
+        if (names[n1] == "all") {
+            mask |= HwcTestMockModel::TRANSFORM_ALL;
+            continue;
+        }
+        size_t idx;
+        for (idx = 0; idx < mockNumTransforms; idx++) {
+            if (names[n1] == mockTransforms[idx].desc) { break; }
+        }
+        if (idx == mockNumTransforms) { return false; }
+        mask |= 1 << mockTransforms[idx].transform;
+    }
+
+    return true;
+}
+
+static bool parseBlends(const string& value, uint32_t& mask)
+{
+    vector<string> names = splitList(value);
+
+    mask = 0;
+    for (size_t n1 = 0; n1 < names.size(); n1++) {
+        if (names[n1] == "all") {
+            mask |= HwcTestMockModel::BLEND_ALL;
+            continue;
+        }
+        size_t idx;
+        for (idx = 0; idx < mockNumBlends; idx++) {
+            if (names[n1] == mockBlends[idx].desc) { break; }
+        }
+        if (idx == mockNumBlends) { return false; }
+        mask |= mockBlends[idx].bit;
+    }
+
+    return true;
+}
+
+bool HwcTestMockModel::parse(const char *script, string& error)
+{
+    string text(script);
+    size_t pos = 0;
+
+    while (pos < text.length()) {
+        // Skip separators and comments
+        char ch = text[pos];
+        if (isspace(ch) || ch == ';') { pos++; continue; }
+        if (ch == '#') {
+            pos = text.find('\n', pos);
+            if (pos == string::npos) { break; }
+            continue;
+        }
+
+        size_t end = pos;
+        while (end < text.length() && !isspace(text[end])
+               && text[end] != ';' && text[end] != '#') {
+            end++;
+        }
+        string setting = text.substr(pos, end - pos);
+        pos = end;
+
+        size_t equals = setting.find('=');
+        if (equals == string::npos) {
+            error = "expected key=value: " + setting;
+            return false;
+        }
+        string key = setting.substr(0, equals);
+        string value = setting.substr(equals + 1);
+        bool ok = true;
+
+        if (key == "display") {
+            ok = parseDim(value, display);
+        } else if (key == "overlays") {
+            char *endp;
+            maxOverlays = strtoul(value.c_str(), &endp, 10);
+            ok = !value.empty() && *endp == '\0';
+        } else if (key == "minFrame") {
+            ok = parseDim(value, minFrame);
+        } else if (key == "maxFrame") {
+            ok = parseDim(value, maxFrame);
+        } else if (key == "scale") {
+            char extra;
+            ok = sscanf(value.c_str(), "%f:%f%c", &minScale, &maxScale,
+                        &extra) == 2 && minScale >= 0.0 && minScale <= maxScale;
+        } else if (key == "formats") {
+            vector<string> names = splitList(value);
+            defaults.overlay = false;
+            for (size_t n1 = 0; n1 < formatCaps.size(); n1++) {
+                formatCaps[n1].overlay = false;
+            }
+            for (size_t n1 = 0; ok && n1 < names.size(); n1++) {
+                const struct hwcTestGraphicFormat *format
+                    = hwcTestGraphicFormatLookup(names[n1].c_str());
+                if (format == NULL) {
+                    error = "unknown format: " + names[n1];
+                    return false;
+                }
+                editCaps(format->format).overlay = true;
+            }
+        } else if (key == "transforms") {
+            ok = parseTransforms(value, defaults.transforms);
+            for (size_t n1 = 0; ok && n1 < formatCaps.size(); n1++) {
+                formatCaps[n1].transforms = defaults.transforms;
+            }
+        } else if (key == "blends") {
+            ok = parseBlends(value, defaults.blends);
+            for (size_t n1 = 0; ok && n1 < formatCaps.size(); n1++) {
+                formatCaps[n1].blends = defaults.blends;
+            }
+        } else if (key.find('.') != string::npos) {
+            string name = key.substr(0, key.find('.'));
+            string field = key.substr(key.find('.') + 1);
+            const struct hwcTestGraphicFormat *format
+                = hwcTestGraphicFormatLookup(name.c_str());
+            if (format == NULL) {
+                error = "unknown format: " + name;
+                return false;
+            }
+            if (field == "transforms") {
+                ok = parseTransforms(value,
+                                     editCaps(format->format).transforms);
+            } else if (field == "blends") {
+                ok = parseBlends(value, editCaps(format->format).blends);
+            } else {
+                error = "unknown setting: " + key;
+                return false;
+            }
+        } else {
+            error = "unknown setting: " + key;
+            return false;
+        }
+
+        if (!ok) {
+            error = "bad value for " + key + ": " + value;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#ifndef __ANDROID__
+// Read-only mappings of the buffers composed by set(), by handle.  A
+// buffer is mapped the first time it's composed and unmapped when
+// GLTestBuffer frees it, rather than on every set().  Buffers can be
+// freed from any thread, such as those filling frames ahead of a test,
+// and by static destructors, so the cache itself is never destroyed.
+struct mockMapping {
+    void *base;
+    size_t size;
+};
+struct mockMapCache {
+    mutex lock;
+    map<buffer_handle_t, mockMapping> maps;
+};
+static mockMapCache& mockMaps = *new mockMapCache;
+
+static void mockFreeBuffer(buffer_handle_t handle)
+{
+    lock_guard<mutex> lock(mockMaps.lock);
+    map<buffer_handle_t, mockMapping>::iterator it
+        = mockMaps.maps.find(handle);
+    if (it == mockMaps.maps.end()) { return; }
+
+    munmap(it->second.base, it->second.size);
+    mockMaps.maps.erase(it);
+}
+
+// Pixels of the buffer behind a handle, or NULL if it can't be mapped
+static const unsigned char *mockMapBuffer(buffer_handle_t handle, int fd)
+{
+    lock_guard<mutex> lock(mockMaps.lock);
+    map<buffer_handle_t, mockMapping>::iterator it
+        = mockMaps.maps.find(handle);
+    if (it != mockMaps.maps.end()) {
+        return static_cast<const unsigned char *>(it->second.base);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) { return NULL; }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) { return NULL; }
+    mockMapping mapping = { base, (size_t) st.st_size };
+    mockMaps.maps[handle] = mapping;
+
+    return static_cast<const unsigned char *>(base);
+}
+#endif
+
+// The mock device.  The HAL structure comes first, so that the device
+// pointers handed to the callbacks can be cast back to the mock.
+class HwcTestMock : public hwc_composer_device_1_t {
+  public:
+    explicit HwcTestMock(const HwcTestMockModel& mockModel);
+    ~HwcTestMock();
+
+    HwcTestMockModel model;
+    HwcTestMockStats stats;
+    sp<GLTestBuffer> output;
+    HwcTestCompositor *compositor;  // Created along with output
+
+  private:
+    static int closeHook(struct hw_device_t *dev);
+    static int prepareHook(struct hwc_composer_device_1 *dev,
+                           size_t numDisplays,
+                           hwc_display_contents_1_t **displays);
+    static int setHook(struct hwc_composer_device_1 *dev, size_t numDisplays,
+                       hwc_display_contents_1_t **displays);
+    static int eventControlHook(struct hwc_composer_device_1 *dev, int disp,
+                                int event, int enabled);
+    static int blankHook(struct hwc_composer_device_1 *dev, int disp,
+                         int blank);
+    static int queryHook(struct hwc_composer_device_1 *dev, int what,
+                         int *value);
+    static void registerProcsHook(struct hwc_composer_device_1 *dev,
+                                  hwc_procs_t const *procs);
+    static void dumpHook(struct hwc_composer_device_1 *dev, char *buff,
+                         int buffLen);
+
+    void prepareDisplay(hwc_display_contents_1_t *list);
+    void setDisplay(hwc_display_contents_1_t *list);
+};
+
+// Only identifies the mock's devices; it isn't registered with the HAL
+static struct hw_module_methods_t mockMethods = {
+    .open = NULL,
+};
+
+static struct hw_module_t mockModule = {
+    .tag = HARDWARE_MODULE_TAG,
+    .module_api_version = HWC_MODULE_API_VERSION_0_1,
+    .hal_api_version = HARDWARE_HAL_API_VERSION,
+    .id = HWC_HARDWARE_MODULE_ID,
+    .name = "hwcTest mock hardware composer",
+    .author = "The Android Open Source Project",
+    .methods = &mockMethods,
+    .dso = NULL,
+    .reserved = {0},
+};
+
+HwcTestMock::HwcTestMock(const HwcTestMockModel& mockModel)
+    : model(mockModel), compositor(NULL)
+{
+    memset(static_cast<hwc_composer_device_1_t *>(this), 0,
+           sizeof(hwc_composer_device_1_t));
+    memset(&stats, 0, sizeof(stats));
+
+    common.tag = HARDWARE_DEVICE_TAG;
+    common.version = HWC_DEVICE_API_VERSION_1_0;
+    common.module = &mockModule;
+    common.close = closeHook;
+
+    prepare = prepareHook;
+    set = setHook;
+    eventControl = eventControlHook;
+    blank = blankHook;
+    query = queryHook;
+    registerProcs = registerProcsHook;
+    dump = dumpHook;
+
+#ifndef __ANDROID__
+    GLTestBuffer::setFreeHook(mockFreeBuffer);
+#endif
+}
+
+HwcTestMock::~HwcTestMock()
+{
+    delete compositor;
+}
+
+int HwcTestMock::closeHook(struct hw_device_t *dev)
+{
+    delete static_cast<HwcTestMock *>(
+        reinterpret_cast<hwc_composer_device_1_t *>(dev));
+
+    return 0;
+}
+
+int HwcTestMock::prepareHook(struct hwc_composer_device_1 *dev,
+                             size_t numDisplays,
+                             hwc_display_contents_1_t **displays)
+{
+    HwcTestMock *mock = static_cast<HwcTestMock *>(dev);
+    uint64_t start = glTestBenchNow();
+
+    // Only the primary display is modeled
+    if (numDisplays > 0 && displays[0] != NULL) {
+        mock->prepareDisplay(displays[0]);
+    }
+    mock->stats.prepares++;
+    mock->stats.prepareNs += glTestBenchNow() - start;
+
+    return 0;
+}
+
+int HwcTestMock::setHook(struct hwc_composer_device_1 *dev,
+                         size_t numDisplays,
+                         hwc_display_contents_1_t **displays)
+{
+    HwcTestMock *mock = static_cast<HwcTestMock *>(dev);
+    uint64_t start = glTestBenchNow();
+
+    for (size_t n1 = 0; n1 < numDisplays; n1++) {
+        if (displays[n1] == NULL) { continue; }
+        if (n1 == 0) {
+            mock->setDisplay(displays[n1]);
+        }
+
+        // Nothing is left pending, so every fence is signaled at once
+        for (size_t n2 = 0; n2 < displays[n1]->numHwLayers; n2++) {
+            hwc_layer_1_t *layer = &displays[n1]->hwLayers[n2];
+            if (layer->acquireFenceFd >= 0) {
+                close(layer->acquireFenceFd);
+                layer->acquireFenceFd = -1;
+            }
+            layer->releaseFenceFd = -1;
+        }
+        displays[n1]->retireFenceFd = -1;
+    }
+    mock->stats.sets++;
+    mock->stats.setNs += glTestBenchNow() - start;
+
+    return 0;
+}
+
+int HwcTestMock::eventControlHook(struct hwc_composer_device_1 *, int, int,
+                                  int)
+{
+    return 0;
+}
+
+int HwcTestMock::blankHook(struct hwc_composer_device_1 *, int, int)
+{
+    return 0;
+}
+
+int HwcTestMock::queryHook(struct hwc_composer_device_1 *, int what,
+                           int *value)
+{
+    switch (what) {
+    case HWC_BACKGROUND_LAYER_SUPPORTED:
+        *value = 0;
+        return 0;
+
+    case HWC_VSYNC_PERIOD:
+        *value = 1000000000 / 60;
+        return 0;
+    }
+
+    return -EINVAL;
+}
+
+void HwcTestMock::registerProcsHook(struct hwc_composer_device_1 *,
+                                    hwc_procs_t const *)
+{
+}
+
+void HwcTestMock::dumpHook(struct hwc_composer_device_1 *dev, char *buff,
+                           int buffLen)
+{
+    HwcTestMock *mock = static_cast<HwcTestMock *>(dev);
+
+    snprintf(buff, buffLen, "hwcTest mock: %ux%u, %u overlays, "
+             "%llu prepares, %llu sets\n",
+             mock->model.display.width(), mock->model.display.height(),
+             mock->model.maxOverlays,
+             (unsigned long long) mock->stats.prepares,
+             (unsigned long long) mock->stats.sets);
+}
+
+// Geometry of the buffer behind a handle.  Only GLTestBuffer stand-in
+// handles can be read, see glTestBuffer.h for their layout.
+struct mockBufferInfo {
+    int fd;
+    uint32_t width, height, stride, format;
+};
+
+static bool mockLookupBuffer(buffer_handle_t handle,
+                             struct mockBufferInfo& info)
+{
+#ifdef __ANDROID__
+    (void) handle;
+    (void) info;
+    return false;
+#else
+    if (handle == NULL || handle->numFds > 1 || handle->numInts != 4) {
+        return false;
+    }
+    const int *ints = &handle->data[handle->numFds];
+    info.fd = (handle->numFds == 1) ? handle->data[0] : -1;
+    info.width = ints[0];
+    info.height = ints[1];
+    info.stride = ints[2];
+    info.format = ints[3];
+
+    return true;
+#endif
+}
+
+void HwcTestMock::prepareDisplay(hwc_display_contents_1_t *list)
+{
+    uint32_t overlaysLeft = model.maxOverlays;
+
+    for (size_t n1 = 0; n1 < list->numHwLayers; n1++) {
+        hwc_layer_1_t *layer = &list->hwLayers[n1];
+        if (layer->compositionType == HWC_FRAMEBUFFER_TARGET) { continue; }
+        stats.layers++;
+        layer->hints = 0;
+        layer->compositionType = HWC_FRAMEBUFFER;
+
+        if ((layer->flags & HWC_SKIP_LAYER) || layer->handle == NULL) {
+            stats.rejectSkip++;
+            continue;
+        }
+
+        struct mockBufferInfo info;
+        const HwcTestMockModel::FormatCaps& caps
+            = mockLookupBuffer(layer->handle, info) ? model.caps(info.format)
+                                                  : model.defaults;
+        if (!caps.overlay) {
+            stats.rejectFormat++;
+            continue;
+        }
+
+        const hwc_rect_t& frame = layer->displayFrame;
+        const hwc_rect_t& crop = layer->sourceCrop;
+        int frameW = frame.right - frame.left;
+        int frameH = frame.bottom - frame.top;
+        if (frameW < (int) model.minFrame.width()
+            || frameH < (int) model.minFrame.height()
+            || (uint32_t) frameW > model.maxFrame.width()
+            || (uint32_t) frameH > model.maxFrame.height()) {
+            stats.rejectFrame++;
+            continue;
+        }
+
+        // A 90 degree rotation scans the crop width down the frame
+        int cropW = crop.right - crop.left;
+        int cropH = crop.bottom - crop.top;
+        if (layer->transform & HWC_TRANSFORM_ROT_90) { swap(cropW, cropH); }
+        if (cropW <= 0 || cropH <= 0) {
+            stats.rejectScale++;
+            continue;
+        }
+        float scaleX = (float) frameW / cropW;
+        float scaleY = (float) frameH / cropH;
+        if (scaleX < model.minScale || scaleX > model.maxScale
+            || scaleY < model.minScale || scaleY > model.maxScale) {
+            stats.rejectScale++;
+            continue;
+        }
+
+        if (layer->transform > 7
+            || !(caps.transforms & (1 << layer->transform))) {
+            stats.rejectTransform++;
+            continue;
+        }
+
+        uint32_t blendBit = 0;
+        for (size_t idx = 0; idx < mockNumBlends; idx++) {
+            if ((uint32_t) layer->blending == mockBlends[idx].blending) {
+                blendBit = mockBlends[idx].bit;
+            }
+        }
+        if (!(caps.blends & blendBit)) {
+            stats.rejectBlend++;
+            continue;
+        }
+
+        if (overlaysLeft == 0) {
+            stats.rejectOverlays++;
+            continue;
+        }
+        overlaysLeft--;
+        layer->compositionType = HWC_OVERLAY;
+        stats.overlays++;
+    }
+}
+
+void HwcTestMock::setDisplay(hwc_display_contents_1_t *list)
+{
+#ifdef __ANDROID__
+    (void) list;
+#else
+    uint64_t start = glTestBenchNow();
+
+    if (output.get() == NULL) {
+        output = new GLTestBuffer(model.display.width(),
+                                  model.display.height(),
+                                  HAL_PIXEL_FORMAT_RGBA_8888,
+                                  GLTestBuffer::USAGE_SW_READ_OFTEN
+                                  | GLTestBuffer::USAGE_SW_WRITE_OFTEN);
+        if (output->initCheck() != NO_ERROR) {
+            testPrintE("hwcTest mock output allocation failed: %d",
+                       output->initCheck());
+            exit(120);
+        }
+        compositor = new HwcTestCompositor;
+    }
+
+    unsigned char *dst;
+    if (output->lock(GLTestBuffer::USAGE_SW_WRITE_OFTEN,
+                     (void **) &dst) != NO_ERROR) {
+        testPrintE("hwcTest mock output lock failed");
+        exit(121);
+    }
+
+    // What the framebuffer would show is up to GL, so only the overlay
+    // layers are composed
+    vector<HwcTestComposeSource> sources(list->numHwLayers);
+    for (size_t n1 = 0; n1 < list->numHwLayers; n1++) {
+        const hwc_layer_1_t *layer = &list->hwLayers[n1];
+        struct mockBufferInfo info;
+        sources[n1].pixels = NULL;
+        if (layer->compositionType != HWC_OVERLAY
+            || !mockLookupBuffer(layer->handle, info) || info.fd < 0) {
+            continue;
+        }
+
+        sources[n1].pixels = mockMapBuffer(layer->handle, info.fd);
+        if (sources[n1].pixels == NULL) { continue; }
+        sources[n1].width = info.width;
+        sources[n1].height = info.height;
+        sources[n1].stride = info.stride;
+        sources[n1].format = info.format;
+    }
+    stats.composed += compositor->compose(list, sources.data(),
+        reinterpret_cast<uint32_t *>(dst), output->getWidth(),
+        output->getHeight(), output->getStride());
+
+    output->unlock();
+    stats.composeNs += glTestBenchNow() - start;
+#endif
+}
+
+// Whether hwcTestOpenHwc() opens the mock instead of the HAL
+bool hwcTestMockActive(void)
+{
+    return getenv("GLTEST_HWC_MOCK") != NULL;
+}
+
+// The model given by GLTEST_HWC_MOCK, parsed on first use
+const HwcTestMockModel& hwcTestMockEnvModel(void)
+{
+    static HwcTestMockModel model;
+    static bool parsed;
+
+    if (parsed) { return model; }
+    parsed = true;
+
+    const char *env = getenv("GLTEST_HWC_MOCK");
+    if (env == NULL) { return model; }
+
+    string script(env);
+    if (env[0] == '@') {
+        FILE *fp = fopen(env + 1, "r");
+        if (fp == NULL) {
+            testPrintE("Unable to open hwc mock model %s: %s", env + 1,
+                       strerror(errno));
+            exit(122);
+        }
+        script.clear();
+        char buf[256];
+        size_t len;
+        while ((len = fread(buf, 1, sizeof(buf), fp)) > 0) {
+            script.append(buf, len);
+        }
+        fclose(fp);
+    }
+
+    string error;
+    if (!model.parse(script.c_str(), error)) {
+        testPrintE("Bad hwc mock model: %s", error.c_str());
+        exit(123);
+    }
+
+    return model;
+}
+
+hwc_composer_device_1_t *hwcTestMockOpen(const HwcTestMockModel& model)
+{
+    return new HwcTestMock(model);
+}
+
+bool hwcTestMockIsMock(const hwc_composer_device_1_t *dev)
+{
+    return dev != NULL && dev->common.module == &mockModule;
+}
+
+const HwcTestMockStats& hwcTestMockGetStats(hwc_composer_device_1_t *dev)
+{
+    return static_cast<HwcTestMock *>(dev)->stats;
+}
+
+// The buffer set() composes into, or NULL before the first set() and on
+// device
+GLTestBuffer *hwcTestMockOutput(hwc_composer_device_1_t *dev)
+{
+    return static_cast<HwcTestMock *>(dev)->output.get();
+}
+
+void hwcTestMockReport(hwc_composer_device_1_t *dev)
+{
+    const HwcTestMockStats& stats = hwcTestMockGetStats(dev);
+
+    testPrintI("hwc mock: %llu prepares, %llu sets",
+               (unsigned long long) stats.prepares,
+               (unsigned long long) stats.sets);
+    testPrintI("  layers %llu, overlays %llu, composed %llu",
+               (unsigned long long) stats.layers,
+               (unsigned long long) stats.overlays,
+               (unsigned long long) stats.composed);
+    testPrintI("  framebuffer: skip %llu, format %llu, frame %llu, "
+               "scale %llu, transform %llu, blend %llu, no overlay %llu",
+               (unsigned long long) stats.rejectSkip,
+               (unsigned long long) stats.rejectFormat,
+               (unsigned long long) stats.rejectFrame,
+               (unsigned long long) stats.rejectScale,
+               (unsigned long long) stats.rejectTransform,
+               (unsigned long long) stats.rejectBlend,
+               (unsigned long long) stats.rejectOverlays);
+    testPrintI("  prepare %.3f ms, set %.3f ms (compose %.3f ms)",
+               stats.prepareNs / 1e6, stats.setNs / 1e6,
+               stats.composeNs / 1e6);
+}
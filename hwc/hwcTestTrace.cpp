@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Hardware Composer Test Library - Prepare and Set Traces
+ *
+ * A trace holds what a test showed the HWC: the buffers it filled and
+ * the layer lists it prepared and set.  Layers refer to buffers by their
+ * index in the last TRACE_FRAMES record, rather than by handle, so that
+ * a replay can allocate its own buffers.  The buffers are described by
+ * the solid color they were filled with, rather than by their pixels,
+ * which keeps a trace of many passes to a few bytes per layer.
+ *
+ * The reader maps the whole file and hands out pointers into it, so a
+ * replay does no parsing or copying between calls to the HWC.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "hwcTestLib.h"
+
+using namespace std;
+
+static const char traceMagic[8] = { 'h', 'w', 'c', 'T', 'r', 'a', 'c', 'e' };
+static const uint32_t traceVersion = 2;
+
+// Bytes of a record's payload, before padding
+static size_t tracePayload(uint16_t type, uint16_t count)
+{
+    switch (type) {
+    case HwcTestTraceRecord::TRACE_FRAMES:
+        return count * sizeof(HwcTestTraceBuffer);
+    case HwcTestTraceRecord::TRACE_PREPARE:
+        return sizeof(uint32_t) + count * sizeof(HwcTestTraceLayer);
+    case HwcTestTraceRecord::TRACE_SET:
+        return count * sizeof(uint16_t);
+    }
+
+    return 0;
+}
+
+// Bytes padded to a multiple of 4
+static size_t tracePad(size_t bytes)
+{
+    return (bytes + 3) & ~(size_t) 3;
+}
+
+// Value of a narrow record field, exiting when it doesn't fit
+static uint32_t traceField(const char *name, size_t value, size_t max)
+{
+    if (value > max) {
+        testPrintE("Trace %s of %zu exceeds %zu", name, value, max);
+        exit(133);
+    }
+
+    return value;
+}
+
+bool HwcTestTraceWriter::open(const char *path, uint32_t width,
+                              uint32_t height)
+{
+    close();
+    _fp = fopen(path, "w");
+    if (_fp == NULL) { return false; }
+
+    HwcTestTraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, traceMagic, sizeof(header.magic));
+    header.version = traceVersion;
+    header.width = width;
+    header.height = height;
+    write(&header, sizeof(header));
+
+    return true;
+}
+
+void HwcTestTraceWriter::close(void)
+{
+    if (_fp == NULL) { return; }
+
+    if (fclose(_fp) != 0) {
+        testPrintE("Trace close failed: %s", strerror(errno));
+        exit(131);
+    }
+    _fp = NULL;
+    _index.clear();
+}
+
+void HwcTestTraceWriter::write(const void *data, size_t bytes)
+{
+    static const uint32_t zero = 0;
+
+    if ((fwrite(data, 1, bytes, _fp) != bytes)
+        || (fwrite(&zero, 1, tracePad(bytes) - bytes, _fp)
+            != tracePad(bytes) - bytes)) {
+        testPrintE("Trace write failed: %s", strerror(errno));
+        exit(130);
+    }
+}
+
+// Pushes the records written so far to the file, ahead of the HWC call
+// they describe, so a trace of a run the HWC crashes or hangs still
+// holds the failing pass
+void HwcTestTraceWriter::flush(void)
+{
+    if (fflush(_fp) != 0) {
+        testPrintE("Trace flush failed: %s", strerror(errno));
+        exit(134);
+    }
+}
+
+uint16_t HwcTestTraceWriter::bufferIndex(buffer_handle_t handle)
+{
+    map<buffer_handle_t, uint16_t>::const_iterator it = _index.find(handle);
+    if (it == _index.end()) {
+        testPrintE("Trace of a layer with an unknown buffer: %p", handle);
+        exit(132);
+    }
+
+    return it->second;
+}
+
+void HwcTestTraceWriter::frames(const vector<buffer_handle_t>& handles,
+                                const vector<HwcTestTraceBuffer>& buffers)
+{
+    if (_fp == NULL) { return; }
+
+    HwcTestTraceRecord rec = { HwcTestTraceRecord::TRACE_FRAMES,
+        (uint16_t) traceField("buffer count", buffers.size(), UINT16_MAX) };
+    write(&rec, sizeof(rec));
+    write(buffers.data(), buffers.size() * sizeof(HwcTestTraceBuffer));
+
+    _index.clear();
+    for (size_t n1 = 0; n1 < handles.size(); n1++) {
+        _index[handles[n1]] = n1;
+    }
+}
+
+void HwcTestTraceWriter::prepare(uint32_t pass,
+                                 const hwc_display_contents_1_t *list)
+{
+    if (_fp == NULL) { return; }
+
+    HwcTestTraceRecord rec = { HwcTestTraceRecord::TRACE_PREPARE,
+        (uint16_t) traceField("layer count", list->numHwLayers, UINT16_MAX) };
+    vector<HwcTestTraceLayer> layers(list->numHwLayers);
+    for (size_t n1 = 0; n1 < list->numHwLayers; n1++) {
+        const hwc_layer_1_t *layer = &list->hwLayers[n1];
+        HwcTestTraceLayer *out = &layers[n1];
+
+        memset(out, 0, sizeof(*out));
+        out->buffer = bufferIndex(layer->handle);
+        out->blending = traceField("blending", layer->blending, UINT16_MAX);
+        out->transform = traceField("transform", layer->transform,
+                                    UINT8_MAX);
+        out->flags = traceField("flags", layer->flags, UINT8_MAX);
+        out->sourceCrop[0] = layer->sourceCrop.left;
+        out->sourceCrop[1] = layer->sourceCrop.top;
+        out->sourceCrop[2] = layer->sourceCrop.right;
+        out->sourceCrop[3] = layer->sourceCrop.bottom;
+        out->displayFrame[0] = layer->displayFrame.left;
+        out->displayFrame[1] = layer->displayFrame.top;
+        out->displayFrame[2] = layer->displayFrame.right;
+        out->displayFrame[3] = layer->displayFrame.bottom;
+    }
+
+    write(&rec, sizeof(rec));
+    write(&pass, sizeof(pass));
+    write(layers.data(), layers.size() * sizeof(HwcTestTraceLayer));
+    flush();
+}
+
+void HwcTestTraceWriter::set(const hwc_display_contents_1_t *list)
+{
+    if (_fp == NULL) { return; }
+
+    HwcTestTraceRecord rec = { HwcTestTraceRecord::TRACE_SET,
+        (uint16_t) traceField("layer count", list->numHwLayers, UINT16_MAX) };
+    vector<uint16_t> buffers(list->numHwLayers);
+    for (size_t n1 = 0; n1 < list->numHwLayers; n1++) {
+        buffers[n1] = bufferIndex(list->hwLayers[n1].handle);
+    }
+    write(&rec, sizeof(rec));
+    write(buffers.data(), buffers.size() * sizeof(uint16_t));
+    flush();
+}
+
+bool HwcTestTraceReader::open(const char *path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) { return false; }
+    struct stat st;
+    if ((fstat(fd, &st) != 0)
+        || ((size_t) st.st_size < sizeof(HwcTestTraceHeader))) {
+        ::close(fd);
+        errno = EINVAL;
+        return false;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) { return false; }
+
+    _base = base;
+    _size = st.st_size;
+    if ((memcmp(header().magic, traceMagic, sizeof(traceMagic)) != 0)
+        || (header().version != traceVersion)) {
+        close();
+        errno = EINVAL;
+        return false;
+    }
+
+    // Replays read the records in order, once per loop
+    madvise(_base, _size, MADV_SEQUENTIAL);
+    rewind();
+
+    return true;
+}
+
+void HwcTestTraceReader::close(void)
+{
+    if (_base == NULL) { return; }
+
+    munmap(_base, _size);
+    _base = NULL;
+    _size = 0;
+}
+
+const HwcTestTraceRecord *HwcTestTraceReader::next(void)
+{
+    if (_bad || (_pos == _size)) { return NULL; }
+    if (_pos + sizeof(HwcTestTraceRecord) > _size) {
+        _bad = true;
+        return NULL;
+    }
+
+    const HwcTestTraceRecord *rec
+        = reinterpret_cast<const HwcTestTraceRecord *>(
+            static_cast<const char *>(_base) + _pos);
+    if ((rec->type < HwcTestTraceRecord::TRACE_FRAMES)
+        || (rec->type > HwcTestTraceRecord::TRACE_SET)) {
+        _bad = true;
+        return NULL;
+    }
+    size_t bytes = sizeof(*rec) + tracePad(tracePayload(rec->type,
+                                                        rec->count));
+    if (_pos + bytes > _size) {
+        _bad = true;
+        return NULL;
+    }
+    _pos += bytes;
+
+    return rec;
+}
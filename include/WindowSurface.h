@@ -17,31 +17,136 @@
 #ifndef OPENGL_TESTS_WINDOWSURFACE_H
 #define OPENGL_TESTS_WINDOWSURFACE_H
 
+#include <stdint.h>
+
+#include <vector>
+
+#ifdef __ANDROID__
 #include <gui/SurfaceControl.h>
+#endif
+#include <utils/Errors.h>
 
 #include <EGL/egl.h>
 
 namespace android {
 
 /*
- * A window that covers the entire display surface.
+ * A render target for the tests.
+ *
+ * By default this is a window that covers the entire display surface.
+ * The backend can instead be selected at runtime through the
+ * GLTEST_SURFACE environment variable, so that the same test binary
+ * can run offscreen:
+ *
+ *   surfaceflinger  Full-screen SurfaceFlinger window (default)
+ *   pbuffer         EGL pbuffer surface
+ *   surfaceless     EGL_KHR_surfaceless_context plus a framebuffer object
+ *   software        Software EGL (e.g. Mesa llvmpipe) rendering into
+ *                   a pbuffer, for build hosts without a GPU
+ *
+ * The resolution of the offscreen backends is given by
+ * GLTEST_SURFACE_SIZE, in the form WIDTHxHEIGHT.
+ *
+ * Tests should obtain the display, config, surface and current context
+ * through this object rather than with the raw EGL calls, so that each
+ * backend can substitute its own behavior.
  *
- * The window is destroyed when this object is destroyed, so don't try
- * to use the surface after that point.
+ * The window, and the framebuffer objects of the surfaceless backend,
+ * are destroyed when this object is destroyed, so don't try to use the
+ * surface after that point.
  */
 class WindowSurface {
 public:
-    // Creates the window.
+    enum Backend {
+        BACKEND_SURFACEFLINGER,
+        BACKEND_PBUFFER,
+        BACKEND_SURFACELESS,
+        BACKEND_SOFTWARE,
+    };
+
+    static const uint32_t defaultOffscreenWidth = 1920;
+    static const uint32_t defaultOffscreenHeight = 1080;
+
+    // Creates the window, using the backend and resolution given by
+    // the environment.
     WindowSurface();
 
-    // Retrieves a handle to the window.
+    // Creates the window with an explicit backend.  A width or height of
+    // zero selects the default resolution for that backend.
+    explicit WindowSurface(Backend backend, uint32_t width = 0,
+            uint32_t height = 0);
+
+    ~WindowSurface();
+
+    // Retrieves a handle to the window.  Returns NULL for the offscreen
+    // backends.
     EGLNativeWindowType getSurface() const;
 
+    Backend getBackend() const { return mBackend; }
+    bool isOffscreen() const { return mBackend != BACKEND_SURFACEFLINGER; }
+    uint32_t getWidth() const { return mWidth; }
+    uint32_t getHeight() const { return mHeight; }
+
+    // Returns the EGL display appropriate for this backend.  The caller
+    // is still responsible for eglInitialize() and eglTerminate().
+    EGLDisplay getDisplay() const;
+
+    // Selects a config from attrs that can render to this backend.
+    status_t selectConfig(EGLDisplay dpy, EGLint const* attrs,
+            EGLConfig* outConfig) const;
+
+    // Creates the EGL surface for this backend.  The surfaceless backend
+    // returns EGL_NO_SURFACE, which makeCurrent() and swapBuffers()
+    // accept.
+    EGLSurface createEGLSurface(EGLDisplay dpy, EGLConfig config);
+
+    // eglMakeCurrent() replacement.  For the surfaceless backend each
+    // context gets its own framebuffer object, as they aren't shared
+    // between contexts, created the first time it's made current and
+    // bound every time.
+    EGLBoolean makeCurrent(EGLDisplay dpy, EGLSurface surface,
+            EGLContext context);
+
+    // eglDestroyContext() replacement.  Deletes the surfaceless
+    // backend's framebuffer object of the context first, so that a
+    // later context given the same handle doesn't bind it.
+    EGLBoolean destroyContext(EGLDisplay dpy, EGLContext context);
+
+    // eglSwapBuffers() replacement.  The offscreen backends flush
+    // instead of presenting.
+    EGLBoolean swapBuffers(EGLDisplay dpy, EGLSurface surface);
+
+    // Backend name conversions, for command-line flags and reports.
+    static const char* backendName(Backend backend);
+    static bool parseBackend(const char* name, Backend* outBackend);
+
 private:
     WindowSurface(const WindowSurface&);
     WindowSurface& operator=(const WindowSurface&);
 
+    void init(Backend backend, uint32_t width, uint32_t height);
+    bool initSurfaceFlinger();
+    bool initFramebuffer(EGLDisplay dpy, EGLContext context);
+    void releaseFramebuffer(EGLDisplay dpy, EGLContext context);
+
+    Backend mBackend;
+    uint32_t mWidth;
+    uint32_t mHeight;
+
+    // Surfaceless backend render target of one context
+    struct Framebuffer {
+        EGLContext context;
+        bool oes;           // GLES 1.x, through GL_OES_framebuffer_object
+        uint32_t framebuffer;
+        uint32_t colorbuffer;
+        uint32_t depthbuffer;
+    };
+    std::vector<Framebuffer> mFramebuffers;
+    EGLDisplay mSurfacelessDisplay; // Known to be surfaceless capable
+
+#ifdef __ANDROID__
     sp<SurfaceControl> mSurfaceControl;
+#endif
 };
 
 } // namespace android
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Graphics Test Benchmark Harness Header
+ *
+ * Statistical timing shared by the benchmarks.  A measurement runs a
+ * number of untimed warmup iterations, then timed iterations until the
+ * 95% confidence interval of the mean is within a target fraction of
+ * the mean (or an iteration/time cap is reached).  Outliers are rejected
+ * by their distance from the median in units of the median absolute
+ * deviation, and the remaining samples are summarized as
+ * min/median/mean/p90/p99/max/stddev.
+ *
+ * Typical use:
+ *
+ *   GLTestBench bench("fill solid");
+ *   while (bench.iterate()) {
+ *       drawFrame();
+ *   }
+ *   bench.report();
+ *
+ * Results are printed as text by default.  GLTEST_BENCH_FORMAT selects
+ * json (one object per line) or csv, and GLTEST_BENCH_OUTPUT names a
+ * file to append the results to instead of stdout.
+ */
+
+#ifndef OPENGL_TESTS_GLTESTBENCH_H
+#define OPENGL_TESTS_GLTESTBENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+struct GLTestBenchConfig {
+    GLTestBenchConfig();
+
+    unsigned int warmupIterations; // Untimed iterations before sampling
+    unsigned int minIterations;    // Samples taken before convergence check
+    unsigned int maxIterations;    // Hard cap on the number of samples
+    double maxSeconds;             // Hard cap on time spent sampling
+    double targetRelCI;            // Stop once ci95 / mean <= this value
+    bool checkConvergence;         // False to sample up to the caps and
+                                   // leave convergence out of the report,
+                                   // e.g. for latencies
+    double outlierMads;            // Reject samples further than this many
+                                   // MADs from the median, 0 to disable
+    double workPerIteration;       // Units of work done by one iteration,
+    const char *workUnits;         // used to report a throughput
+};
+
+struct GLTestBenchResult {
+    std::string name;
+    unsigned int samples;     // Samples kept after outlier rejection
+    unsigned int rejected;    // Samples rejected as outliers
+    bool checkConvergence;    // Convergence is reported
+    bool converged;           // Confidence target met before a cap
+    // Per iteration times, in nanoseconds
+    double min, median, mean, p90, p99, max, stddev, ci95;
+    // Work per second at the median, 0 when no work was specified
+    double throughput;
+    const char *workUnits;
+};
+
+class GLTestBench {
+  public:
+    GLTestBench(const char *name,
+                const GLTestBenchConfig& config = GLTestBenchConfig());
+
+    // Ends the iteration started by the previous call, if any, and
+    // returns true when another iteration should be run.
+    bool iterate();
+
+    // Adds an externally timed sample (e.g. from a GPU timer), for
+    // loops that don't fit iterate().  Samples added during warmup
+    // are discarded.
+    void addSample(double ns);
+    bool done() const;
+
+    const GLTestBenchResult& result();
+    void report();
+
+  private:
+    void finish();
+
+    std::string _name;
+    GLTestBenchConfig _config;
+    std::vector<double> _samples;
+    unsigned int _warmupLeft;
+    double _sum, _sumSq;
+    uint64_t _startNs;
+    uint64_t _iterStartNs;
+    bool _running;
+    bool _finished;
+    GLTestBenchResult _result;
+};
+
+uint64_t glTestBenchNow();
+void glTestBenchSummarize(const char *name, const GLTestBenchConfig& config,
+                          std::vector<double>& samples,
+                          GLTestBenchResult& result);
+void glTestBenchReport(const GLTestBenchResult& result);
+
+#endif /* OPENGL_TESTS_GLTESTBENCH_H */
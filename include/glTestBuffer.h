@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Graphics Test Buffer Header
+ *
+ * GLTestBuffer is the graphic buffer used by the CPU pixel paths (buffer
+ * fills, gralloc copies).  On device it is android::GraphicBuffer,
+ * allocated through gralloc.  On build hosts it is a stand-in with the
+ * same interface, backed by a memfd mapping, so that the same code can
+ * be run and profiled without a device.
+ *
+ * The host allocation is configured by GLTestBufferConfig, which takes
+ * its defaults from the environment:
+ *
+ *   GLTEST_BUFFER_ALIGN      Stride alignment, in pixels (default 16)
+ *   GLTEST_BUFFER_HUGEPAGES  1 to back buffers with huge pages
+ *   GLTEST_BUFFER_UNCACHED   1 to flush the buffer from the CPU caches
+ *                            at every lock and unlock
+ *
+ * Host memory is always cacheable.  The uncached option only makes each
+ * lock start from cold caches and each unlock write everything back,
+ * which approximates the cost of uncached or write-combined gralloc
+ * memory for access patterns that touch the buffer once per lock.
+ */
+
+#ifndef OPENGL_TESTS_GLTESTBUFFER_H
+#define OPENGL_TESTS_GLTESTBUFFER_H
+
+#ifdef __ANDROID__
+
+#include <ui/GraphicBuffer.h>
+
+typedef android::GraphicBuffer GLTestBuffer;
+
+#else
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cutils/native_handle.h>
+#include <hardware/gralloc.h>
+#include <system/graphics.h>
+#include <utils/Errors.h>
+#include <utils/RefBase.h>
+
+struct GLTestBufferConfig {
+    GLTestBufferConfig();
+
+    uint32_t strideAlign;   // Stride alignment in pixels, a power of two
+    bool hugePages;         // Back the buffer with huge pages
+    bool uncached;          // Flush the CPU caches at lock and unlock
+};
+
+class GLTestBuffer : public android::LightRefBase<GLTestBuffer> {
+public:
+    enum {
+        USAGE_SW_READ_NEVER   = GRALLOC_USAGE_SW_READ_NEVER,
+        USAGE_SW_READ_RARELY  = GRALLOC_USAGE_SW_READ_RARELY,
+        USAGE_SW_READ_OFTEN   = GRALLOC_USAGE_SW_READ_OFTEN,
+        USAGE_SW_READ_MASK    = GRALLOC_USAGE_SW_READ_MASK,
+
+        USAGE_SW_WRITE_NEVER  = GRALLOC_USAGE_SW_WRITE_NEVER,
+        USAGE_SW_WRITE_RARELY = GRALLOC_USAGE_SW_WRITE_RARELY,
+        USAGE_SW_WRITE_OFTEN  = GRALLOC_USAGE_SW_WRITE_OFTEN,
+        USAGE_SW_WRITE_MASK   = GRALLOC_USAGE_SW_WRITE_MASK,
+
+        USAGE_HW_TEXTURE      = GRALLOC_USAGE_HW_TEXTURE,
+        USAGE_HW_RENDER       = GRALLOC_USAGE_HW_RENDER,
+        USAGE_HW_2D           = GRALLOC_USAGE_HW_2D,
+        USAGE_HW_COMPOSER     = GRALLOC_USAGE_HW_COMPOSER,
+    };
+
+    GLTestBuffer(uint32_t width, uint32_t height, int format,
+            uint32_t usage);
+    GLTestBuffer(uint32_t width, uint32_t height, int format,
+            uint32_t usage, const GLTestBufferConfig& config);
+    ~GLTestBuffer();
+
+    // NO_ERROR, or the reason the allocation failed
+    android::status_t initCheck() const { return mStatus; }
+
+    uint32_t getWidth() const { return mWidth; }
+    uint32_t getHeight() const { return mHeight; }
+    uint32_t getStride() const { return mStride; }  // In pixels
+    int getPixelFormat() const { return mFormat; }
+    uint32_t getUsage() const { return mUsage; }
+
+    // Size of the allocation, in bytes
+    size_t getSize() const { return mSize; }
+
+    android::status_t lock(uint32_t usage, void **vaddr);
+    android::status_t unlock();
+
+    // The memfd of the buffer, followed by its width, height, stride and
+    // format.  The memfd is absent when memfd_create isn't available and
+    // the buffer is private anonymous memory.
+    buffer_handle_t handle;
+
+    // Called with the handle of every buffer as it is freed, before its
+    // memfd is closed, so that mappings made from the handle, such as
+    // those of the mock HWC, can be dropped.  May be called from any
+    // thread that frees a buffer.
+    typedef void (*FreeHook)(buffer_handle_t handle);
+    static void setFreeHook(FreeHook hook);
+
+private:
+    GLTestBuffer(const GLTestBuffer&);
+    GLTestBuffer& operator=(const GLTestBuffer&);
+
+    void init(const GLTestBufferConfig& config);
+    void flushCaches() const;
+
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mStride;
+    int mFormat;
+    uint32_t mUsage;
+    bool mUncached;
+    android::status_t mStatus;
+
+    int mFd;
+    size_t mSize;           // Bytes used by the pixels
+    size_t mMapSize;        // Bytes mapped, rounded to the page size
+    void *mBase;
+    bool mLocked;
+};
+
+#endif // __ANDROID__
+
+#endif // OPENGL_TESTS_GLTESTBUFFER_H
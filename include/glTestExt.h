@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Graphics Test Extension Header
+ *
+ * Extension string checks and the EGL_KHR_fence_sync entry points,
+ * shared by the GPU timer, frame limiter and frame recorder.  The entry
+ * points are looked up at runtime, as libglTest is linked into both the
+ * GLES 1 and GLES 2 tests, and on hosts against whatever EGL is found.
+ */
+
+#ifndef OPENGL_TESTS_GLTESTEXT_H
+#define OPENGL_TESTS_GLTESTEXT_H
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// Whether a space separated extension string, from glGetString() or
+// eglQueryString(), lists name.  A NULL string lists nothing.
+bool glTestHasExtension(const char *extensions, const char *name);
+
+// EGL_KHR_fence_sync entry points, NULL when the EGL lacks them.  Valid
+// once glTestSyncProcsResolve() has been called.
+struct GLTestSyncProcs {
+    bool resolved;
+    PFNEGLCREATESYNCKHRPROC createSync;
+    PFNEGLCLIENTWAITSYNCKHRPROC clientWaitSync;
+    PFNEGLDESTROYSYNCKHRPROC destroySync;
+};
+extern GLTestSyncProcs glTestSyncProcs;
+void glTestSyncProcsResolve(void);
+
+#endif // OPENGL_TESTS_GLTESTEXT_H
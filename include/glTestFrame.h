@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Graphics Test Frame Pacing Header
+ *
+ * Timestamps every swap of a surface and reports frame pacing: the
+ * distribution of frame intervals, jank against the display refresh
+ * period and the frame rate sustained over one second windows.
+ *
+ * The timestamp of each frame comes from the best available source:
+ *
+ *   present  EGL_ANDROID_get_frame_timestamps display present time
+ *   fence    Completion of an EGL_KHR_fence_sync fence inserted after
+ *            the swap, as first seen by the recorder.  Only accurate to
+ *            within a frame, as fences are polled once per swap.
+ *   cpu      Return from eglSwapBuffers()
+ *
+ * GLTEST_FRAME_SOURCE restricts the choice to the given source or one
+ * below it.  The refresh period is given by GLTEST_REFRESH_HZ, else
+ * read from the compositor when the present source is in use, else
+ * assumed to be 60 Hz.
+ *
+ * Completed frame records are published to a lock-free ring.  Swaps are
+ * recorded on the rendering thread; analyze() and report() may run on
+ * any one other thread.  A reader that falls more than a ring behind
+ * loses the oldest frames, which are counted as dropped.
+ */
+
+#ifndef OPENGL_TESTS_GLTESTFRAME_H
+#define OPENGL_TESTS_GLTESTFRAME_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <WindowSurface.h>
+
+struct GLTestFrameRecord {
+    uint64_t frame;     // Swap number, from 0
+    uint64_t cpuNs;     // Return from the swap
+    uint64_t timeNs;    // Timestamp from the recorder's source
+    bool presented;     // False if the source has no time for the frame
+};
+
+struct GLTestFrameStats {
+    const char *source;
+    uint64_t frames;            // Frames analyzed
+    uint64_t dropped;           // Frames lost to ring overrun
+    uint64_t unpresented;       // Frames without a timestamp
+    double refreshNs;
+    double durationNs;          // Sum of the frame intervals
+
+    // Frame intervals, in nanoseconds
+    double intervalMedian;
+    double intervalP90;
+    double intervalP99;
+    double intervalMax;
+
+    double fpsMean;             // Over the whole duration
+    double fpsLow1;             // 1% low, from the 99th percentile interval
+    double sustainedFpsMin;     // Over one second windows
+    double sustainedFpsMedian;
+
+    uint64_t jankFrames;        // Intervals over 1.5 refresh periods
+    uint64_t missedRefreshes;   // Refresh periods skipped by those frames
+
+    // Interval histogram in 1 ms buckets.  The last bucket holds all
+    // longer intervals.
+    std::vector<uint64_t> histogram;
+};
+
+class GLTestFrameRecorder {
+  public:
+    enum Source {
+        SOURCE_CPU,
+        SOURCE_FENCE,
+        SOURCE_PRESENT,
+    };
+
+    static const unsigned int histogramBuckets = 100;
+
+    // Records swaps of surface on dpy.  The ring holds capacity frames,
+    // rounded up to a power of two.
+    GLTestFrameRecorder(EGLDisplay dpy, EGLSurface surface,
+                        unsigned int capacity = 4096);
+    ~GLTestFrameRecorder();
+
+    Source source(void) const { return _source; }
+    static const char *sourceName(Source source);
+
+    // Swaps through windowSurface and records the frame
+    EGLBoolean swapBuffers(android::WindowSurface& windowSurface);
+
+    // Bracket a swap made some other way
+    void beforeSwap(void);
+    void afterSwap(void);
+
+    // Waits up to timeoutNs for the timestamps of recent frames, which
+    // the present and fence sources only resolve a few frames later
+    void flush(uint64_t timeoutNs = 100000000);
+
+    // Statistics over every frame read from the ring since the last
+    // reset()
+    GLTestFrameStats analyze(void);
+    void reset(void);
+
+    // Prints analyze(), prefixed with name, with the interval histogram
+    // if requested
+    void report(const char *name, bool histogram = true);
+
+  private:
+    struct Pending {
+        uint64_t frame;
+        uint64_t cpuNs;
+        uint64_t frameId;   // EGL frame id, for the present source
+        EGLSyncKHR sync;    // Fence, for the fence source
+    };
+
+    // Ring slot.  seq is 2 * (frame + 1) once the record is complete and
+    // odd while it is being written.
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        std::atomic<uint64_t> cpuNs;
+        std::atomic<uint64_t> timeNs;
+        std::atomic<bool> presented;
+    };
+
+    GLTestFrameRecorder(const GLTestFrameRecorder&);
+    GLTestFrameRecorder& operator=(const GLTestFrameRecorder&);
+
+    bool resolve(const Pending& pending, uint64_t& timeNs, bool& presented);
+    void resolvePending(void);
+    void publishPending(bool presented);
+    void publish(uint64_t frame, uint64_t cpuNs, uint64_t timeNs,
+                 bool presented);
+    void drain(void);
+
+    EGLDisplay _dpy;
+    EGLSurface _surface;
+    Source _source;
+    std::atomic<uint64_t> _refreshNs;
+    bool _compositorRefresh;    // _refreshNs still to be read from it
+    uint64_t _nextFrame;
+    uint64_t _nextFrameId;
+    std::deque<Pending> _pending;
+
+    // Ring shared with the reader
+    Slot *_ring;
+    uint64_t _mask;
+    std::atomic<uint64_t> _head;    // Frames published
+
+    // Reader state
+    uint64_t _tail;
+    uint64_t _dropped;
+    std::vector<GLTestFrameRecord> _records;
+};
+
+#endif /* OPENGL_TESTS_GLTESTFRAME_H */
@@ -24,8 +24,115 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
 #include "EGLUtils.h"
 
+// Timing of one GPU timer scope, in nanoseconds
+struct GLTestGpuTiming {
+    uint64_t cpuSubmitNs; // CPU time from begin() to end()
+    uint64_t gpuNs;       // GPU execution time of the scope
+    bool estimated;       // gpuNs is a fence/glFinish upper bound
+    bool disjoint;        // GPU timer was disjoint, gpuNs is invalid
+};
+
+// Scoped GPU timer.  Each begin()/end() pair brackets the GL commands
+// to be timed.  With GL_EXT_disjoint_timer_query a ring of up to depth
+// GL_TIME_ELAPSED_EXT queries is kept in flight, and results are read
+// back without stalling once they become available.  Without it, end()
+// places an EGL_KHR_fence_sync fence, which is polled in the same way,
+// and the time from begin() to when the fence is seen signaled is
+// reported, an upper bound on the GPU time.  Without fences, only wait()
+// completes a scope, with glFinish().  Up to depth scopes are kept in
+// flight either way.  Requires a current context for the lifetime of the
+// object.
+class GLTestGpuTimer {
+  public:
+    GLTestGpuTimer(unsigned int depth = 4);
+    ~GLTestGpuTimer();
+
+    bool hasTimerQuery(void) const { return _hasTimerQuery; }
+
+    void begin(void);
+    void end(void);
+
+    // Retrieves the oldest completed scope.  poll() returns false when
+    // none is ready, wait() blocks and returns false only when there
+    // are no scopes outstanding.
+    bool poll(GLTestGpuTiming& timing);
+    bool wait(GLTestGpuTiming& timing);
+
+  private:
+    struct Scope {
+        unsigned int query;
+        EGLSyncKHR sync;          // Fallback fence, or EGL_NO_SYNC_KHR
+        uint64_t cpuStartNs;
+        uint64_t cpuEndNs;
+    };
+
+    bool collect(bool block);
+
+    bool _hasTimerQuery;
+    bool _hasFenceSync;
+    unsigned int _depth;
+    std::vector<unsigned int> _freeQueries;
+    std::deque<Scope> _inFlight;
+    std::deque<GLTestGpuTiming> _completed;
+    Scope _current;
+    bool _inScope;
+};
+
+// Frames-in-flight limiter, for benchmark loops.  frameEnd() is called
+// after each swap.  Drained (0 frames in flight) it calls glFinish(), so
+// every frame completes before the next starts and the loop measures
+// latency.  Pipelined (1 to 3 frames) it fences each frame and waits
+// only for the frame that many swaps back, so the loop measures the
+// throughput a pipelined app would see.  Fences come from
+// EGL_KHR_fence_sync, or glFenceSync() on ES 3 contexts; without either
+// the limiter stays drained.
+//
+// The default count is given by GLTEST_FRAMES_IN_FLIGHT, and is 0.
+// Requires a current context for the lifetime of the object.
+class GLTestFrameLimiter {
+  public:
+    static const int fromEnvironment = -1;
+    static const unsigned int maxFramesInFlight = 3;
+
+    GLTestFrameLimiter(int framesInFlight = fromEnvironment);
+    ~GLTestFrameLimiter();
+
+    unsigned int framesInFlight(void) const { return _framesInFlight; }
+    bool drained(void) const { return _framesInFlight == 0; }
+
+    // "drained" or "pipelined N", for report names
+    const char *name(void) const { return _name; }
+
+    void frameEnd(void);
+
+    // Waits for every frame in flight
+    void drain(void);
+
+    // Time spent blocked in frameEnd() and drain()
+    uint64_t waitNs(void) const { return _waitNs; }
+
+  private:
+    GLTestFrameLimiter(const GLTestFrameLimiter&);
+    GLTestFrameLimiter& operator=(const GLTestFrameLimiter&);
+
+    void *fence(void);
+    void waitFence(void *fence);
+
+    unsigned int _framesInFlight;
+    bool _glSync;           // Fences are GLsync, not EGLSyncKHR
+    EGLDisplay _dpy;
+    std::deque<void *> _fences;
+    uint64_t _waitNs;
+    char _name[16];
+};
+
 void glTestPrintGLString(const char *name, GLenum s);
 void glTestCheckEglError(const char* op, EGLBoolean returnVal = EGL_TRUE);
 void glTestCheckGlError(const char* op);
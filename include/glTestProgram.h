@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Graphics Test Program Cache Header
+ *
+ * Shared shader compile and link for the GLES 2 tests.  Linked programs
+ * are saved with glGetProgramBinary() (ES 3.0 or
+ * GL_OES_get_program_binary) to a cache directory, keyed by a hash of
+ * the shader sources, attribute bindings and the GL renderer and version
+ * strings, and later runs load them with glProgramBinary() instead of
+ * compiling.  A binary the driver rejects is recompiled and replaced.
+ *
+ * The cache directory is given by GLTEST_PROGRAM_CACHE, and defaults to
+ * /data/local/tmp/gltest-programs.  Set it to an empty string to always
+ * compile from source.  Programs are compiled from source, without a
+ * message, when the default directory can't be written.
+ */
+
+#ifndef OPENGL_TESTS_GLTESTPROGRAM_H
+#define OPENGL_TESTS_GLTESTPROGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+struct GLTestProgramStats {
+    unsigned int compiled;    // Programs compiled and linked from source
+    unsigned int loaded;      // Programs loaded from the cache
+    unsigned int rejected;    // Cached binaries the driver refused
+    uint64_t compileNs;       // Total time compiling and linking
+    uint64_t loadNs;          // Total time loading binaries
+    unsigned int queueWaits;  // GLTestProgramQueue::wait() calls
+    uint64_t queueStallNs;    // Time those calls spent blocked
+};
+
+// Compiles a shader, returning 0 and logging the info log on failure.
+GLuint glTestLoadShader(GLenum shaderType, const char *source);
+
+// Receives each message of the program helpers, such as a shader info
+// log, from whichever thread built the program.  Without a hook they
+// go to stderr.  Tests whose stderr is lost, such as the JNI ones, send
+// them to the system log instead.
+typedef void (*GLTestProgramLogHook)(const char *msg);
+void glTestProgramSetLogHook(GLTestProgramLogHook hook);
+
+// Creates a linked program from the given sources, from the cache when
+// possible.  attribs optionally names the attributes to bind to
+// locations 0, 1, ..., terminated by NULL.  Returns 0 on failure.
+GLuint glTestCreateProgram(const char *vertexSource,
+                           const char *fragmentSource,
+                           const char *const *attribs = NULL);
+
+// Builds programs ahead of their use.  Programs are submitted up front
+// and retrieved with wait(), which only blocks if that program isn't
+// ready yet.  With GL_KHR_parallel_shader_compile the driver compiles
+// in the background; otherwise a worker thread builds them in a context
+// shared with the one current at construction.  If neither is possible,
+// wait() builds the program itself.  Submitted sources must stay valid
+// until the program is retrieved, and wait() must be called from the
+// thread and context that created the queue.
+class GLTestProgramQueue {
+  public:
+    enum Mode {
+        MODE_PARALLEL,  // GL_KHR_parallel_shader_compile
+        MODE_THREAD,    // Shared context worker thread
+        MODE_SYNC,      // Built on demand by wait()
+    };
+
+    GLTestProgramQueue(const char *const *attribs = NULL);
+    ~GLTestProgramQueue();
+
+    Mode mode(void) const { return _mode; }
+    static const char *modeName(Mode mode);
+
+    // Queues a program, returning a ticket for wait()
+    unsigned int submit(const char *vertexSource, const char *fragmentSource);
+
+    // Returns the linked program for ticket, or 0 if it failed to build.
+    // Each ticket may be waited for once.
+    GLuint wait(unsigned int ticket);
+
+  private:
+    struct Job;
+
+    GLTestProgramQueue(const GLTestProgramQueue&);
+    GLTestProgramQueue& operator=(const GLTestProgramQueue&);
+
+    bool startWorker(void);
+    void worker(void);
+
+    Mode _mode;
+    const char *const *_attribs;
+    std::deque<Job *> _jobs;
+    std::mutex _lock;
+    std::condition_variable _cond;
+    std::thread _thread;
+    size_t _nextJob;        // Next job for the worker
+    bool _stop;
+    EGLDisplay _dpy;
+    EGLContext _context;
+    EGLSurface _surface;
+};
+
+const GLTestProgramStats& glTestProgramStats(void);
+void glTestProgramReport(void);
+
+#endif /* OPENGL_TESTS_GLTESTPROGRAM_H */
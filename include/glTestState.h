@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Graphics Test State Cache Header
+ *
+ * Shadow copy of the GLES 2 binding and enable state.  Calls made
+ * through a GLTestStateCache are forwarded to GL only when they change
+ * the shadowed state, and every call and every redundant call is counted
+ * per kind of state.  With filtering disabled all calls are forwarded
+ * but still counted, so a workload can be timed both ways with the same
+ * call stream.
+ *
+ * The cache starts with all state unknown, so the first call of each
+ * kind is always forwarded.  State changed behind its back, by direct GL
+ * calls or another library, must be followed by invalidate().  Objects
+ * should be deleted through the cache so stale bindings are forgotten.
+ *
+ * Filtering is enabled by default; set GLTEST_STATE_FILTER=0 to forward
+ * every call.
+ */
+
+#ifndef OPENGL_TESTS_GLTESTSTATE_H
+#define OPENGL_TESTS_GLTESTSTATE_H
+
+#include <stdint.h>
+
+#include <GLES2/gl2.h>
+
+enum GLTestStateKind {
+    GLTEST_STATE_PROGRAM,
+    GLTEST_STATE_ACTIVE_TEXTURE,
+    GLTEST_STATE_TEXTURE,
+    GLTEST_STATE_CAPABILITY,
+    GLTEST_STATE_BLEND_FUNC,
+    GLTEST_STATE_BUFFER,
+    GLTEST_STATE_ATTRIB_ARRAY,
+    GLTEST_STATE_ATTRIB_POINTER,
+    GLTEST_STATE_VIEWPORT,
+    GLTEST_STATE_CLEAR_COLOR,
+    GLTEST_STATE_KIND_COUNT
+};
+
+struct GLTestStateStats {
+    uint64_t calls[GLTEST_STATE_KIND_COUNT];     // Calls made to the cache
+    uint64_t redundant[GLTEST_STATE_KIND_COUNT]; // Calls that changed nothing,
+                                                 // dropped when filtering
+
+    uint64_t totalCalls(void) const;
+    uint64_t totalRedundant(void) const;
+};
+
+class GLTestStateCache {
+  public:
+    GLTestStateCache();
+
+    // Enables or disables dropping of redundant calls.  The shadow is
+    // kept up to date either way.
+    void setFiltering(bool filtering) { _filtering = filtering; }
+    bool filtering(void) const { return _filtering; }
+
+    // Forgets all shadowed state
+    void invalidate(void);
+
+    void useProgram(GLuint program);
+    void activeTexture(GLenum texture);
+    void bindTexture(GLenum target, GLuint texture);
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+    void blendFunc(GLenum sfactor, GLenum dfactor);
+    void bindBuffer(GLenum target, GLuint buffer);
+    void enableVertexAttribArray(GLuint index);
+    void disableVertexAttribArray(GLuint index);
+    void vertexAttribPointer(GLuint index, GLint size, GLenum type,
+                             GLboolean normalized, GLsizei stride,
+                             const void *pointer);
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    void clearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+
+    void deleteProgram(GLuint program);
+    void deleteTextures(GLsizei n, const GLuint *textures);
+    void deleteBuffers(GLsizei n, const GLuint *buffers);
+
+    const GLTestStateStats& stats(void) const { return _stats; }
+    void resetStats(void);
+
+    // Prints the call and redundant counts, prefixed with name
+    void report(const char *name) const;
+
+    static const char *kindName(GLTestStateKind kind);
+
+  private:
+    enum {
+        maxTextureUnits = 32,
+        textureTargets = 3,     // 2D, cube map and external
+        capabilities = 9,       // The GLES 2 glEnable() caps
+        maxAttribs = 16,
+    };
+
+    struct AttribPointer {
+        bool known;
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+        GLsizei stride;
+        const void *pointer;
+        GLuint buffer;          // GL_ARRAY_BUFFER binding it was set with
+    };
+
+    bool filter(GLTestStateKind kind, bool redundant);
+
+    bool _filtering;
+    GLTestStateStats _stats;
+
+    GLuint _program;
+    GLenum _activeTexture;
+    GLuint _textures[maxTextureUnits][textureTargets];
+    int8_t _caps[capabilities];        // -1 unknown, else 0 or 1
+    bool _blendKnown;
+    GLenum _blendSrc;
+    GLenum _blendDst;
+    GLuint _arrayBuffer;
+    GLuint _elementBuffer;
+    int8_t _attribArrays[maxAttribs];
+    AttribPointer _attribPointers[maxAttribs];
+    bool _viewportKnown;
+    GLint _viewport[4];
+    bool _clearColorKnown;
+    GLfloat _clearColor[4];
+};
+
+#endif /* OPENGL_TESTS_GLTESTSTATE_H */
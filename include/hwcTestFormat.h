@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Hardware Composer Test Library - Graphic Format Registry
+ *
+ * Everything the tests know about a graphic format is in its entry of
+ * hwcTestGraphicFormat[]: the names, the size constraints, the pixel
+ * layout and the in gamut range of each component.  Adding a format
+ * only takes a new entry.
+ *
+ * A pixel value holds the components at the shifts given by the entry.
+ * Packed formats store the low bytes of the value in host byte order.
+ * Planar formats store a full resolution Y plane followed by the V and
+ * U planes, subsampled and with rows aligned as given by the entry, and
+ * their pixel value holds Y, U and V in its low three bytes.
+ *
+ * The table is constexpr, so HwcTestFormat<Index> resolves the layout of
+ * one entry at compile time, and HwcTestFormatDispatch instantiates a
+ * kernel for every entry and runs the one for a format, letting loops
+ * over pixels run without per-pixel format lookups.
+ */
+
+#ifndef HWC_TEST_FORMAT_H
+#define HWC_TEST_FORMAT_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+
+#include <hardware/hwcomposer.h>
+
+// Formats since dropped from the HAL, at their former values.  Current
+// gralloc implementations may refuse to allocate them.
+enum {
+    HWC_TEST_FORMAT_RGBA_5551 = 6,
+    HWC_TEST_FORMAT_RGBA_4444 = 7,
+};
+
+// Format flags
+enum {
+    HWC_TEST_FORMAT_YUV = 0x1,      // Components are Y, U and V
+    HWC_TEST_FORMAT_PLANAR = 0x2,   // Y plane followed by V and U planes
+    HWC_TEST_FORMAT_LEGACY = 0x4,   // Only used when asked for by name
+};
+
+// Position and in gamut range of one component.  The full range is 0 to
+// (1 << bits) - 1.
+struct hwcTestFormatComponent {
+    uint8_t shift;
+    uint8_t bits;
+    uint16_t low, high;
+};
+
+// Characteristics of known graphic formats
+struct hwcTestGraphicFormat {
+    uint32_t format;
+    const char *desc;
+    uint32_t wMod, hMod; // Width/height mod this value must equal zero
+    uint32_t flags;
+    uint32_t bytes;      // Bytes per pixel, or per Y sample when planar
+    uint32_t hSub, vSub; // Chroma subsampling of planar formats
+    uint32_t cAlign;     // Chroma row alignment of planar formats
+    struct hwcTestFormatComponent c[3]; // R, G, B or Y, U, V
+    struct hwcTestFormatComponent a;    // Alpha, 0 bits when there is none
+};
+
+constexpr struct hwcTestGraphicFormat hwcTestGraphicFormat[] = {
+    {HAL_PIXEL_FORMAT_RGBA_8888, "RGBA8888", 1, 1, 0, 4, 1, 1, 1,
+     {{0, 8, 0, 255}, {8, 8, 0, 255}, {16, 8, 0, 255}}, {24, 8, 0, 255}},
+    {HAL_PIXEL_FORMAT_RGBX_8888, "RGBX8888", 1, 1, 0, 4, 1, 1, 1,
+     {{0, 8, 0, 255}, {8, 8, 0, 255}, {16, 8, 0, 255}}, {0, 0, 0, 0}},
+    {HAL_PIXEL_FORMAT_RGB_888,   "RGB888",   1, 1, 0, 3, 1, 1, 1,
+     {{0, 8, 0, 255}, {8, 8, 0, 255}, {16, 8, 0, 255}}, {0, 0, 0, 0}},
+    {HAL_PIXEL_FORMAT_RGB_565,   "RGB565",   1, 1, 0, 2, 1, 1, 1,
+     {{11, 5, 0, 31}, {5, 6, 0, 63}, {0, 5, 0, 31}}, {0, 0, 0, 0}},
+    {HAL_PIXEL_FORMAT_BGRA_8888, "BGRA8888", 1, 1, 0, 4, 1, 1, 1,
+     {{16, 8, 0, 255}, {8, 8, 0, 255}, {0, 8, 0, 255}}, {24, 8, 0, 255}},
+    {HAL_PIXEL_FORMAT_YV12,      "YV12",     2, 2,
+     HWC_TEST_FORMAT_YUV | HWC_TEST_FORMAT_PLANAR, 1, 2, 2, 16,
+     {{0, 8, 16, 235}, {8, 8, 16, 240}, {16, 8, 16, 240}}, {0, 0, 0, 0}},
+    {HWC_TEST_FORMAT_RGBA_5551,  "RGBA5551", 1, 1,
+     HWC_TEST_FORMAT_LEGACY, 2, 1, 1, 1,
+     {{11, 5, 0, 31}, {6, 5, 0, 31}, {1, 5, 0, 31}}, {0, 1, 0, 1}},
+    {HWC_TEST_FORMAT_RGBA_4444,  "RGBA4444", 1, 1,
+     HWC_TEST_FORMAT_LEGACY, 2, 1, 1, 1,
+     {{12, 4, 0, 15}, {8, 4, 0, 15}, {4, 4, 0, 15}}, {0, 4, 0, 15}},
+};
+
+constexpr size_t hwcTestGraphicFormatCount
+    = sizeof(hwcTestGraphicFormat) / sizeof(hwcTestGraphicFormat[0]);
+
+// Plane layout of a planar graphic buffer, in bytes
+struct hwcTestPlaneLayout {
+    uint32_t yStride;
+    uint32_t cStride;
+    uint32_t vOffset;
+    uint32_t uOffset;
+};
+
+inline struct hwcTestPlaneLayout hwcTestPlanes(
+    const struct hwcTestGraphicFormat& format, uint32_t stride,
+    uint32_t height)
+{
+    struct hwcTestPlaneLayout layout;
+
+    layout.yStride = stride;
+    layout.cStride = ((stride / format.hSub) + format.cAlign - 1)
+        & ~(format.cAlign - 1);
+    layout.vOffset = layout.yStride * height;
+    layout.uOffset = layout.vOffset + layout.cStride * (height / format.vSub);
+
+    return layout;
+}
+
+// Compile-time view of the registry entry at Index
+template <size_t Index>
+struct HwcTestFormat {
+    static constexpr const struct hwcTestGraphicFormat& desc(void) {
+        return hwcTestGraphicFormat[Index];
+    }
+
+    static constexpr uint32_t format = hwcTestGraphicFormat[Index].format;
+    static constexpr uint32_t bytes = hwcTestGraphicFormat[Index].bytes;
+    static constexpr bool planar
+        = (hwcTestGraphicFormat[Index].flags & HWC_TEST_FORMAT_PLANAR) != 0;
+
+    // Code of a component, from its fraction of the full range, clamped
+    // to the range the way HwcTestColorConverter::convertToPixels() does
+    static uint32_t code(const struct hwcTestFormatComponent& comp,
+                         float fract) {
+        fract = (fract < 0.0f) ? 0.0f : (fract > 1.0f) ? 1.0f : fract;
+        return (uint32_t) round((((1 << comp.bits) - 1) * fract))
+            << comp.shift;
+    }
+
+    // Fraction of the full range of a component, from a pixel value
+    static float fract(const struct hwcTestFormatComponent& comp,
+                       uint32_t pixel) {
+        uint32_t max = (1 << comp.bits) - 1;
+        return (float) ((pixel >> comp.shift) & max) / (float) max;
+    }
+
+    static uint32_t pack(float c1, float c2, float c3, float alpha) {
+        uint32_t pixel = code(desc().c[0], c1) | code(desc().c[1], c2)
+            | code(desc().c[2], c3);
+        if (desc().a.bits) { pixel |= code(desc().a, alpha); }
+
+        return pixel;
+    }
+
+    // Alpha is 1.0 for formats without it
+    static void unpack(uint32_t pixel, float *c1, float *c2, float *c3,
+                       float *alpha) {
+        *c1 = fract(desc().c[0], pixel);
+        *c2 = fract(desc().c[1], pixel);
+        *c3 = fract(desc().c[2], pixel);
+        *alpha = desc().a.bits ? fract(desc().a, pixel) : 1.0;
+    }
+};
+
+/*
+ * Runs Kernel<Index>::run(args...) for the registry entry of format.
+ * Returns false, without running anything, for an unknown format.
+ */
+template <template <size_t> class Kernel, size_t Index = 0>
+struct HwcTestFormatDispatch {
+    template <typename... Args>
+    static bool run(uint32_t format, Args&&... args) {
+        if (hwcTestGraphicFormat[Index].format == format) {
+            Kernel<Index>::run(std::forward<Args>(args)...);
+            return true;
+        }
+
+        return HwcTestFormatDispatch<Kernel, Index + 1>::run(format,
+            std::forward<Args>(args)...);
+    }
+};
+
+template <template <size_t> class Kernel>
+struct HwcTestFormatDispatch<Kernel, hwcTestGraphicFormatCount> {
+    template <typename... Args>
+    static bool run(uint32_t, Args&&...) { return false; }
+};
+
+#endif /* HWC_TEST_FORMAT_H */
@@ -18,10 +18,30 @@ include $(CLEAR_VARS)
 LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
 LOCAL_MODULE_TAGS := tests
 LOCAL_MODULE:= libglTest
-LOCAL_SRC_FILES:= glTestLib.cpp WindowSurface.cpp
+LOCAL_SRC_FILES:= glTestLib.cpp glTestBench.cpp glTestExt.cpp \
+	glTestFrame.cpp glTestProgram.cpp glTestState.cpp WindowSurface.cpp
 LOCAL_C_INCLUDES += system/extras/tests/include \
 	$(call include-path-for, opengl-tests-includes)
 
 LOCAL_CFLAGS := -DGL_GLEXT_PROTOTYPES -DEGL_EGLEXT_PROTOTYPES -Wall -Wextra -Werror
+LOCAL_CXX_STL := libc++
 
 include $(BUILD_STATIC_LIBRARY)
+
+# Host build of the render target, for running the offscreen backends
+# against a software EGL (e.g. Mesa llvmpipe) on build hosts, and of the
+# GLTestBuffer stand-in for GraphicBuffer.
+include $(CLEAR_VARS)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+LOCAL_MODULE_TAGS := tests
+LOCAL_MODULE:= libglTest_host
+LOCAL_SRC_FILES:= glTestBench.cpp glTestBuffer.cpp glTestExt.cpp \
+	glTestFrame.cpp WindowSurface.cpp
+LOCAL_C_INCLUDES += $(call include-path-for, opengl-tests-includes) \
+	hardware/libhardware/include
+LOCAL_STATIC_LIBRARIES := libutils libcutils
+
+LOCAL_CFLAGS := -DEGL_EGLEXT_PROTOTYPES -Wall -Wextra -Werror
+LOCAL_CXX_STL := libc++
+
+include $(BUILD_HOST_STATIC_LIBRARY)
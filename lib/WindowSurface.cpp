@@ -16,21 +16,186 @@
 
 #include <WindowSurface.h>
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+
+#include <glTestExt.h>
+
+#ifdef __ANDROID__
 #include <gui/SurfaceComposerClient.h>
 #include <gui/ISurfaceComposer.h>
 #include <gui/Surface.h>
 #include <ui/DisplayInfo.h>
 
+#include <EGLUtils.h>
+#endif
+
 using namespace android;
 
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+// Framebuffer object entry points and tokens.  These are looked up at
+// runtime, because libglTest is linked into both GLES 1.x tests (where
+// they come from GL_OES_framebuffer_object) and GLES 2.0 tests (where
+// they are core), and the token values are identical between the two.
+#define WS_GL_FRAMEBUFFER           0x8D40
+#define WS_GL_RENDERBUFFER          0x8D41
+#define WS_GL_RGBA8                 0x8058
+#define WS_GL_RGBA4                 0x8056
+#define WS_GL_RGB565                0x8D62
+#define WS_GL_DEPTH_COMPONENT16     0x81A5
+#define WS_GL_COLOR_ATTACHMENT0     0x8CE0
+#define WS_GL_DEPTH_ATTACHMENT      0x8D00
+#define WS_GL_FRAMEBUFFER_COMPLETE  0x8CD5
+
+typedef void (*PFNWSGENPROC)(int n, uint32_t* names);
+typedef void (*PFNWSDELETEPROC)(int n, const uint32_t* names);
+typedef void (*PFNWSBINDPROC)(uint32_t target, uint32_t name);
+typedef void (*PFNWSSTORAGEPROC)(uint32_t target, uint32_t format,
+        int width, int height);
+typedef void (*PFNWSATTACHPROC)(uint32_t target, uint32_t attachment,
+        uint32_t rbTarget, uint32_t rb);
+typedef uint32_t (*PFNWSCHECKPROC)(uint32_t target);
+
+// Looked up once each for the OES and the core names
+static struct FramebufferProcs {
+    bool resolved;
+    PFNWSGENPROC genFramebuffers;
+    PFNWSDELETEPROC deleteFramebuffers;
+    PFNWSBINDPROC bindFramebuffer;
+    PFNWSGENPROC genRenderbuffers;
+    PFNWSDELETEPROC deleteRenderbuffers;
+    PFNWSBINDPROC bindRenderbuffer;
+    PFNWSSTORAGEPROC renderbufferStorage;
+    PFNWSATTACHPROC framebufferRenderbuffer;
+    PFNWSCHECKPROC checkFramebufferStatus;
+} framebufferProcs[2];
+
+// Entry points of the OES or the core names, NULL if any is missing
+static const FramebufferProcs* framebufferProcsResolve(bool oes) {
+    FramebufferProcs* procs = &framebufferProcs[oes ? 1 : 0];
+    if (!procs->resolved) {
+#define X(member, type, name) \
+        procs->member = (type) eglGetProcAddress( \
+                oes ? name "OES" : name)
+        X(genFramebuffers, PFNWSGENPROC, "glGenFramebuffers");
+        X(deleteFramebuffers, PFNWSDELETEPROC, "glDeleteFramebuffers");
+        X(bindFramebuffer, PFNWSBINDPROC, "glBindFramebuffer");
+        X(genRenderbuffers, PFNWSGENPROC, "glGenRenderbuffers");
+        X(deleteRenderbuffers, PFNWSDELETEPROC, "glDeleteRenderbuffers");
+        X(bindRenderbuffer, PFNWSBINDPROC, "glBindRenderbuffer");
+        X(renderbufferStorage, PFNWSSTORAGEPROC, "glRenderbufferStorage");
+        X(framebufferRenderbuffer, PFNWSATTACHPROC,
+                "glFramebufferRenderbuffer");
+        X(checkFramebufferStatus, PFNWSCHECKPROC,
+                "glCheckFramebufferStatus");
+#undef X
+        procs->resolved = true;
+    }
+
+    if (procs->genFramebuffers == NULL || procs->deleteFramebuffers == NULL
+            || procs->bindFramebuffer == NULL
+            || procs->genRenderbuffers == NULL
+            || procs->deleteRenderbuffers == NULL
+            || procs->bindRenderbuffer == NULL
+            || procs->renderbufferStorage == NULL
+            || procs->framebufferRenderbuffer == NULL
+            || procs->checkFramebufferStatus == NULL) {
+        return NULL;
+    }
+    return procs;
+}
+
+static const struct {
+    WindowSurface::Backend backend;
+    const char* name;
+} backendNames[] = {
+    { WindowSurface::BACKEND_SURFACEFLINGER, "surfaceflinger" },
+    { WindowSurface::BACKEND_PBUFFER,        "pbuffer" },
+    { WindowSurface::BACKEND_SURFACELESS,    "surfaceless" },
+    { WindowSurface::BACKEND_SOFTWARE,       "software" },
+};
+
 WindowSurface::WindowSurface() {
+    Backend backend = BACKEND_SURFACEFLINGER;
+    uint32_t width = 0, height = 0;
+
+    const char* env = getenv("GLTEST_SURFACE");
+    if (env != NULL && *env != '\0' && !parseBackend(env, &backend)) {
+        fprintf(stderr, "Unknown GLTEST_SURFACE backend \"%s\", "
+                "using %s\n", env, backendName(backend));
+    }
+
+    env = getenv("GLTEST_SURFACE_SIZE");
+    if (env != NULL && *env != '\0') {
+        if (sscanf(env, "%ux%u", &width, &height) != 2) {
+            fprintf(stderr, "Invalid GLTEST_SURFACE_SIZE \"%s\", "
+                    "expected WIDTHxHEIGHT\n", env);
+            width = height = 0;
+        }
+    }
+
+    init(backend, width, height);
+}
+
+WindowSurface::WindowSurface(Backend backend, uint32_t width,
+        uint32_t height) {
+    init(backend, width, height);
+}
+
+WindowSurface::~WindowSurface() {
+    while (!mFramebuffers.empty()) {
+        releaseFramebuffer(mSurfacelessDisplay,
+                mFramebuffers.back().context);
+    }
+}
+
+void WindowSurface::init(Backend backend, uint32_t width, uint32_t height) {
+    mBackend = backend;
+    mWidth = width ? width : defaultOffscreenWidth;
+    mHeight = height ? height : defaultOffscreenHeight;
+    mSurfacelessDisplay = EGL_NO_DISPLAY;
+
+    switch (mBackend) {
+    case BACKEND_SURFACEFLINGER:
+        if (!initSurfaceFlinger()) {
+            return;
+        }
+        break;
+
+    case BACKEND_SOFTWARE:
+        // Must be in place before the first EGL call.  Don't override
+        // a driver explicitly requested by the caller.
+        setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+        setenv("GALLIUM_DRIVER", "llvmpipe", 0);
+        break;
+
+    case BACKEND_PBUFFER:
+    case BACKEND_SURFACELESS:
+        break;
+    }
+
+    if (isOffscreen()) {
+        fprintf(stderr, "WindowSurface: %s backend, %ux%u\n",
+                backendName(mBackend), mWidth, mHeight);
+    }
+}
+
+bool WindowSurface::initSurfaceFlinger() {
+#ifdef __ANDROID__
     status_t err;
 
     sp<SurfaceComposerClient> surfaceComposerClient = new SurfaceComposerClient;
     err = surfaceComposerClient->initCheck();
     if (err != NO_ERROR) {
         fprintf(stderr, "SurfaceComposerClient::initCheck error: %#x\n", err);
-        return;
+        return false;
     }
 
     // Get main display parameters.
@@ -40,7 +205,7 @@ WindowSurface::WindowSurface() {
     err = SurfaceComposerClient::getDisplayInfo(mainDpy, &mainDpyInfo);
     if (err != NO_ERROR) {
         fprintf(stderr, "ERROR: unable to get display characteristics\n");
-        return;
+        return false;
     }
 
     uint32_t width, height;
@@ -59,28 +224,304 @@ WindowSurface::WindowSurface() {
             PIXEL_FORMAT_RGBX_8888, ISurfaceComposerClient::eOpaque);
     if (sc == NULL || !sc->isValid()) {
         fprintf(stderr, "Failed to create SurfaceControl\n");
-        return;
+        return false;
     }
 
     SurfaceComposerClient::openGlobalTransaction();
     err = sc->setLayer(0x7FFFFFFF);     // always on top
     if (err != NO_ERROR) {
         fprintf(stderr, "SurfaceComposer::setLayer error: %#x\n", err);
-        return;
+        return false;
     }
 
     err = sc->show();
     if (err != NO_ERROR) {
         fprintf(stderr, "SurfaceComposer::show error: %#x\n", err);
-        return;
+        return false;
     }
     SurfaceComposerClient::closeGlobalTransaction();
 
     mSurfaceControl = sc;
+    mWidth = width;
+    mHeight = height;
+    return true;
+#else
+    fprintf(stderr, "SurfaceFlinger backend not available on this host\n");
+    return false;
+#endif
 }
 
 EGLNativeWindowType WindowSurface::getSurface() const {
-    sp<ANativeWindow> anw = mSurfaceControl->getSurface();
-    return (EGLNativeWindowType) anw.get();
+#ifdef __ANDROID__
+    if (mBackend == BACKEND_SURFACEFLINGER && mSurfaceControl != NULL) {
+        sp<ANativeWindow> anw = mSurfaceControl->getSurface();
+        return (EGLNativeWindowType) anw.get();
+    }
+#endif
+    return (EGLNativeWindowType) 0;
+}
+
+EGLDisplay WindowSurface::getDisplay() const {
+    if (mBackend == BACKEND_SOFTWARE) {
+        // Prefer the Mesa surfaceless platform, which needs neither a
+        // window system nor a GPU.
+        const char* exts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (exts != NULL && strstr(exts, "EGL_MESA_platform_surfaceless")) {
+            PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                    (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+                    eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (getPlatformDisplay != NULL) {
+                EGLDisplay dpy = getPlatformDisplay(
+                        EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY,
+                        NULL);
+                if (dpy != EGL_NO_DISPLAY) {
+                    return dpy;
+                }
+            }
+        }
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+status_t WindowSurface::selectConfig(EGLDisplay dpy, EGLint const* attrs,
+        EGLConfig* outConfig) const {
+    if (!attrs || outConfig == NULL)
+        return BAD_VALUE;
+
+#ifdef __ANDROID__
+    if (mBackend == BACKEND_SURFACEFLINGER) {
+        return EGLUtils::selectConfigForNativeWindow(dpy, attrs,
+                getSurface(), outConfig);
+    }
+#endif
+
+    // Replace the caller's surface type with the one this backend
+    // renders to.  Surfaceless rendering places no requirement on it.
+    size_t n = 0;
+    while (attrs[n] != EGL_NONE) {
+        n += 2;
+    }
+    EGLint* const offscreenAttrs = (EGLint*)malloc(sizeof(EGLint) * (n + 3));
+    if (offscreenAttrs == NULL)
+        return NO_MEMORY;
+    size_t j = 0;
+    for (size_t i = 0; i < n; i += 2) {
+        if (attrs[i] == EGL_SURFACE_TYPE) {
+            continue;
+        }
+        offscreenAttrs[j++] = attrs[i];
+        offscreenAttrs[j++] = attrs[i + 1];
+    }
+    offscreenAttrs[j++] = EGL_SURFACE_TYPE;
+    offscreenAttrs[j++] = (mBackend == BACKEND_SURFACELESS)
+            ? 0 : EGL_PBUFFER_BIT;
+    offscreenAttrs[j] = EGL_NONE;
+
+    EGLint numConfigs = 0;
+    EGLBoolean rv = eglChooseConfig(dpy, offscreenAttrs, outConfig, 1,
+            &numConfigs);
+    free(offscreenAttrs);
+    if (rv == EGL_FALSE)
+        return BAD_VALUE;
+
+    return (numConfigs > 0) ? NO_ERROR : NAME_NOT_FOUND;
+}
+
+EGLSurface WindowSurface::createEGLSurface(EGLDisplay dpy, EGLConfig config) {
+    switch (mBackend) {
+    case BACKEND_SURFACEFLINGER:
+        return eglCreateWindowSurface(dpy, config, getSurface(), NULL);
+
+    case BACKEND_PBUFFER:
+    case BACKEND_SOFTWARE: {
+        EGLint pbufferAttribs[] = {
+                EGL_WIDTH, (EGLint) mWidth,
+                EGL_HEIGHT, (EGLint) mHeight,
+                EGL_NONE };
+        return eglCreatePbufferSurface(dpy, config, pbufferAttribs);
+    }
+
+    case BACKEND_SURFACELESS:
+        break;
+    }
+
+    return EGL_NO_SURFACE;
+}
+
+EGLBoolean WindowSurface::makeCurrent(EGLDisplay dpy, EGLSurface surface,
+        EGLContext context) {
+    if (mBackend != BACKEND_SURFACELESS) {
+        return eglMakeCurrent(dpy, surface, surface, context);
+    }
+
+    if (dpy != mSurfacelessDisplay) {
+        if (!glTestHasExtension(eglQueryString(dpy, EGL_EXTENSIONS),
+                "EGL_KHR_surfaceless_context")) {
+            fprintf(stderr, "EGL_KHR_surfaceless_context not supported\n");
+            return EGL_FALSE;
+        }
+        mSurfacelessDisplay = dpy;
+    }
+
+    if (eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, context)
+            != EGL_TRUE) {
+        return EGL_FALSE;
+    }
+    if (context == EGL_NO_CONTEXT) {
+        return EGL_TRUE;
+    }
+
+    return initFramebuffer(dpy, context) ? EGL_TRUE : EGL_FALSE;
+}
+
+EGLBoolean WindowSurface::destroyContext(EGLDisplay dpy,
+        EGLContext context) {
+    releaseFramebuffer(dpy, context);
+    return eglDestroyContext(dpy, context);
+}
+
+// Color renderbuffer format of a context.  RGBA8 needs GL_OES_rgb8_rgba8
+// on GLES, without it the 16-bit format matching the config's alpha is
+// used.
+static uint32_t colorbufferFormat(EGLDisplay dpy, EGLContext context) {
+    if (glTestHasExtension((const char*) glGetString(GL_EXTENSIONS),
+            "GL_OES_rgb8_rgba8")) {
+        return WS_GL_RGBA8;
+    }
+
+    EGLint configId = 0, numConfigs = 0, alphaSize = 0;
+    EGLConfig config;
+    eglQueryContext(dpy, context, EGL_CONFIG_ID, &configId);
+    EGLint attrs[] = { EGL_CONFIG_ID, configId, EGL_NONE };
+    if (eglChooseConfig(dpy, attrs, &config, 1, &numConfigs)
+            && numConfigs > 0) {
+        eglGetConfigAttrib(dpy, config, EGL_ALPHA_SIZE, &alphaSize);
+    }
+    return (alphaSize > 0) ? WS_GL_RGBA4 : WS_GL_RGB565;
+}
+
+// Deletes the objects of a framebuffer, with its context current
+static void deleteFramebuffer(const FramebufferProcs* procs,
+        uint32_t framebuffer, const uint32_t renderbuffers[2]) {
+    procs->deleteFramebuffers(1, &framebuffer);
+    procs->deleteRenderbuffers(2, renderbuffers);
 }
 
+void WindowSurface::releaseFramebuffer(EGLDisplay dpy, EGLContext context) {
+    for (size_t i = 0; i < mFramebuffers.size(); i++) {
+        if (mFramebuffers[i].context != context) {
+            continue;
+        }
+        Framebuffer fb = mFramebuffers[i];
+        mFramebuffers.erase(mFramebuffers.begin() + i);
+
+        // The objects can only be deleted with their context current.
+        // When it can't be made current, e.g. it is current on another
+        // thread, they go with the context.
+        EGLDisplay curDpy = eglGetCurrentDisplay();
+        EGLSurface curDraw = eglGetCurrentSurface(EGL_DRAW);
+        EGLSurface curRead = eglGetCurrentSurface(EGL_READ);
+        EGLContext curContext = eglGetCurrentContext();
+        if (curContext != context && eglMakeCurrent(dpy, EGL_NO_SURFACE,
+                EGL_NO_SURFACE, context) != EGL_TRUE) {
+            return;
+        }
+        uint32_t renderbuffers[2] = { fb.colorbuffer, fb.depthbuffer };
+        deleteFramebuffer(framebufferProcsResolve(fb.oes), fb.framebuffer,
+                renderbuffers);
+        if (curContext != context) {
+            eglMakeCurrent((curContext == EGL_NO_CONTEXT) ? dpy : curDpy,
+                    curDraw, curRead, curContext);
+        }
+        return;
+    }
+}
+
+bool WindowSurface::initFramebuffer(EGLDisplay dpy, EGLContext context) {
+    for (size_t i = 0; i < mFramebuffers.size(); i++) {
+        const Framebuffer& fb = mFramebuffers[i];
+        if (fb.context == context) {
+            framebufferProcsResolve(fb.oes)->bindFramebuffer(
+                    WS_GL_FRAMEBUFFER, fb.framebuffer);
+            return true;
+        }
+    }
+
+    EGLint clientVersion = 1;
+    eglQueryContext(dpy, context, EGL_CONTEXT_CLIENT_VERSION, &clientVersion);
+    Framebuffer fb;
+    fb.context = context;
+    fb.oes = (clientVersion < 2);
+    const FramebufferProcs* procs = framebufferProcsResolve(fb.oes);
+    if (procs == NULL) {
+        fprintf(stderr, "Framebuffer objects not supported\n");
+        return false;
+    }
+
+    procs->genFramebuffers(1, &fb.framebuffer);
+    procs->genRenderbuffers(1, &fb.colorbuffer);
+    procs->genRenderbuffers(1, &fb.depthbuffer);
+
+    procs->bindRenderbuffer(WS_GL_RENDERBUFFER, fb.colorbuffer);
+    procs->renderbufferStorage(WS_GL_RENDERBUFFER,
+            colorbufferFormat(dpy, context), mWidth, mHeight);
+    procs->bindRenderbuffer(WS_GL_RENDERBUFFER, fb.depthbuffer);
+    procs->renderbufferStorage(WS_GL_RENDERBUFFER, WS_GL_DEPTH_COMPONENT16,
+            mWidth, mHeight);
+
+    procs->bindFramebuffer(WS_GL_FRAMEBUFFER, fb.framebuffer);
+    procs->framebufferRenderbuffer(WS_GL_FRAMEBUFFER,
+            WS_GL_COLOR_ATTACHMENT0, WS_GL_RENDERBUFFER, fb.colorbuffer);
+    procs->framebufferRenderbuffer(WS_GL_FRAMEBUFFER, WS_GL_DEPTH_ATTACHMENT,
+            WS_GL_RENDERBUFFER, fb.depthbuffer);
+
+    uint32_t status = procs->checkFramebufferStatus(WS_GL_FRAMEBUFFER);
+    if (status != WS_GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Framebuffer incomplete: %#x\n", status);
+        uint32_t renderbuffers[2] = { fb.colorbuffer, fb.depthbuffer };
+        deleteFramebuffer(procs, fb.framebuffer, renderbuffers);
+        return false;
+    }
+    mFramebuffers.push_back(fb);
+    return true;
+}
+
+EGLBoolean WindowSurface::swapBuffers(EGLDisplay dpy, EGLSurface surface) {
+    if (mBackend == BACKEND_SURFACEFLINGER) {
+        return eglSwapBuffers(dpy, surface);
+    }
+
+    // Nothing to present.  Flush so that each "frame" is submitted to
+    // the GPU at the same point it would have been by a real swap.
+    glFlush();
+    return EGL_TRUE;
+}
+
+const char* WindowSurface::backendName(Backend backend) {
+    for (size_t i = 0; i < sizeof(backendNames) / sizeof(backendNames[0]);
+            i++) {
+        if (backendNames[i].backend == backend) {
+            return backendNames[i].name;
+        }
+    }
+    return "unknown";
+}
+
+bool WindowSurface::parseBackend(const char* name, Backend* outBackend) {
+    if (name == NULL) {
+        return false;
+    }
+    if (strcmp(name, "sf") == 0) {
+        *outBackend = BACKEND_SURFACEFLINGER;
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(backendNames) / sizeof(backendNames[0]);
+            i++) {
+        if (strcmp(name, backendNames[i].name) == 0) {
+            *outBackend = backendNames[i].backend;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Graphics Test Benchmark Harness
+ */
+
+#include <glTestBench.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+using namespace std;
+
+static const double nsPerSec = 1e9;
+
+// Scale of the median absolute deviation that makes it a consistent
+// estimator of the standard deviation of normally distributed samples.
+static const double madScale = 1.4826;
+
+// Two sided 95% z value, good enough once minIterations samples are in.
+static const double z95 = 1.96;
+
+GLTestBenchConfig::GLTestBenchConfig() :
+    warmupIterations(3), minIterations(10), maxIterations(1000),
+    maxSeconds(10.0), targetRelCI(0.02), checkConvergence(true),
+    outlierMads(5.0), workPerIteration(0.0), workUnits(NULL)
+{
+}
+
+uint64_t glTestBenchNow()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/*
+ * Percentile of sorted samples, linearly interpolated between the
+ * closest ranks.
+ */
+static double percentile(const vector<double>& sorted, double p)
+{
+    if (sorted.empty()) { return 0.0; }
+
+    double rank = p / 100.0 * (sorted.size() - 1);
+    size_t lo = (size_t) floor(rank);
+    size_t hi = min(lo + 1, sorted.size() - 1);
+
+    return sorted[lo] + (rank - lo) * (sorted[hi] - sorted[lo]);
+}
+
+static void meanStddev(const vector<double>& samples, double& mean,
+                       double& stddev)
+{
+    mean = stddev = 0.0;
+    if (samples.empty()) { return; }
+
+    for (size_t i = 0; i < samples.size(); i++) { mean += samples[i]; }
+    mean /= samples.size();
+
+    if (samples.size() < 2) { return; }
+    double sumSq = 0.0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        sumSq += (samples[i] - mean) * (samples[i] - mean);
+    }
+    stddev = sqrt(sumSq / (samples.size() - 1));
+}
+
+/*
+ * Summarize
+ *
+ * Sorts the given samples, rejects outliers and fills in result.
+ * Samples are left sorted with the outliers removed.
+ */
+void glTestBenchSummarize(const char *name, const GLTestBenchConfig& config,
+                          vector<double>& samples, GLTestBenchResult& result)
+{
+    result.name = name;
+    result.workUnits = config.workUnits;
+    result.checkConvergence = config.checkConvergence;
+    result.rejected = 0;
+    sort(samples.begin(), samples.end());
+
+    if ((config.outlierMads > 0.0) && (samples.size() >= 3)) {
+        double median = percentile(samples, 50.0);
+        vector<double> deviations(samples.size());
+        for (size_t i = 0; i < samples.size(); i++) {
+            deviations[i] = fabs(samples[i] - median);
+        }
+        sort(deviations.begin(), deviations.end());
+        double limit = config.outlierMads * madScale
+            * percentile(deviations, 50.0);
+
+        // A zero MAD means most samples are identical, in which case
+        // nothing is considered an outlier.
+        if (limit > 0.0) {
+            vector<double>::iterator first = lower_bound(samples.begin(),
+                samples.end(), median - limit);
+            vector<double>::iterator last = upper_bound(samples.begin(),
+                samples.end(), median + limit);
+            result.rejected = samples.size() - (last - first);
+            samples.erase(last, samples.end());
+            samples.erase(samples.begin(), first);
+        }
+    }
+
+    result.samples = samples.size();
+    result.min = samples.empty() ? 0.0 : samples.front();
+    result.max = samples.empty() ? 0.0 : samples.back();
+    result.median = percentile(samples, 50.0);
+    result.p90 = percentile(samples, 90.0);
+    result.p99 = percentile(samples, 99.0);
+    meanStddev(samples, result.mean, result.stddev);
+    result.ci95 = (samples.size() < 2) ? 0.0
+        : z95 * result.stddev / sqrt((double) samples.size());
+    result.throughput = ((config.workPerIteration > 0.0)
+        && (result.median > 0.0))
+        ? config.workPerIteration * nsPerSec / result.median : 0.0;
+}
+
+/*
+ * Report
+ *
+ * Writes result in the format selected by GLTEST_BENCH_FORMAT, to the
+ * file named by GLTEST_BENCH_OUTPUT or stdout.  The CSV header is
+ * written once per process.
+ */
+void glTestBenchReport(const GLTestBenchResult& result)
+{
+    static bool csvHeaderDone;
+    const char *format = getenv("GLTEST_BENCH_FORMAT");
+    const char *path = getenv("GLTEST_BENCH_OUTPUT");
+    const char *units = (result.workUnits == NULL) ? "" : result.workUnits;
+    FILE *out = stdout;
+
+    if ((path != NULL) && (*path != '\0')) {
+        if ((out = fopen(path, "a")) == NULL) {
+            fprintf(stderr, "glTestBench: unable to open %s, using stdout\n",
+                    path);
+            out = stdout;
+        }
+    }
+
+    if ((format != NULL) && (strcmp(format, "json") == 0)) {
+        fprintf(out, "{\"name\": \"");
+        for (const char *p = result.name.c_str(); *p != '\0'; p++) {
+            if ((*p == '"') || (*p == '\\')) { fputc('\\', out); }
+            fputc(*p, out);
+        }
+        fprintf(out, "\", \"samples\": %u, \"rejected\": %u, "
+                "\"converged\": %s, \"min_ns\": %.0f, \"median_ns\": %.0f, "
+                "\"mean_ns\": %.0f, \"p90_ns\": %.0f, \"p99_ns\": %.0f, "
+                "\"max_ns\": %.0f, \"stddev_ns\": %.0f, \"ci95_ns\": %.0f, "
+                "\"throughput\": %f, \"units\": \"%s\"}\n",
+                result.samples, result.rejected,
+                !result.checkConvergence ? "null"
+                    : result.converged ? "true" : "false",
+                result.min, result.median, result.mean, result.p90,
+                result.p99, result.max, result.stddev, result.ci95,
+                result.throughput, units);
+    } else if ((format != NULL) && (strcmp(format, "csv") == 0)) {
+        if (!csvHeaderDone) {
+            fprintf(out, "name,samples,rejected,converged,min_ns,median_ns,"
+                    "mean_ns,p90_ns,p99_ns,max_ns,stddev_ns,ci95_ns,"
+                    "throughput,units\n");
+            csvHeaderDone = true;
+        }
+        fprintf(out, "\"%s\",%u,%u,%s,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,"
+                "%.0f,%f,%s\n", result.name.c_str(), result.samples,
+                result.rejected, !result.checkConvergence ? ""
+                    : result.converged ? "1" : "0", result.min, result.median,
+                result.mean, result.p90, result.p99, result.max,
+                result.stddev, result.ci95, result.throughput, units);
+    } else {
+        fprintf(out, "%s: n=%u rejected=%u%s\n", result.name.c_str(),
+                result.samples, result.rejected,
+                (!result.checkConvergence || result.converged) ? ""
+                    : " (not converged)");
+        fprintf(out, "  min %.3f ms, median %.3f ms, mean %.3f ms "
+                "+/- %.3f ms\n", result.min / 1e6, result.median / 1e6,
+                result.mean / 1e6, result.ci95 / 1e6);
+        fprintf(out, "  p90 %.3f ms, p99 %.3f ms, max %.3f ms, "
+                "stddev %.3f ms\n", result.p90 / 1e6, result.p99 / 1e6,
+                result.max / 1e6, result.stddev / 1e6);
+        if (result.throughput > 0.0) {
+            fprintf(out, "  %f %s/sec\n", result.throughput, units);
+        }
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    } else {
+        fflush(out);
+    }
+}
+
+GLTestBench::GLTestBench(const char *name, const GLTestBenchConfig& config) :
+    _name(name), _config(config), _warmupLeft(config.warmupIterations),
+    _sum(0.0), _sumSq(0.0), _startNs(0), _iterStartNs(0), _running(false),
+    _finished(false)
+{
+    _samples.reserve(min(_config.maxIterations, 4096U));
+}
+
+bool GLTestBench::done() const
+{
+    if (_finished) { return true; }
+    if (_warmupLeft > 0) { return false; }
+    if (_samples.size() >= _config.maxIterations) { return true; }
+    if (!_samples.empty()
+        && ((glTestBenchNow() - _startNs) / nsPerSec >= _config.maxSeconds)) {
+        return true;
+    }
+    if (_samples.size() < max(_config.minIterations, 2U)) { return false; }
+    if (!_config.checkConvergence) { return false; }
+
+    // The running estimate includes outliers, so it's pessimistic;
+    // the reported interval is computed after they are rejected.
+    double n = _samples.size();
+    double mean = _sum / n;
+    double var = max((_sumSq - n * mean * mean) / (n - 1), 0.0);
+    double ci = z95 * sqrt(var / n);
+
+    return (mean > 0.0) && (ci / mean <= _config.targetRelCI);
+}
+
+void GLTestBench::addSample(double ns)
+{
+    if (_warmupLeft > 0) {
+        _warmupLeft--;
+        return;
+    }
+    if (_samples.empty()) { _startNs = glTestBenchNow(); }
+    _samples.push_back(ns);
+    _sum += ns;
+    _sumSq += ns * ns;
+}
+
+bool GLTestBench::iterate()
+{
+    uint64_t now = glTestBenchNow();
+
+    if (_running) {
+        addSample((double) (now - _iterStartNs));
+        _running = false;
+    }
+    if (done()) {
+        finish();
+        return false;
+    }
+
+    _running = true;
+    _iterStartNs = glTestBenchNow();
+    return true;
+}
+
+void GLTestBench::finish()
+{
+    if (_finished) { return; }
+
+    // Converged only if the cap wasn't what stopped the measurement
+    bool capped = (_samples.size() >= _config.maxIterations)
+        || (!_samples.empty()
+            && ((glTestBenchNow() - _startNs) / nsPerSec
+                >= _config.maxSeconds));
+    glTestBenchSummarize(_name.c_str(), _config, _samples, _result);
+    _result.converged = !capped;
+    _finished = true;
+}
+
+const GLTestBenchResult& GLTestBench::result()
+{
+    finish();
+    return _result;
+}
+
+void GLTestBench::report()
+{
+    glTestBenchReport(result());
+}
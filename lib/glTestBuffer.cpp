@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Graphics Test Buffer - host stand-in for GraphicBuffer
+ *
+ * Only built for hosts; on device GLTestBuffer is GraphicBuffer itself.
+ */
+
+#include <glTestBuffer.h>
+#include <hwcTestFormat.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace android;
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB 0x0004U
+#endif
+
+static const size_t hugePageSize = 2 * 1024 * 1024;
+static const size_t cacheLineSize = 64;
+
+// Registry entry of a format, or NULL when it's unknown
+static const struct hwcTestGraphicFormat *formatLookup(int format)
+{
+    for (size_t n1 = 0; n1 < hwcTestGraphicFormatCount; n1++) {
+        if (hwcTestGraphicFormat[n1].format == (uint32_t) format) {
+            return &hwcTestGraphicFormat[n1];
+        }
+    }
+
+    return NULL;
+}
+
+GLTestBufferConfig::GLTestBufferConfig()
+    : strideAlign(16), hugePages(false), uncached(false)
+{
+    const char *env = getenv("GLTEST_BUFFER_ALIGN");
+    if (env) {
+        unsigned long value = strtoul(env, NULL, 0);
+        if (value == 0 || (value & (value - 1)) != 0) {
+            fprintf(stderr, "Invalid GLTEST_BUFFER_ALIGN \"%s\", "
+                    "using %u\n", env, strideAlign);
+        } else {
+            strideAlign = value;
+        }
+    }
+
+    env = getenv("GLTEST_BUFFER_HUGEPAGES");
+    hugePages = env && atoi(env) != 0;
+
+    env = getenv("GLTEST_BUFFER_UNCACHED");
+    uncached = env && atoi(env) != 0;
+}
+
+// memfd_create() only has a libc wrapper from glibc 2.27
+static int memfdCreate(const char *name, unsigned int flags)
+{
+#ifdef SYS_memfd_create
+    return syscall(SYS_memfd_create, name, flags);
+#else
+    (void) name;
+    (void) flags;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+GLTestBuffer::GLTestBuffer(uint32_t width, uint32_t height, int format,
+        uint32_t usage)
+    : handle(NULL), mWidth(width), mHeight(height), mStride(0),
+      mFormat(format), mUsage(usage), mUncached(false), mStatus(NO_INIT),
+      mFd(-1), mSize(0), mMapSize(0), mBase(NULL), mLocked(false)
+{
+    init(GLTestBufferConfig());
+}
+
+GLTestBuffer::GLTestBuffer(uint32_t width, uint32_t height, int format,
+        uint32_t usage, const GLTestBufferConfig& config)
+    : handle(NULL), mWidth(width), mHeight(height), mStride(0),
+      mFormat(format), mUsage(usage), mUncached(false), mStatus(NO_INIT),
+      mFd(-1), mSize(0), mMapSize(0), mBase(NULL), mLocked(false)
+{
+    init(config);
+}
+
+static GLTestBuffer::FreeHook freeHook;
+
+void GLTestBuffer::setFreeHook(FreeHook hook)
+{
+    freeHook = hook;
+}
+
+GLTestBuffer::~GLTestBuffer()
+{
+    if (handle && freeHook) {
+        freeHook(handle);
+    }
+    if (mBase) {
+        munmap(mBase, mMapSize);
+    }
+    if (handle) {
+        native_handle_t *h = const_cast<native_handle_t *>(handle);
+        native_handle_close(h);
+        native_handle_delete(h);
+    } else if (mFd >= 0) {
+        close(mFd);
+    }
+}
+
+void GLTestBuffer::init(const GLTestBufferConfig& config)
+{
+    mUncached = config.uncached;
+
+    if (mWidth == 0 || mHeight == 0) {
+        mStatus = BAD_VALUE;
+        return;
+    }
+
+    const struct hwcTestGraphicFormat *desc = formatLookup(mFormat);
+    if (desc == NULL) {
+        mStatus = BAD_VALUE;
+        return;
+    }
+    bool planar = (desc->flags & HWC_TEST_FORMAT_PLANAR) != 0;
+
+    // The Y stride of a planar format is aligned at least as much as its
+    // chroma rows, as with gralloc
+    uint32_t align = config.strideAlign;
+    if (planar && align < desc->cAlign) {
+        align = desc->cAlign;
+    }
+    mStride = (mWidth + align - 1) & ~(align - 1);
+
+    mSize = (size_t) mStride * mHeight * desc->bytes;
+    if (planar) {
+        struct hwcTestPlaneLayout planes
+            = hwcTestPlanes(*desc, mStride * desc->bytes, mHeight);
+        mSize = planes.uOffset
+            + (size_t) planes.cStride * (mHeight / desc->vSub);
+    }
+
+    // Huge pages come from hugetlbfs when it has pages reserved, and
+    // otherwise from transparent huge pages when the kernel allows them
+    // for shared memory.  The hugetlbfs mapping is populated up front, so
+    // that a shortage of reserved pages fails here rather than as a
+    // SIGBUS on first touch.
+    bool hugeTlb = false;
+    if (config.hugePages) {
+        mMapSize = (mSize + hugePageSize - 1) & ~(hugePageSize - 1);
+        mFd = memfdCreate("GLTestBuffer", MFD_CLOEXEC | MFD_HUGETLB);
+        if (mFd >= 0 && ftruncate(mFd, mMapSize) == 0) {
+            mBase = mmap(NULL, mMapSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, mFd, 0);
+            hugeTlb = mBase != MAP_FAILED;
+        }
+        if (!hugeTlb && mFd >= 0) {
+            close(mFd);
+            mFd = -1;
+        }
+    }
+    if (!hugeTlb) {
+        size_t pageSize = sysconf(_SC_PAGESIZE);
+        mMapSize = (mSize + pageSize - 1) & ~(pageSize - 1);
+        mFd = memfdCreate("GLTestBuffer", MFD_CLOEXEC);
+        if (mFd >= 0 && ftruncate(mFd, mMapSize) != 0) {
+            mStatus = -errno;
+            return;
+        }
+
+        if (mFd >= 0) {
+            mBase = mmap(NULL, mMapSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    mFd, 0);
+        } else {
+            mBase = mmap(NULL, mMapSize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+    }
+    if (mBase == MAP_FAILED) {
+        mBase = NULL;
+        mStatus = -errno;
+        return;
+    }
+#ifdef MADV_HUGEPAGE
+    if (config.hugePages && !hugeTlb) {
+        madvise(mBase, mMapSize, MADV_HUGEPAGE);
+    }
+#endif
+
+    native_handle_t *h = native_handle_create(mFd >= 0 ? 1 : 0, 4);
+    if (h == NULL) {
+        mStatus = NO_MEMORY;
+        return;
+    }
+    int n = 0;
+    if (mFd >= 0) {
+        h->data[n++] = mFd;
+    }
+    h->data[n++] = mWidth;
+    h->data[n++] = mHeight;
+    h->data[n++] = mStride;
+    h->data[n++] = mFormat;
+    handle = h;
+
+    mStatus = NO_ERROR;
+}
+
+// Writes back and evicts every cache line of the buffer
+void GLTestBuffer::flushCaches() const
+{
+    const char *p = static_cast<const char *>(mBase);
+    const char *end = p + mSize;
+
+#if defined(__SSE2__)
+    for (; p < end; p += cacheLineSize) {
+        _mm_clflush(p);
+    }
+    _mm_mfence();
+#elif defined(__aarch64__)
+    for (; p < end; p += cacheLineSize) {
+        asm volatile("dc civac, %0" : : "r" (p) : "memory");
+    }
+    asm volatile("dsb sy" : : : "memory");
+#else
+    (void) p;
+    (void) end;
+#endif
+}
+
+status_t GLTestBuffer::lock(uint32_t usage, void **vaddr)
+{
+    if (mStatus != NO_ERROR) {
+        return mStatus;
+    }
+    if (mLocked) {
+        return INVALID_OPERATION;
+    }
+    (void) usage;
+
+    if (mUncached) {
+        flushCaches();
+    }
+    mLocked = true;
+    *vaddr = mBase;
+
+    return NO_ERROR;
+}
+
+status_t GLTestBuffer::unlock()
+{
+    if (!mLocked) {
+        return INVALID_OPERATION;
+    }
+
+    if (mUncached) {
+        flushCaches();
+    }
+    mLocked = false;
+
+    return NO_ERROR;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Graphics Test Extensions
+ *
+ * See glTestExt.h.
+ */
+
+#include <glTestExt.h>
+
+#include <string.h>
+
+bool glTestHasExtension(const char *extensions, const char *name)
+{
+    if (extensions == NULL) { return false; }
+
+    size_t len = strlen(name);
+    for (const char *p = extensions; (p = strstr(p, name)) != NULL; p += len) {
+        if (((p == extensions) || (p[-1] == ' '))
+            && ((p[len] == ' ') || (p[len] == '\0'))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+GLTestSyncProcs glTestSyncProcs;
+
+void glTestSyncProcsResolve(void)
+{
+    if (glTestSyncProcs.resolved) { return; }
+
+#define X(member, type, name) \
+    glTestSyncProcs.member = (type) eglGetProcAddress(name)
+    X(createSync, PFNEGLCREATESYNCKHRPROC, "eglCreateSyncKHR");
+    X(clientWaitSync, PFNEGLCLIENTWAITSYNCKHRPROC, "eglClientWaitSyncKHR");
+    X(destroySync, PFNEGLDESTROYSYNCKHRPROC, "eglDestroySyncKHR");
+#undef X
+    glTestSyncProcs.resolved = true;
+}
@@ -0,0 +1,517 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Graphics Test Frame Pacing
+ */
+
+#include <glTestFrame.h>
+#include <glTestBench.h>
+#include <glTestExt.h>
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+using namespace std;
+
+// Not in older eglext.h
+#ifndef EGL_ANDROID_get_frame_timestamps
+typedef int64_t EGLnsecsANDROID;
+#define EGL_TIMESTAMP_PENDING_ANDROID     ((EGLnsecsANDROID) -2)
+#define EGL_TIMESTAMPS_ANDROID            0x3430
+#define EGL_COMPOSITE_INTERVAL_ANDROID    0x3432
+#define EGL_DISPLAY_PRESENT_TIME_ANDROID  0x343A
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLGETCOMPOSITORTIMINGSUPPORTEDANDROIDPROC)
+    (EGLDisplay dpy, EGLSurface surface, EGLint name);
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLGETCOMPOSITORTIMINGANDROIDPROC)
+    (EGLDisplay dpy, EGLSurface surface, EGLint numTimestamps,
+     const EGLint *names, EGLnsecsANDROID *values);
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLGETNEXTFRAMEIDANDROIDPROC)
+    (EGLDisplay dpy, EGLSurface surface, EGLuint64KHR *frameId);
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLGETFRAMETIMESTAMPSUPPORTEDANDROIDPROC)
+    (EGLDisplay dpy, EGLSurface surface, EGLint timestamp);
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLGETFRAMETIMESTAMPSANDROIDPROC)
+    (EGLDisplay dpy, EGLSurface surface, EGLuint64KHR frameId,
+     EGLint numTimestamps, const EGLint *timestamps,
+     EGLnsecsANDROID *values);
+#endif
+
+static const uint64_t nsPerMs = 1000000;
+static const uint64_t nsPerSec = 1000000000;
+static const uint64_t defaultRefreshNs = nsPerSec / 60;
+static const uint64_t noFrameId = ~0ULL;
+
+// Frames left unresolved before the recorder stops waiting on them.
+// Present times trail the swap by a few frames; fences are waited for,
+// which bounds how far the CPU can run ahead of the GPU.
+static const size_t maxPendingPresent = 16;
+static const size_t maxPendingFence = 8;
+
+static const char *sourceNames[] = { "cpu", "fence", "present" };
+
+static struct {
+    bool resolved;
+    PFNEGLGETCOMPOSITORTIMINGSUPPORTEDANDROIDPROC getCompositorTimingSupported;
+    PFNEGLGETCOMPOSITORTIMINGANDROIDPROC getCompositorTiming;
+    PFNEGLGETNEXTFRAMEIDANDROIDPROC getNextFrameId;
+    PFNEGLGETFRAMETIMESTAMPSUPPORTEDANDROIDPROC getFrameTimestampSupported;
+    PFNEGLGETFRAMETIMESTAMPSANDROIDPROC getFrameTimestamps;
+} frameProcs;
+
+static void frameProcsResolve(void)
+{
+    if (frameProcs.resolved) { return; }
+
+#define X(member, type, name) \
+    frameProcs.member = (type) eglGetProcAddress(name)
+    X(getCompositorTimingSupported,
+      PFNEGLGETCOMPOSITORTIMINGSUPPORTEDANDROIDPROC,
+      "eglGetCompositorTimingSupportedANDROID");
+    X(getCompositorTiming, PFNEGLGETCOMPOSITORTIMINGANDROIDPROC,
+      "eglGetCompositorTimingANDROID");
+    X(getNextFrameId, PFNEGLGETNEXTFRAMEIDANDROIDPROC,
+      "eglGetNextFrameIdANDROID");
+    X(getFrameTimestampSupported, PFNEGLGETFRAMETIMESTAMPSUPPORTEDANDROIDPROC,
+      "eglGetFrameTimestampSupportedANDROID");
+    X(getFrameTimestamps, PFNEGLGETFRAMETIMESTAMPSANDROIDPROC,
+      "eglGetFrameTimestampsANDROID");
+#undef X
+    glTestSyncProcsResolve();
+    frameProcs.resolved = true;
+}
+
+// Linearly interpolated percentile of sorted values
+static double percentile(const vector<double>& sorted, double p)
+{
+    if (sorted.empty()) { return 0; }
+
+    double pos = p / 100 * (sorted.size() - 1);
+    size_t lo = (size_t) pos;
+    size_t hi = min(lo + 1, sorted.size() - 1);
+    return sorted[lo] + (sorted[hi] - sorted[lo]) * (pos - lo);
+}
+
+GLTestFrameRecorder::GLTestFrameRecorder(EGLDisplay dpy, EGLSurface surface,
+                                         unsigned int capacity) :
+    _dpy(dpy), _surface(surface), _source(SOURCE_CPU),
+    _refreshNs(defaultRefreshNs), _compositorRefresh(false), _nextFrame(0),
+    _nextFrameId(noFrameId), _head(0), _tail(0), _dropped(0)
+{
+    frameProcsResolve();
+
+    Source maxSource = SOURCE_PRESENT;
+    const char *env = getenv("GLTEST_FRAME_SOURCE");
+    if ((env != NULL) && (*env != '\0')) {
+        unsigned int n;
+        for (n = 0; n < sizeof(sourceNames) / sizeof(sourceNames[0]); n++) {
+            if (strcmp(env, sourceNames[n]) == 0) { break; }
+        }
+        if (n < sizeof(sourceNames) / sizeof(sourceNames[0])) {
+            maxSource = (Source) n;
+        } else {
+            fprintf(stderr, "Unknown GLTEST_FRAME_SOURCE \"%s\"\n", env);
+        }
+    }
+
+    env = getenv("GLTEST_REFRESH_HZ");
+    if ((env != NULL) && (atof(env) > 0)) {
+        _refreshNs = (uint64_t) (nsPerSec / atof(env));
+    }
+
+    const char *extensions = eglQueryString(dpy, EGL_EXTENSIONS);
+    if ((maxSource >= SOURCE_PRESENT) && (surface != EGL_NO_SURFACE)
+        && glTestHasExtension(extensions, "EGL_ANDROID_get_frame_timestamps")
+        && (frameProcs.getNextFrameId != NULL)
+        && (frameProcs.getFrameTimestamps != NULL)
+        && (frameProcs.getFrameTimestampSupported != NULL)
+        && eglSurfaceAttrib(dpy, surface, EGL_TIMESTAMPS_ANDROID, EGL_TRUE)
+        && frameProcs.getFrameTimestampSupported(dpy, surface,
+               EGL_DISPLAY_PRESENT_TIME_ANDROID)) {
+        _source = SOURCE_PRESENT;
+        _compositorRefresh = (env == NULL)
+            && (frameProcs.getCompositorTimingSupported != NULL)
+            && frameProcs.getCompositorTimingSupported(dpy, surface,
+                   EGL_COMPOSITE_INTERVAL_ANDROID);
+    } else if ((maxSource >= SOURCE_FENCE)
+               && glTestHasExtension(extensions, "EGL_KHR_fence_sync")
+               && (glTestSyncProcs.createSync != NULL)) {
+        _source = SOURCE_FENCE;
+    }
+    eglGetError();
+
+    uint64_t size = 1;
+    while (size < capacity) { size <<= 1; }
+    _ring = new Slot[size];
+    _mask = size - 1;
+    for (uint64_t n = 0; n < size; n++) {
+        _ring[n].seq.store(0, memory_order_relaxed);
+    }
+}
+
+GLTestFrameRecorder::~GLTestFrameRecorder()
+{
+    for (size_t n = 0; n < _pending.size(); n++) {
+        if (_pending[n].sync != EGL_NO_SYNC_KHR) {
+            glTestSyncProcs.destroySync(_dpy, _pending[n].sync);
+        }
+    }
+    delete[] _ring;
+}
+
+const char *GLTestFrameRecorder::sourceName(Source source)
+{
+    return (source <= SOURCE_PRESENT) ? sourceNames[source] : "unknown";
+}
+
+EGLBoolean GLTestFrameRecorder::swapBuffers(
+    android::WindowSurface& windowSurface)
+{
+    beforeSwap();
+    EGLBoolean rv = windowSurface.swapBuffers(_dpy, _surface);
+    afterSwap();
+
+    return rv;
+}
+
+void GLTestFrameRecorder::beforeSwap(void)
+{
+    if (_source != SOURCE_PRESENT) { return; }
+
+    EGLuint64KHR frameId;
+    _nextFrameId = frameProcs.getNextFrameId(_dpy, _surface, &frameId)
+        ? frameId : noFrameId;
+}
+
+void GLTestFrameRecorder::afterSwap(void)
+{
+    Pending pending;
+    pending.frame = _nextFrame++;
+    pending.cpuNs = glTestBenchNow();
+    pending.frameId = _nextFrameId;
+    pending.sync = EGL_NO_SYNC_KHR;
+    _nextFrameId = noFrameId;
+
+    switch (_source) {
+    case SOURCE_CPU:
+        publish(pending.frame, pending.cpuNs, pending.cpuNs, true);
+        return;
+
+    case SOURCE_FENCE:
+        pending.sync = glTestSyncProcs.createSync(_dpy, EGL_SYNC_FENCE_KHR,
+                                                  NULL);
+        break;
+
+    case SOURCE_PRESENT:
+        if (_compositorRefresh) {
+            EGLint name = EGL_COMPOSITE_INTERVAL_ANDROID;
+            EGLnsecsANDROID interval = 0;
+            if (frameProcs.getCompositorTiming(_dpy, _surface, 1, &name,
+                                               &interval)
+                && (interval > 0)) {
+                _refreshNs = interval;
+                _compositorRefresh = false;
+            }
+        }
+        break;
+    }
+
+    _pending.push_back(pending);
+    resolvePending();
+}
+
+/*
+ * Resolve
+ *
+ * Returns true once the timestamp of pending is known, or is known to
+ * be unavailable.
+ */
+bool GLTestFrameRecorder::resolve(const Pending& pending, uint64_t& timeNs,
+                                  bool& presented)
+{
+    presented = false;
+    timeNs = pending.cpuNs;
+
+    if (_source == SOURCE_FENCE) {
+        if (pending.sync == EGL_NO_SYNC_KHR) { return true; }
+        EGLint rv = glTestSyncProcs.clientWaitSync(_dpy, pending.sync,
+            EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, 0);
+        if (rv == EGL_TIMEOUT_EXPIRED_KHR) { return false; }
+        if (rv == EGL_CONDITION_SATISFIED_KHR) {
+            timeNs = glTestBenchNow();
+            presented = true;
+        }
+        glTestSyncProcs.destroySync(_dpy, pending.sync);
+        return true;
+    }
+
+    if (pending.frameId == noFrameId) { return true; }
+    EGLint name = EGL_DISPLAY_PRESENT_TIME_ANDROID;
+    EGLnsecsANDROID present = 0;
+    if (!frameProcs.getFrameTimestamps(_dpy, _surface, pending.frameId, 1,
+                                       &name, &present)) {
+        // Aged out of the driver's history
+        eglGetError();
+        return true;
+    }
+    if (present == EGL_TIMESTAMP_PENDING_ANDROID) { return false; }
+    if (present > 0) {
+        timeNs = present;
+        presented = true;
+    }
+
+    return true;
+}
+
+void GLTestFrameRecorder::resolvePending(void)
+{
+    while (!_pending.empty()) {
+        Pending& pending = _pending.front();
+        uint64_t timeNs;
+        bool presented;
+
+        if (resolve(pending, timeNs, presented)) {
+            publish(pending.frame, pending.cpuNs, timeNs, presented);
+            _pending.pop_front();
+            continue;
+        }
+
+        if ((_source == SOURCE_FENCE) && (_pending.size() > maxPendingFence)) {
+            glTestSyncProcs.clientWaitSync(_dpy, pending.sync,
+                EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, EGL_FOREVER_KHR);
+            continue;
+        }
+        if ((_source == SOURCE_PRESENT)
+            && (_pending.size() > maxPendingPresent)) {
+            publishPending(false);
+            continue;
+        }
+        break;
+    }
+}
+
+// Publishes the oldest pending frame without waiting for its timestamp
+void GLTestFrameRecorder::publishPending(bool presented)
+{
+    Pending& pending = _pending.front();
+    if (pending.sync != EGL_NO_SYNC_KHR) {
+        glTestSyncProcs.destroySync(_dpy, pending.sync);
+    }
+    publish(pending.frame, pending.cpuNs, pending.cpuNs, presented);
+    _pending.pop_front();
+}
+
+void GLTestFrameRecorder::flush(uint64_t timeoutNs)
+{
+    uint64_t deadline = glTestBenchNow() + timeoutNs;
+
+    resolvePending();
+    while (!_pending.empty() && (glTestBenchNow() < deadline)) {
+        usleep(1000);
+        resolvePending();
+    }
+    while (!_pending.empty()) { publishPending(false); }
+}
+
+void GLTestFrameRecorder::publish(uint64_t frame, uint64_t cpuNs,
+                                  uint64_t timeNs, bool presented)
+{
+    Slot& slot = _ring[frame & _mask];
+
+    slot.seq.store(2 * frame + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot.cpuNs.store(cpuNs, memory_order_relaxed);
+    slot.timeNs.store(timeNs, memory_order_relaxed);
+    slot.presented.store(presented, memory_order_relaxed);
+    slot.seq.store(2 * frame + 2, memory_order_release);
+    _head.store(frame + 1, memory_order_release);
+}
+
+/*
+ * Drain
+ *
+ * Copies the records published since the last call to _records.  Slots
+ * the writer has lapped, or is rewriting during the copy, are dropped.
+ */
+void GLTestFrameRecorder::drain(void)
+{
+    uint64_t head = _head.load(memory_order_acquire);
+
+    if (head - _tail > _mask + 1) {
+        _dropped += head - (_mask + 1) - _tail;
+        _tail = head - (_mask + 1);
+    }
+
+    for (; _tail < head; _tail++) {
+        Slot& slot = _ring[_tail & _mask];
+        uint64_t seq = slot.seq.load(memory_order_acquire);
+        GLTestFrameRecord record;
+        record.frame = _tail;
+        record.cpuNs = slot.cpuNs.load(memory_order_relaxed);
+        record.timeNs = slot.timeNs.load(memory_order_relaxed);
+        record.presented = slot.presented.load(memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if ((seq != 2 * _tail + 2)
+            || (slot.seq.load(memory_order_relaxed) != seq)) {
+            _dropped++;
+            continue;
+        }
+        _records.push_back(record);
+    }
+}
+
+void GLTestFrameRecorder::reset(void)
+{
+    drain();
+    _records.clear();
+    _dropped = 0;
+}
+
+GLTestFrameStats GLTestFrameRecorder::analyze(void)
+{
+    drain();
+
+    GLTestFrameStats stats;
+    stats.source = sourceName(_source);
+    stats.frames = _records.size();
+    stats.dropped = _dropped;
+    stats.unpresented = 0;
+    stats.refreshNs = _refreshNs.load(memory_order_relaxed);
+    stats.durationNs = 0;
+    stats.intervalMedian = stats.intervalP90 = stats.intervalP99 = 0;
+    stats.intervalMax = 0;
+    stats.fpsMean = stats.fpsLow1 = 0;
+    stats.sustainedFpsMin = stats.sustainedFpsMedian = 0;
+    stats.jankFrames = stats.missedRefreshes = 0;
+    stats.histogram.assign(histogramBuckets, 0);
+
+    // Intervals between presented frames.  An unpresented frame is
+    // folded into the interval that spans it, as the display saw, but
+    // no interval spans frames lost from the ring.
+    vector<uint64_t> times;
+    vector<bool> gapBefore;
+    bool gap = true;
+    for (size_t n = 0; n < _records.size(); n++) {
+        if ((n > 0) && (_records[n].frame != _records[n - 1].frame + 1)) {
+            gap = true;
+        }
+        if (!_records[n].presented) {
+            stats.unpresented++;
+            continue;
+        }
+        if (!times.empty() && (_records[n].timeNs < times.back())) {
+            continue;
+        }
+        times.push_back(_records[n].timeNs);
+        gapBefore.push_back(gap);
+        gap = false;
+    }
+
+    vector<double> intervals;
+    vector<double> windows;
+    uint64_t windowStart = 0;
+    uint64_t windowFrames = 0;
+    for (size_t n = 0; n < times.size(); n++) {
+        if (gapBefore[n]) {
+            windowStart = times[n];
+            windowFrames = 0;
+            continue;
+        }
+
+        double interval = times[n] - times[n - 1];
+        intervals.push_back(interval);
+        stats.durationNs += interval;
+
+        size_t bucket = min((size_t) (interval / nsPerMs),
+                            (size_t) histogramBuckets - 1);
+        stats.histogram[bucket]++;
+        if (interval > 1.5 * stats.refreshNs) {
+            stats.jankFrames++;
+            stats.missedRefreshes += (uint64_t) llround(
+                interval / stats.refreshNs) - 1;
+        }
+
+        // Frame rate over each complete one second window
+        while (times[n] >= windowStart + nsPerSec) {
+            windows.push_back(windowFrames);
+            windowStart += nsPerSec;
+            windowFrames = 0;
+        }
+        windowFrames++;
+    }
+    if (intervals.empty()) { return stats; }
+
+    stats.fpsMean = intervals.size() * (double) nsPerSec / stats.durationNs;
+
+    sort(intervals.begin(), intervals.end());
+    stats.intervalMedian = percentile(intervals, 50);
+    stats.intervalP90 = percentile(intervals, 90);
+    stats.intervalP99 = percentile(intervals, 99);
+    stats.intervalMax = intervals.back();
+    stats.fpsLow1 = (stats.intervalP99 > 0)
+        ? nsPerSec / stats.intervalP99 : 0;
+
+    if (windows.empty()) {
+        stats.sustainedFpsMin = stats.sustainedFpsMedian = stats.fpsMean;
+    } else {
+        sort(windows.begin(), windows.end());
+        stats.sustainedFpsMin = windows[0];
+        stats.sustainedFpsMedian = percentile(windows, 50);
+    }
+
+    return stats;
+}
+
+void GLTestFrameRecorder::report(const char *name, bool histogram)
+{
+    GLTestFrameStats stats = analyze();
+    const double ms = nsPerMs;
+
+    printf("%s: %" PRIu64 " frames (%s), %.2f fps, 1%% low %.2f fps, "
+           "sustained min %.2f median %.2f fps\n",
+           name, stats.frames, stats.source, stats.fpsMean, stats.fpsLow1,
+           stats.sustainedFpsMin, stats.sustainedFpsMedian);
+    printf("    interval median %.2f p90 %.2f p99 %.2f max %.2f ms\n",
+           stats.intervalMedian / ms, stats.intervalP90 / ms,
+           stats.intervalP99 / ms, stats.intervalMax / ms);
+    printf("    jank %" PRIu64 " frames, %" PRIu64 " missed refreshes "
+           "at %.2f ms", stats.jankFrames, stats.missedRefreshes,
+           stats.refreshNs / ms);
+    if (stats.dropped || stats.unpresented) {
+        printf(", %" PRIu64 " dropped, %" PRIu64 " unpresented",
+               stats.dropped, stats.unpresented);
+    }
+    printf("\n");
+
+    if (!histogram) { return; }
+
+    uint64_t peak = *max_element(stats.histogram.begin(),
+                                 stats.histogram.end());
+    for (unsigned int n = 0; n < histogramBuckets; n++) {
+        if (stats.histogram[n] == 0) { continue; }
+        int bar = (int) ((stats.histogram[n] * 40 + peak - 1) / peak);
+        printf("    %3u%s ms %-40.*s %" PRIu64 "\n", n,
+               (n == histogramBuckets - 1) ? "+" : " ", bar,
+               "########################################",
+               stats.histogram[n]);
+    }
+}
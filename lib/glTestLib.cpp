@@ -20,6 +20,12 @@
  */
 
 #include <glTestLib.h>
+#include <glTestBench.h>
+#include <glTestExt.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
@@ -116,3 +122,334 @@ void glTestPrintEGLConfiguration(EGLDisplay dpy, EGLConfig config)
     }
     testPrintI("");
 }
+
+// ES 3.0 sync objects, which the GLES 2 headers don't declare.  GLsync
+// is an opaque pointer.
+#define GLTEST_GL_SYNC_GPU_COMMANDS_COMPLETE  0x9117
+#define GLTEST_GL_SYNC_FLUSH_COMMANDS_BIT     0x00000001
+#define GLTEST_GL_WAIT_FAILED                 0x911D
+#define GLTEST_GL_TIMEOUT_IGNORED             0xFFFFFFFFFFFFFFFFULL
+typedef void *(GL_APIENTRYP FenceSyncProc)(GLenum condition,
+    GLbitfield flags);
+typedef GLenum (GL_APIENTRYP ClientWaitGLSyncProc)(void *sync,
+    GLbitfield flags, uint64_t timeout);
+typedef void (GL_APIENTRYP DeleteSyncProc)(void *sync);
+
+/*
+ * GL_EXT_disjoint_timer_query and ES 3.0 sync entry points.  These are
+ * looked up at runtime, as libglTest is linked into both the GLES 1 and
+ * GLES 2 tests.  The EGL_KHR_fence_sync ones are in glTestExt.h.
+ */
+static struct {
+    bool resolved;
+    PFNGLGENQUERIESEXTPROC genQueries;
+    PFNGLDELETEQUERIESEXTPROC deleteQueries;
+    PFNGLBEGINQUERYEXTPROC beginQuery;
+    PFNGLENDQUERYEXTPROC endQuery;
+    PFNGLGETQUERYOBJECTUIVEXTPROC getQueryObjectuiv;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v;
+    FenceSyncProc fenceSync;
+    ClientWaitGLSyncProc clientWaitGLSync;
+    DeleteSyncProc deleteSync;
+} gpuTimerProcs;
+
+static void gpuTimerResolve(void)
+{
+    if (gpuTimerProcs.resolved) { return; }
+
+#define X(member, type, name) \
+    gpuTimerProcs.member = (type) eglGetProcAddress(name)
+    X(genQueries, PFNGLGENQUERIESEXTPROC, "glGenQueriesEXT");
+    X(deleteQueries, PFNGLDELETEQUERIESEXTPROC, "glDeleteQueriesEXT");
+    X(beginQuery, PFNGLBEGINQUERYEXTPROC, "glBeginQueryEXT");
+    X(endQuery, PFNGLENDQUERYEXTPROC, "glEndQueryEXT");
+    X(getQueryObjectuiv, PFNGLGETQUERYOBJECTUIVEXTPROC,
+      "glGetQueryObjectuivEXT");
+    X(getQueryObjectui64v, PFNGLGETQUERYOBJECTUI64VEXTPROC,
+      "glGetQueryObjectui64vEXT");
+    X(fenceSync, FenceSyncProc, "glFenceSync");
+    X(clientWaitGLSync, ClientWaitGLSyncProc, "glClientWaitSync");
+    X(deleteSync, DeleteSyncProc, "glDeleteSync");
+#undef X
+    glTestSyncProcsResolve();
+    gpuTimerProcs.resolved = true;
+}
+
+GLTestGpuTimer::GLTestGpuTimer(unsigned int depth) :
+    _hasTimerQuery(false), _hasFenceSync(false),
+    _depth((depth == 0) ? 1 : depth), _inScope(false)
+{
+    gpuTimerResolve();
+
+    const char *glExtensions = (const char *) glGetString(GL_EXTENSIONS);
+    _hasTimerQuery
+        = glTestHasExtension(glExtensions, "GL_EXT_disjoint_timer_query")
+        && (gpuTimerProcs.genQueries != NULL)
+        && (gpuTimerProcs.getQueryObjectui64v != NULL);
+
+    EGLDisplay dpy = eglGetCurrentDisplay();
+    _hasFenceSync = (dpy != EGL_NO_DISPLAY)
+        && glTestHasExtension(eglQueryString(dpy, EGL_EXTENSIONS),
+                              "EGL_KHR_fence_sync")
+        && (glTestSyncProcs.createSync != NULL);
+
+    if (_hasTimerQuery) {
+        _freeQueries.resize(_depth);
+        gpuTimerProcs.genQueries(_depth, &_freeQueries[0]);
+
+        // Clear any disjoint event from before the first scope
+        GLint disjoint;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    }
+}
+
+GLTestGpuTimer::~GLTestGpuTimer()
+{
+    EGLDisplay dpy = eglGetCurrentDisplay();
+    for (size_t i = 0; i < _inFlight.size(); i++) {
+        if (_inFlight[i].sync != EGL_NO_SYNC_KHR) {
+            glTestSyncProcs.destroySync(dpy, _inFlight[i].sync);
+        }
+    }
+
+    if (_hasTimerQuery) {
+        if (_inScope) {
+            gpuTimerProcs.endQuery(GL_TIME_ELAPSED_EXT);
+            _freeQueries.push_back(_current.query);
+        }
+        for (size_t i = 0; i < _inFlight.size(); i++) {
+            _freeQueries.push_back(_inFlight[i].query);
+        }
+        gpuTimerProcs.deleteQueries(_freeQueries.size(), &_freeQueries[0]);
+    }
+}
+
+void GLTestGpuTimer::begin(void)
+{
+    if (_inScope) { end(); }
+
+    // Reuse the oldest query once the ring is full.  Its result is
+    // moved to the completed list, stalling only if it isn't done yet.
+    if ((_hasTimerQuery && _freeQueries.empty())
+        || (_inFlight.size() >= _depth)) {
+        collect(true);
+    }
+
+    _inScope = true;
+    _current.query = 0;
+    _current.sync = EGL_NO_SYNC_KHR;
+    _current.cpuStartNs = glTestBenchNow();
+    if (_hasTimerQuery) {
+        _current.query = _freeQueries.back();
+        _freeQueries.pop_back();
+        gpuTimerProcs.beginQuery(GL_TIME_ELAPSED_EXT, _current.query);
+    }
+}
+
+void GLTestGpuTimer::end(void)
+{
+    if (!_inScope) { return; }
+    _inScope = false;
+
+    if (_hasTimerQuery) {
+        gpuTimerProcs.endQuery(GL_TIME_ELAPSED_EXT);
+    } else if (_hasFenceSync) {
+        // Fallback: fence the scope, flushed so that it signals without
+        // a wait, and time it to when the fence is seen signaled
+        _current.sync = glTestSyncProcs.createSync(eglGetCurrentDisplay(),
+                                                   EGL_SYNC_FENCE_KHR, NULL);
+        glFlush();
+    }
+    _current.cpuEndNs = glTestBenchNow();
+    _inFlight.push_back(_current);
+}
+
+/*
+ * Collect
+ *
+ * Moves the oldest in flight scope to the completed list, if its query
+ * result is available, or its fence signaled, or block is set.  Scopes
+ * without a query or fence only complete with block set, through
+ * glFinish().  Returns true if a scope was moved.
+ */
+bool GLTestGpuTimer::collect(bool block)
+{
+    if (_inFlight.empty()) { return false; }
+
+    Scope& scope = _inFlight.front();
+    if (!_hasTimerQuery) {
+        EGLDisplay dpy = eglGetCurrentDisplay();
+        if (scope.sync != EGL_NO_SYNC_KHR) {
+            EGLint status = glTestSyncProcs.clientWaitSync(dpy, scope.sync,
+                0, block ? EGL_FOREVER_KHR : 0);
+            if ((status == EGL_TIMEOUT_EXPIRED_KHR) && !block) {
+                return false;
+            }
+            glTestSyncProcs.destroySync(dpy, scope.sync);
+        } else if (block) {
+            glFinish();
+        } else {
+            return false;
+        }
+
+        GLTestGpuTiming timing;
+        timing.cpuSubmitNs = scope.cpuEndNs - scope.cpuStartNs;
+        timing.gpuNs = glTestBenchNow() - scope.cpuStartNs;
+        timing.estimated = true;
+        timing.disjoint = false;
+        _completed.push_back(timing);
+        _inFlight.pop_front();
+
+        return true;
+    }
+
+    GLuint available = GL_FALSE;
+    gpuTimerProcs.getQueryObjectuiv(scope.query,
+        GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+    if (!available && !block) { return false; }
+
+    GLuint64 elapsed = 0;
+    gpuTimerProcs.getQueryObjectui64v(scope.query, GL_QUERY_RESULT_EXT,
+                                      &elapsed);
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+    GLTestGpuTiming timing;
+    timing.cpuSubmitNs = scope.cpuEndNs - scope.cpuStartNs;
+    timing.gpuNs = elapsed;
+    timing.estimated = false;
+    timing.disjoint = (disjoint != 0);
+    _completed.push_back(timing);
+
+    _freeQueries.push_back(scope.query);
+    _inFlight.pop_front();
+
+    return true;
+}
+
+bool GLTestGpuTimer::poll(GLTestGpuTiming& timing)
+{
+    while (collect(false)) {}
+    if (_completed.empty()) { return false; }
+
+    timing = _completed.front();
+    _completed.pop_front();
+
+    return true;
+}
+
+bool GLTestGpuTimer::wait(GLTestGpuTiming& timing)
+{
+    if (_completed.empty()) {
+        if (_inScope) { end(); }
+        collect(true);
+    }
+
+    return poll(timing);
+}
+
+GLTestFrameLimiter::GLTestFrameLimiter(int framesInFlight) :
+    _framesInFlight(0), _glSync(false), _dpy(eglGetCurrentDisplay()),
+    _waitNs(0)
+{
+    gpuTimerResolve();
+
+    if (framesInFlight == fromEnvironment) {
+        const char *env = getenv("GLTEST_FRAMES_IN_FLIGHT");
+        framesInFlight = (env == NULL) ? 0 : atoi(env);
+    }
+    if (framesInFlight < 0) { framesInFlight = 0; }
+    if ((unsigned int) framesInFlight > maxFramesInFlight) {
+        fprintf(stderr, "glTestLib: %d frames in flight, limited to %u\n",
+                framesInFlight, maxFramesInFlight);
+        framesInFlight = maxFramesInFlight;
+    }
+
+    if (framesInFlight > 0) {
+        const char *version = (const char *) glGetString(GL_VERSION);
+        if ((_dpy != EGL_NO_DISPLAY)
+            && glTestHasExtension(eglQueryString(_dpy, EGL_EXTENSIONS),
+                                  "EGL_KHR_fence_sync")
+            && (glTestSyncProcs.createSync != NULL)) {
+            _framesInFlight = framesInFlight;
+        } else if ((version != NULL)
+                   && (strncmp(version, "OpenGL ES 3", 11) == 0)
+                   && (gpuTimerProcs.fenceSync != NULL)) {
+            _framesInFlight = framesInFlight;
+            _glSync = true;
+        } else {
+            fprintf(stderr, "glTestLib: no fence sync, frames are drained\n");
+        }
+    }
+
+    if (_framesInFlight == 0) {
+        snprintf(_name, sizeof(_name), "drained");
+    } else {
+        snprintf(_name, sizeof(_name), "pipelined %u", _framesInFlight);
+    }
+}
+
+GLTestFrameLimiter::~GLTestFrameLimiter()
+{
+    drain();
+}
+
+void *GLTestFrameLimiter::fence(void)
+{
+    if (_glSync) {
+        return gpuTimerProcs.fenceSync(GLTEST_GL_SYNC_GPU_COMMANDS_COMPLETE,
+                                       0);
+    }
+
+    EGLSyncKHR sync = glTestSyncProcs.createSync(_dpy, EGL_SYNC_FENCE_KHR,
+                                                 NULL);
+    return (sync == EGL_NO_SYNC_KHR) ? NULL : (void *) sync;
+}
+
+void GLTestFrameLimiter::waitFence(void *fence)
+{
+    uint64_t start = glTestBenchNow();
+
+    if (_glSync) {
+        gpuTimerProcs.clientWaitGLSync(fence,
+            GLTEST_GL_SYNC_FLUSH_COMMANDS_BIT, GLTEST_GL_TIMEOUT_IGNORED);
+        gpuTimerProcs.deleteSync(fence);
+    } else {
+        glTestSyncProcs.clientWaitSync(_dpy, (EGLSyncKHR) fence,
+            EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, EGL_FOREVER_KHR);
+        glTestSyncProcs.destroySync(_dpy, (EGLSyncKHR) fence);
+    }
+    _waitNs += glTestBenchNow() - start;
+}
+
+void GLTestFrameLimiter::frameEnd(void)
+{
+    if (_framesInFlight == 0) {
+        uint64_t start = glTestBenchNow();
+        glFinish();
+        _waitNs += glTestBenchNow() - start;
+        return;
+    }
+
+    void *sync = fence();
+    if (sync == NULL) {
+        // Out of fences, fall back to draining this frame
+        drain();
+        glFinish();
+        return;
+    }
+
+    _fences.push_back(sync);
+    while (_fences.size() > _framesInFlight) {
+        waitFence(_fences.front());
+        _fences.pop_front();
+    }
+}
+
+void GLTestFrameLimiter::drain(void)
+{
+    while (!_fences.empty()) {
+        waitFence(_fences.front());
+        _fences.pop_front();
+    }
+}
@@ -0,0 +1,646 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Graphics Test Program Cache
+ */
+
+#include <glTestProgram.h>
+#include <glTestBench.h>
+#include <glTestExt.h>
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+
+using namespace std;
+
+static const char defaultCacheDir[] = "/data/local/tmp/gltest-programs";
+static const uint32_t cacheMagic = 0x50545447; // "GTTP"
+
+// Cache file header, followed by length bytes of program binary
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t format;
+    uint32_t length;
+};
+
+typedef void (GL_APIENTRYP GetProgramBinaryProc)(GLuint program,
+    GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (GL_APIENTRYP ProgramBinaryProc)(GLuint program,
+    GLenum binaryFormat, const void *binary, GLint length);
+
+// A program being built, either loaded from the cache or with its link
+// issued but not yet checked
+struct PendingProgram {
+    GLuint program;
+    GLuint vertexShader;
+    GLuint pixelShader;
+    bool fromCache;
+    string path;
+    uint64_t ns;    // Time spent starting it
+};
+
+// Programs may be built on a GLTestProgramQueue worker thread
+static mutex statsLock;
+static GLTestProgramStats stats;
+
+static GLTestProgramLogHook logHook;
+
+void glTestProgramSetLogHook(GLTestProgramLogHook hook)
+{
+    logHook = hook;
+}
+
+// Formats a message for the log hook, or stderr without one
+static void programLog(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (len < 0) { return; }
+
+    vector<char> msg(len + 1);
+    va_start(args, fmt);
+    vsnprintf(&msg[0], msg.size(), fmt, args);
+    va_end(args);
+
+    if (logHook != NULL) {
+        logHook(&msg[0]);
+    } else {
+        fprintf(stderr, "%s\n", &msg[0]);
+    }
+}
+
+static struct {
+    bool resolved;
+    bool supported;
+    string dir;
+    GetProgramBinaryProc getProgramBinary;
+    ProgramBinaryProc programBinary;
+} cache;
+
+/*
+ * Resolves the program binary entry points and the cache directory.
+ * The cache is only used when the driver supports at least one binary
+ * format and the directory can be created and written.  That is only
+ * reported for a directory given by GLTEST_PROGRAM_CACHE, as the default
+ * is out of reach of app UIDs, such as the JNI tests'.
+ */
+static void cacheInit(void)
+{
+    if (cache.resolved) { return; }
+    cache.resolved = true;
+
+    const char *dir = getenv("GLTEST_PROGRAM_CACHE");
+    cache.dir = (dir == NULL) ? defaultCacheDir : dir;
+    if (cache.dir.empty()) { return; }
+
+    // The ES 3.0 names share the OES enums and signatures
+    cache.getProgramBinary = (GetProgramBinaryProc)
+        eglGetProcAddress("glGetProgramBinary");
+    cache.programBinary = (ProgramBinaryProc)
+        eglGetProcAddress("glProgramBinary");
+    if ((cache.getProgramBinary == NULL) || (cache.programBinary == NULL)) {
+        cache.getProgramBinary = (GetProgramBinaryProc)
+            eglGetProcAddress("glGetProgramBinaryOES");
+        cache.programBinary = (ProgramBinaryProc)
+            eglGetProcAddress("glProgramBinaryOES");
+    }
+    if ((cache.getProgramBinary == NULL) || (cache.programBinary == NULL)) {
+        return;
+    }
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+    glGetError(); // Not an error if the enum is unknown, just no formats
+    if (formats <= 0) { return; }
+
+    if (((mkdir(cache.dir.c_str(), 0777) != 0) && (errno != EEXIST))
+        || (access(cache.dir.c_str(), W_OK) != 0)) {
+        if (dir != NULL) {
+            programLog("glTestProgram: unable to use %s: %s",
+                       cache.dir.c_str(), strerror(errno));
+        }
+        return;
+    }
+
+    cache.supported = true;
+}
+
+// 64-bit FNV-1a hash, continued from hash
+static uint64_t fnv1a(uint64_t hash, const char *str)
+{
+    if (str == NULL) { str = ""; }
+    for (const unsigned char *p = (const unsigned char *) str; ; p++) {
+        hash = (hash ^ *p) * 0x100000001b3ULL;
+        if (*p == '\0') { break; }
+    }
+
+    return hash;
+}
+
+static string cachePath(const char *vertexSource, const char *fragmentSource,
+                        const char *const *attribs)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    char name[32];
+
+    hash = fnv1a(hash, (const char *) glGetString(GL_RENDERER));
+    hash = fnv1a(hash, (const char *) glGetString(GL_VERSION));
+    hash = fnv1a(hash, vertexSource);
+    hash = fnv1a(hash, fragmentSource);
+    for (const char *const *a = attribs; (a != NULL) && (*a != NULL); a++) {
+        hash = fnv1a(hash, *a);
+    }
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long) hash);
+
+    return cache.dir + name;
+}
+
+static void logInfoLog(GLuint object, bool isProgram, const char *what)
+{
+    GLint len = 0;
+
+    if (isProgram) {
+        glGetProgramiv(object, GL_INFO_LOG_LENGTH, &len);
+    } else {
+        glGetShaderiv(object, GL_INFO_LOG_LENGTH, &len);
+    }
+    if (len <= 0) { return; }
+
+    vector<char> buf(len);
+    if (isProgram) {
+        glGetProgramInfoLog(object, len, NULL, &buf[0]);
+    } else {
+        glGetShaderInfoLog(object, len, NULL, &buf[0]);
+    }
+    programLog("%s:\n%s", what, &buf[0]);
+}
+
+GLuint glTestLoadShader(GLenum shaderType, const char *source)
+{
+    GLuint shader = glCreateShader(shaderType);
+
+    if (shader) {
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        GLint compiled = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            char what[64];
+            snprintf(what, sizeof(what), "Could not compile shader %d",
+                     shaderType);
+            logInfoLog(shader, false, what);
+            glDeleteShader(shader);
+            shader = 0;
+        }
+    }
+
+    return shader;
+}
+
+/*
+ * Load Program
+ *
+ * Creates a program from the cache file at path.  Returns 0 if there is
+ * no usable binary.
+ */
+static GLuint loadProgram(const string& path)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == NULL) { return 0; }
+
+    CacheHeader header;
+    vector<char> binary;
+    bool ok = (fread(&header, sizeof(header), 1, fp) == 1)
+        && (header.magic == cacheMagic) && (header.length > 0);
+    if (ok) {
+        binary.resize(header.length);
+        ok = fread(&binary[0], header.length, 1, fp) == 1;
+    }
+    fclose(fp);
+    if (!ok) { return 0; }
+
+    GLuint program = glCreateProgram();
+    cache.programBinary(program, header.format, &binary[0], header.length);
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE) {
+        // Typically a driver update; recompile and overwrite the entry
+        glGetError();
+        glDeleteProgram(program);
+        lock_guard<mutex> lock(statsLock);
+        stats.rejected++;
+        return 0;
+    }
+
+    return program;
+}
+
+static void saveProgram(const string& path, GLuint program)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if (length <= 0) { return; }
+
+    vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    cache.getProgramBinary(program, length, &written, &format, &binary[0]);
+    if (written <= 0) { return; }
+
+    // Written under a temporary name, so that a concurrent or interrupted
+    // run never sees a partial entry
+    string tmpPath = path + ".tmp";
+    FILE *fp = fopen(tmpPath.c_str(), "wb");
+    if (fp == NULL) { return; }
+
+    CacheHeader header = {cacheMagic, format, (uint32_t) written};
+    bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1)
+        && (fwrite(&binary[0], written, 1, fp) == 1);
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || (rename(tmpPath.c_str(), path.c_str()) != 0)) {
+        unlink(tmpPath.c_str());
+    }
+}
+
+/*
+ * Start Program
+ *
+ * Loads the program from the cache, or issues the compiles and the link
+ * without querying their status, so that a driver that compiles in the
+ * background (GL_KHR_parallel_shader_compile) isn't forced to wait.
+ */
+static void startProgram(const char *vertexSource, const char *fragmentSource,
+                         const char *const *attribs, PendingProgram& pending)
+{
+    uint64_t start = glTestBenchNow();
+
+    pending.program = pending.vertexShader = pending.pixelShader = 0;
+    pending.fromCache = false;
+    pending.path.clear();
+
+    if (cache.supported) {
+        pending.path = cachePath(vertexSource, fragmentSource, attribs);
+        if ((pending.program = loadProgram(pending.path)) != 0) {
+            pending.fromCache = true;
+            pending.ns = glTestBenchNow() - start;
+            return;
+        }
+        start = glTestBenchNow();
+    }
+
+    pending.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(pending.vertexShader, 1, &vertexSource, NULL);
+    glCompileShader(pending.vertexShader);
+    pending.pixelShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(pending.pixelShader, 1, &fragmentSource, NULL);
+    glCompileShader(pending.pixelShader);
+
+    pending.program = glCreateProgram();
+    if (pending.program) {
+        glAttachShader(pending.program, pending.vertexShader);
+        glAttachShader(pending.program, pending.pixelShader);
+        for (GLuint i = 0; (attribs != NULL) && (attribs[i] != NULL); i++) {
+            glBindAttribLocation(pending.program, i, attribs[i]);
+        }
+        glLinkProgram(pending.program);
+    }
+    pending.ns = glTestBenchNow() - start;
+}
+
+/*
+ * Finish Program
+ *
+ * Checks the compile and link status of a started program, blocking
+ * until they are known, and saves it to the cache.  Returns the program,
+ * or 0 on failure.
+ */
+static GLuint finishProgram(PendingProgram& pending)
+{
+    uint64_t start = glTestBenchNow();
+    GLuint program = pending.program;
+
+    if (pending.fromCache) {
+        lock_guard<mutex> lock(statsLock);
+        stats.loaded++;
+        stats.loadNs += pending.ns;
+        return program;
+    }
+
+    const GLuint shaders[] = {pending.vertexShader, pending.pixelShader};
+    for (size_t i = 0; i < sizeof(shaders) / sizeof(shaders[0]); i++) {
+        GLint compiled = 0;
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            char what[64];
+            GLint shaderType = 0;
+            glGetShaderiv(shaders[i], GL_SHADER_TYPE, &shaderType);
+            snprintf(what, sizeof(what), "Could not compile shader %d",
+                     shaderType);
+            logInfoLog(shaders[i], false, what);
+            if (program) {
+                glDeleteProgram(program);
+                program = 0;
+            }
+        }
+    }
+
+    if (program) {
+        GLint linkStatus = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+        if (linkStatus != GL_TRUE) {
+            logInfoLog(program, true, "Could not link program");
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    // The program keeps what it needs once linked
+    glDeleteShader(pending.vertexShader);
+    glDeleteShader(pending.pixelShader);
+
+    if (program) {
+        {
+            lock_guard<mutex> lock(statsLock);
+            stats.compiled++;
+            stats.compileNs += pending.ns + (glTestBenchNow() - start);
+        }
+        if (cache.supported) { saveProgram(pending.path, program); }
+    }
+
+    return program;
+}
+
+GLuint glTestCreateProgram(const char *vertexSource,
+                           const char *fragmentSource,
+                           const char *const *attribs)
+{
+    PendingProgram pending;
+
+    cacheInit();
+    startProgram(vertexSource, fragmentSource, attribs, pending);
+
+    return finishProgram(pending);
+}
+
+struct GLTestProgramQueue::Job {
+    const char *vertexSource;
+    const char *fragmentSource;
+    PendingProgram pending;
+    GLuint program;
+    bool started;   // pending is valid (parallel mode)
+    bool claimed;   // Being built by the worker, or by wait()
+    bool done;      // program is valid
+};
+
+typedef void (GL_APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+const char *GLTestProgramQueue::modeName(Mode mode)
+{
+    switch (mode) {
+    case MODE_PARALLEL: return "parallel";
+    case MODE_THREAD: return "thread";
+    case MODE_SYNC: return "sync";
+    }
+
+    return "unknown";
+}
+
+GLTestProgramQueue::GLTestProgramQueue(const char *const *attribs) :
+    _mode(MODE_SYNC), _attribs(attribs), _nextJob(0), _stop(false),
+    _dpy(eglGetCurrentDisplay()),
+    _context(EGL_NO_CONTEXT), _surface(EGL_NO_SURFACE)
+{
+    // Resolved here, as the worker must not race the first use
+    cacheInit();
+
+    MaxShaderCompilerThreadsProc maxThreads = (MaxShaderCompilerThreadsProc)
+        eglGetProcAddress("glMaxShaderCompilerThreadsKHR");
+    if (glTestHasExtension((const char *) glGetString(GL_EXTENSIONS),
+                           "GL_KHR_parallel_shader_compile")
+        && (maxThreads != NULL)) {
+        maxThreads(0xffffffff); // Let the driver pick
+        _mode = MODE_PARALLEL;
+    } else if (startWorker()) {
+        _mode = MODE_THREAD;
+    }
+}
+
+/*
+ * Start Worker
+ *
+ * Creates a context in the share group of the current one, of the same
+ * client version, with a 1x1 pbuffer unless EGL_KHR_surfaceless_context
+ * is supported, and starts the worker thread on it.
+ */
+bool GLTestProgramQueue::startWorker(void)
+{
+    EGLContext share = eglGetCurrentContext();
+    if ((_dpy == EGL_NO_DISPLAY) || (share == EGL_NO_CONTEXT)) {
+        return false;
+    }
+
+    EGLint configId = 0, numConfigs = 0, clientVersion = 2;
+    EGLConfig config;
+    eglQueryContext(_dpy, share, EGL_CONFIG_ID, &configId);
+    eglQueryContext(_dpy, share, EGL_CONTEXT_CLIENT_VERSION, &clientVersion);
+    const EGLint configAttribs[] = {EGL_CONFIG_ID, configId, EGL_NONE};
+    if (!eglChooseConfig(_dpy, configAttribs, &config, 1, &numConfigs)
+        || (numConfigs < 1)) {
+        return false;
+    }
+
+    const EGLint contextAttribs[] = {EGL_CONTEXT_CLIENT_VERSION,
+                                     clientVersion, EGL_NONE};
+    _context = eglCreateContext(_dpy, config, share, contextAttribs);
+    if (_context == EGL_NO_CONTEXT) { return false; }
+
+    if (!glTestHasExtension(eglQueryString(_dpy, EGL_EXTENSIONS),
+                            "EGL_KHR_surfaceless_context")) {
+        const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1,
+                                         EGL_NONE};
+        _surface = eglCreatePbufferSurface(_dpy, config, pbufferAttribs);
+        if (_surface == EGL_NO_SURFACE) {
+            eglDestroyContext(_dpy, _context);
+            _context = EGL_NO_CONTEXT;
+            return false;
+        }
+    }
+
+    _thread = thread(&GLTestProgramQueue::worker, this);
+
+    return true;
+}
+
+void GLTestProgramQueue::worker(void)
+{
+    if (!eglMakeCurrent(_dpy, _surface, _surface, _context)) {
+        // wait() builds whatever the worker doesn't claim
+        programLog("glTestProgram: worker eglMakeCurrent failed 0x%x",
+                   eglGetError());
+        return;
+    }
+
+    unique_lock<mutex> lock(_lock);
+    for (;;) {
+        while (!_stop && (_nextJob >= _jobs.size())) { _cond.wait(lock); }
+        if (_stop) { break; }
+
+        Job *job = _jobs[_nextJob++];
+        if (job->claimed) { continue; }
+        job->claimed = true;
+
+        lock.unlock();
+        GLuint program = glTestCreateProgram(job->vertexSource,
+                                             job->fragmentSource, _attribs);
+        // Make the program complete before another context uses it
+        glFinish();
+        lock.lock();
+
+        job->program = program;
+        job->done = true;
+        _cond.notify_all();
+    }
+    lock.unlock();
+
+    eglMakeCurrent(_dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglReleaseThread();
+}
+
+GLTestProgramQueue::~GLTestProgramQueue()
+{
+    if (_thread.joinable()) {
+        {
+            lock_guard<mutex> lock(_lock);
+            _stop = true;
+            _cond.notify_all();
+        }
+        _thread.join();
+    }
+    if (_context != EGL_NO_CONTEXT) { eglDestroyContext(_dpy, _context); }
+    if (_surface != EGL_NO_SURFACE) { eglDestroySurface(_dpy, _surface); }
+
+    // Programs that were never retrieved
+    for (size_t i = 0; i < _jobs.size(); i++) {
+        Job *job = _jobs[i];
+        if (job->started && !job->done) {
+            glDeleteProgram(finishProgram(job->pending));
+        } else if (job->done) {
+            glDeleteProgram(job->program);
+        }
+        delete job;
+    }
+}
+
+unsigned int GLTestProgramQueue::submit(const char *vertexSource,
+                                        const char *fragmentSource)
+{
+    Job *job = new Job;
+
+    job->vertexSource = vertexSource;
+    job->fragmentSource = fragmentSource;
+    job->program = 0;
+    job->started = job->claimed = job->done = false;
+
+    if (_mode == MODE_PARALLEL) {
+        startProgram(vertexSource, fragmentSource, _attribs, job->pending);
+        job->started = true;
+    }
+
+    lock_guard<mutex> lock(_lock);
+    _jobs.push_back(job);
+    _cond.notify_all();
+
+    return _jobs.size() - 1;
+}
+
+GLuint GLTestProgramQueue::wait(unsigned int ticket)
+{
+    uint64_t start = glTestBenchNow();
+    GLuint program = 0;
+    unique_lock<mutex> lock(_lock);
+
+    if (ticket >= _jobs.size()) { return 0; }
+    Job *job = _jobs[ticket];
+
+    if (job->started) {
+        lock.unlock();
+        program = finishProgram(job->pending);
+        job->started = false;
+        lock.lock();
+    } else {
+        while (job->claimed && !job->done) { _cond.wait(lock); }
+        if (!job->done && !job->claimed) {
+            // Not reached by the worker yet (or there is none)
+            job->claimed = true;
+            lock.unlock();
+            program = glTestCreateProgram(job->vertexSource,
+                                          job->fragmentSource, _attribs);
+            lock.lock();
+        } else {
+            program = job->program;
+        }
+    }
+
+    // Handed to the caller
+    job->program = 0;
+    job->done = true;
+    lock.unlock();
+
+    lock_guard<mutex> statsGuard(statsLock);
+    stats.queueWaits++;
+    stats.queueStallNs += glTestBenchNow() - start;
+
+    return program;
+}
+
+const GLTestProgramStats& glTestProgramStats(void)
+{
+    return stats;
+}
+
+void glTestProgramReport(void)
+{
+    lock_guard<mutex> lock(statsLock);
+
+    printf("programs: %u compiled in %.3f ms (%.3f ms each), "
+           "%u loaded from cache in %.3f ms (%.3f ms each), %u rejected\n",
+           stats.compiled, stats.compileNs / 1e6,
+           stats.compiled ? stats.compileNs / 1e6 / stats.compiled : 0.0,
+           stats.loaded, stats.loadNs / 1e6,
+           stats.loaded ? stats.loadNs / 1e6 / stats.loaded : 0.0,
+           stats.rejected);
+    if (stats.queueWaits) {
+        printf("programs: %u queue waits stalled for %.3f ms\n",
+               stats.queueWaits, stats.queueStallNs / 1e6);
+    }
+}
@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Graphics Test State Cache
+ */
+
+#include <glTestState.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GLES2/gl2ext.h>
+
+// Object name used for an unknown binding.  GL never generates it in
+// practice, so it can't match a real bind.
+static const GLuint unknownName = ~0u;
+
+static const GLenum capabilityList[] = {
+    GL_BLEND,
+    GL_CULL_FACE,
+    GL_DEPTH_TEST,
+    GL_DITHER,
+    GL_POLYGON_OFFSET_FILL,
+    GL_SAMPLE_ALPHA_TO_COVERAGE,
+    GL_SAMPLE_COVERAGE,
+    GL_SCISSOR_TEST,
+    GL_STENCIL_TEST,
+};
+
+static const char *kindNames[GLTEST_STATE_KIND_COUNT] = {
+    "program",
+    "activeTexture",
+    "texture",
+    "capability",
+    "blendFunc",
+    "buffer",
+    "attribArray",
+    "attribPointer",
+    "viewport",
+    "clearColor",
+};
+
+static int capabilityIndex(GLenum cap)
+{
+    for (unsigned int i = 0;
+         i < sizeof(capabilityList) / sizeof(capabilityList[0]); i++) {
+        if (capabilityList[i] == cap) { return i; }
+    }
+
+    return -1;
+}
+
+static int textureTargetIndex(GLenum target)
+{
+    switch (target) {
+    case GL_TEXTURE_2D: return 0;
+    case GL_TEXTURE_CUBE_MAP: return 1;
+    case GL_TEXTURE_EXTERNAL_OES: return 2;
+    }
+
+    return -1;
+}
+
+uint64_t GLTestStateStats::totalCalls(void) const
+{
+    uint64_t total = 0;
+    for (unsigned int kind = 0; kind < GLTEST_STATE_KIND_COUNT; kind++) {
+        total += calls[kind];
+    }
+
+    return total;
+}
+
+uint64_t GLTestStateStats::totalRedundant(void) const
+{
+    uint64_t total = 0;
+    for (unsigned int kind = 0; kind < GLTEST_STATE_KIND_COUNT; kind++) {
+        total += redundant[kind];
+    }
+
+    return total;
+}
+
+GLTestStateCache::GLTestStateCache()
+{
+    const char *env = getenv("GLTEST_STATE_FILTER");
+    _filtering = (env == NULL) || (strcmp(env, "0") != 0);
+
+    resetStats();
+    invalidate();
+}
+
+void GLTestStateCache::invalidate(void)
+{
+    _program = unknownName;
+    _activeTexture = 0;
+    for (unsigned int unit = 0; unit < maxTextureUnits; unit++) {
+        for (unsigned int target = 0; target < textureTargets; target++) {
+            _textures[unit][target] = unknownName;
+        }
+    }
+    memset(_caps, -1, sizeof(_caps));
+    _blendKnown = false;
+    _arrayBuffer = unknownName;
+    _elementBuffer = unknownName;
+    memset(_attribArrays, -1, sizeof(_attribArrays));
+    for (unsigned int index = 0; index < maxAttribs; index++) {
+        _attribPointers[index].known = false;
+    }
+    _viewportKnown = false;
+    _clearColorKnown = false;
+}
+
+void GLTestStateCache::resetStats(void)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+/*
+ * Counts a call of the given kind, and returns true if it should be
+ * dropped.
+ */
+bool GLTestStateCache::filter(GLTestStateKind kind, bool redundant)
+{
+    _stats.calls[kind]++;
+    if (redundant) { _stats.redundant[kind]++; }
+
+    return _filtering && redundant;
+}
+
+void GLTestStateCache::useProgram(GLuint program)
+{
+    if (filter(GLTEST_STATE_PROGRAM, program == _program)) { return; }
+
+    glUseProgram(program);
+    _program = program;
+}
+
+void GLTestStateCache::activeTexture(GLenum texture)
+{
+    if (filter(GLTEST_STATE_ACTIVE_TEXTURE, texture == _activeTexture)) {
+        return;
+    }
+
+    glActiveTexture(texture);
+    _activeTexture = texture;
+}
+
+void GLTestStateCache::bindTexture(GLenum target, GLuint texture)
+{
+    unsigned int unit = _activeTexture - GL_TEXTURE0;
+    int index = textureTargetIndex(target);
+    bool tracked = (_activeTexture != 0) && (unit < maxTextureUnits)
+        && (index >= 0);
+
+    if (filter(GLTEST_STATE_TEXTURE,
+               tracked && (_textures[unit][index] == texture))) {
+        return;
+    }
+
+    glBindTexture(target, texture);
+    if (tracked) { _textures[unit][index] = texture; }
+}
+
+void GLTestStateCache::enable(GLenum cap)
+{
+    int index = capabilityIndex(cap);
+
+    if (filter(GLTEST_STATE_CAPABILITY, (index >= 0) && (_caps[index] == 1))) {
+        return;
+    }
+
+    glEnable(cap);
+    if (index >= 0) { _caps[index] = 1; }
+}
+
+void GLTestStateCache::disable(GLenum cap)
+{
+    int index = capabilityIndex(cap);
+
+    if (filter(GLTEST_STATE_CAPABILITY, (index >= 0) && (_caps[index] == 0))) {
+        return;
+    }
+
+    glDisable(cap);
+    if (index >= 0) { _caps[index] = 0; }
+}
+
+void GLTestStateCache::blendFunc(GLenum sfactor, GLenum dfactor)
+{
+    if (filter(GLTEST_STATE_BLEND_FUNC, _blendKnown && (sfactor == _blendSrc)
+               && (dfactor == _blendDst))) {
+        return;
+    }
+
+    glBlendFunc(sfactor, dfactor);
+    _blendKnown = true;
+    _blendSrc = sfactor;
+    _blendDst = dfactor;
+}
+
+void GLTestStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+    GLuint *binding = NULL;
+    switch (target) {
+    case GL_ARRAY_BUFFER: binding = &_arrayBuffer; break;
+    case GL_ELEMENT_ARRAY_BUFFER: binding = &_elementBuffer; break;
+    }
+
+    if (filter(GLTEST_STATE_BUFFER, (binding != NULL) && (*binding == buffer))) {
+        return;
+    }
+
+    glBindBuffer(target, buffer);
+    if (binding != NULL) { *binding = buffer; }
+}
+
+void GLTestStateCache::enableVertexAttribArray(GLuint index)
+{
+    bool tracked = index < maxAttribs;
+
+    if (filter(GLTEST_STATE_ATTRIB_ARRAY,
+               tracked && (_attribArrays[index] == 1))) {
+        return;
+    }
+
+    glEnableVertexAttribArray(index);
+    if (tracked) { _attribArrays[index] = 1; }
+}
+
+void GLTestStateCache::disableVertexAttribArray(GLuint index)
+{
+    bool tracked = index < maxAttribs;
+
+    if (filter(GLTEST_STATE_ATTRIB_ARRAY,
+               tracked && (_attribArrays[index] == 0))) {
+        return;
+    }
+
+    glDisableVertexAttribArray(index);
+    if (tracked) { _attribArrays[index] = 0; }
+}
+
+void GLTestStateCache::vertexAttribPointer(GLuint index, GLint size,
+    GLenum type, GLboolean normalized, GLsizei stride, const void *pointer)
+{
+    // The pointer is an offset into the bound array buffer, so it only
+    // matches when that binding is known and unchanged
+    bool tracked = (index < maxAttribs) && (_arrayBuffer != unknownName);
+    bool redundant = false;
+    if (tracked) {
+        const AttribPointer& cur = _attribPointers[index];
+        redundant = cur.known && (cur.size == size) && (cur.type == type)
+            && (cur.normalized == normalized) && (cur.stride == stride)
+            && (cur.pointer == pointer) && (cur.buffer == _arrayBuffer);
+    }
+
+    if (filter(GLTEST_STATE_ATTRIB_POINTER, redundant)) { return; }
+
+    glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+    if (index < maxAttribs) {
+        AttribPointer& cur = _attribPointers[index];
+        cur.known = tracked;
+        cur.size = size;
+        cur.type = type;
+        cur.normalized = normalized;
+        cur.stride = stride;
+        cur.pointer = pointer;
+        cur.buffer = _arrayBuffer;
+    }
+}
+
+void GLTestStateCache::viewport(GLint x, GLint y, GLsizei width,
+                                GLsizei height)
+{
+    if (filter(GLTEST_STATE_VIEWPORT, _viewportKnown && (_viewport[0] == x)
+               && (_viewport[1] == y) && (_viewport[2] == width)
+               && (_viewport[3] == height))) {
+        return;
+    }
+
+    glViewport(x, y, width, height);
+    _viewportKnown = true;
+    _viewport[0] = x;
+    _viewport[1] = y;
+    _viewport[2] = width;
+    _viewport[3] = height;
+}
+
+void GLTestStateCache::clearColor(GLfloat red, GLfloat green, GLfloat blue,
+                                  GLfloat alpha)
+{
+    if (filter(GLTEST_STATE_CLEAR_COLOR, _clearColorKnown
+               && (_clearColor[0] == red) && (_clearColor[1] == green)
+               && (_clearColor[2] == blue) && (_clearColor[3] == alpha))) {
+        return;
+    }
+
+    glClearColor(red, green, blue, alpha);
+    _clearColorKnown = true;
+    _clearColor[0] = red;
+    _clearColor[1] = green;
+    _clearColor[2] = blue;
+    _clearColor[3] = alpha;
+}
+
+void GLTestStateCache::deleteProgram(GLuint program)
+{
+    // A current program is only deleted once it is no longer in use, so
+    // the binding stays valid
+    glDeleteProgram(program);
+}
+
+void GLTestStateCache::deleteTextures(GLsizei n, const GLuint *textures)
+{
+    // Deleted textures are unbound from every unit of this context
+    glDeleteTextures(n, textures);
+    for (GLsizei i = 0; i < n; i++) {
+        if (textures[i] == 0) { continue; }
+        for (unsigned int unit = 0; unit < maxTextureUnits; unit++) {
+            for (unsigned int target = 0; target < textureTargets; target++) {
+                if (_textures[unit][target] == textures[i]) {
+                    _textures[unit][target] = 0;
+                }
+            }
+        }
+    }
+}
+
+void GLTestStateCache::deleteBuffers(GLsizei n, const GLuint *buffers)
+{
+    // Deleted buffers are unbound, including from the attribute arrays
+    glDeleteBuffers(n, buffers);
+    for (GLsizei i = 0; i < n; i++) {
+        if (buffers[i] == 0) { continue; }
+        if (_arrayBuffer == buffers[i]) { _arrayBuffer = 0; }
+        if (_elementBuffer == buffers[i]) { _elementBuffer = 0; }
+        for (unsigned int index = 0; index < maxAttribs; index++) {
+            if (_attribPointers[index].buffer == buffers[i]) {
+                _attribPointers[index].known = false;
+            }
+        }
+    }
+}
+
+const char *GLTestStateCache::kindName(GLTestStateKind kind)
+{
+    return (kind < GLTEST_STATE_KIND_COUNT) ? kindNames[kind] : "unknown";
+}
+
+void GLTestStateCache::report(const char *name) const
+{
+    uint64_t calls = _stats.totalCalls();
+    uint64_t redundant = _stats.totalRedundant();
+
+    printf("%s: state calls %" PRIu64 ", redundant %" PRIu64 " (%.1f%%), %s\n",
+           name, calls, redundant,
+           (calls == 0) ? 0.0 : 100.0 * redundant / calls,
+           _filtering ? "filtered" : "forwarded");
+    for (unsigned int kind = 0; kind < GLTEST_STATE_KIND_COUNT; kind++) {
+        if (_stats.calls[kind] == 0) { continue; }
+        printf("    %-14s %10" PRIu64 " calls %10" PRIu64 " redundant\n",
+               kindNames[kind], _stats.calls[kind], _stats.redundant[kind]);
+    }
+}
@@ -25,6 +25,7 @@
 #include <utils/StopWatch.h>
 #include <WindowSurface.h>
 #include <EGLUtils.h>
+#include <glTestFrame.h>
 
 using namespace android;
 
@@ -46,15 +47,13 @@ int main(int argc, char** argv)
 
     
     WindowSurface windowSurface;
-    EGLNativeWindowType window = windowSurface.getSurface();
 
-    dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    dpy = windowSurface.getDisplay();
     eglInitialize(dpy, &majorVersion, &minorVersion);
     eglGetConfigs(dpy, NULL, 0, &numConfigs);
     printf("# configs = %d\n", numConfigs);
 
-    status_t err = EGLUtils::selectConfigForNativeWindow(
-            dpy, configAttribs, window, &config);
+    status_t err = windowSurface.selectConfig(dpy, configAttribs, &config);
     if (err) {
         fprintf(stderr, "error: %s", EGLUtils::strerror(eglGetError()));
         eglTerminate(dpy);
@@ -68,8 +67,9 @@ int main(int argc, char** argv)
     eglGetConfigAttrib(dpy, config, EGL_ALPHA_SIZE, &a);
     eglGetConfigAttrib(dpy, config, EGL_NATIVE_VISUAL_ID, &vid);
 
-    surface = eglCreateWindowSurface(dpy, config, window, NULL);
-    if (surface == EGL_NO_SURFACE) {
+    surface = windowSurface.createEGLSurface(dpy, config);
+    if (surface == EGL_NO_SURFACE
+            && windowSurface.getBackend() != WindowSurface::BACKEND_SURFACELESS) {
         EGLint err = eglGetError();
         fprintf(stderr, "error: %s, config=%p, format = %d-%d-%d-%d, visual-id = %d\n",
                 EGLUtils::strerror(err), config, r,g,b,a, vid);
@@ -81,9 +81,9 @@ int main(int argc, char** argv)
     }
 
     context = eglCreateContext(dpy, config, NULL, NULL);
-    eglMakeCurrent(dpy, surface, surface, context);   
-    eglQuerySurface(dpy, surface, EGL_WIDTH, &w);
-    eglQuerySurface(dpy, surface, EGL_HEIGHT, &h);
+    windowSurface.makeCurrent(dpy, surface, context);
+    w = windowSurface.getWidth();
+    h = windowSurface.getHeight();
 
     printf("w=%d, h=%d\n", w, h);
 
@@ -97,28 +97,32 @@ int main(int argc, char** argv)
 
     glClearColor(1,0,0,0);
     glClear(GL_COLOR_BUFFER_BIT);
-    eglSwapBuffers(dpy, surface);
+    windowSurface.swapBuffers(dpy, surface);
 
 
     int time = 10;
     printf("screen should flash red/green quickly for %d s...\n", time);
 
+    // Offscreen backends aren't vsync limited, so allow for many frames
+    GLTestFrameRecorder recorder(dpy, surface, 1 << 16);
     int c = 0;
     nsecs_t start = systemTime();
     nsecs_t t;
     do {
         glClearColor(1,0,0,0);
         glClear(GL_COLOR_BUFFER_BIT);
-        eglSwapBuffers(dpy, surface);
+        recorder.swapBuffers(windowSurface);
         glClearColor(0,1,0,0);
         glClear(GL_COLOR_BUFFER_BIT);
-        eglSwapBuffers(dpy, surface);
+        recorder.swapBuffers(windowSurface);
         t = systemTime() - start;
         c += 2;
     } while (int(ns2s(t))<=time);
 
     double p =  (double(t) / c) / 1000000000.0;
     printf("refresh-rate is %f fps (%f ms)\n", 1.0f/p, p*1000.0);
+    recorder.flush();
+    recorder.report("swapinterval");
 
     eglTerminate(dpy);
 
@@ -20,12 +20,13 @@ using namespace android;
 EGLDisplay eglDisplay;
 EGLSurface eglSurface;
 EGLContext eglContext;
+WindowSurface* eglWindowSurface;
 GLuint texture;
 
 #define FIXED_ONE 0x10000
 #define ITERATIONS 50
 
-int init_gl_surface(const WindowSurface&);
+int init_gl_surface(WindowSurface&);
 void free_gl_surface(void);
 void init_scene(void);
 void render(int quads);
@@ -118,7 +119,7 @@ int main(int argc, char **argv)
     return 0;
 }
 
-int init_gl_surface(const WindowSurface& windowSurface)
+int init_gl_surface(WindowSurface& windowSurface)
 {
     EGLint numConfigs = 1;
     EGLConfig myConfig = {0};
@@ -129,7 +130,9 @@ int init_gl_surface(const WindowSurface& windowSurface)
             EGL_NONE
     };
 
-    if ( (eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY)) == EGL_NO_DISPLAY )
+    eglWindowSurface = &windowSurface;
+
+    if ( (eglDisplay = windowSurface.getDisplay()) == EGL_NO_DISPLAY )
     {
         printf("eglGetDisplay failed\n");
         return 0;
@@ -141,11 +144,11 @@ int init_gl_surface(const WindowSurface& windowSurface)
         return 0;
     }
 
-    EGLNativeWindowType window = windowSurface.getSurface();
-    EGLUtils::selectConfigForNativeWindow(eglDisplay, attrib, window, &myConfig);
+    windowSurface.selectConfig(eglDisplay, attrib, &myConfig);
 
-    if ( (eglSurface = eglCreateWindowSurface(eglDisplay, myConfig,
-            window, 0)) == EGL_NO_SURFACE )
+    if ( (eglSurface = windowSurface.createEGLSurface(eglDisplay,
+            myConfig)) == EGL_NO_SURFACE
+            && windowSurface.getBackend() != WindowSurface::BACKEND_SURFACELESS )
     {
         printf("eglCreateWindowSurface failed\n");
         return 0;
@@ -157,7 +160,7 @@ int init_gl_surface(const WindowSurface& windowSurface)
         return 0;
     }
 
-    if ( eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext) != EGL_TRUE )
+    if ( windowSurface.makeCurrent(eglDisplay, eglSurface, eglContext) != EGL_TRUE )
     {
         printf("eglMakeCurrent failed\n");
         return 0;
@@ -172,8 +175,9 @@ void free_gl_surface(void)
     {
         eglMakeCurrent( EGL_NO_DISPLAY, EGL_NO_SURFACE,
                 EGL_NO_SURFACE, EGL_NO_CONTEXT );
-        eglDestroyContext( eglDisplay, eglContext );
-        eglDestroySurface( eglDisplay, eglSurface );
+        eglWindowSurface->destroyContext( eglDisplay, eglContext );
+        if (eglSurface != EGL_NO_SURFACE)
+            eglDestroySurface( eglDisplay, eglSurface );
         eglTerminate( eglDisplay );
         eglDisplay = EGL_NO_DISPLAY;
     }
@@ -258,10 +262,10 @@ void render(int quads)
     // no problems with the very first ones (who knows)
     glClearColor(0.4, 0.4, 0.4, 0.4);
     glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
-    eglSwapBuffers(eglDisplay, eglSurface);
+    eglWindowSurface->swapBuffers(eglDisplay, eglSurface);
     glClearColor(0.6, 0.6, 0.6, 0.6);
     glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
-    eglSwapBuffers(eglDisplay, eglSurface);
+    eglWindowSurface->swapBuffers(eglDisplay, eglSurface);
     glClearColor(1.0, 1.0, 1.0, 1.0);
 
     for (j=0 ; j<10 ; j++) {
@@ -270,7 +274,7 @@ void render(int quads)
         int nelem = sizeof(quadIndices)/sizeof(quadIndices[0]);
         glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
         glDrawElements(GL_TRIANGLES, nelem*quads, GL_UNSIGNED_SHORT, indices);
-        eglSwapBuffers(eglDisplay, eglSurface);
+        eglWindowSurface->swapBuffers(eglDisplay, eglSurface);
     }
 
     free(indices);